@@ -56,6 +56,19 @@
  */
 #define MAX_FOUND_DEVICES       25
 
+/**
+ * Size of the hashed address index of found devices (power of two, at least twice
+ * MAX_FOUND_DEVICES) and number of bits of the filter of devices already reported with their
+ * name (power of two)
+ */
+#define FOUND_INDEX_SIZE        64
+#define FOUND_FILTER_BITS       1024
+
+/**
+ * Size of the hashed connection index of peers (power of two, larger than BLE_GAP_MAX_CONNECTED)
+ */
+#define PEER_INDEX_SIZE         16
+
 /**
  * Macro checking if address is resolvable
  */
@@ -68,6 +81,13 @@
 #define GATT_CLIENT_STORAGE_ID  BLE_STORAGE_KEY_APP(0, 0)
 #define CPS_CLIENT_STORAGE_ID   BLE_STORAGE_KEY_APP(0, 1)
 
+/**
+ * Version of the attribute handle cache of bonded peers. Entries stored with other version, e.g.
+ * by an older application with different client serialization, are dropped and services are
+ * discovered again. Must be increased whenever serialization of any stored client changes.
+ */
+#define CLIENT_CACHE_VERSION    1
+
 typedef enum {
         APP_STATE_IDLE,
         APP_STATE_CONNECTING,
@@ -102,6 +122,16 @@ __RETAINED static struct {
         bool match_any;
         found_device_t devices[MAX_FOUND_DEVICES];
         size_t num_devices;
+        /* Index in devices + 1 by address hash, 0 if slot is empty */
+        uint8_t index[FOUND_INDEX_SIZE];
+        /* Bloom filter of addresses of devices reported with their name */
+        uint32_t named_filter[FOUND_FILTER_BITS / 32];
+        /* Advertising reports handled: in total, in the current and in the last full second */
+        uint32_t reports;
+        uint32_t period_reports;
+        uint32_t reports_per_sec;
+        uint32_t max_reports_per_sec;
+        OS_TICK_TIME period_start;
 } scan_state;
 
 typedef struct {
@@ -110,6 +140,13 @@ typedef struct {
         uint16_t end_h;
 } browse_req_t;
 
+/* Header of the BLE client stored in the attribute handle cache */
+typedef struct {
+        uint8_t version;
+        uint8_t reserved;
+        uint16_t length;
+} __attribute__((packed)) client_cache_hdr_t;
+
 typedef struct {
         void *next;
 
@@ -128,11 +165,19 @@ typedef struct {
         ble_client_t *cps_client;
 
         OS_TIMER cps_tmo_timer;
+
+        /* Connection time and whether services were restored from cache, for latency report */
+        OS_TICK_TIME connected_time;
+        bool cache_hit;
+        bool measurement_received;
 } peer_info_t;
 
 /* Current peers information */
 __RETAINED static queue_t peer_info_queue;
 
+/* Peers by connection index hash, linear probing */
+__RETAINED static peer_info_t *peer_index[PEER_INDEX_SIZE];
+
 /* Queue of connection indexes of peer where CPS timeout was triggered */
 __RETAINED static OS_QUEUE peer_cps_tmo_queue;
 
@@ -155,19 +200,50 @@ static bool peer_conn_idx_match(const void *data, const void *match_data)
         return peer_info->conn_idx == conn_idx;
 }
 
+/* Slot of peer in index, or the empty slot where it would be added */
+static size_t peer_index_slot(uint16_t conn_idx)
+{
+        size_t slot = conn_idx & (PEER_INDEX_SIZE - 1);
+
+        while (peer_index[slot] && peer_index[slot]->conn_idx != conn_idx) {
+                slot = (slot + 1) & (PEER_INDEX_SIZE - 1);
+        }
+
+        return slot;
+}
+
 static inline void add_peer_info(peer_info_t *peer_info)
 {
+        OS_ASSERT(queue_length(&peer_info_queue) < PEER_INDEX_SIZE - 1);
+
         queue_push_front(&peer_info_queue, peer_info);
+        peer_index[peer_index_slot(peer_info->conn_idx)] = peer_info;
 }
 
 static inline peer_info_t *remove_peer_info(uint16_t conn_idx)
 {
+        size_t slot = peer_index_slot(conn_idx);
+
+        if (!peer_index[slot]) {
+                return NULL;
+        }
+
+        /* Move back the following peers of the probe sequence, so that none becomes unreachable */
+        peer_index[slot] = NULL;
+        for (slot = (slot + 1) & (PEER_INDEX_SIZE - 1); peer_index[slot];
+                                                slot = (slot + 1) & (PEER_INDEX_SIZE - 1)) {
+                peer_info_t *peer_info = peer_index[slot];
+
+                peer_index[slot] = NULL;
+                peer_index[peer_index_slot(peer_info->conn_idx)] = peer_info;
+        }
+
         return queue_remove(&peer_info_queue, peer_conn_idx_match, &conn_idx);
 }
 
 static inline peer_info_t *find_peer_info(uint16_t conn_idx)
 {
-        return queue_find(&peer_info_queue, peer_conn_idx_match, &conn_idx);
+        return peer_index[peer_index_slot(conn_idx)];
 }
 
 #define pending_init_execute_and_check(PEER_INFO, FLAG, FUNCTION, ...)          \
@@ -259,6 +335,7 @@ static void clear_pending_action(peer_info_t *peer_info, pending_action_t action
 
 static void store_client(uint16_t conn_idx, ble_client_t *client, ble_storage_key_t key)
 {
+        client_cache_hdr_t *hdr;
         uint8_t *buffer = NULL;
         size_t length;
 
@@ -268,11 +345,20 @@ static void store_client(uint16_t conn_idx, ble_client_t *client, ble_storage_ke
 
         /* Get serialized BLE Client length */
         ble_client_serialize(client, NULL, &length);
-        buffer = OS_MALLOC(length);
+        buffer = OS_MALLOC(sizeof(*hdr) + length);
+
+        hdr = (client_cache_hdr_t *) buffer;
+        hdr->version = CLIENT_CACHE_VERSION;
+        hdr->reserved = 0;
+        hdr->length = length;
+
         /* Serialize BLE Client */
-        ble_client_serialize(client, buffer, &length);
-        /* Put BLE Client to the storage */
-        ble_storage_put_buffer(conn_idx, key, length, buffer, OS_FREE_FUNC, true);
+        ble_client_serialize(client, buffer + sizeof(*hdr), &length);
+        /*
+         * Put BLE Client to the storage, it's written to NVMS along with the bond data of the peer
+         * and restored on any subsequent connection to it.
+         */
+        ble_storage_put_buffer(conn_idx, key, sizeof(*hdr) + length, buffer, OS_FREE_FUNC, true);
 }
 
 static void purge_gatt(peer_info_t *peer_info)
@@ -318,7 +404,7 @@ static void clicmd_default_handler(int argc, const char *argv[], void *user_data
 
 static void clicmd_scan_usage(void)
 {
-        printf("usage: scan <start|stop> [any]\r\n");
+        printf("usage: scan <start|stop|stats> [any]\r\n");
         printf("\t\"any\" will disable filtering devices by CPS UUID, only valid for \"scan start\"\r\n");
 }
 
@@ -352,6 +438,13 @@ static void clicmd_scan_handler(int argc, const char *argv[], void *user_data)
 
                 scan_state.match_any = (argc > 2) && !strcmp(argv[2], "any");
                 scan_state.num_devices = 0;
+                memset(scan_state.index, 0, sizeof(scan_state.index));
+                memset(scan_state.named_filter, 0, sizeof(scan_state.named_filter));
+                scan_state.reports = 0;
+                scan_state.period_reports = 0;
+                scan_state.reports_per_sec = 0;
+                scan_state.max_reports_per_sec = 0;
+                scan_state.period_start = OS_GET_TICK_COUNT();
         } else if (!strcasecmp("stop", argv[1])) {
                 if (app_state != APP_STATE_SCANNING) {
                         printf("ERROR: application need to be in scanning state to stop "
@@ -366,6 +459,11 @@ static void clicmd_scan_handler(int argc, const char *argv[], void *user_data)
                 }
 
                 printf("Scan stopping...\r\n");
+        } else if (!strcasecmp("stats", argv[1])) {
+                printf("Advertising reports: %" PRIu32 " (%" PRIu32 "/s, max %" PRIu32 "/s)\r\n",
+                                        scan_state.reports, scan_state.reports_per_sec,
+                                        scan_state.max_reports_per_sec);
+                printf("Found devices: %u\r\n", (unsigned) scan_state.num_devices);
         } else {
                 clicmd_scan_usage();
         }
@@ -843,6 +941,11 @@ static void finish_auth(peer_info_t *peer_info, ble_error_t status)
                 start_browse(peer_info);
                 return;
         }
+
+        /* Resume actions which failed due to insufficient authentication or encryption */
+        if (peer_info->pending_init && !peer_info->browsing && (status == BLE_STATUS_OK)) {
+                process_pending_actions(peer_info);
+        }
 }
 
 static void resolve_found_device(found_device_t *dev)
@@ -853,20 +956,80 @@ static void resolve_found_device(found_device_t *dev)
         }
 }
 
-static found_device_t *get_found_device(const bd_address_t *addr, size_t *index)
+/* FNV-1a hash of address, including its type */
+static uint32_t address_hash(const bd_address_t *addr)
 {
+        uint32_t hash = 2166136261u;
         size_t i;
 
-        for (i = 0; i < scan_state.num_devices; i++) {
-                found_device_t *dev = &scan_state.devices[i];
+        for (i = 0; i < sizeof(addr->addr); i++) {
+                hash = (hash ^ addr->addr[i]) * 16777619u;
+        }
+
+        return (hash ^ addr->addr_type) * 16777619u;
+}
+
+/* Slot of device in index, or the empty slot where it would be added */
+static size_t found_index_slot(const bd_address_t *addr, uint32_t hash)
+{
+        size_t slot = hash & (FOUND_INDEX_SIZE - 1);
+
+        while (scan_state.index[slot] &&
+                        !ble_address_cmp(&scan_state.devices[scan_state.index[slot] - 1].addr, addr)) {
+                slot = (slot + 1) & (FOUND_INDEX_SIZE - 1);
+        }
+
+        return slot;
+}
 
-                if (ble_address_cmp(&dev->addr, addr)) {
-                        *index = i + 1;
-                        return dev;
+static inline uint32_t named_filter_bit(uint32_t hash, int n)
+{
+        return (n ? hash >> 16 : hash) & (FOUND_FILTER_BITS - 1);
+}
+
+static void named_filter_add(uint32_t hash)
+{
+        int n;
+
+        for (n = 0; n < 2; n++) {
+                uint32_t bit = named_filter_bit(hash, n);
+
+                scan_state.named_filter[bit / 32] |= 1u << (bit % 32);
+        }
+}
+
+/* False if device was never reported with its name, true if it may have been */
+static bool named_filter_test(uint32_t hash)
+{
+        int n;
+
+        for (n = 0; n < 2; n++) {
+                uint32_t bit = named_filter_bit(hash, n);
+
+                if (!(scan_state.named_filter[bit / 32] & (1u << (bit % 32)))) {
+                        return false;
                 }
         }
 
-        return NULL;
+        return true;
+}
+
+static found_device_t *find_found_device(const bd_address_t *addr, uint32_t hash, size_t *index)
+{
+        size_t slot = found_index_slot(addr, hash);
+
+        if (!scan_state.index[slot]) {
+                return NULL;
+        }
+
+        *index = scan_state.index[slot];
+
+        return &scan_state.devices[scan_state.index[slot] - 1];
+}
+
+static found_device_t *get_found_device(const bd_address_t *addr, size_t *index)
+{
+        return find_found_device(addr, address_hash(addr), index);
 }
 
 static found_device_t *add_found_device(const bd_address_t *addr, size_t *index)
@@ -880,6 +1043,7 @@ static found_device_t *add_found_device(const bd_address_t *addr, size_t *index)
         } else {
                 dev = &scan_state.devices[scan_state.num_devices++];
                 *index = scan_state.num_devices;
+                scan_state.index[found_index_slot(addr, address_hash(addr))] = *index;
         }
 
         dev->addr = *addr;
@@ -897,9 +1061,29 @@ static void handle_evt_gap_adv_report(const ble_evt_gap_adv_report_t *evt)
         bool new_device = false;
         const char *dev_name = NULL;
         size_t dev_name_len = 0;
+        uint32_t hash = address_hash(&evt->address);
+        OS_TICK_TIME now = OS_GET_TICK_COUNT();
 
-        dev = get_found_device(&evt->address, &dev_index);
-        if (dev && dev->name_found) {
+        if (now - scan_state.period_start >= OS_MS_2_TICKS(1000)) {
+                scan_state.reports_per_sec = scan_state.period_reports;
+                if (scan_state.reports_per_sec > scan_state.max_reports_per_sec) {
+                        scan_state.max_reports_per_sec = scan_state.reports_per_sec;
+                }
+                scan_state.period_reports = 0;
+                scan_state.period_start = now;
+        }
+        scan_state.period_reports++;
+        scan_state.reports++;
+
+        dev = find_found_device(&evt->address, hash, &dev_index);
+
+        /*
+         * Early reject of devices already reported with their name. Devices beyond
+         * MAX_FOUND_DEVICES are not in the index, the filter alone stops them from being parsed
+         * and reported again.
+         */
+        if (dev ? dev->name_found : (scan_state.num_devices >= MAX_FOUND_DEVICES &&
+                                                                named_filter_test(hash))) {
                 return;
         }
 
@@ -957,6 +1141,7 @@ static void handle_evt_gap_adv_report(const ble_evt_gap_adv_report_t *evt)
          */
         if (dev && dev_name) {
                 dev->name_found = true;
+                named_filter_add(hash);
                 printf("[%02d] Device found: %s %s (%.*s)\r\n", dev_index,
                                 evt->address.addr_type == PUBLIC_ADDRESS ? "public " : "private",
                                 ble_address_to_string(&evt->address),
@@ -970,7 +1155,8 @@ static void handle_evt_gap_adv_report(const ble_evt_gap_adv_report_t *evt)
 
 static void handle_evt_gap_scan_completed(const ble_evt_gap_scan_completed_t *evt)
 {
-        printf("Scan stopped\r\n");
+        printf("Scan stopped (%" PRIu32 " advertising reports, max %" PRIu32 "/s)\r\n",
+                                        scan_state.reports, scan_state.max_reports_per_sec);
 
         app_state = APP_STATE_IDLE;
 }
@@ -1254,6 +1440,14 @@ static void cps_measuremnet_notif_cb(ble_client_t *client,
                 return;
         }
 
+        if (!peer_info->measurement_received) {
+                peer_info->measurement_received = true;
+
+                printf("First CP Measurement %" PRIu32 " ms after connection (%s)\r\n",
+                        (uint32_t) OS_TICKS_2_MS(OS_GET_TICK_COUNT() - peer_info->connected_time),
+                        peer_info->cache_hit ? "cached services" : "service discovery");
+        }
+
         printf("CP Measurement notification received\r\n");
 
         printf("\tInstantaneous power: %d [W]\r\n", measurement->instant_power);
@@ -1448,6 +1642,8 @@ static const cps_client_callbacks_t cps_callbacks = {
 
 static ble_client_t *get_stored_client(uint16_t conn_idx, ble_storage_key_t key)
 {
+        const client_cache_hdr_t *hdr;
+        ble_client_t *client = NULL;
         ble_error_t err;
         uint16_t len = 0;
         void *buffer;
@@ -1457,14 +1653,27 @@ static ble_client_t *get_stored_client(uint16_t conn_idx, ble_storage_key_t key)
                 return NULL;
         }
 
-        switch (key) {
-        case GATT_CLIENT_STORAGE_ID:
-                return gatt_client_init_from_data(conn_idx, &gatt_callbacks, buffer, len);
-        case CPS_CLIENT_STORAGE_ID:
-                return cps_client_init_from_data(conn_idx, &cps_callbacks, buffer, len);
-        default:
-                return NULL;
+        hdr = buffer;
+        if ((len >= sizeof(*hdr)) && (hdr->version == CLIENT_CACHE_VERSION) &&
+                                                        (hdr->length == len - sizeof(*hdr))) {
+                switch (key) {
+                case GATT_CLIENT_STORAGE_ID:
+                        client = gatt_client_init_from_data(conn_idx, &gatt_callbacks, hdr + 1,
+                                                                                hdr->length);
+                        break;
+                case CPS_CLIENT_STORAGE_ID:
+                        client = cps_client_init_from_data(conn_idx, &cps_callbacks, hdr + 1,
+                                                                                hdr->length);
+                        break;
+                }
         }
+
+        /* Stale or corrupted entry, services will be discovered and stored again */
+        if (!client) {
+                ble_storage_remove(conn_idx, key);
+        }
+
+        return client;
 }
 
 static void handle_evt_gap_connected(const ble_evt_gap_connected_t *evt)
@@ -1485,6 +1694,7 @@ static void handle_evt_gap_connected(const ble_evt_gap_connected_t *evt)
 
         peer_info->addr = evt->peer_address;
         peer_info->conn_idx = evt->conn_idx;
+        peer_info->connected_time = OS_GET_TICK_COUNT();
 
         queue_init(&peer_info->pending_browse_queue);
 
@@ -1504,6 +1714,9 @@ static void handle_evt_gap_connected(const ble_evt_gap_connected_t *evt)
                 } else {
                         cps_client_cap_t cps_cap;
 
+                        printf("\tServices restored from cache\r\n");
+                        peer_info->cache_hit = true;
+
                         add_pending_action(peer_info, PENDING_ACTION_ENABLE_MEASUREMENT_NOTIF);
                         add_pending_action(peer_info, PENDING_ACTION_READ_FEATURES);
                         add_pending_action(peer_info, PENDING_ACTION_READ_SENSOR_LOCATION);
@@ -0,0 +1,283 @@
+/**
+ ****************************************************************************************
+ *
+ * @file cp_pipeline.c
+ *
+ * @brief Cycling Power sample pipeline
+ *
+ * Copyright (c) 2026 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "osal.h"
+#include "sdk_defs.h"
+#include "cp_pipeline.h"
+
+/* Make sure ring data are accessed in program order with respect to the indexes */
+#define RING_BARRIER()                  __DMB()
+
+/* A revolution taking longer than this means the crank has stopped, it is not reported */
+#define CP_REVOLUTION_TIMEOUT_MS        (4000)
+
+/* Half width (degrees) of the ranges around 0 and 180 degrees searched for the dead spots */
+#define CP_DEAD_SPOT_RANGE              (45)
+
+/* 2 * pi / 32 in 1/1024 units, i.e. energy (1/1024 J) per 1/32 Nm of torque over a revolution */
+#define CP_TORQUE_TO_ENERGY             (201)
+
+void cp_sample_ring_reset(cp_sample_ring_t *ring)
+{
+        OS_ASSERT((CP_SAMPLE_RING_SIZE & (CP_SAMPLE_RING_SIZE - 1)) == 0);
+
+        ring->head = 0;
+        ring->tail = 0;
+        ring->overruns = 0;
+}
+
+bool cp_sample_ring_put(cp_sample_ring_t *ring, const cp_sample_t *sample)
+{
+        uint32_t head = ring->head;
+
+        if (head - ring->tail >= CP_SAMPLE_RING_SIZE) {
+                ring->overruns++;
+                return false;
+        }
+
+        ring->samples[head & (CP_SAMPLE_RING_SIZE - 1)] = *sample;
+        RING_BARRIER();
+        ring->head = head + 1;
+
+        return true;
+}
+
+bool cp_sample_ring_get(cp_sample_ring_t *ring, cp_sample_t *sample)
+{
+        uint32_t tail = ring->tail;
+
+        if (ring->head == tail) {
+                return false;
+        }
+
+        RING_BARRIER();
+        *sample = ring->samples[tail & (CP_SAMPLE_RING_SIZE - 1)];
+        RING_BARRIER();
+        ring->tail = tail + 1;
+
+        return true;
+}
+
+static uint16_t ms_to_1024(uint32_t time_ms)
+{
+        return (uint16_t)(((uint64_t) time_ms * 1024) / 1000);
+}
+
+static void start_revolution(cp_aggregator_t *agg, uint32_t time_ms)
+{
+        agg->rev_start_ms = time_ms;
+        agg->rev_samples = 0;
+        agg->torque_sum = 0;
+        agg->max_magnitude = INT16_MIN;
+        agg->min_magnitude = INT16_MAX;
+        agg->max_angle = 0;
+        agg->min_angle = 0;
+        agg->top_dead_spot_magnitude = INT16_MAX;
+        agg->bottom_dead_spot_magnitude = INT16_MAX;
+}
+
+static void flush_vector(cp_aggregator_t *agg)
+{
+        uint32_t buf[(sizeof(cps_power_vector_t) + CP_VECTOR_BATCH_LEN * sizeof(int16_t) +
+                                                        sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+        cps_power_vector_t *vector = (cps_power_vector_t *) buf;
+
+        if (agg->vector_len == 0) {
+                return;
+        }
+
+        if (agg->cb && agg->cb->vector) {
+                memset(buf, 0, sizeof(buf));
+                vector->crank_revolution_data_present = true;
+                vector->crs_cumul_crank_revol = agg->crank_revolutions;
+                vector->crs_last_crank_evt_time = agg->last_crank_event_time;
+                vector->crank_measurement_angle_present = true;
+                vector->first_crank_measur_angle = agg->vector_first_angle;
+                vector->vector_direction = agg->direction;
+                vector->instantaneous_magnitude_len = agg->vector_len;
+                memcpy(vector->instantaneous_magnitude_arr, agg->vector_magnitudes,
+                                                        agg->vector_len * sizeof(int16_t));
+
+                agg->cb->vector(vector);
+        }
+
+        agg->vector_len = 0;
+}
+
+static void complete_revolution(cp_aggregator_t *agg, uint32_t time_ms)
+{
+        cps_measurement_t measurement = { 0 };
+        uint32_t duration_ms = time_ms - agg->rev_start_ms;
+        int32_t avg_torque;
+
+        /* Magnitudes of the revolution go out before its measurement */
+        flush_vector(agg);
+
+        if (agg->rev_samples == 0 || duration_ms == 0) {
+                return;
+        }
+
+        avg_torque = agg->torque_sum / agg->rev_samples;
+
+        agg->crank_revolutions++;
+        agg->last_crank_event_time = ms_to_1024(time_ms);
+        agg->accumulated_torque += (uint16_t) avg_torque;
+        if (avg_torque > 0) {
+                agg->energy_frac += avg_torque * CP_TORQUE_TO_ENERGY;
+                agg->energy += agg->energy_frac / 1024;
+                agg->energy_frac %= 1024;
+        }
+
+        if (!agg->cb || !agg->cb->measurement) {
+                return;
+        }
+
+        /* Work done over the revolution divided by its duration */
+        measurement.instant_power = (int16_t)(((int64_t) avg_torque * CP_TORQUE_TO_ENERGY * 1000) /
+                                                                ((int64_t) duration_ms * 1024));
+
+        measurement.crank_revolution_data_present = true;
+        measurement.crd_cumulative_revol = agg->crank_revolutions;
+        measurement.crd_last_crank_evt_time = agg->last_crank_event_time;
+
+        measurement.accumulated_torque_present = true;
+        measurement.accumulated_torque = agg->accumulated_torque;
+
+        if (agg->torque_based) {
+                measurement.extreme_torque_magnitude_present = true;
+                measurement.etm_max_torq_magnitude = agg->max_magnitude;
+                measurement.etm_min_torq_magnitude = agg->min_magnitude;
+        } else {
+                measurement.extreme_force_magnitude_present = true;
+                measurement.efm_max_force_magnitude = agg->max_magnitude;
+                measurement.efm_min_force_magnitude = agg->min_magnitude;
+        }
+
+        measurement.extreme_angle_present = true;
+        measurement.ea_maximum_angle = agg->max_angle;
+        measurement.ea_minimum_angle = agg->min_angle;
+
+        if (agg->top_dead_spot_magnitude != INT16_MAX) {
+                measurement.top_dead_spot_angle_present = true;
+                measurement.top_dead_spot_angle = agg->top_dead_spot;
+        }
+
+        if (agg->bottom_dead_spot_magnitude != INT16_MAX) {
+                measurement.bottom_dead_spot_angle_present = true;
+                measurement.bottom_dead_spot_angle = agg->bottom_dead_spot;
+        }
+
+        measurement.accumulated_energy_present = true;
+        measurement.accumulated_energy = (uint16_t)(agg->energy / 1000);
+
+        agg->cb->measurement(&measurement);
+}
+
+void cp_aggregator_init(cp_aggregator_t *agg, const cp_pipeline_callbacks_t *cb,
+                        bool torque_based, uint16_t crank_length, cps_vector_direction_t direction)
+{
+        memset(agg, 0, sizeof(*agg));
+
+        agg->cb = cb;
+        agg->torque_based = torque_based;
+        agg->crank_length = crank_length;
+        agg->direction = direction;
+}
+
+void cp_aggregator_add(cp_aggregator_t *agg, const cp_sample_t *sample)
+{
+        int16_t magnitude = sample->magnitude;
+        uint16_t angle = sample->angle;
+        int32_t torque;
+
+        if (!agg->started) {
+                agg->started = true;
+                start_revolution(agg, sample->time_ms);
+        } else if (angle < agg->prev_angle) {
+                /* Crank angle wrapped, the revolution is complete */
+                complete_revolution(agg, sample->time_ms);
+                start_revolution(agg, sample->time_ms);
+        } else if (sample->time_ms - agg->rev_start_ms > CP_REVOLUTION_TIMEOUT_MS) {
+                agg->vector_len = 0;
+                start_revolution(agg, sample->time_ms);
+        }
+        agg->prev_angle = angle;
+
+        /* Torque (1/32 Nm) from force (N) and crank length (1/2 mm): F * L / 2000 * 32 */
+        torque = agg->torque_based ? magnitude : (magnitude * agg->crank_length * 2) / 125;
+        agg->torque_sum += torque;
+        agg->rev_samples++;
+
+        if (magnitude > agg->max_magnitude) {
+                agg->max_magnitude = magnitude;
+                agg->max_angle = angle;
+        }
+
+        if (magnitude < agg->min_magnitude) {
+                agg->min_magnitude = magnitude;
+                agg->min_angle = angle;
+        }
+
+        if (angle < CP_DEAD_SPOT_RANGE || angle >= 360 - CP_DEAD_SPOT_RANGE) {
+                if (magnitude < agg->top_dead_spot_magnitude) {
+                        agg->top_dead_spot_magnitude = magnitude;
+                        agg->top_dead_spot = angle;
+                }
+        } else if (angle >= 180 - CP_DEAD_SPOT_RANGE && angle < 180 + CP_DEAD_SPOT_RANGE) {
+                if (magnitude < agg->bottom_dead_spot_magnitude) {
+                        agg->bottom_dead_spot_magnitude = magnitude;
+                        agg->bottom_dead_spot = angle;
+                }
+        }
+
+        if (agg->vector_len == 0) {
+                agg->vector_first_angle = angle;
+        }
+        agg->vector_magnitudes[agg->vector_len++] = magnitude;
+        if (agg->vector_len == CP_VECTOR_BATCH_LEN) {
+                flush_vector(agg);
+        }
+}
+
+uint32_t cp_aggregator_drain(cp_aggregator_t *agg, cp_sample_ring_t *ring)
+{
+        cp_sample_t sample;
+        uint32_t count = 0;
+
+        while (cp_sample_ring_get(ring, &sample)) {
+                cp_aggregator_add(agg, &sample);
+                count++;
+        }
+
+        return count;
+}
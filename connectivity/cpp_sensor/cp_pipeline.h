@@ -0,0 +1,189 @@
+/**
+ ****************************************************************************************
+ *
+ * @file cp_pipeline.h
+ *
+ * @brief Cycling Power sample pipeline
+ *
+ * Copyright (c) 2026 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef CP_PIPELINE_H_
+#define CP_PIPELINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cps.h"
+
+/* Number of samples buffered between the sensor and the task, power of two */
+#ifndef CP_SAMPLE_RING_SIZE
+#define CP_SAMPLE_RING_SIZE     (64)
+#endif
+
+/* Number of magnitudes sent in one CP Vector, as many as fit in the default ATT MTU */
+#ifndef CP_VECTOR_BATCH_LEN
+#define CP_VECTOR_BATCH_LEN     (6)
+#endif
+
+/**
+ * Crank sensor sample
+ */
+typedef struct {
+        /* Sample time in ms */
+        uint32_t time_ms;
+        /* Crank angle in degrees (0-359), increasing while pedaling */
+        uint16_t angle;
+        /* Force (N) or torque (1/32 Nm) depending on sensor measurement context */
+        int16_t magnitude;
+} cp_sample_t;
+
+/**
+ * Sample ring
+ *
+ * Single producer (e.g. the sensor interrupt or timer) and single consumer (the application
+ * task) ring of samples. Head and tail are free-running indexes.
+ */
+typedef struct {
+        cp_sample_t samples[CP_SAMPLE_RING_SIZE];
+        volatile uint32_t head;
+        volatile uint32_t tail;
+        /* Samples dropped because the ring was full */
+        uint32_t overruns;
+} cp_sample_ring_t;
+
+/**
+ * Revolution callbacks
+ */
+typedef struct {
+        /* Measurement of a completed crank revolution */
+        void (* measurement)(const cps_measurement_t *measurement);
+        /* Batch of up to CP_VECTOR_BATCH_LEN magnitudes of the revolution in progress */
+        void (* vector)(const cps_power_vector_t *vector);
+} cp_pipeline_callbacks_t;
+
+/**
+ * Sample aggregator
+ *
+ * Aggregates the samples of a crank revolution incrementally: extreme magnitudes and their
+ * angles, dead spot angles and average torque. Once the crank angle wraps, a measurement with
+ * crank revolution data, instantaneous power, accumulated torque and accumulated energy is
+ * emitted. Magnitudes are batched into power vectors as they arrive.
+ */
+typedef struct {
+        const cp_pipeline_callbacks_t *cb;
+        bool torque_based;
+        uint16_t crank_length;                  /* 1/2 mm */
+        cps_vector_direction_t direction;
+
+        /* Revolution in progress */
+        bool started;
+        uint16_t prev_angle;
+        uint32_t rev_start_ms;
+        uint16_t rev_samples;
+        int32_t torque_sum;                     /* 1/32 Nm */
+        int16_t max_magnitude;
+        int16_t min_magnitude;
+        uint16_t max_angle;
+        uint16_t min_angle;
+        uint16_t top_dead_spot;                 /* Angle of the weakest sample around 0 deg */
+        uint16_t bottom_dead_spot;              /* Angle of the weakest sample around 180 deg */
+        int16_t top_dead_spot_magnitude;
+        int16_t bottom_dead_spot_magnitude;
+
+        /* Totals since start */
+        uint16_t crank_revolutions;
+        uint16_t last_crank_event_time;         /* 1/1024 s */
+        uint16_t accumulated_torque;            /* 1/32 Nm */
+        uint32_t energy;                        /* J */
+        uint32_t energy_frac;                   /* 1/1024 J */
+
+        /* Power vector batch */
+        uint8_t vector_len;
+        uint16_t vector_first_angle;
+        int16_t vector_magnitudes[CP_VECTOR_BATCH_LEN];
+} cp_aggregator_t;
+
+/**
+ * \brief Reset sample ring
+ *
+ * \param [in]          ring            sample ring
+ */
+void cp_sample_ring_reset(cp_sample_ring_t *ring);
+
+/**
+ * \brief Put sample into ring
+ *
+ * Called by the producer only.
+ *
+ * \param [in]          ring            sample ring
+ * \param [in]          sample          sample
+ *
+ * \return true if sample was stored, false if ring is full and sample was dropped
+ */
+bool cp_sample_ring_put(cp_sample_ring_t *ring, const cp_sample_t *sample);
+
+/**
+ * \brief Get oldest sample from ring
+ *
+ * Called by the consumer only.
+ *
+ * \param [in]          ring            sample ring
+ * \param [out]         sample          sample
+ *
+ * \return true if a sample was taken, false if ring is empty
+ */
+bool cp_sample_ring_get(cp_sample_ring_t *ring, cp_sample_t *sample);
+
+/**
+ * \brief Initialize sample aggregator
+ *
+ * \param [in]          agg             aggregator
+ * \param [in]          cb              revolution callbacks
+ * \param [in]          torque_based    samples are torque (true) or force (false) magnitudes
+ * \param [in]          crank_length    crank length in 1/2 mm, used to get torque from force
+ * \param [in]          direction       direction of the power vector magnitudes
+ */
+void cp_aggregator_init(cp_aggregator_t *agg, const cp_pipeline_callbacks_t *cb,
+                        bool torque_based, uint16_t crank_length, cps_vector_direction_t direction);
+
+/**
+ * \brief Add sample to aggregator
+ *
+ * Callbacks are called from this function once a vector batch is full or a revolution completes.
+ *
+ * \param [in]          agg             aggregator
+ * \param [in]          sample          sample
+ */
+void cp_aggregator_add(cp_aggregator_t *agg, const cp_sample_t *sample);
+
+/**
+ * \brief Aggregate all samples of ring
+ *
+ * \param [in]          agg             aggregator
+ * \param [in]          ring            sample ring
+ *
+ * \return number of samples aggregated
+ */
+uint32_t cp_aggregator_drain(cp_aggregator_t *agg, cp_sample_ring_t *ring);
+
+#endif /* CP_PIPELINE_H_ */
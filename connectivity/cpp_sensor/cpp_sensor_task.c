@@ -40,25 +40,40 @@
 #include "ble_common.h"
 #include "ble_service.h"
 #include "cps.h"
+#include "cp_pipeline.h"
 #include "dis.h"
 #include "ble_gattc.h"
 
-#define CP_MEASUREMENT_INTERVAL_MS (1000)
+/* Crank sensor sampling rate, measurements are sent once per crank revolution */
+#define CP_SAMPLING_RATE_HZ (50)
 
-#define CP_MEASUREMENT_INTERVAL OS_MS_2_TICKS(CP_MEASUREMENT_INTERVAL_MS)
+#define CP_SAMPLE_INTERVAL OS_MS_2_TICKS(1000 / CP_SAMPLING_RATE_HZ)
 
-#define CP_MEASUREMENT_NOTIF (1 << 1)
+#define CP_SAMPLE_NOTIF (1 << 1)
+
+/* Crank length in 1/2 mm (172.5 mm) */
+#define CP_CRANK_LENGTH (345)
+
+/* Cadence of the simulated crank sensor */
+#define CP_SIM_CADENCE_RPM (90)
+
+/* Max number of collectors (e.g. head unit, phone and trainer) served at the same time */
+#ifndef CPP_SENSOR_MAX_CONNECTIONS
+#define CPP_SENSOR_MAX_CONNECTIONS (3)
+#endif
 
 /* Instance of CPS Service */
 PRIVILEGED_DATA static ble_service_t *cps;
-/* Register device's connection index for power measurements */
-INITIALISED_PRIVILEGED_DATA static uint16_t measure_notif_conn_idx = BLE_CONN_IDX_INVALID;
-/* Timer used for sending measurements */
-PRIVILEGED_DATA static OS_TIMER cp_measure_timer;
-/* Measurement value */
-INITIALISED_PRIVILEGED_DATA static cps_measurement_t measurement = {
-        .instant_power = 0,
-};
+/* Number of connected collectors */
+PRIVILEGED_DATA static uint8_t connected_count;
+/* Timer used for sampling the crank sensor */
+PRIVILEGED_DATA static OS_TIMER cp_sample_timer;
+/* Samples from the crank sensor to the task */
+PRIVILEGED_DATA static cp_sample_ring_t cp_samples;
+/* Aggregator of the samples into measurements and power vectors */
+PRIVILEGED_DATA static cp_aggregator_t cp_aggregator;
+/* Simulated crank angle in 1/100 degrees */
+PRIVILEGED_DATA static uint16_t sim_crank_angle;
 
 /*
  * CPP advertising and scan response data
@@ -106,31 +121,71 @@ static const cps_config_t cps_config =  {
         .supported_sensor_locations = sensor_locations,
         .supported_sensor_locations_count = sizeof(sensor_locations),
         .init_location = CPS_SENSOR_LOCATION_OTHER,
-        .sampling_rate = 50, /* Expected values are between 25 Hz and 50 Hz */
+        .sampling_rate = CP_SAMPLING_RATE_HZ, /* Expected values are between 25 Hz and 50 Hz */
+        .supported_features = CPS_FEATURE_ACCUMULATED_TORQUE_SUPPORRT |
+                              CPS_FEATURE_CRANK_REVOLUTION_DATA_SUPPORT |
+                              CPS_FEATURE_EXTREME_MAGNITUDE_SUPPORT |
+                              CPS_FEATURE_EXTREME_ANGLE_SUPPORT |
+                              CPS_FEATURE_TOP_AND_BOTTOM_DEAD_SPOT_ANGLES_SUPPORT |
+                              CPS_FEATURE_ACCUMULATED_ENERGY_SUPPORT,
+        .init_crank_length = CP_CRANK_LENGTH,
+        .power_vector_support = true,
 };
 
-static void measure_timer_cb(TimerHandle_t timer)
+/*
+ * Simulated crank sensor, sampled from the timer task: the force peaks at 90 degrees on the
+ * down stroke and is lowest at 270 degrees.
+ */
+static void sample_timer_cb(TimerHandle_t timer)
 {
         OS_TASK task = (OS_TASK) pvTimerGetTimerID(timer);
+        cp_sample_t sample;
+        int16_t from_peak;
+
+        sim_crank_angle = (sim_crank_angle + CP_SIM_CADENCE_RPM * 600 / CP_SAMPLING_RATE_HZ) % 36000;
 
-        OS_TASK_NOTIFY(task, CP_MEASUREMENT_NOTIF, OS_NOTIFY_SET_BITS);
+        sample.time_ms = OS_TICKS_2_MS(OS_GET_TICK_COUNT());
+        sample.angle = sim_crank_angle / 100;
+        from_peak = sample.angle >= 270 ? 450 - sample.angle : sample.angle - 90;
+        from_peak = from_peak < 0 ? -from_peak : from_peak;
+        sample.magnitude = 50 + 200 * (180 - from_peak) / 180 + rand() % 21 - 10;
+
+        if (cp_sample_ring_put(&cp_samples, &sample)) {
+                OS_TASK_NOTIFY(task, CP_SAMPLE_NOTIF, OS_NOTIFY_SET_BITS);
+        }
 }
 
-static void measure_notification_changed_cb(ble_service_t *svc, uint16_t conn_idx, bool enabled)
+static void notification_changed_cb(ble_service_t *svc, uint16_t conn_idx, bool enabled)
 {
-        if (enabled) {
-                measure_notif_conn_idx = conn_idx;
-                /* Start measurement notification timer */
-                OS_TIMER_START(cp_measure_timer, CP_MEASUREMENT_INTERVAL);
+        /* The sensor is sampled while any client has enabled measurements or power vectors */
+        if (cps_get_measurement_subscribers(svc) > 0 || cps_get_vector_subscribers(svc) > 0) {
+                if (!OS_TIMER_IS_ACTIVE(cp_sample_timer)) {
+                        OS_TIMER_START(cp_sample_timer, OS_TIMER_FOREVER);
+                }
         } else {
-                measure_notif_conn_idx = BLE_CONN_IDX_INVALID;
-                /* Stop measurement notification timer */
-                OS_TIMER_STOP(cp_measure_timer, 0);
+                OS_TIMER_STOP(cp_sample_timer, OS_TIMER_FOREVER);
         }
 }
 
 static const cps_callbacks_t cps_callbacks = {
-        .measur_notif_changed       = measure_notification_changed_cb,
+        .measur_notif_changed       = notification_changed_cb,
+        .power_vector_notif_changed = notification_changed_cb,
+};
+
+static void revolution_measurement_cb(const cps_measurement_t *measurement)
+{
+        /* Encoded once and sent to every subscriber that can take it */
+        cps_notify_cp_measurement(cps, measurement);
+}
+
+static void revolution_vector_cb(const cps_power_vector_t *vector)
+{
+        cps_notify_cp_vector(cps, vector);
+}
+
+static const cp_pipeline_callbacks_t cp_pipeline_callbacks = {
+        .measurement = revolution_measurement_cb,
+        .vector      = revolution_vector_cb,
 };
 
 static void handle_evt_gap_pair_req(ble_evt_gap_pair_req_t *evt)
@@ -138,9 +193,20 @@ static void handle_evt_gap_pair_req(ble_evt_gap_pair_req_t *evt)
         ble_gap_pair_reply(evt->conn_idx, true, evt->bond);
 }
 
+static void handle_evt_gap_connected(ble_evt_gap_connected_t *evt)
+{
+        /* Keep accepting collectors while there are free connections */
+        if (++connected_count < CPP_SENSOR_MAX_CONNECTIONS) {
+                ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
+        }
+}
+
 static void handle_evt_gap_disconnected(ble_evt_gap_disconnected_t *evt)
 {
-        ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
+        /* Advertising is already running unless all connections were in use */
+        if (connected_count-- == CPP_SENSOR_MAX_CONNECTIONS) {
+                ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
+        }
 }
 
 void cpp_sensor_task(void *params)
@@ -177,10 +243,15 @@ void cpp_sensor_task(void *params)
         ble_service_add(cps);
 
         /*
-         * Set timer with 1 sec delay
+         * Set crank sensor sampling timer and the pipeline turning samples into notifications
          */
-        cp_measure_timer = OS_TIMER_CREATE("cp", CP_MEASUREMENT_INTERVAL, pdTRUE,
-                                                (void *) OS_GET_CURRENT_TASK(), measure_timer_cb);
+        cp_sample_ring_reset(&cp_samples);
+        cp_aggregator_init(&cp_aggregator, &cp_pipeline_callbacks,
+                        cps_config.cfg_measurement_context_type ==
+                                                CPS_SENSOR_MEASUREMENT_CONTEXT_TORQUE_BASED,
+                        CP_CRANK_LENGTH, cps_config.cfg_vector_direction);
+        cp_sample_timer = OS_TIMER_CREATE("cp", CP_SAMPLE_INTERVAL, pdTRUE,
+                                                (void *) OS_GET_CURRENT_TASK(), sample_timer_cb);
 
         /*
          * Set advertising data and scan response, then start advertising.
@@ -230,6 +301,7 @@ void cpp_sensor_task(void *params)
                                         handle_evt_gap_disconnected((ble_evt_gap_disconnected_t *) hdr);
                                         break;
                                 case BLE_EVT_GAP_CONNECTED:
+                                        handle_evt_gap_connected((ble_evt_gap_connected_t *) hdr);
                                         break;
                                 default:
                                         ble_handle_event_default(hdr);
@@ -250,13 +322,9 @@ no_event:
                         }
                 }
 
-                if (notif & CP_MEASUREMENT_NOTIF) {
-                        /* Randomize power measurement values */
-                        measurement.instant_power = rand() % 100;
-
-                        if (measure_notif_conn_idx != BLE_CONN_IDX_INVALID) {
-                                cps_send_cp_measurement(cps, measure_notif_conn_idx, &measurement);
-                        }
+                if (notif & CP_SAMPLE_NOTIF) {
+                        /* Measurements and power vectors are sent as revolutions complete */
+                        cp_aggregator_drain(&cp_aggregator, &cp_samples);
                 }
         }
 }
@@ -562,7 +562,8 @@ bool cps_mask_cp_measurement_char_cfm(ble_service_t *svc, uint16_t conn_idx, cps
 /**
  * \brief Send CP measurement
  *
- * Function sends cp measurement to specified client
+ * Function sends cp measurement to specified client. The measurement is dropped if the client has
+ * CPS_MEASUREMENT_MAX_INFLIGHT measurements not yet sent.
  *
  * \param [in]          svc             CP service instance
  * \param [in]          conn_idx        connection index
@@ -573,6 +574,48 @@ bool cps_mask_cp_measurement_char_cfm(ble_service_t *svc, uint16_t conn_idx, cps
 bool cps_send_cp_measurement(ble_service_t *svc, uint16_t conn_idx,
                                                              const cps_measurement_t *measurement);
 
+/**
+ * \brief Notify CP measurement to all subscribers
+ *
+ * Function encodes cp measurement once and sends it to every client which enabled notifications.
+ * A client which has CPS_MEASUREMENT_MAX_INFLIGHT measurements not yet sent, or for which the
+ * BLE stack cannot take the notification, skips this measurement.
+ *
+ * \param [in]          svc             CP service instance
+ * \param [in]          measurement     CP measurement
+ *
+ * \return number of clients the measurement was sent to
+ */
+uint8_t cps_notify_cp_measurement(ble_service_t *svc, const cps_measurement_t *measurement);
+
+/**
+ * \brief Get number of CP measurement subscribers
+ *
+ * \param [in]          svc             CP service instance
+ *
+ * \return number of connected clients which enabled CP measurement notifications
+ */
+uint8_t cps_get_measurement_subscribers(ble_service_t *svc);
+
+/**
+ * \brief Get number of CP vector subscribers
+ *
+ * \param [in]          svc             CP service instance
+ *
+ * \return number of connected clients which enabled CP vector notifications
+ */
+uint8_t cps_get_vector_subscribers(ble_service_t *svc);
+
+/**
+ * \brief Get number of CP measurements dropped for a client
+ *
+ * \param [in]          svc             CP service instance
+ * \param [in]          conn_idx        connection index
+ *
+ * \return number of measurements not sent to the client since it connected
+ */
+uint32_t cps_get_measurement_dropped(ble_service_t *svc, uint16_t conn_idx);
+
 /**
  * \brief Send CP vector
  *
@@ -586,6 +629,18 @@ bool cps_send_cp_measurement(ble_service_t *svc, uint16_t conn_idx,
  */
 bool cps_send_cp_vector(ble_service_t *svc, uint16_t conn_idx, const cps_power_vector_t *vector);
 
+/**
+ * \brief Notify CP vector to all subscribers
+ *
+ * Function sends cp vector to every client which enabled notifications
+ *
+ * \param [in]          svc             CP service instance
+ * \param [in]          vector          CP vector
+ *
+ * \return number of clients the vector was sent to
+ */
+uint8_t cps_notify_cp_vector(ble_service_t *svc, const cps_power_vector_t *vector);
+
 /**
  * \brief Send CP Power Vector notification enable confirmation
  *
@@ -31,9 +31,11 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "osal.h"
+#include "sdk_defs.h"
 #include "ble_att.h"
 #include "ble_bufops.h"
 #include "ble_common.h"
+#include "ble_gap.h"
 #include "ble_gatts.h"
 #include "ble_uuid.h"
 #include "ble_storage.h"
@@ -54,6 +56,27 @@
 #define SENSOR_LOCATION_SIZE   (1)
 #define POWER_MEASUREMENT_SIZE (34)
 
+/*
+ * Number of connections tracked by the service (CCC values, CP Measurement subscribers). CCC
+ * values of other connections are looked up in the BLE storage.
+ */
+#ifndef CPS_MAX_CONNECTIONS
+#define CPS_MAX_CONNECTIONS    (BLE_GAP_MAX_CONNECTED)
+#endif
+
+/*
+ * Max number of CP Measurement notifications queued for a connection. Further measurements are
+ * dropped for that connection until one has been sent, so a slow link does not hold the others.
+ */
+#ifndef CPS_MEASUREMENT_MAX_INFLIGHT
+#define CPS_MEASUREMENT_MAX_INFLIGHT (2)
+#endif
+
+/* Max number of fields of a CP Measurement, including the Instantaneous Power */
+#define CPS_MEASUREMENT_MAX_FIELDS (13)
+/* Field length marking the Extreme Angles, packed from two 12-bit values */
+#define CPS_EXTREME_ANGLES_LEN     (3)
+
 #define CPS_ALL_SUPPORTED_FEATURES_MASK (CPS_FEATURE_PEDAL_POWER_BALANCE_SUPPORT    | \
                                 CPS_FEATURE_ACCUMULATED_TORQUE_SUPPORRT             | \
                                 CPS_FEATURE_WHEEL_REVOLUTION_DATA_SUPPORT           | \
@@ -133,6 +156,68 @@ typedef enum {
         CPS_PM_FLAGS_OFFSET_COMPENSATION_INDICATOR       = 0x1000,
 } cps_measurement_flags_t;
 
+/*
+ * CP Measurement field, copied from cps_measurement_t if its flag is set (0 if always present).
+ * Values are kept in the byte order of the CPU, which is the little-endian order of the packet.
+ */
+typedef struct {
+        uint16_t flag;
+        uint8_t  offset;
+        uint8_t  len;
+} cps_measurement_field_t;
+
+/* CP Measurement fields, in the order of the characteristic value */
+static const cps_measurement_field_t measurement_fields[] = {
+        { 0, offsetof(cps_measurement_t, instant_power), 2 },
+        { CPS_PM_FLAGS_PEDAL_POWER_BALANCE_PRESENT,
+                offsetof(cps_measurement_t, pedal_power_balance), 1 },
+        { CPS_PM_FLAGS_ACCUMULATED_TORQUE_PRESENT,
+                offsetof(cps_measurement_t, accumulated_torque), 2 },
+        { CPS_PM_FLAGS_WHEEL_REVOLUTION_DATA_PRESENT,
+                offsetof(cps_measurement_t, wrd_cumulative_revol), 4 },
+        { CPS_PM_FLAGS_WHEEL_REVOLUTION_DATA_PRESENT,
+                offsetof(cps_measurement_t, wrd_last_wheel_evt_time), 2 },
+        { CPS_PM_FLAGS_CRANK_REVOLUTION_DATA_PRESENT,
+                offsetof(cps_measurement_t, crd_cumulative_revol), 2 },
+        { CPS_PM_FLAGS_CRANK_REVOLUTION_DATA_PRESENT,
+                offsetof(cps_measurement_t, crd_last_crank_evt_time), 2 },
+        { CPS_PM_FLAGS_EXTREME_FORCE_MAGNITUDES_PRESENT,
+                offsetof(cps_measurement_t, efm_max_force_magnitude), 2 },
+        { CPS_PM_FLAGS_EXTREME_FORCE_MAGNITUDES_PRESENT,
+                offsetof(cps_measurement_t, efm_min_force_magnitude), 2 },
+        { CPS_PM_FLAGS_EXTREME_TORQUE_MAGNITUDES_PRESENT,
+                offsetof(cps_measurement_t, etm_max_torq_magnitude), 2 },
+        { CPS_PM_FLAGS_EXTREME_TORQUE_MAGNITUDES_PRESENT,
+                offsetof(cps_measurement_t, etm_min_torq_magnitude), 2 },
+        { CPS_PM_FLAGS_EXTREME_ANGLES_PRESENT,
+                offsetof(cps_measurement_t, ea_maximum_angle), CPS_EXTREME_ANGLES_LEN },
+        { CPS_PM_FLAGS_TOP_DEAD_SPOT_ANGLE_PRESENT,
+                offsetof(cps_measurement_t, top_dead_spot_angle), 2 },
+        { CPS_PM_FLAGS_BOTTOM_DEAD_SPOT_ANGLE_PRESENT,
+                offsetof(cps_measurement_t, bottom_dead_spot_angle), 2 },
+        { CPS_PM_FLAGS_ACCUMULATED_ENERGY_PRESENT,
+                offsetof(cps_measurement_t, accumulated_energy), 2 },
+};
+
+/*
+ * Encoding plan of a CP Measurement, i.e. the fields to copy for a given set of flags. It is built
+ * again only when the flags change, so sending a measurement is a sequence of copies.
+ */
+typedef struct {
+        uint16_t flags;
+        uint8_t  num_fields;
+        cps_measurement_field_t fields[CPS_MEASUREMENT_MAX_FIELDS];
+} cps_measurement_plan_t;
+
+/* Connection state: CCC values, as stored in the BLE storage, and CP Measurements in flight */
+typedef struct {
+        uint16_t conn_idx;
+        uint16_t measurement_ccc;
+        uint16_t vector_ccc;
+        uint8_t  measurement_inflight;
+        uint32_t measurement_dropped;
+} cps_conn_t;
+
 /**
  * Cycling Power Vector characteristic flags
  */
@@ -181,6 +266,11 @@ typedef struct {
         /* Sensor context for determining force based (0) or torque based (1) measurements */
         bool measurements_context_type;
 
+        /* Plan of the last CP Measurement sent */
+        cps_measurement_plan_t measurement_plan;
+
+        cps_conn_t conns[CPS_MAX_CONNECTIONS];
+
 } cp_service_t;
 
 /*
@@ -237,6 +327,73 @@ static uint16_t cps_get_num_att(const ble_service_config_t *config, const cps_co
         return ble_service_get_num_attr(config, num_chars, num_desc);
 }
 
+static cps_conn_t *conn_find(cp_service_t *cps, uint16_t conn_idx)
+{
+        int i;
+
+        for (i = 0; i < CPS_MAX_CONNECTIONS; i++) {
+                if (cps->conns[i].conn_idx == conn_idx) {
+                        return &cps->conns[i];
+                }
+        }
+
+        return NULL;
+}
+
+/* Tracks a connection and caches its CCC values, if there is room for it */
+static void conn_add(cp_service_t *cps, uint16_t conn_idx)
+{
+        cps_conn_t *entry = conn_find(cps, conn_idx);
+
+        if (!entry) {
+                entry = conn_find(cps, BLE_CONN_IDX_INVALID);
+                if (!entry) {
+                        return;
+                }
+        }
+
+        memset(entry, 0, sizeof(*entry));
+        entry->conn_idx = conn_idx;
+        ble_storage_get_u16(conn_idx, cps->cp_measurement_ccc_h, &entry->measurement_ccc);
+        if (cps->cp_cpv_ccc_h) {
+                ble_storage_get_u16(conn_idx, cps->cp_cpv_ccc_h, &entry->vector_ccc);
+        }
+}
+
+/* Stores a CCC value and updates the cached one */
+static void put_ccc(cp_service_t *cps, uint16_t conn_idx, uint16_t handle, uint16_t ccc)
+{
+        cps_conn_t *entry = conn_find(cps, conn_idx);
+
+        ble_storage_put_u32(conn_idx, handle, ccc, true);
+
+        if (!entry) {
+                return;
+        }
+
+        if (handle == cps->cp_measurement_ccc_h) {
+                entry->measurement_ccc = ccc;
+        } else if (handle == cps->cp_cpv_ccc_h) {
+                entry->vector_ccc = ccc;
+        }
+}
+
+/* Gets the CP Measurement or CP Vector CCC value, from the BLE storage on cache miss only */
+static uint16_t get_ccc(cp_service_t *cps, uint16_t conn_idx, uint16_t handle)
+{
+        cps_conn_t *entry = conn_find(cps, conn_idx);
+        uint16_t ccc = 0x0000;
+
+        if (entry) {
+                return handle == cps->cp_measurement_ccc_h ? entry->measurement_ccc :
+                                                                                entry->vector_ccc;
+        }
+
+        ble_storage_get_u16(conn_idx, handle, &ccc);
+
+        return ccc;
+}
+
 static void handle_ccc_read_req(uint16_t conn_idx, uint16_t handle)
 {
         uint16_t ccc = 0x0000;
@@ -276,6 +433,12 @@ static void vector_notification_changed(cp_service_t *cps, uint16_t conn_idx, bo
 static void handle_disconnect_evt(ble_service_t *svc, const ble_evt_gap_disconnected_t *evt)
 {
         cp_service_t *cps = (cp_service_t *) svc;
+        cps_conn_t *entry = conn_find(cps, evt->conn_idx);
+
+        /* Stop tracking the connection first, it is no longer a subscriber */
+        if (entry) {
+                entry->conn_idx = BLE_CONN_IDX_INVALID;
+        }
 
         measurement_notification_changed(cps, evt->conn_idx, false);
         vector_notification_changed(cps, evt->conn_idx, false);
@@ -287,21 +450,29 @@ static void handle_event_sent_evt(ble_service_t *svc, const ble_evt_gatts_event_
 
         if (evt->handle == cps->cp_ctrl_point_h) {
                 ble_storage_remove(evt->conn_idx, cps->cp_ctrl_point_h);
+        } else if (evt->handle == cps->cp_measurement_h) {
+                cps_conn_t *entry = conn_find(cps, evt->conn_idx);
+
+                if (entry && entry->measurement_inflight) {
+                        entry->measurement_inflight--;
+                }
         }
 }
 
 static void handle_connect_evt(ble_service_t *svc, const ble_evt_gap_connected_t *evt)
 {
         cp_service_t *cps = (cp_service_t *) svc;
-        uint16_t ccc = 0x0000;
+        uint16_t ccc;
+
+        /* CCC values of a bonded client are restored at this point */
+        conn_add(cps, evt->conn_idx);
 
-        ble_storage_get_u16(evt->conn_idx, cps->cp_measurement_ccc_h, &ccc);
+        ccc = get_ccc(cps, evt->conn_idx, cps->cp_measurement_ccc_h);
         if (ccc & GATT_CCC_NOTIFICATIONS) {
                 measurement_notification_changed(cps, evt->conn_idx, true);
         }
 
-        ccc = 0x0000; /* set default value to prevent above storage get to take action */
-        ble_storage_get_u16(evt->conn_idx, cps->cp_cpv_ccc_h, &ccc);
+        ccc = cps->cp_cpv_ccc_h ? get_ccc(cps, evt->conn_idx, cps->cp_cpv_ccc_h) : 0x0000;
         if (ccc & GATT_CCC_NOTIFICATIONS) {
                 vector_notification_changed(cps, evt->conn_idx, true);
         }
@@ -844,7 +1015,7 @@ static void handle_cp_vector_ccc_write(cp_service_t *cps, uint16_t conn_idx, uin
                 cps->cb->vector_notification_enable(&cps->svc, conn_idx, enabled);
 
         } else {
-                ble_storage_put_u32(conn_idx, cps->cp_cpv_ccc_h, ccc, true);
+                put_ccc(cps, conn_idx, cps->cp_cpv_ccc_h, ccc);
                 vector_notification_changed(cps, conn_idx, enabled);
                 ble_gatts_write_cfm(conn_idx, cps->cp_cpv_ccc_h, ATT_ERROR_OK);
         }
@@ -877,7 +1048,7 @@ static void handle_write_req(ble_service_t *svc, const ble_evt_gatts_write_req_t
                 ccc = get_u16(evt->value);
 
                 if (evt->handle == cps->cp_measurement_ccc_h) {
-                        ble_storage_put_u32(evt->conn_idx, evt->handle, ccc, true);
+                        put_ccc(cps, evt->conn_idx, evt->handle, ccc);
                         measurement_notification_changed(cps, evt->conn_idx,
                                                                      ccc & GATT_CCC_NOTIFICATIONS);
                         status = ATT_ERROR_OK;
@@ -933,6 +1104,9 @@ ble_service_t *cps_init(const ble_service_config_t *config, const cps_config_t *
 
         cps->cb = cb;
         cps->supported_features = cps_config->supported_features;
+        for (int i = 0; i < CPS_MAX_CONNECTIONS; i++) {
+                cps->conns[i].conn_idx = BLE_CONN_IDX_INVALID;
+        }
         cps->svc.read_req = handle_read_req;
         cps->svc.write_req = handle_write_req;
         cps->svc.connected_evt = handle_connect_evt;
@@ -1082,7 +1256,7 @@ bool cps_vector_notification_enable_cfm(ble_service_t *svc, uint16_t conn_idx, a
 
         if (status == ATT_ERROR_OK) {
                 vector_notification_changed(cps, conn_idx, (ccc & GATT_CCC_NOTIFICATIONS));
-                ble_storage_put_u32(conn_idx, cps->cp_cpv_ccc_h, ccc, true);
+                put_ccc(cps, conn_idx, cps->cp_cpv_ccc_h, ccc);
         }
 
         /* Remove storage to indicate that notification enabling procedure has ended */
@@ -1091,122 +1265,223 @@ bool cps_vector_notification_enable_cfm(ble_service_t *svc, uint16_t conn_idx, a
         return ret == BLE_STATUS_OK;
 }
 
-bool cps_send_cp_measurement(ble_service_t *svc, uint16_t conn_idx,
-                                                              const cps_measurement_t *measurement)
+/* Flags of the fields to send, the Content Mask of the Control Point overrides those requested */
+static uint16_t get_measurement_flags(cp_service_t *cps, const cps_measurement_t *measurement)
 {
-        cp_service_t *cps = (cp_service_t *) svc;
-        uint8_t notification[POWER_MEASUREMENT_SIZE];
-        uint8_t *ptr = &notification[2];
-        uint16_t ccc = 0x0000;
-        ble_error_t ret;
-        cps_measurement_flags_t flags = 0;
-        cps_measurement_t measure = *measurement;
+        uint16_t flags = 0;
 
-        ble_storage_get_u16(conn_idx, cps->cp_measurement_ccc_h, &ccc);
-        if (!(ccc & GATT_CCC_NOTIFICATIONS)) {
-                return false;
-        }
-
-        memset(notification, 0, sizeof(notification));
-
-        /* Set which measurement to disable if masking occurred */
         if (cps->measurement_flag_mask > 0) {
-                /* Mask Pedal Power Balance */
-                measure.pedal_power_balance_present = ~cps->measurement_flag_mask & (1 << 0);
-                /* Mask Accumulated Torque */
-                measure.accumulated_torque_present = ~cps->measurement_flag_mask & (1 << 1);
-                /* Mask Wheel Revolution Data */
-                measure.wheel_revolution_data_present = ~cps->measurement_flag_mask & (1 << 2);
-                /* Mask Crank Revolution Data */
-                measure.crank_revolution_data_present = ~cps->measurement_flag_mask & (1 << 3);
-                /* Mask Extreme Magnitudes - Force Magnitude */
-                measure.extreme_force_magnitude_present = ~cps->measurement_flag_mask & (1 << 4);
-                /* Mask Extreme Magnitudes - Torque Magnitude */
-                measure.extreme_torque_magnitude_present = ~cps->measurement_flag_mask & (1 << 4);
-                /* Mask Extreme Angles */
-                measure.extreme_angle_present = ~cps->measurement_flag_mask & (1 << 5);
-                /* Mask Top Dead Spot Angle */
-                measure.top_dead_spot_angle_present = ~cps->measurement_flag_mask & (1 << 6);
-                /* Mask Bottom Dead Spot Angle */
-                measure.bottom_dead_spot_angle_present = ~cps->measurement_flag_mask & (1 << 7);
-                /* Mask Accumulated Energy */
-                measure.accumulated_energy_present = ~cps->measurement_flag_mask & (1 << 8);
+                uint16_t present = ~cps->measurement_flag_mask;
+
+                /* Content Mask bits, from Pedal Power Balance (bit 0) to Accumulated Energy (bit 8) */
+                flags |= (present & (1 << 0)) ? CPS_PM_FLAGS_PEDAL_POWER_BALANCE_PRESENT : 0;
+                flags |= (present & (1 << 1)) ? CPS_PM_FLAGS_ACCUMULATED_TORQUE_PRESENT : 0;
+                flags |= (present & (1 << 2)) ? CPS_PM_FLAGS_WHEEL_REVOLUTION_DATA_PRESENT : 0;
+                flags |= (present & (1 << 3)) ? CPS_PM_FLAGS_CRANK_REVOLUTION_DATA_PRESENT : 0;
+                flags |= (present & (1 << 4)) ? (CPS_PM_FLAGS_EXTREME_FORCE_MAGNITUDES_PRESENT |
+                                                CPS_PM_FLAGS_EXTREME_TORQUE_MAGNITUDES_PRESENT) : 0;
+                flags |= (present & (1 << 5)) ? CPS_PM_FLAGS_EXTREME_ANGLES_PRESENT : 0;
+                flags |= (present & (1 << 6)) ? CPS_PM_FLAGS_TOP_DEAD_SPOT_ANGLE_PRESENT : 0;
+                flags |= (present & (1 << 7)) ? CPS_PM_FLAGS_BOTTOM_DEAD_SPOT_ANGLE_PRESENT : 0;
+                flags |= (present & (1 << 8)) ? CPS_PM_FLAGS_ACCUMULATED_ENERGY_PRESENT : 0;
                 /* Reset mask to prevent caching */
                 cps->measurement_flag_mask = 0;
+        } else {
+                flags |= measurement->pedal_power_balance_present ?
+                                                CPS_PM_FLAGS_PEDAL_POWER_BALANCE_PRESENT : 0;
+                flags |= measurement->accumulated_torque_present ?
+                                                CPS_PM_FLAGS_ACCUMULATED_TORQUE_PRESENT : 0;
+                flags |= measurement->wheel_revolution_data_present ?
+                                                CPS_PM_FLAGS_WHEEL_REVOLUTION_DATA_PRESENT : 0;
+                flags |= measurement->crank_revolution_data_present ?
+                                                CPS_PM_FLAGS_CRANK_REVOLUTION_DATA_PRESENT : 0;
+                flags |= measurement->extreme_force_magnitude_present ?
+                                                CPS_PM_FLAGS_EXTREME_FORCE_MAGNITUDES_PRESENT : 0;
+                flags |= measurement->extreme_torque_magnitude_present ?
+                                                CPS_PM_FLAGS_EXTREME_TORQUE_MAGNITUDES_PRESENT : 0;
+                flags |= measurement->extreme_angle_present ?
+                                                CPS_PM_FLAGS_EXTREME_ANGLES_PRESENT : 0;
+                flags |= measurement->top_dead_spot_angle_present ?
+                                                CPS_PM_FLAGS_TOP_DEAD_SPOT_ANGLE_PRESENT : 0;
+                flags |= measurement->bottom_dead_spot_angle_present ?
+                                                CPS_PM_FLAGS_BOTTOM_DEAD_SPOT_ANGLE_PRESENT : 0;
+                flags |= measurement->accumulated_energy_present ?
+                                                CPS_PM_FLAGS_ACCUMULATED_ENERGY_PRESENT : 0;
+        }
+
+        /* Only the extreme magnitudes of the sensor measurement context can be sent */
+        if (cps->measurements_context_type == CPS_SENSOR_MEASUREMENT_CONTEXT_FORCE_BASED) {
+                flags &= ~CPS_PM_FLAGS_EXTREME_TORQUE_MAGNITUDES_PRESENT;
+        } else {
+                flags &= ~CPS_PM_FLAGS_EXTREME_FORCE_MAGNITUDES_PRESENT;
         }
 
-        put_u16_inc(&ptr, measurement->instant_power);
+        if (measurement->offset_compensation_indicator) {
+                flags |= CPS_PM_FLAGS_OFFSET_COMPENSATION_INDICATOR;
+        }
+
+        return flags;
+}
+
+static void build_measurement_plan(cps_measurement_plan_t *plan, uint16_t flags)
+{
+        uint8_t i;
 
-        if (measure.pedal_power_balance_present) {
-                flags |= CPS_PM_FLAGS_PEDAL_POWER_BALANCE_PRESENT;
-                put_u8_inc(&ptr, measurement->pedal_power_balance);
+        plan->flags = flags;
+        plan->num_fields = 0;
+
+        for (i = 0; i < ARRAY_LENGTH(measurement_fields); i++) {
+                if (!measurement_fields[i].flag || (measurement_fields[i].flag & flags)) {
+                        plan->fields[plan->num_fields++] = measurement_fields[i];
+                }
         }
+}
+
+/* Encodes a CP Measurement, returns its length */
+static uint16_t encode_measurement(cp_service_t *cps, const cps_measurement_t *measurement,
+                                                                            uint8_t *notification)
+{
+        cps_measurement_plan_t *plan = &cps->measurement_plan;
+        uint8_t *ptr = &notification[2];
+        uint16_t flags;
+        uint8_t i;
 
-        if (measure.accumulated_torque_present) {
-                flags |= CPS_PM_FLAGS_ACCUMULATED_TORQUE_PRESENT;
-                put_u16_inc(&ptr, measurement->accumulated_torque);
+        flags = get_measurement_flags(cps, measurement);
+        if (flags != plan->flags || plan->num_fields == 0) {
+                build_measurement_plan(plan, flags);
         }
 
-        if (measure.wheel_revolution_data_present) {
-                flags |= CPS_PM_FLAGS_WHEEL_REVOLUTION_DATA_PRESENT;
-                put_u32_inc(&ptr, measurement->wrd_cumulative_revol);
-                put_u16_inc(&ptr, measurement->wrd_last_wheel_evt_time);
+        put_u16(&notification[0], flags);
+
+        for (i = 0; i < plan->num_fields; i++) {
+                const uint8_t *field = (const uint8_t *) measurement + plan->fields[i].offset;
+
+                if (plan->fields[i].len == CPS_EXTREME_ANGLES_LEN) {
+                        uint32_t angles;
+
+                        angles = (measurement->ea_minimum_angle << 12) |
+                                                          (measurement->ea_maximum_angle & 0x0FFF);
+                        /* We need only 24-bit of little-endian value */
+                        memcpy(ptr, &angles, CPS_EXTREME_ANGLES_LEN);
+                } else {
+                        memcpy(ptr, field, plan->fields[i].len);
+                }
+                ptr += plan->fields[i].len;
         }
 
-        if (measure.crank_revolution_data_present) {
-                flags |= CPS_PM_FLAGS_CRANK_REVOLUTION_DATA_PRESENT;
-                put_u16_inc(&ptr, measurement->crd_cumulative_revol);
-                put_u16_inc(&ptr, measurement->crd_last_crank_evt_time);
+        return ptr - notification;
+}
+
+/* Sends an encoded CP Measurement, unless the connection has too many of them in flight */
+static bool send_measurement(cp_service_t *cps, uint16_t conn_idx, cps_conn_t *entry,
+                                                        uint16_t length, const uint8_t *notification)
+{
+        ble_error_t ret;
+
+        if (entry && entry->measurement_inflight >= CPS_MEASUREMENT_MAX_INFLIGHT) {
+                entry->measurement_dropped++;
+                return false;
         }
 
-        if (measure.extreme_force_magnitude_present &&
-                 (cps->measurements_context_type ==  CPS_SENSOR_MEASUREMENT_CONTEXT_FORCE_BASED)) {
-                flags |= CPS_PM_FLAGS_EXTREME_FORCE_MAGNITUDES_PRESENT;
-                put_u16_inc(&ptr, measurement->efm_max_force_magnitude);
-                put_u16_inc(&ptr, measurement->efm_min_force_magnitude);
+        ret = ble_gatts_send_event(conn_idx, cps->cp_measurement_h, GATT_EVENT_NOTIFICATION,
+                                                                             length, notification);
+        if (!entry) {
+                return ret == BLE_STATUS_OK;
         }
 
-        if (measure.extreme_torque_magnitude_present &&
-                 (cps->measurements_context_type == CPS_SENSOR_MEASUREMENT_CONTEXT_TORQUE_BASED)) {
-                flags |= CPS_PM_FLAGS_EXTREME_TORQUE_MAGNITUDES_PRESENT;
-                put_u16_inc(&ptr, measurement->etm_max_torq_magnitude);
-                put_u16_inc(&ptr, measurement->etm_min_torq_magnitude);
+        if (ret != BLE_STATUS_OK) {
+                entry->measurement_dropped++;
+                return false;
         }
 
-        if (measure.extreme_angle_present) {
-                uint32_t angles;
+        entry->measurement_inflight++;
 
-                angles = (measurement->ea_minimum_angle << 12) |
-                                                          (measurement->ea_maximum_angle & 0x0FFF);
-                flags |= CPS_PM_FLAGS_EXTREME_ANGLES_PRESENT;
-                /* We need only 24-bit of little-endian value */
-                put_data_inc(&ptr, 3, &angles);
-        }
+        return true;
+}
+
+bool cps_send_cp_measurement(ble_service_t *svc, uint16_t conn_idx,
+                                                              const cps_measurement_t *measurement)
+{
+        cp_service_t *cps = (cp_service_t *) svc;
+        uint8_t notification[POWER_MEASUREMENT_SIZE];
+        uint16_t length;
 
-        if (measure.top_dead_spot_angle_present) {
-                flags |= CPS_PM_FLAGS_TOP_DEAD_SPOT_ANGLE_PRESENT;
-                put_u16_inc(&ptr, measurement->top_dead_spot_angle);
+        if (!(get_ccc(cps, conn_idx, cps->cp_measurement_ccc_h) & GATT_CCC_NOTIFICATIONS)) {
+                return false;
         }
 
-        if (measure.bottom_dead_spot_angle_present) {
-                flags |= CPS_PM_FLAGS_BOTTOM_DEAD_SPOT_ANGLE_PRESENT;
-                put_u16_inc(&ptr, measurement->bottom_dead_spot_angle);
+        length = encode_measurement(cps, measurement, notification);
+
+        return send_measurement(cps, conn_idx, conn_find(cps, conn_idx), length, notification);
+}
+
+uint8_t cps_notify_cp_measurement(ble_service_t *svc, const cps_measurement_t *measurement)
+{
+        cp_service_t *cps = (cp_service_t *) svc;
+        uint8_t notification[POWER_MEASUREMENT_SIZE];
+        uint16_t length = 0;
+        uint8_t sent = 0;
+        int i;
+
+        for (i = 0; i < CPS_MAX_CONNECTIONS; i++) {
+                cps_conn_t *entry = &cps->conns[i];
+
+                if (entry->conn_idx == BLE_CONN_IDX_INVALID ||
+                                        !(entry->measurement_ccc & GATT_CCC_NOTIFICATIONS)) {
+                        continue;
+                }
+
+                /* Encoded once, for the first subscriber */
+                if (length == 0) {
+                        length = encode_measurement(cps, measurement, notification);
+                }
+
+                if (send_measurement(cps, entry->conn_idx, entry, length, notification)) {
+                        sent++;
+                }
         }
 
-        if (measure.accumulated_energy_present) {
-                flags |= CPS_PM_FLAGS_ACCUMULATED_ENERGY_PRESENT;
-                put_u16_inc(&ptr, measurement->accumulated_torque);
+        return sent;
+}
+
+uint8_t cps_get_measurement_subscribers(ble_service_t *svc)
+{
+        cp_service_t *cps = (cp_service_t *) svc;
+        uint8_t count = 0;
+        int i;
+
+        for (i = 0; i < CPS_MAX_CONNECTIONS; i++) {
+                if (cps->conns[i].conn_idx != BLE_CONN_IDX_INVALID &&
+                                (cps->conns[i].measurement_ccc & GATT_CCC_NOTIFICATIONS)) {
+                        count++;
+                }
         }
 
-        if (measure.offset_compensation_indicator) {
-                flags |= CPS_PM_FLAGS_OFFSET_COMPENSATION_INDICATOR;
+        return count;
+}
+
+uint8_t cps_get_vector_subscribers(ble_service_t *svc)
+{
+        cp_service_t *cps = (cp_service_t *) svc;
+        uint8_t count = 0;
+        int i;
+
+        for (i = 0; i < CPS_MAX_CONNECTIONS; i++) {
+                if (cps->conns[i].conn_idx != BLE_CONN_IDX_INVALID &&
+                                (cps->conns[i].vector_ccc & GATT_CCC_NOTIFICATIONS)) {
+                        count++;
+                }
         }
 
-        put_u16(&notification[0], flags);
-        ret = ble_gatts_send_event(conn_idx, cps->cp_measurement_h, GATT_EVENT_NOTIFICATION,
-                                                                 ptr - notification, notification);
+        return count;
+}
 
-        return ret == BLE_STATUS_OK;
+uint32_t cps_get_measurement_dropped(ble_service_t *svc, uint16_t conn_idx)
+{
+        cp_service_t *cps = (cp_service_t *) svc;
+        cps_conn_t *entry = conn_find(cps, conn_idx);
+
+        return entry ? entry->measurement_dropped : 0;
 }
 
 bool cps_send_cp_vector(ble_service_t *svc, uint16_t conn_idx, const cps_power_vector_t *vector)
@@ -1214,12 +1489,10 @@ bool cps_send_cp_vector(ble_service_t *svc, uint16_t conn_idx, const cps_power_v
         cp_service_t *cps = (cp_service_t *) svc;
         uint8_t notification[CPS_POWER_VECTOR_SIZE];
         uint8_t *ptr= &notification[1];;
-        uint16_t ccc = 0x0000;
         ble_error_t ret;
         cps_vector_flags_t flags = 0;
 
-        ble_storage_get_u16(conn_idx, cps->cp_cpv_ccc_h, &ccc);
-        if (!(ccc & GATT_CCC_NOTIFICATIONS)) {
+        if (!(get_ccc(cps, conn_idx, cps->cp_cpv_ccc_h) & GATT_CCC_NOTIFICATIONS)) {
                 return false;
         }
 
@@ -1265,6 +1538,24 @@ bool cps_send_cp_vector(ble_service_t *svc, uint16_t conn_idx, const cps_power_v
         return ret == BLE_STATUS_OK;
 }
 
+uint8_t cps_notify_cp_vector(ble_service_t *svc, const cps_power_vector_t *vector)
+{
+        cp_service_t *cps = (cp_service_t *) svc;
+        uint8_t sent = 0;
+        int i;
+
+        for (i = 0; i < CPS_MAX_CONNECTIONS; i++) {
+                cps_conn_t *entry = &cps->conns[i];
+
+                if (entry->conn_idx != BLE_CONN_IDX_INVALID &&
+                                        cps_send_cp_vector(svc, entry->conn_idx, vector)) {
+                        sent++;
+                }
+        }
+
+        return sent;
+}
+
 static ble_error_t confirmation_helper(ble_service_t *svc, uint16_t conn_idx,
                                                        cps_cp_opcode_t opcode, cps_status_t status)
 {
@@ -33,6 +33,7 @@
 #include <stddef.h>
 #include <string.h>
 #include "osal.h"
+#include "sdk_defs.h"
 #include "ble_storage.h"
 #include "ble_bufops.h"
 #include "ble_gatts.h"
@@ -40,6 +41,34 @@
 #include "ble_uuid.h"
 #include "svc_defines.h"
 #include "dsps.h"
+#include "dsps_lz.h"
+#include "dsps_stats.h"
+
+#if DSPS_COMPRESSION
+/* Compression state of a connection */
+typedef struct {
+        uint16_t        conn_idx;
+        bool            tx_on;          /* Notifications are compressed */
+        bool            rx_on;          /* Writes of the client are compressed */
+        dsps_lz_enc_t   enc;
+        dsps_lz_dec_t   dec;
+} dsps_lz_link_t;
+
+__RETAINED static dsps_lz_link_t lz_links[DSPS_MAX_CONNECTIONS];
+/* Packet being compressed or decompressed, only accessed from the BLE task */
+__RETAINED static uint8_t lz_buf[DSPS_LZ_PACKET_DATA_MAX];
+
+static dsps_lz_link_t *lz_link_find(uint16_t conn_idx)
+{
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                if (lz_links[i].conn_idx == conn_idx) {
+                        return &lz_links[i];
+                }
+        }
+
+        return NULL;
+}
+#endif /* DSPS_COMPRESSION */
 
 static bool send_tx_data(dsps_service_t *sps, uint16_t conn_idx, uint16_t length, uint8_t *data)
 {
@@ -108,6 +137,42 @@ static att_error_t handle_tx_ccc_write(dsps_service_t *sps,  uint16_t conn_idx,
         return ATT_ERROR_OK;
 }
 
+#if DSPS_COMPRESSION
+/* The first request of the client offers compression, the second one starts it for its writes */
+static void compress_req(dsps_service_t *sps, uint16_t conn_idx)
+{
+        const uint8_t value[] = { DSPS_FLOW_CONTROL_COMPRESS, DSPS_LZ_CODEC };
+        dsps_lz_link_t *lz = lz_link_find(conn_idx);
+        uint16_t ccc = 0x0000;
+
+        if (lz) {
+                if (!lz->rx_on) {
+                        dsps_lz_dec_reset(&lz->dec);
+                        lz->rx_on = true;
+                }
+                return;
+        }
+
+        /* The offer is not answered, so the client keeps sending data as is, if this fails */
+        lz = lz_link_find(BLE_CONN_IDX_INVALID);
+        ble_storage_get_u16(conn_idx, sps->sps_flow_ctrl_ccc_h, &ccc);
+        if (lz == NULL || !(ccc & GATT_CCC_NOTIFICATIONS)) {
+                return;
+        }
+
+        if (ble_gatts_send_event(conn_idx, sps->sps_flow_ctrl_val_h, GATT_EVENT_NOTIFICATION,
+                                                        sizeof(value), value) != BLE_STATUS_OK) {
+                return;
+        }
+
+        /* Notifications following the answer are compressed */
+        dsps_lz_enc_reset(&lz->enc);
+        lz->conn_idx = conn_idx;
+        lz->tx_on = true;
+        lz->rx_on = false;
+}
+#endif /* DSPS_COMPRESSION */
+
 static att_error_t set_flow_control_req(dsps_service_t *sps, uint16_t conn_idx,
                                         uint16_t offset, uint16_t length, const uint8_t *value)
 {
@@ -115,6 +180,25 @@ static att_error_t set_flow_control_req(dsps_service_t *sps, uint16_t conn_idx,
                 return ATT_ERROR_ATTRIBUTE_NOT_LONG;
         }
 
+        if (length == DSPS_FLOW_CONTROL_CREDIT_LEN && value[0] == DSPS_FLOW_CONTROL_CREDIT) {
+                /* Credits are not answered, and so not used, unless the application handles them */
+                if (sps->cb && sps->cb->credit_limit) {
+                        sps->cb->credit_limit((ble_service_t *)sps, conn_idx, get_u32(value + 1));
+                }
+
+                return ATT_ERROR_OK;
+        }
+
+        if (length == DSPS_FLOW_CONTROL_COMPRESS_LEN && value[0] == DSPS_FLOW_CONTROL_COMPRESS) {
+#if DSPS_COMPRESSION
+                /* Other codecs are not answered, so data are not compressed */
+                if (value[1] == DSPS_LZ_CODEC) {
+                        compress_req(sps, conn_idx);
+                }
+#endif
+                return ATT_ERROR_OK;
+        }
+
         if (length != sizeof(uint8_t)) {
                 return ATT_ERROR_INVALID_VALUE_LENGTH;
         }
@@ -129,6 +213,21 @@ static att_error_t set_flow_control_req(dsps_service_t *sps, uint16_t conn_idx,
 static att_error_t handle_rx_data(dsps_service_t *sps, uint16_t conn_idx,
                                         uint16_t offset, uint16_t length, const uint8_t *value)
 {
+#if DSPS_COMPRESSION
+        dsps_lz_link_t *lz = lz_link_find(conn_idx);
+
+        if (lz && lz->rx_on && length) {
+                int len = dsps_lz_decode(&lz->dec, value, length, lz_buf);
+
+                if (len < 0) {
+                        return ATT_ERROR_APPLICATION_ERROR;
+                }
+
+                value = lz_buf;
+                length = len;
+        }
+#endif
+
         if (sps->cb && sps->cb->rx_data && length) {
                 sps->cb->rx_data((ble_service_t *)sps, conn_idx, value, length);
         }
@@ -136,6 +235,40 @@ static att_error_t handle_rx_data(dsps_service_t *sps, uint16_t conn_idx,
         return ATT_ERROR_OK;
 }
 
+#if DSPS_STATS_ENABLE
+static att_error_t handle_stats_write(dsps_service_t *sps, uint16_t conn_idx,
+                                        uint16_t offset, uint16_t length, const uint8_t *value)
+{
+        if (offset) {
+                return ATT_ERROR_ATTRIBUTE_NOT_LONG;
+        }
+
+        /* Any write resets the statistics */
+        dsps_stats_reset();
+
+        return ATT_ERROR_OK;
+}
+
+static void handle_stats_read(dsps_service_t *sps, const ble_evt_gatts_read_req_t *evt)
+{
+        /* Snapshot taken on the first read so that long reads return consistent data */
+        static uint8_t stats_buf[DSPS_STATS_SERIALIZED_SIZE];
+        static uint16_t stats_len;
+
+        if (evt->offset == 0) {
+                stats_len = dsps_stats_serialize(stats_buf);
+        }
+
+        if (evt->offset > stats_len) {
+                ble_gatts_read_cfm(evt->conn_idx, evt->handle, ATT_ERROR_INVALID_OFFSET, 0, NULL);
+                return;
+        }
+
+        ble_gatts_read_cfm(evt->conn_idx, evt->handle, ATT_ERROR_OK, stats_len - evt->offset,
+                                                                        stats_buf + evt->offset);
+}
+#endif /* DSPS_STATS_ENABLE */
+
 static void handle_write_req(ble_service_t *svc, const ble_evt_gatts_write_req_t *evt)
 {
         dsps_service_t *sps = (dsps_service_t *) svc;
@@ -157,6 +290,12 @@ static void handle_write_req(ble_service_t *svc, const ble_evt_gatts_write_req_t
                 status = handle_rx_data(sps, evt->conn_idx, evt->offset, evt->length, evt->value);
         }
 
+#if DSPS_STATS_ENABLE
+        if (handle == sps->sps_stats_val_h) {
+                status = handle_stats_write(sps, evt->conn_idx, evt->offset, evt->length, evt->value);
+        }
+#endif
+
         ble_gatts_write_cfm(evt->conn_idx, evt->handle, status);
 }
 
@@ -173,6 +312,10 @@ static void handle_read_req(ble_service_t *svc, const ble_evt_gatts_read_req_t *
                 }
                 // we're little-endian, ok to write directly from uint16_t
                 ble_gatts_read_cfm(evt->conn_idx, evt->handle, ATT_ERROR_OK, sizeof(ccc), &ccc);
+#if DSPS_STATS_ENABLE
+        } else if (evt->handle == sps->sps_stats_val_h) {
+                handle_stats_read(sps, evt);
+#endif
         } else {
                 ble_gatts_read_cfm(evt->conn_idx, evt->handle, ATT_ERROR_READ_NOT_PERMITTED, 0, NULL);
         }
@@ -190,6 +333,17 @@ static void handle_event_sent(ble_service_t *svc, const ble_evt_gatts_event_sent
         }
 }
 
+#if DSPS_COMPRESSION
+static void handle_disconnected_evt(ble_service_t *svc, const ble_evt_gap_disconnected_t *evt)
+{
+        dsps_lz_link_t *lz = lz_link_find(evt->conn_idx);
+
+        if (lz) {
+                lz->conn_idx = BLE_CONN_IDX_INVALID;
+        }
+}
+#endif /* DSPS_COMPRESSION */
+
 static void cleanup(ble_service_t *svc)
 {
         dsps_service_t *sps = (dsps_service_t *) svc;
@@ -205,13 +359,26 @@ static void cleanup(ble_service_t *svc)
 ble_service_t *dsps_init(dsps_callbacks_t *cb)
 {
         uint16_t num_attr, sps_tx_desc_h, sps_rx_desc_h, sps_flow_ctrl_desc_h;
+#if DSPS_STATS_ENABLE
+        uint16_t sps_stats_desc_h;
+#endif
         dsps_service_t *sps;
         att_uuid_t uuid;
 
         sps = OS_MALLOC(sizeof(*sps));
         memset(sps, 0, sizeof(*sps));
 
+#if DSPS_COMPRESSION
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                lz_links[i].conn_idx = BLE_CONN_IDX_INVALID;
+        }
+#endif
+
+#if DSPS_STATS_ENABLE
+        num_attr = ble_gatts_get_num_attr(0, 4, 6);
+#else
         num_attr = ble_gatts_get_num_attr(0, 3, 5);
+#endif
 
         ble_uuid_from_string(UUID_DSPS, &uuid);
         ble_gatts_add_service(&uuid, GATT_SERVICE_PRIMARY, num_attr);
@@ -238,7 +405,7 @@ ble_service_t *dsps_init(dsps_callbacks_t *cb)
         /* SPS Flow Control */
         ble_uuid_from_string(UUID_DSPS_FLOW_CTRL, &uuid);
         ble_gatts_add_characteristic(&uuid, GATT_PROP_WRITE_NO_RESP | GATT_PROP_NOTIFY, ATT_PERM_WRITE,
-                                                1, 0, NULL, &sps->sps_flow_ctrl_val_h);
+                                                DSPS_FLOW_CONTROL_CREDIT_LEN, 0, NULL, &sps->sps_flow_ctrl_val_h);
 
         ble_uuid_create16(UUID_GATT_CLIENT_CHAR_CONFIGURATION, &uuid);
         ble_gatts_add_descriptor(&uuid, ATT_PERM_RW, 2, 0, &sps->sps_flow_ctrl_ccc_h);
@@ -246,21 +413,42 @@ ble_service_t *dsps_init(dsps_callbacks_t *cb)
         ble_uuid_create16(UUID_GATT_CHAR_USER_DESCRIPTION, &uuid);
         ble_gatts_add_descriptor(&uuid, ATT_PERM_READ, sizeof(dsps_flow_control_desc), 0, &sps_flow_ctrl_desc_h);
 
+#if DSPS_STATS_ENABLE
+        /* SPS Statistics (debug), read for a snapshot, write to reset */
+        ble_uuid_from_string(UUID_DSPS_STATS, &uuid);
+        ble_gatts_add_characteristic(&uuid, GATT_PROP_READ | GATT_PROP_WRITE, ATT_PERM_RW,
+                                                DSPS_STATS_SERIALIZED_SIZE, GATTS_FLAG_CHAR_READ_REQ,
+                                                NULL, &sps->sps_stats_val_h);
+
+        ble_uuid_create16(UUID_GATT_CHAR_USER_DESCRIPTION, &uuid);
+        ble_gatts_add_descriptor(&uuid, ATT_PERM_READ, sizeof(dsps_stats_desc), 0, &sps_stats_desc_h);
+#endif
+
         /* Register SPS Service */
         ble_gatts_register_service(&sps->svc.start_h, &sps->sps_tx_val_h, &sps->sps_tx_ccc_h,
                                                 &sps_tx_desc_h, &sps->sps_rx_val_h, &sps_rx_desc_h,
                                                 &sps->sps_flow_ctrl_val_h, &sps->sps_flow_ctrl_ccc_h,
-                                                &sps_flow_ctrl_desc_h, 0);
+                                                &sps_flow_ctrl_desc_h,
+#if DSPS_STATS_ENABLE
+                                                &sps->sps_stats_val_h, &sps_stats_desc_h,
+#endif
+                                                0);
 
         /* Set value of Characteristic Descriptions */
         ble_gatts_set_value(sps_tx_desc_h, sizeof(dsps_tx_desc), dsps_tx_desc);
         ble_gatts_set_value(sps_rx_desc_h, sizeof(dsps_rx_desc), dsps_rx_desc);
         ble_gatts_set_value(sps_flow_ctrl_desc_h, sizeof(dsps_flow_control_desc), dsps_flow_control_desc);
+#if DSPS_STATS_ENABLE
+        ble_gatts_set_value(sps_stats_desc_h, sizeof(dsps_stats_desc), dsps_stats_desc);
+#endif
 
         sps->svc.end_h = sps->svc.start_h + num_attr;
         sps->svc.write_req = handle_write_req;
         sps->svc.read_req = handle_read_req;
         sps->svc.event_sent = handle_event_sent;
+#if DSPS_COMPRESSION
+        sps->svc.disconnected_evt = handle_disconnected_evt;
+#endif
         sps->svc.cleanup = cleanup;
         sps->cb = cb;
 
@@ -281,10 +469,35 @@ void dsps_set_flow_control(dsps_service_t *sps, uint16_t conn_idx, DSPS_FLOW_CON
         notify_flow_ctrl(sps, conn_idx, value);
 }
 
+DSPS_FLOW_CONTROL dsps_get_flow_control(dsps_service_t *sps, uint16_t conn_idx)
+{
+        uint8_t flow_ctrl = DSPS_FLOW_CONTROL_OFF;
+
+        ble_storage_get_u8(conn_idx, sps->sps_flow_ctrl_val_h, &flow_ctrl);
+
+        return flow_ctrl;
+}
+
+bool dsps_send_credit_limit(dsps_service_t *sps, uint16_t conn_idx, uint32_t limit)
+{
+        uint8_t value[DSPS_FLOW_CONTROL_CREDIT_LEN];
+        uint16_t ccc = 0x0000;
+
+        ble_storage_get_u16(conn_idx, sps->sps_flow_ctrl_ccc_h, &ccc);
+        if (!(ccc & GATT_CCC_NOTIFICATIONS)) {
+                return false;
+        }
+
+        value[0] = DSPS_FLOW_CONTROL_CREDIT;
+        put_u32(value + 1, limit);
+
+        return ble_gatts_send_event(conn_idx, sps->sps_flow_ctrl_val_h, GATT_EVENT_NOTIFICATION,
+                                                        sizeof(value), value) == BLE_STATUS_OK;
+}
+
 bool dsps_tx_data(dsps_service_t *sps, uint16_t conn_idx, uint8_t *data, uint16_t length)
 {
         uint16_t ccc = 0x0000;
-        uint8_t flow_ctrl = DSPS_FLOW_CONTROL_OFF;
 
         /* Check if remote client registered for TX data */
         ble_storage_get_u16(conn_idx, sps->sps_tx_ccc_h, &ccc);
@@ -294,12 +507,39 @@ bool dsps_tx_data(dsps_service_t *sps, uint16_t conn_idx, uint8_t *data, uint16_
         }
 
         /* Check if flow control is enabled */
-        ble_storage_get_u8(conn_idx, sps->sps_flow_ctrl_val_h, &flow_ctrl);
-        if (flow_ctrl != DSPS_FLOW_CONTROL_ON) {
+        if (dsps_get_flow_control(sps, conn_idx) != DSPS_FLOW_CONTROL_ON) {
                 return false;
         }
 
-        send_tx_data(sps, conn_idx, length, data);
-        return true;
+        /* Fails if the BLE stack cannot take any more notifications for now */
+        return send_tx_data(sps, conn_idx, length, data);
+}
+
+uint32_t dsps_tx_data_compressed(dsps_service_t *sps, uint16_t conn_idx, const uint8_t *data,
+                                                        uint32_t length, uint16_t max_len)
+{
+#if DSPS_COMPRESSION
+        dsps_lz_link_t *lz = lz_link_find(conn_idx);
+
+        if (lz && lz->tx_on) {
+                uint32_t consumed;
+                uint16_t len;
+
+                len = dsps_lz_encode(&lz->enc, data, length, lz_buf, MIN(max_len, sizeof(lz_buf)),
+                                                                                        &consumed);
+
+                /* The client never sees a packet that was not sent, drop it from the stream */
+                if (consumed && !dsps_tx_data(sps, conn_idx, lz_buf, len)) {
+                        dsps_lz_enc_rollback(&lz->enc, consumed);
+                        return 0;
+                }
+
+                return consumed;
+        }
+#endif
+
+        length = MIN(length, max_len);
+
+        return dsps_tx_data(sps, conn_idx, (uint8_t *)data, length) ? length : 0;
 }
 #endif /* defined(CONFIG_USE_BLE_SERVICES) */
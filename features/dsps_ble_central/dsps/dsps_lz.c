@@ -0,0 +1,222 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_lz.c
+ *
+ * @brief DSPS payload compression
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "osal.h"
+#include "dsps_lz.h"
+
+#define HISTORY_MASK            (DSPS_LZ_HISTORY_SIZE - 1)
+#define LITERALS_MAX            (128)
+#define MATCH_LEN_SHORT_MAX     (DSPS_LZ_MIN_MATCH + 14)
+
+/* Bytes needed to encode a run of literals */
+static uint32_t literals_len(uint32_t n)
+{
+        return n + (n + LITERALS_MAX - 1) / LITERALS_MAX;
+}
+
+static uint32_t hash3(const uint8_t *p)
+{
+        uint32_t v = p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+
+        return (v * 2654435761U) >> (32 - DSPS_LZ_HASH_BITS);
+}
+
+static uint8_t *put_literals(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        while (n) {
+                uint32_t len = MIN(n, LITERALS_MAX);
+
+                *dst++ = len - 1;
+                memcpy(dst, src, len);
+                dst += len;
+                src += len;
+                n -= len;
+        }
+
+        return dst;
+}
+
+/* Copy data to the history ring at a stream position */
+static void history_write(uint8_t *history, uint32_t pos, const uint8_t *data, uint32_t len)
+{
+        uint32_t offset = pos & HISTORY_MASK;
+        uint32_t chunk = MIN(len, DSPS_LZ_HISTORY_SIZE - offset);
+
+        memcpy(&history[offset], data, chunk);
+        memcpy(history, data + chunk, len - chunk);
+}
+
+void dsps_lz_enc_reset(dsps_lz_enc_t *enc)
+{
+        memset(enc, 0, sizeof(*enc));
+}
+
+uint16_t dsps_lz_encode(dsps_lz_enc_t *enc, const uint8_t *src, uint32_t src_len, uint8_t *dst,
+                                                        uint16_t dst_len, uint32_t *consumed)
+{
+        const uint32_t start = enc->pos;
+        uint8_t *out = dst;
+        uint32_t i = 0, lit_start = 0;
+
+        src_len = MIN(src_len, DSPS_LZ_PACKET_DATA_MAX);
+
+        /* Data are added to the history upfront, so that a match may overlap the data it encodes */
+        history_write(enc->history, start, src, src_len);
+
+        while (i < src_len) {
+                uint32_t lits = i - lit_start;
+                uint32_t len = 0, dist = 0;
+
+                if (i + DSPS_LZ_MIN_MATCH <= src_len) {
+                        uint32_t h = hash3(src + i);
+
+                        /* Candidates are verified, so stale or rolled back entries are harmless */
+                        dist = (uint16_t)((start + i) - enc->hash[h]);
+                        enc->hash[h] = (uint16_t)(start + i);
+
+                        if (dist >= 1 && dist <= DSPS_LZ_MAX_DISTANCE) {
+                                uint32_t from = start + i - dist;
+                                uint32_t max = MIN(src_len - i, DSPS_LZ_MAX_MATCH);
+
+                                while (len < max && enc->history[(from + len) & HISTORY_MASK] == src[i + len]) {
+                                        len++;
+                                }
+                        }
+                }
+
+                if (len < DSPS_LZ_MIN_MATCH) {
+                        if (out - dst + literals_len(lits + 1) > dst_len) {
+                                break;
+                        }
+                        i++;
+                        continue;
+                }
+
+                if (out - dst + literals_len(lits) + (len > MATCH_LEN_SHORT_MAX ? 3 : 2) > dst_len) {
+                        break;
+                }
+
+                out = put_literals(out, src + lit_start, lits);
+
+                dist--;
+                if (len > MATCH_LEN_SHORT_MAX) {
+                        *out++ = 0xF8 | (dist >> 8);
+                        *out++ = dist;
+                        *out++ = len - MATCH_LEN_SHORT_MAX - 1;
+                } else {
+                        *out++ = 0x80 | ((len - DSPS_LZ_MIN_MATCH) << 3) | (dist >> 8);
+                        *out++ = dist;
+                }
+
+                /* Also index the strings starting inside the match */
+                for (uint32_t k = i + 1; k < i + len && k + DSPS_LZ_MIN_MATCH <= src_len; k++) {
+                        enc->hash[hash3(src + k)] = (uint16_t)(start + k);
+                }
+
+                i += len;
+                lit_start = i;
+        }
+
+        out = put_literals(out, src + lit_start, i - lit_start);
+
+        enc->pos = start + i;
+        *consumed = i;
+
+        return out - dst;
+}
+
+void dsps_lz_enc_rollback(dsps_lz_enc_t *enc, uint32_t consumed)
+{
+        /* History past the rolled back position is overwritten by the next packet */
+        enc->pos -= consumed;
+}
+
+void dsps_lz_dec_reset(dsps_lz_dec_t *dec)
+{
+        memset(dec, 0, sizeof(*dec));
+}
+
+int dsps_lz_decode(dsps_lz_dec_t *dec, const uint8_t *src, uint16_t src_len, uint8_t *dst)
+{
+        const uint8_t *end = src + src_len;
+        uint32_t n = 0;
+
+        while (src < end) {
+                uint8_t token = *src++;
+                uint32_t len, dist, from;
+
+                if (!(token & 0x80)) {
+                        len = token + 1;
+                        if (len > (uint32_t)(end - src) || n + len > DSPS_LZ_PACKET_DATA_MAX) {
+                                return -1;
+                        }
+
+                        memcpy(dst + n, src, len);
+                        history_write(dec->history, dec->pos + n, src, len);
+                        src += len;
+                        n += len;
+                        continue;
+                }
+
+                if (src == end) {
+                        return -1;
+                }
+
+                len = ((token >> 3) & 0x0F) + DSPS_LZ_MIN_MATCH;
+                dist = (((token & 0x07) << 8) | *src++) + 1;
+                if (len > MATCH_LEN_SHORT_MAX) {
+                        if (src == end) {
+                                return -1;
+                        }
+                        len += *src++;
+                }
+
+                if (dist > DSPS_LZ_MAX_DISTANCE || n + len > DSPS_LZ_PACKET_DATA_MAX) {
+                        return -1;
+                }
+
+                /* Byte by byte, since a match may overlap the data it produces */
+                from = dec->pos + n - dist;
+                for (uint32_t k = 0; k < len; k++) {
+                        uint8_t b = dec->history[(from + k) & HISTORY_MASK];
+
+                        dst[n + k] = b;
+                        dec->history[(dec->pos + n + k) & HISTORY_MASK] = b;
+                }
+                n += len;
+        }
+
+        dec->pos += n;
+
+        return n;
+}
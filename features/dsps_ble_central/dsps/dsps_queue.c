@@ -32,102 +32,152 @@
 #include <string.h>
 #include <stdbool.h>
 #include "osal.h"
+#include "sdk_defs.h"
 #include "dsps_queue.h"
 
-#define QUEUE_WAIT_WRITE_TICKS    OS_MS_2_TICKS(100)
-#define QUEUE_WAIT_READ_TICKS     OS_QUEUE_NO_WAIT
+/* Make sure ring data are accessed in program order with respect to the indexes */
+#define QUEUE_BARRIER()         __DMB()
 
-sps_queue_t *sps_queue_new(int size, int low_watermark, int high_watermark)
+void sps_queue_init(sps_queue_t *sps_queue, uint8_t *buf, int size, int low_watermark, int high_watermark)
 {
-        sps_queue_t* sps_queue;
-
-        sps_queue = (sps_queue_t *)OS_MALLOC(sizeof(sps_queue_t));
-
-        msg_queue_create(&(sps_queue->q), size, DEFAULT_OS_ALLOCATOR);
-        OS_ASSERT(NULL != (sps_queue->q.queue));
+        /* Free-running indexes are wrapped with a mask */
+        OS_ASSERT(size > 0 && (size & (size - 1)) == 0);
 
+        sps_queue->buf = buf;
+        sps_queue->size = size;
         sps_queue->high_watermark = high_watermark;
         sps_queue->low_watermark  = low_watermark;
-        sps_queue->hwm_reached = false;
-
-        return sps_queue;
+        sps_queue_reset(sps_queue);
 }
 
-void sps_queue_free(sps_queue_t *sps_queue)
+void sps_queue_reset(sps_queue_t *sps_queue)
 {
-        __unused msg m;
-
         if (sps_queue == NULL) {
                 return;
         }
 
-        /* Need to pop all the messages in the queue and release them */
-        while (msg_queue_get(&sps_queue->q, &m, QUEUE_WAIT_READ_TICKS) != OS_QUEUE_EMPTY){
-                msg_release(&m);
+        sps_queue->head = 0;
+        sps_queue->tail = 0;
+        sps_queue->hwm_reached = false;
+}
+
+int sps_queue_item_count(sps_queue_t *sps_queue)
+{
+        if (sps_queue == NULL) {
+                return 0;
         }
 
-        msg_queue_delete(&sps_queue->q);
-        OS_FREE(sps_queue);
+        return (int)(sps_queue->head - sps_queue->tail);
 }
 
-int sps_queue_item_count(sps_queue_t *sps_queue)
+int sps_queue_free_space(sps_queue_t *sps_queue)
 {
-        if(sps_queue == NULL){
+        if (sps_queue == NULL) {
                 return 0;
         }
 
-        return (uxQueueMessagesWaiting(sps_queue->q.queue));
+        return (int)sps_queue->size - sps_queue_item_count(sps_queue);
 }
 
-void sps_queue_write_items(sps_queue_t *sps_queue, MSG_SIZE size, const uint8_t *data)
+uint8_t *sps_queue_write_ptr(sps_queue_t *sps_queue, uint32_t *len)
 {
-        __unused OS_BASE_TYPE ret;
+        uint32_t head, offset;
+
+        *len = 0;
 
         if (sps_queue == NULL) {
+                return NULL;
+        }
+
+        head = sps_queue->head;
+        offset = head & (sps_queue->size - 1);
+
+        /* Free space up to the physical end of the ring */
+        *len = MIN((uint32_t)sps_queue_free_space(sps_queue), sps_queue->size - offset);
+
+        return *len ? &sps_queue->buf[offset] : NULL;
+}
+
+void sps_queue_write_commit(sps_queue_t *sps_queue, uint32_t len)
+{
+        if (sps_queue == NULL || len == 0) {
                 return;
         }
 
-        ret = msg_queue_send(&sps_queue->q, 0, 0, (uint8_t*) data, size, QUEUE_WAIT_WRITE_TICKS);
+        OS_ASSERT(len <= (uint32_t)sps_queue_free_space(sps_queue));
 
-        /* Queue full solution:
-         * 1.Increase queue size or decrease queue high water mark
-         * 2.Change serial speed and BLE throughput so that there is not great speed mismatch
-         */
-        OS_ASSERT(ret != OS_QUEUE_FULL);
+        QUEUE_BARRIER();
+        sps_queue->head += len;
 }
 
-bool sps_queue_pop_items(sps_queue_t *sps_queue, msg* pMsg)
+uint32_t sps_queue_write_items(sps_queue_t *sps_queue, uint32_t size, const uint8_t *data)
 {
-        bool isSuccess = false;
-        __unused OS_BASE_TYPE ret;
+        uint32_t written = 0;
 
-        if(sps_queue == NULL){
-                return isSuccess;
+        if (sps_queue == NULL) {
+                return 0;
         }
 
-        ret = msg_queue_get(&sps_queue->q, pMsg, QUEUE_WAIT_READ_TICKS);
-        if (ret != OS_QUEUE_EMPTY) {
-                isSuccess = true;
+        /*
+         * Data not fitting in the queue are not written, the caller accounts for them. Queue full
+         * solution:
+         * 1.Increase queue size or decrease queue high water mark
+         * 2.Change serial speed and BLE throughput so that there is not great speed mismatch
+         */
+
+        /* At most two chunks are needed when data wrap around the end of the ring */
+        while (written < size) {
+                uint32_t len;
+                uint8_t *ptr = sps_queue_write_ptr(sps_queue, &len);
+
+                if (ptr == NULL) {
+                        break;
+                }
+
+                len = MIN(len, size - written);
+                memcpy(ptr, data + written, len);
+                sps_queue_write_commit(sps_queue, len);
+                written += len;
         }
 
-        return isSuccess;
+        return written;
 }
 
-bool sps_queue_read_items(sps_queue_t *sps_queue, msg* pMsg)
+const uint8_t *sps_queue_read_ptr(sps_queue_t *sps_queue, uint32_t offset, uint32_t *len)
 {
-        bool isSuccess = false;
-        __unused OS_BASE_TYPE ret;
+        uint32_t count, pos;
+
+        *len = 0;
 
         if (sps_queue == NULL) {
-                return isSuccess;
+                return NULL;
         }
 
-        ret = OS_QUEUE_PEEK(sps_queue->q.queue, pMsg, QUEUE_WAIT_READ_TICKS);
-        if (ret != OS_QUEUE_EMPTY) {
-                isSuccess = true;
+        count = (uint32_t)sps_queue_item_count(sps_queue);
+        if (offset >= count) {
+                return NULL;
         }
 
-        return isSuccess;
+        QUEUE_BARRIER();
+
+        pos = (sps_queue->tail + offset) & (sps_queue->size - 1);
+
+        /* Stored data up to the physical end of the ring */
+        *len = MIN(count - offset, sps_queue->size - pos);
+
+        return &sps_queue->buf[pos];
+}
+
+void sps_queue_read_release(sps_queue_t *sps_queue, uint32_t len)
+{
+        if (sps_queue == NULL || len == 0) {
+                return;
+        }
+
+        OS_ASSERT(len <= (uint32_t)sps_queue_item_count(sps_queue));
+
+        QUEUE_BARRIER();
+        sps_queue->tail += len;
 }
 
 bool sps_queue_check_almost_empty(sps_queue_t* sps_queue)
@@ -0,0 +1,132 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_lz.h
+ *
+ * @brief DSPS payload compression
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef DSPS_LZ_H_
+#define DSPS_LZ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dsps_common.h"
+
+/*
+ * LZ77 codec with a streaming dictionary, for the payloads of one direction of a connection.
+ *
+ * Each packet is decoded against the data of all previous packets, which BLE delivers reliably
+ * and in order, so short repeated strings across packets compress well. The stream is a
+ * sequence of tokens:
+ *
+ *   0LLLLLLL                           L + 1 literal bytes follow (1..128)
+ *   1LLLLDDD DDDDDDDD                  match of L + 3 bytes (3..17) at distance D + 1
+ *   11111DDD DDDDDDDD LLLLLLLL         match of L + 18 bytes (18..273) at distance D + 1
+ *
+ * Working memory is static: one history buffer per side, plus a hash table for the encoder.
+ */
+
+/* Codec identifier, negotiated with DSPS_FLOW_CONTROL_COMPRESS */
+#define DSPS_LZ_CODEC           (0x01)
+
+#define DSPS_LZ_MIN_MATCH       (3)
+#define DSPS_LZ_MAX_MATCH       (DSPS_LZ_MIN_MATCH + 15 + 255)
+
+/*
+ * Matches never reach further back than the history size minus the max packet data length,
+ * so that the data of a packet that could not be sent never overwrite history still in use.
+ */
+#define DSPS_LZ_MAX_DISTANCE    (DSPS_LZ_HISTORY_SIZE - DSPS_LZ_PACKET_DATA_MAX)
+
+#if (DSPS_LZ_HISTORY_SIZE & (DSPS_LZ_HISTORY_SIZE - 1)) || DSPS_LZ_MAX_DISTANCE <= 0 || DSPS_LZ_MAX_DISTANCE > 2048
+#error "DSPS_LZ_HISTORY_SIZE must be a power of two up to 2048 bytes past DSPS_LZ_PACKET_DATA_MAX"
+#endif
+
+typedef struct {
+        uint8_t         history[DSPS_LZ_HISTORY_SIZE];
+        uint16_t        hash[1 << DSPS_LZ_HASH_BITS];   /* Last stream position of each hashed string */
+        uint32_t        pos;                            /* Free-running stream position */
+} dsps_lz_enc_t;
+
+typedef struct {
+        uint8_t         history[DSPS_LZ_HISTORY_SIZE];
+        uint32_t        pos;
+} dsps_lz_dec_t;
+
+/**
+ * \brief Start a new encoder stream
+ *
+ * \param [in] enc              encoder instance
+ */
+void dsps_lz_enc_reset(dsps_lz_enc_t *enc);
+
+/**
+ * \brief Compress data into one packet
+ *
+ * Compresses as much of the data as fits in the packet, up to DSPS_LZ_PACKET_DATA_MAX bytes.
+ *
+ * \param [in]  enc             encoder instance
+ * \param [in]  src             data
+ * \param [in]  src_len         data length
+ * \param [out] dst             packet
+ * \param [in]  dst_len         max packet length
+ * \param [out] consumed        number of data bytes compressed into the packet
+ *
+ * \return packet length
+ */
+uint16_t dsps_lz_encode(dsps_lz_enc_t *enc, const uint8_t *src, uint32_t src_len, uint8_t *dst,
+                                                        uint16_t dst_len, uint32_t *consumed);
+
+/**
+ * \brief Drop the last packet from the encoder stream
+ *
+ * Must be called if the packet returned by the last dsps_lz_encode() call is not sent.
+ *
+ * \param [in] enc              encoder instance
+ * \param [in] consumed         number of data bytes compressed into the packet
+ */
+void dsps_lz_enc_rollback(dsps_lz_enc_t *enc, uint32_t consumed);
+
+/**
+ * \brief Start a new decoder stream
+ *
+ * \param [in] dec              decoder instance
+ */
+void dsps_lz_dec_reset(dsps_lz_dec_t *dec);
+
+/**
+ * \brief Decompress one packet
+ *
+ * \param [in]  dec             decoder instance
+ * \param [in]  src             packet
+ * \param [in]  src_len         packet length
+ * \param [out] dst             data, DSPS_LZ_PACKET_DATA_MAX bytes
+ *
+ * \return data length, or -1 if the packet is corrupted
+ */
+int dsps_lz_decode(dsps_lz_dec_t *dec, const uint8_t *src, uint16_t src_len, uint8_t *dst);
+
+#endif /* DSPS_LZ_H_ */
@@ -30,71 +30,119 @@
 #ifndef DSPS_QUEUE_H_
 #define DSPS_QUEUE_H_
 
-#include "msg_queues.h"
+#include <stdint.h>
+#include <stdbool.h>
 
+/*
+ * Byte-oriented, single-producer/single-consumer ring buffer.
+ *
+ * The producer and the consumer run in different tasks and each one only updates its own
+ * index, so no locking is required. Data are exposed as contiguous regions of the ring so
+ * that the serial port can read straight into it and BLE can send straight out of it.
+ */
 typedef struct {
-        msg_queue       q;
-        int             low_watermark;
-        int             high_watermark;
-        bool            hwm_reached;
+        uint8_t                 *buf;
+        uint32_t                size;           /* Must be a power of two */
+        volatile uint32_t       head;           /* Free-running write index, updated by the producer */
+        volatile uint32_t       tail;           /* Free-running read index, updated by the consumer */
+        int                     low_watermark;
+        int                     high_watermark;
+        bool                    hwm_reached;
 } sps_queue_t;
 
 /**
- * \brief Create SPS queue
+ * \brief Initialize SPS queue
  *
- * \param [in] size               size of msg queue
- * \param [in] low_watermark      queue low water mark
- * \param [in] high_watermark     queue high water mark
+ * The ring storage is provided by the caller (typically statically allocated), so no
+ * allocations take place while data flow through the queue.
  *
- * \return SPS queue instance
+ * \param [in] sps_queue          SPS queue instance
+ * \param [in] buf                ring storage
+ * \param [in] size               size of the ring storage in bytes (power of two)
+ * \param [in] low_watermark      queue low water mark in bytes
+ * \param [in] high_watermark     queue high water mark in bytes
  */
-sps_queue_t *sps_queue_new(int size, int low_watermark, int high_watermark);
+void sps_queue_init(sps_queue_t *sps_queue, uint8_t *buf, int size, int low_watermark, int high_watermark);
 
 /**
- * \brief Delete SPS queue
+ * \brief Discard all data stored in a SPS queue
+ *
+ * Must not be called while the producer or the consumer is accessing the queue.
  *
  * \param [in] sps_queue           SPS queue instance
  */
-void sps_queue_free(sps_queue_t *sps_queue);
+void sps_queue_reset(sps_queue_t *sps_queue);
 
 /**
- * \brief Check the number of messages stored in a SPS queue.
+ * \brief Check the number of bytes stored in a SPS queue.
  *
  * \param [in] sps_queue           SPS queue instance
  *
- * \return number of msg
+ * \return number of bytes
  */
 int sps_queue_item_count(sps_queue_t *sps_queue);
 
 /**
- * \brief Write one msg to the SPS queue
+ * \brief Check the number of free bytes in a SPS queue.
+ *
+ * \param [in] sps_queue           SPS queue instance
+ *
+ * \return number of bytes
+ */
+int sps_queue_free_space(sps_queue_t *sps_queue);
+
+/**
+ * \brief Get the contiguous free region of the SPS queue (producer side)
+ *
+ * Data written to the returned region become visible to the consumer only after
+ * sps_queue_write_commit() is called.
+ *
+ * \param [in]  sps_queue          SPS queue instance
+ * \param [out] len                number of contiguous bytes that can be written
+ *
+ * \return ptr to the free region or NULL if the queue is full
+ */
+uint8_t *sps_queue_write_ptr(sps_queue_t *sps_queue, uint32_t *len);
+
+/**
+ * \brief Publish bytes written to the region returned by sps_queue_write_ptr()
  *
  * \param [in] sps_queue            SPS queue instance
- * \param [in] size                 size of msg
+ * \param [in] len                  number of bytes written
+ */
+void sps_queue_write_commit(sps_queue_t *sps_queue, uint32_t len);
+
+/**
+ * \brief Copy data to the SPS queue
+ *
+ * Only the data fitting in the free space of the queue are written.
+ *
+ * \param [in] sps_queue            SPS queue instance
+ * \param [in] size                 size of data
  * \param [in] data                 ptr to the data
  *
+ * \return number of bytes written, less than \p size if the queue is full
  */
-void sps_queue_write_items(sps_queue_t *sps_queue, MSG_SIZE size, const uint8_t *data);
+uint32_t sps_queue_write_items(sps_queue_t *sps_queue, uint32_t size, const uint8_t *data);
 
 /**
- * \brief Pop one msg from the SPS queue
+ * \brief Get a contiguous region of stored data without removing it (consumer side)
  *
- * \param [in] sps_queue           SPS queue instance
- * \param [in] pMsg                message instance
+ * \param [in]  sps_queue          SPS queue instance
+ * \param [in]  offset             number of stored bytes to skip
+ * \param [out] len                number of contiguous bytes available at the returned ptr
  *
- * \return if the process succeeds
+ * \return ptr to the data or NULL if there are no data beyond \p offset
  */
-bool sps_queue_pop_items(sps_queue_t *sps_queue, msg* pMsg);
+const uint8_t *sps_queue_read_ptr(sps_queue_t *sps_queue, uint32_t offset, uint32_t *len);
 
 /**
- * \brief Read one msg from the SPS queue
+ * \brief Remove bytes from the head of the SPS queue
  *
  * \param [in] sps_queue           SPS queue instance
- * \param [in] pMsg                message instance
- *
- * \return if the process succeeds
+ * \param [in] len                 number of bytes to remove
  */
-bool sps_queue_read_items(sps_queue_t *sps_queue, msg* pMsg);
+void sps_queue_read_release(sps_queue_t *sps_queue, uint32_t len);
 
 /**
  * \brief Check if the SPS queue is almost empty (< low water mark)
@@ -106,7 +154,7 @@ bool sps_queue_read_items(sps_queue_t *sps_queue, msg* pMsg);
 bool sps_queue_check_almost_empty(sps_queue_t* sps_queue);
 
 /**
- * \brief Check if the SPS queue is almost full (> low water mark)
+ * \brief Check if the SPS queue is almost full (> high water mark)
  *
  * \param [in] sps_queue           SPS queue instance
  *
@@ -81,6 +81,9 @@ int uart_close(ad_uart_handle_t handle);
 
 uint32_t uart_read_timeout(HW_UART_BAUDRATE baud, uint32_t rx_size);
 
+/* Return the max time in ms a partial frame of rx_size bytes is held back for coalescing */
+uint32_t uart_coalesce_deadline(HW_UART_BAUDRATE baud, uint32_t rx_size);
+
 int read_from_uart(ad_uart_handle_t handle, char *buf, uint32_t len, OS_TICK_TIME timeout);
 
 int write_to_uart(ad_uart_handle_t handle, const char *buf, uint32_t len);
@@ -36,6 +36,7 @@
 #include "osal.h"
 #include "sys_watchdog.h"
 #include "ble_att.h"
+#include "ble_bufops.h"
 #include "ble_common.h"
 #include "ble_config.h"
 #include "ble_gap.h"
@@ -44,7 +45,9 @@
 #include "ble_service.h"
 #include "ble_uuid.h"
 #include "dsps_queue.h"
+#include "dsps_stats.h"
 #include "dsps.h"
+#include "dsps_lz.h"
 #if defined(DSPS_UART)
    #include "dsps_uart.h"
 #endif
@@ -62,6 +65,9 @@
 # include "platform_nvparam.h"
 # include "gap.h"
 #endif
+#if dg_configUSE_CLI
+# include "cli.h"
+#endif
 
 /* SPS handle instance to store the handles */
 typedef struct {
@@ -104,12 +110,20 @@ typedef struct {
 #define BLE_DISCOVER_NOTIF     (1 << 5)
 #define BLE_SCAN_START_NOTIF   (1 << 6)
 #define BLE_CONN_TIMEOUT_NOTIF (1 << 7)
+#define CLI_NOTIF              (1 << 8)
 
 #define BLE_SCAN_INTERVAL      (BLE_SCAN_INTERVAL_FROM_MS(30))
 #define BLE_SCAN_WINDOW        (BLE_SCAN_WINDOW_FROM_MS(15))
 
 __RETAINED static sps_queue_t *rx_queue;
 __RETAINED static sps_queue_t *tx_queue;
+/* Statically allocated storage of TX and RX SPS queues; the OS heap is too small for it */
+__RETAINED static sps_queue_t rx_queue_inst;
+__RETAINED static sps_queue_t tx_queue_inst;
+__RETAINED static uint8_t rx_queue_buf[RX_SPS_QUEUE_SIZE];
+__RETAINED static uint8_t tx_queue_buf[TX_SPS_QUEUE_SIZE];
+/* Serial port to BLE latency of the frames in TX queue */
+__RETAINED static dsps_stats_latency_t tx_latency;
 __RETAINED static dsps_central_t *dsps;
 __RETAINED static OS_TASK ble_central_task_handle;
 __RETAINED static OS_TASK dsps_rx_task_handle;
@@ -118,7 +132,6 @@ __RETAINED static OS_TASK dsps_tx_task_handle;
    __RETAINED static ad_uart_handle_t uart_handle;
 #endif
 __RETAINED static bd_address_t peer_addr;
-__RETAINED static uint8_t dsps_data[DSPS_RX_SIZE];
 __RETAINED static OS_TIMER conn_timeout_h;
 
 __RETAINED_RW static gap_conn_params_t cp = {
@@ -137,6 +150,29 @@ __RETAINED_RW static uint8_t dsps_flow_ctrl = DSPS_FLOW_CONTROL_OFF;
 /* Flag for TX in progress */
 __RETAINED_RW static bool dsps_tx_in_inprogress = false;
 
+/* Number of bytes sent out of TX queue and waiting for tx_done_cb */
+__RETAINED_RW static uint32_t dsps_tx_inflight_len = 0;
+
+/*
+ * Credit-based flow control, used once the server has answered our offer. Byte counts start when
+ * the offer is written (TX) and when the first credit limit of the server is received (RX).
+ */
+__RETAINED_RW static bool dsps_credit_mode = false;
+__RETAINED_RW static bool dsps_credit_pending = false;
+__RETAINED static uint32_t dsps_rx_total;
+__RETAINED static uint32_t dsps_rx_limit;
+__RETAINED static uint32_t dsps_tx_total;
+__RETAINED static uint32_t dsps_tx_limit;
+
+#if DSPS_COMPRESSION
+/* Payload compression, once negotiated with the server for each direction */
+__RETAINED_RW static bool lz_tx_on = false;
+__RETAINED_RW static bool lz_rx_on = false;
+__RETAINED static dsps_lz_enc_t lz_enc;
+__RETAINED static dsps_lz_dec_t lz_dec;
+__RETAINED static uint8_t lz_buf[DSPS_LZ_PACKET_DATA_MAX];
+#endif
+
 /*  Serial RX size */
 __RETAINED_RW static uint32_t dsps_rx_size = DSPS_RX_SIZE;
 
@@ -145,6 +181,9 @@ __RETAINED_RW static uint32_t dsps_rx_size = DSPS_RX_SIZE;
    __RETAINED_RW static uint32_t uart_rx_timeout = 1000;
 #endif
 
+/* Max time partial serial port reads are held back to be coalesced into full frames */
+__RETAINED_RW static OS_TICK_TIME coalesce_deadline = OS_MS_2_TICKS(DSPS_COALESCE_DEADLINE_MS);
+
 /*  flag for indicating UART is ready to read */
 __RETAINED_RW static bool dsps_read_ready = false;
 
@@ -213,6 +252,7 @@ static void throughput_calculation(uint32_t dataSize, SPS_DIRECTION direction)
 #if THROUGHPUT_CALCULATION_ENABLE
         static uint32_t former_ticks[SPS_DIRECTION_MAX] = { [0 ... SPS_DIRECTION_MAX - 1] = 0 };
         static uint32_t accumulated_size[SPS_DIRECTION_MAX] = { [0 ... SPS_DIRECTION_MAX - 1] = 0 };
+        static uint32_t accumulated_packets[SPS_DIRECTION_MAX] = { [0 ... SPS_DIRECTION_MAX - 1] = 0 };
 
         if (accumulated_size[direction] > DATA_THRESHOLD_TO_CAL_THROUGHPUT)
         {
@@ -228,10 +268,13 @@ static void throughput_calculation(uint32_t dataSize, SPS_DIRECTION direction)
                 {
                         passed_ms = OS_TICKS_2_MS(OS_TIMER_FOREVER - former_ticks[direction] + 1 + currentTicks);
                 }
-                DBG_LOG("%s throughput is %ld bytes/s.\r\n", direction == SPS_DIRECTION_IN ? "IN" : "OUT",
-                                                                        accumulated_size[direction] * 1000 / passed_ms);
+                DBG_LOG("%s throughput is %ld bytes/s, %ld bytes per packet.\r\n",
+                                                direction == SPS_DIRECTION_IN ? "IN" : "OUT",
+                                                accumulated_size[direction] * 1000 / passed_ms,
+                                                accumulated_size[direction] / accumulated_packets[direction]);
 
                 accumulated_size[direction] = 0;
+                accumulated_packets[direction] = 0;
         }
         else
         {
@@ -241,6 +284,7 @@ static void throughput_calculation(uint32_t dataSize, SPS_DIRECTION direction)
                 }
 
                 accumulated_size[direction] += dataSize;
+                accumulated_packets[direction]++;
         }
 #endif /* THROUGHPUT_CALCULATION_ENABLE */
 }
@@ -327,22 +371,49 @@ static bool dsps_set_flow_control_host(dsps_central_t *sps, uint16_t conn_idx, D
         return status == BLE_STATUS_OK ? true : false;
 }
 
+/* Function sends SPS credit limit to server. */
+static bool dsps_set_credit_limit_host(dsps_central_t *sps, uint16_t conn_idx, uint32_t limit)
+{
+        uint8_t value[DSPS_FLOW_CONTROL_CREDIT_LEN];
+        uint8_t status;
+
+        value[0] = DSPS_FLOW_CONTROL_CREDIT;
+        put_u32(value + 1, limit);
+
+        status = ble_gattc_write_no_resp(conn_idx, sps->sps_flow_ctrl_val_h, false, sizeof(value), value);
+
+        return status == BLE_STATUS_OK ? true : false;
+}
+
+#if DSPS_COMPRESSION
+/* Function sends SPS compression request to server. */
+static bool dsps_set_compression_host(dsps_central_t *sps, uint16_t conn_idx)
+{
+        uint8_t value[DSPS_FLOW_CONTROL_COMPRESS_LEN] = { DSPS_FLOW_CONTROL_COMPRESS, DSPS_LZ_CODEC };
+        uint8_t status;
+
+        status = ble_gattc_write_no_resp(conn_idx, sps->sps_flow_ctrl_val_h, false, sizeof(value), value);
+
+        return status == BLE_STATUS_OK ? true : false;
+}
+#endif
+
 static void rx_data_available(void)
 {
         bool send_flow_on = false;
-        msg rx_msg;
-        bool ret;
+        const uint8_t *rx_data;
+        uint32_t rx_size;
 
         /**
-         * Pop data from RX queue. Make sure msg is not 0 size or queue is not empty.
+         * Get the contiguous data at the head of RX queue. Make sure queue is not empty.
          */
-        ret = sps_queue_pop_items(rx_queue, &rx_msg);
-        if (rx_msg.size == 0 || ret == false) {
+        rx_data = sps_queue_read_ptr(rx_queue, 0, &rx_size);
+        if (rx_data == NULL) {
                 return;
         }
 
 #if defined(DSPS_UART)
-        SERIAL_PORT_WRITE_DATA(uart_handle, (const char *)rx_msg.data, rx_msg.size, 0/*Not used*/);
+        SERIAL_PORT_WRITE_DATA(uart_handle, (const char *)rx_data, rx_size, 0/*Not used*/);
 #elif defined(DSPS_USBD)
         USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
 
@@ -354,21 +425,28 @@ static void rx_data_available(void)
                  * operation will be performed asynchronously.
                  * Otherwise, the timeout is interpreted in millisecond (blocking operation).
                  */
-                SERIAL_PORT_WRITE_DATA(usbd_handle, (const void *)rx_msg.data, (unsigned)rx_msg.size, 0);
+                SERIAL_PORT_WRITE_DATA(usbd_handle, (const void *)rx_data, (unsigned)rx_size, 0);
         }
 #endif
         /* Here you can add some kind of check to make sure that all bytes requested were transmitted. */
 
-        throughput_calculation(rx_msg.size, SPS_DIRECTION_OUT);
+        throughput_calculation(rx_size, SPS_DIRECTION_OUT);
+        dsps_stats_serial(SPS_DIRECTION_OUT, rx_size);
 
-        msg_release(&rx_msg);
+        sps_queue_read_release(rx_queue, rx_size);
 
-        /* Check if queue is almost empty and send SPS flow on if necessary */
-        send_flow_on = sps_queue_check_almost_empty(rx_queue);
-        if (send_flow_on) {
-                dsps_set_flow_control_host(dsps, conn_idx, DSPS_FLOW_CONTROL_ON);
+        if (dsps_credit_mode) {
+                /* Let BLE task raise the credit limit of the server */
+                OS_TASK_NOTIFY(ble_central_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
+        } else {
+                /* Check if queue is almost empty and send SPS flow on if necessary */
+                send_flow_on = sps_queue_check_almost_empty(rx_queue);
+                if (send_flow_on) {
+                        dsps_stats_flow(DSPS_STATS_FLOW_SPS_LOCAL, true);
+                        dsps_set_flow_control_host(dsps, conn_idx, DSPS_FLOW_CONTROL_ON);
 
-                DBG_LOG("SPS flow on due to LWM\r\n");
+                        DBG_LOG("SPS flow on due to LWM\r\n");
+                }
         }
 
         /* More data in queue -> notify TX task for write */
@@ -381,12 +459,26 @@ static void rx_data_available(void)
 static void rx_data_cb(dsps_central_t *sps, uint16_t conn_idx, const uint8_t *value, uint16_t length)
 {
         bool send_flow_off = false;
+        uint32_t written;
 
-        sps_queue_write_items(rx_queue, length, value);
+        dsps_stats_ble(SPS_DIRECTION_OUT, length);
 
-        /* Check if queue is almost full and issue flow off, if so. */
-        send_flow_off = sps_queue_check_almost_full(rx_queue);
+        written = sps_queue_write_items(rx_queue, length, value);
+        if (written < length) {
+                dsps_stats_dropped(SPS_DIRECTION_OUT, length - written);
+        }
+        dsps_stats_queue_depth(SPS_DIRECTION_OUT, sps_queue_item_count(rx_queue));
+
+        /* The server counts every byte it sends against the credit limit */
+        dsps_rx_total += length;
+
+        /*
+         * Check if queue is almost full and issue flow off, if so. With credits the server cannot
+         * send more than the RX queue can take, so there is no need to.
+         */
+        send_flow_off = !dsps_credit_mode && sps_queue_check_almost_full(rx_queue);
         if (send_flow_off) {
+                dsps_stats_flow(DSPS_STATS_FLOW_SPS_LOCAL, false);
                 /* Note: Certain number of on-the-fly packets might come even after SPS flow off */
                 dsps_set_flow_control_host(sps, conn_idx, DSPS_FLOW_CONTROL_OFF);
 
@@ -398,11 +490,43 @@ static void rx_data_cb(dsps_central_t *sps, uint16_t conn_idx, const uint8_t *va
 
 }
 
+/*
+ * Grant the free space of RX queue to the server. The limit is only raised once at least
+ * DSPS_CREDIT_GRANT_MIN bytes have been freed, unless a previous grant is still pending.
+ */
+static void credit_limit_available(void)
+{
+        uint32_t limit;
+
+        if (!dsps_credit_mode || conn_idx == BLE_CONN_IDX_INVALID) {
+                return;
+        }
+
+        /* RX queue is only written by this task, its free space can only grow meanwhile */
+        limit = dsps_rx_total + sps_queue_free_space(rx_queue);
+        if (!dsps_credit_pending && limit - dsps_rx_limit < DSPS_CREDIT_GRANT_MIN) {
+                return;
+        }
+
+        /* If the BLE stack is busy, retry once it has completed a write */
+        dsps_credit_pending = !dsps_set_credit_limit_host(dsps, conn_idx, limit);
+        if (dsps_credit_pending) {
+                return;
+        }
+
+        dsps_rx_limit = limit;
+        dsps_stats_flow(DSPS_STATS_FLOW_SPS_LOCAL, true);
+}
+
 static void tx_data_available(void)
 {
-        __UNUSED msg tx_msg;
+        const uint8_t *tx_data;
+        uint32_t tx_size;
+        int32_t credits = INT32_MAX;
         bool ret;
 
+        credit_limit_available();
+
         /* Do not continue if TX is already in progress */
         if (dsps_tx_in_inprogress) {
                 return;
@@ -412,17 +536,47 @@ static void tx_data_available(void)
                 return;
         }
 
-        /* Read one msg from TX queue */
-        ret = sps_queue_read_items(tx_queue, &tx_msg);
-        if (tx_msg.size == 0 || ret == false) {
+        if (dsps_credit_mode) {
+                credits = (int32_t)(dsps_tx_limit - dsps_tx_total);
+                if (credits <= 0) {
+                        return;
+                }
+        }
+
+        /* Get up to one write worth of data, straight from TX queue */
+        tx_data = sps_queue_read_ptr(tx_queue, 0, &tx_size);
+        if (tx_data == NULL) {
                 return;
         }
+        tx_size = MIN(tx_size, (uint32_t)credits);
+
+#if DSPS_COMPRESSION
+        if (lz_tx_on) {
+                uint16_t len = dsps_lz_encode(&lz_enc, tx_data, tx_size, lz_buf, dsps_rx_size, &tx_size);
+
+                /* The server never sees a write that was not sent, drop it from the stream */
+                ret = tx_size && dsps_send_tx_data_host(dsps, conn_idx, lz_buf, len);
+                if (!ret) {
+                        dsps_lz_enc_rollback(&lz_enc, tx_size);
+                }
+        } else
+#endif
+        {
+                tx_size = MIN(tx_size, dsps_rx_size);
 
-        throughput_calculation(tx_msg.size, SPS_DIRECTION_IN);
+                /* Data are copied by the BLE stack */
+                ret = dsps_send_tx_data_host(dsps, conn_idx, (uint8_t *)tx_data, tx_size);
+        }
 
-        ret = dsps_send_tx_data_host(dsps, conn_idx, tx_msg.data, tx_msg.size);
         if (ret) {
+                throughput_calculation(tx_size, SPS_DIRECTION_IN);
+                dsps_stats_ble(SPS_DIRECTION_IN, tx_size);
+
+                dsps_tx_inflight_len = tx_size;
                 dsps_tx_in_inprogress = true;
+
+                /* Counted since the offer, the server answers with a limit relative to it */
+                dsps_tx_total += tx_size;
         }
 }
 
@@ -430,15 +584,17 @@ static void tx_data_available(void)
 static void tx_done_cb(dsps_central_t *sps, uint16_t conn_idx)
 {
         dsps_tx_in_inprogress = false;
-        msg m;
         bool send_flow_on = false;
 
-        sps_queue_pop_items(tx_queue, &m);
-        msg_release(&m);
+        /* Release the transmitted data */
+        sps_queue_read_release(tx_queue, dsps_tx_inflight_len);
+        dsps_tx_inflight_len = 0;
+        dsps_stats_latency_end(&tx_latency, tx_queue->tail);
 
         /* Check if queue is almost empty and send SPS flow off if necessary */
         send_flow_on = sps_queue_check_almost_empty(tx_queue);
         if (send_flow_on) {
+                dsps_stats_flow(DSPS_STATS_FLOW_SERIAL, true);
 
 #if defined(DSPS_UART)
 # if defined(CFG_UART_HW_FLOW_CTRL)
@@ -461,8 +617,8 @@ static void tx_done_cb(dsps_central_t *sps, uint16_t conn_idx)
                 DBG_LOG("SERIAL flow on due to LWM\r\n");
         }
 
-        /* More data in queue -> notify BLE task for TX */
-        if (sps_queue_item_count(tx_queue)) {
+        /* More data in queue or a pending credit limit -> notify BLE task for TX */
+        if (sps_queue_item_count(tx_queue) || dsps_credit_pending) {
                 OS_TASK_NOTIFY(ble_central_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
         }
 }
@@ -581,6 +737,7 @@ static void handle_evt_gap_mtu_exchanged(ble_evt_gattc_mtu_changed_t *evt)
 
 #if defined(DSPS_UART)
         uart_rx_timeout = uart_read_timeout(CFG_UART_SPS_BAUDRATE, dsps_rx_size);
+        coalesce_deadline = OS_MS_2_TICKS(uart_coalesce_deadline(CFG_UART_SPS_BAUDRATE, dsps_rx_size));
 #endif
 
         DBG_LOG("Central exchanged MTU size is %u\r\n", evt->mtu);
@@ -602,6 +759,8 @@ static void handle_evt_gap_disconnected(ble_evt_gap_disconnected_t *evt)
         /* Reset connection index (this will also stop sending SPS_START_READ_NOTIF) */
         conn_idx = BLE_CONN_IDX_INVALID;
 
+        dsps_stats_flow(DSPS_STATS_FLOW_SERIAL, false);
+
 #if defined(DSPS_UART)
 # if defined(CFG_UART_HW_FLOW_CTRL)
         SERIAL_PORT_SET_FLOW_OFF(&UART_DEVICE);
@@ -623,6 +782,13 @@ static void handle_evt_gap_disconnected(ble_evt_gap_disconnected_t *evt)
          * while the latter receives bytes and tx_done_cb() is never called to reset it.
          */
         dsps_tx_in_inprogress = false;
+        dsps_tx_inflight_len = 0;
+        dsps_credit_mode = false;
+        dsps_credit_pending = false;
+#if DSPS_COMPRESSION
+        lz_tx_on = false;
+        lz_rx_on = false;
+#endif
 
 #if defined(DSPS_UART)
         /* Let serial activity to finish */
@@ -632,11 +798,10 @@ static void handle_evt_gap_disconnected(ble_evt_gap_disconnected_t *evt)
 #elif defined(DSPS_USBD)
 #endif
 
-        /* Delete TX and RX queue */
-        sps_queue_free(tx_queue);
-        sps_queue_free(rx_queue);
-        tx_queue = NULL;
-        rx_queue = NULL;
+        /* Drop any data left in TX and RX queue */
+        sps_queue_reset(tx_queue);
+        sps_queue_reset(rx_queue);
+        dsps_stats_latency_reset(&tx_latency);
 
         /* Notify main thread, we'll start reconnection from there */
         OS_TASK_NOTIFY(ble_central_task_handle, BLE_SCAN_START_NOTIF, OS_NOTIFY_SET_BITS);
@@ -751,10 +916,11 @@ static void handle_evt_gattc_browse_completed(ble_evt_gattc_browse_completed_t *
         DBG_LOG("%s: conn_idx=%04x status=%d\r\n", __func__, evt->conn_idx, evt->status);
 
         /**
-         * Create TX and RX SPS queues
+         * Start with empty TX and RX SPS queues
          */
-        rx_queue = sps_queue_new(RX_SPS_QUEUE_SIZE, RX_QUEUE_LWM, RX_QUEUE_HWM);
-        tx_queue = sps_queue_new(TX_SPS_QUEUE_SIZE, TX_QUEUE_LWM, TX_QUEUE_HWM);
+        sps_queue_reset(rx_queue);
+        sps_queue_reset(tx_queue);
+        dsps_stats_latency_reset(&tx_latency);
 
 #if defined(DSPS_UART)
         uart_handle = SERIAL_PORT_OPEN(&UART_DEVICE);
@@ -762,6 +928,8 @@ static void handle_evt_gattc_browse_completed(ble_evt_gattc_browse_completed_t *
 #elif defined(DSPS_USBD)
 #endif
 
+        dsps_stats_flow(DSPS_STATS_FLOW_SERIAL, true);
+
 #if defined(DSPS_UART)
 # if defined(CFG_UART_HW_FLOW_CTRL)
         SERIAL_PORT_SET_FLOW_ON(&UART_DEVICE);
@@ -781,6 +949,24 @@ static void handle_evt_gattc_browse_completed(ble_evt_gattc_browse_completed_t *
 
         dsps_set_flow_control_host(dsps, conn_idx, DSPS_FLOW_CONTROL_ON);
 
+#if DSPS_CREDIT_FLOW_CONTROL
+        /*
+         * Offer credit-based flow control. Servers not supporting it reject the write and keep using
+         * ON/OFF flow control, so bytes sent from now on are counted in case the server answers.
+         */
+        dsps_credit_mode = false;
+        dsps_credit_pending = false;
+        dsps_tx_total = 0;
+        dsps_set_credit_limit_host(dsps, conn_idx, 0);
+#endif
+
+#if DSPS_COMPRESSION
+        /* Offer compression; data are sent as is until the server answers */
+        lz_tx_on = false;
+        lz_rx_on = false;
+        dsps_set_compression_host(dsps, conn_idx);
+#endif
+
         /* Start reading from serial interface */
         OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_START_READ_NOTIF, OS_NOTIFY_SET_BITS);
 }
@@ -802,15 +988,61 @@ static void handle_evt_gattc_notification(ble_evt_gattc_notification_t *evt)
         if (dsps->sps_tx_val_h == evt -> handle) {
                 /* Call RX data callback if SPS flow is on */
                 if (dsps_flow_ctrl == DSPS_FLOW_CONTROL_ON) {
+#if DSPS_COMPRESSION
+                        if (lz_rx_on && evt->length) {
+                                int len = dsps_lz_decode(&lz_dec, evt->value, evt->length, lz_buf);
+
+                                if (len < 0) {
+                                        DBG_LOG("Corrupted compressed SPS data\r\n");
+                                } else if (len) {
+                                        rx_data_cb(dsps, conn_idx, lz_buf, len);
+                                }
+                                return;
+                        }
+#endif
                         if (evt->length){
                                 rx_data_cb(dsps, conn_idx, evt->value, evt->length);
                          }
                 }
         }
-        if (dsps->sps_flow_ctrl_val_h == evt->handle)
+#if DSPS_COMPRESSION
+        if (dsps->sps_flow_ctrl_val_h == evt->handle && evt->length == DSPS_FLOW_CONTROL_COMPRESS_LEN &&
+                        evt->value[0] == DSPS_FLOW_CONTROL_COMPRESS && evt->value[1] == DSPS_LZ_CODEC) {
+                if (!lz_rx_on) {
+                        /* Server answered our offer, the notifications following it are compressed */
+                        dsps_lz_dec_reset(&lz_dec);
+                        lz_rx_on = true;
+
+                        /* Our writes are compressed once the server has been told so */
+                        dsps_lz_enc_reset(&lz_enc);
+                        lz_tx_on = dsps_set_compression_host(dsps, conn_idx);
+
+                        DBG_LOG("SPS compression is ON\r\n");
+                }
+                return;
+        }
+#endif
+        if (dsps->sps_flow_ctrl_val_h == evt->handle &&
+                        evt->length == DSPS_FLOW_CONTROL_CREDIT_LEN && evt->value[0] == DSPS_FLOW_CONTROL_CREDIT) {
+                if (!dsps_credit_mode) {
+                        /* Server answered our offer, bytes received are counted from now on */
+                        dsps_credit_mode = true;
+                        dsps_credit_pending = true;
+                        dsps_rx_total = 0;
+                        dsps_rx_limit = 0;
+                        dsps_flow_ctrl = DSPS_FLOW_CONTROL_ON;
+
+                        DBG_LOG("SPS credit-based flow control\r\n");
+                }
+
+                dsps_tx_limit = get_u32(evt->value + 1);
+                dsps_stats_flow(DSPS_STATS_FLOW_SPS_PEER, true);
+                OS_TASK_NOTIFY(ble_central_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
+        } else if (dsps->sps_flow_ctrl_val_h == evt->handle)
         {
                 /* Save the latest SPS flow status */
                 dsps_flow_ctrl = evt->value[0];
+                dsps_stats_flow(DSPS_STATS_FLOW_SPS_PEER, dsps_flow_ctrl == DSPS_FLOW_CONTROL_ON);
                 switch(dsps_flow_ctrl) {
                         case DSPS_FLOW_CONTROL_ON:
                                 DBG_LOG("SPS flow control is ON\r\n");
@@ -840,12 +1072,45 @@ static void conn_timeout_cb(OS_TIMER xTimer)
         OS_TASK_NOTIFY(task, BLE_CONN_TIMEOUT_NOTIF, OS_NOTIFY_SET_BITS);
 }
 
+#if dg_configUSE_CLI
+static void clicmd_default_handler(int argc, const char *argv[], void *user_data)
+{
+        printf("Valid commands:\r\n");
+        printf("\tstats [reset]\r\n");
+}
+
+static void clicmd_stats_handler(int argc, const char *argv[], void *user_data)
+{
+        if (argc > 1 && !strcmp(argv[1], "reset")) {
+                dsps_stats_reset();
+                return;
+        }
+
+        dsps_stats_print();
+}
+
+static const cli_command_t clicmd[] = {
+        { .name = "stats",              .handler = clicmd_stats_handler, },
+        {},
+};
+#endif /* dg_configUSE_CLI */
+
 void dsps_BLE_task(void *params)
 {
         int8_t wdog_id;
+#if dg_configUSE_CLI
+        cli_t cli;
+#endif
 
         ble_central_task_handle = OS_GET_CURRENT_TASK();
 
+        dsps_stats_reset();
+
+#if dg_configUSE_CLI
+        /* Register CLI for dumping the statistics */
+        cli = cli_register(CLI_NOTIF, clicmd, clicmd_default_handler);
+#endif
+
         /* register ble_central task to be monitored by watchdog */
         wdog_id = sys_watchdog_register(false);
 
@@ -865,6 +1130,14 @@ void dsps_BLE_task(void *params)
         dsps = OS_MALLOC(sizeof(*dsps));
         memset(dsps, 0, sizeof(*dsps));
 
+        /**
+         * Create TX and RX SPS queues. Their storage is reused across connections.
+         */
+        rx_queue = &rx_queue_inst;
+        tx_queue = &tx_queue_inst;
+        sps_queue_init(rx_queue, rx_queue_buf, RX_SPS_QUEUE_SIZE, RX_QUEUE_LWM, RX_QUEUE_HWM);
+        sps_queue_init(tx_queue, tx_queue_buf, TX_SPS_QUEUE_SIZE, TX_QUEUE_LWM, TX_QUEUE_HWM);
+
         scan_start();
 
         conn_timeout_h = OS_TIMER_CREATE("CONN_TIMEOUT", OS_MS_2_TICKS(CONN_TIMEOUT_MS), OS_TIMER_FAIL,
@@ -988,12 +1261,24 @@ no_event:
 
                         ASSERT_WARNING(status == BLE_STATUS_OK);
                 }
+
+#if dg_configUSE_CLI
+                if (notif & CLI_NOTIF) {
+                        cli_handle_notified(cli);
+                }
+#endif
         }
 }
 
 void dsps_rx_task(void *params)
 {
-        static uint32_t ReadSize = 0;
+        static int ReadSize = 0;
+        /* Frame of the TX queue being filled and number of bytes read into it so far */
+        static uint8_t *dsps_data;
+        static uint32_t frame_len;
+        static uint32_t pending_len = 0;
+        static uint16_t read_conn_idx;
+        static OS_TICK_TIME coalesce_start;
 
         dsps_rx_task_handle = OS_GET_CURRENT_TASK();
 
@@ -1011,12 +1296,19 @@ void dsps_rx_task(void *params)
                 if (notif & SPS_DATA_READ_NOTIF) {
                         bool send_flow_off = false;
 
-                        sps_queue_write_items(tx_queue, ReadSize, dsps_data);
+                        /* Data were read straight into TX queue, just publish them */
+                        if (conn_idx != BLE_CONN_IDX_INVALID && conn_idx == read_conn_idx) {
+                                sps_queue_write_commit(tx_queue, pending_len);
+                                dsps_stats_latency_start(&tx_latency, tx_queue->head, coalesce_start);
+                        }
+                        pending_len = 0;
+                        dsps_stats_queue_depth(SPS_DIRECTION_IN, sps_queue_item_count(tx_queue));
 
                         /* Check if queue is almost full and issue to send a SPS flow off, if so */
                         send_flow_off = sps_queue_check_almost_full(tx_queue);
 
                         if (send_flow_off) {
+                                dsps_stats_flow(DSPS_STATS_FLOW_SERIAL, false);
 
 #if defined(DSPS_UART)
 # if defined(CFG_UART_HW_FLOW_CTRL)
@@ -1046,11 +1338,44 @@ void dsps_rx_task(void *params)
                  if (notif & SPS_START_READ_NOTIF) {
                          /* Must be connected with peer and the SPS flow should be ON */
                          if ((conn_idx != BLE_CONN_IDX_INVALID) && dsps_read_ready) {
+                                 uint32_t read_len;
+                                 OS_TICK_TIME timeout = OS_MS_2_TICKS(uart_rx_timeout);
+
+                                 /* Drop a partial frame left over from a previous connection */
+                                 if (pending_len && conn_idx != read_conn_idx) {
+                                         pending_len = 0;
+                                 }
+
+                                 if (pending_len == 0) {
+                                         /*
+                                          * Read into the free region of TX queue. If the queue is full, reading
+                                          * is resumed by tx_done_cb() once the low watermark is reached.
+                                          */
+                                         dsps_data = sps_queue_write_ptr(tx_queue, &read_len);
+                                         if (dsps_data == NULL) {
+                                                 continue;
+                                         }
+                                         frame_len = MIN(read_len, dsps_rx_size);
+                                         read_len = frame_len;
+                                         read_conn_idx = conn_idx;
+                                 } else {
+                                         /*
+                                          * Coalesce short bursts: wait for the rest of the frame, but do not
+                                          * hold the bytes already read for longer than the deadline.
+                                          */
+                                         OS_TICK_TIME elapsed = OS_GET_TICK_COUNT() - coalesce_start;
+
+                                         read_len = frame_len - pending_len;
+                                         timeout = elapsed < coalesce_deadline ? coalesce_deadline - elapsed : 0;
+                                 }
+                                 ReadSize = 0;
 
                                  /* Read from input serial port with calculated timeout */
 #if defined(DSPS_UART)
-                                 ReadSize = SERIAL_PORT_READ_DATA(uart_handle,
-                                         (char *)dsps_data, dsps_rx_size, OS_MS_2_TICKS(uart_rx_timeout));
+                                 if (timeout) {
+                                         ReadSize = SERIAL_PORT_READ_DATA(uart_handle,
+                                                 (char *)dsps_data + pending_len, read_len, timeout);
+                                 }
 #elif defined(DSPS_USBD)
                                  USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
 
@@ -1062,12 +1387,27 @@ void dsps_rx_task(void *params)
                                           * from the internal EndPoint buffer (if any and up to the size requested or less).
                                           * Otherwise the timeout is interpreted in millisecond.
                                           */
-                                         ReadSize = SERIAL_PORT_READ_DATA(usbd_handle, (void *)dsps_data,
-                                                                                         (unsigned)dsps_rx_size, 0);
+                                         if (pending_len == 0) {
+                                                 ReadSize = SERIAL_PORT_READ_DATA(usbd_handle, (void *)dsps_data,
+                                                                                         (unsigned)read_len, 0);
+                                         } else if (timeout) {
+                                                 ReadSize = SERIAL_PORT_READ_DATA(usbd_handle, (void *)(dsps_data + pending_len),
+                                                                 (unsigned)read_len, MAX(OS_TICKS_2_MS(timeout), 1));
+                                         }
                                  }
 #endif
 
                                  if (ReadSize > 0 /* In USB device the returned value might be negative indicating some kind of error */) {
+                                         if (pending_len == 0) {
+                                                 coalesce_start = OS_GET_TICK_COUNT();
+                                         }
+                                         pending_len += ReadSize;
+                                         dsps_stats_serial(SPS_DIRECTION_IN, ReadSize);
+                                 }
+
+                                 /* Publish full frames, or partial ones once the deadline has expired */
+                                 if (pending_len && (pending_len == frame_len ||
+                                                 OS_GET_TICK_COUNT() - coalesce_start >= coalesce_deadline)) {
                                          OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_DATA_READ_NOTIF, OS_NOTIFY_SET_BITS);
                                  }
                                  else {
@@ -38,15 +38,15 @@ typedef enum {
 } SPS_DIRECTION;
 
 /**
- * TX and RX queues used to buffer data between UART and BLE.
- * Queue size, high water mark, low water mark are defined.
+ * TX and RX byte queues used to buffer data between UART and BLE.
+ * Queue size (in bytes, power of two), high water mark, low water mark are defined.
  */
 #ifndef TX_SPS_QUEUE_SIZE
-   #define TX_SPS_QUEUE_SIZE (60)
+   #define TX_SPS_QUEUE_SIZE (16384)
 #endif
 
 #ifndef RX_SPS_QUEUE_SIZE
-   #define RX_SPS_QUEUE_SIZE (60)
+   #define RX_SPS_QUEUE_SIZE (16384)
 #endif
 
 #ifndef DATA_THRESHOLD_TO_CAL_THROUGHPUT
@@ -57,6 +57,33 @@ typedef enum {
    #define THROUGHPUT_CALCULATION_ENABLE  (1)
 #endif
 
+/**
+ * Bridge statistics (byte/packet counters, flow control events, queue depth history and serial
+ * port to BLE latency histogram), see dsps_stats.h.
+ */
+#ifndef DSPS_STATS_ENABLE
+   #define DSPS_STATS_ENABLE          (1)
+#endif
+
+/* Length (ms) of a queue depth history period and number of periods kept */
+#ifndef DSPS_STATS_PERIOD_MS
+   #define DSPS_STATS_PERIOD_MS       (1000)
+#endif
+
+#ifndef DSPS_STATS_HISTORY_LEN
+   #define DSPS_STATS_HISTORY_LEN     (8)
+#endif
+
+/* Number of latency histogram bins; the last one counts latencies of 2^(bins-2) ms and above */
+#ifndef DSPS_STATS_LATENCY_BINS
+   #define DSPS_STATS_LATENCY_BINS    (12)
+#endif
+
+/* Max number of frames per TX queue tracked for latency at the same time */
+#ifndef DSPS_STATS_LATENCY_SLOTS
+   #define DSPS_STATS_LATENCY_SLOTS   (16)
+#endif
+
 #ifndef MTU_SIZE
    #define MTU_SIZE         (dg_configBLE_DATA_LENGTH_TX_MAX - 4) // 4-byte L2CAP header
 #endif
@@ -65,6 +92,86 @@ typedef enum {
    #define DSPS_RX_SIZE     (MTU_SIZE - 3) // Match the used MTU size, excluding the 3-byte ATT header
 #endif
 
+/**
+ * Max number of centrals bridged to the serial port at the same time. Each connection has its own
+ * TX and RX queues, so RAM usage grows accordingly. The BLE stack must be configured to support
+ * at least as many connections.
+ */
+#ifndef DSPS_MAX_CONNECTIONS
+   #define DSPS_MAX_CONNECTIONS    (1)
+#endif
+
+/**
+ * Max number of SPS notifications in flight. The actual window is sized at runtime from the
+ * negotiated data length and connection interval; set to 1 to send one notification at a time.
+ */
+#ifndef DSPS_TX_WINDOW_MAX
+   #define DSPS_TX_WINDOW_MAX      (8)
+#endif
+
+/* LL TX data length and air time (us) in use until the data length is negotiated (LE 1M) */
+#ifndef DSPS_LL_TX_LENGTH_DEFAULT
+   #define DSPS_LL_TX_LENGTH_DEFAULT  (27)
+#endif
+
+#ifndef DSPS_LL_TX_TIME_DEFAULT
+   #define DSPS_LL_TX_TIME_DEFAULT    (328)
+#endif
+
+/* Per LL packet overhead (us): 2 x T_IFS plus the empty packet from the peer on LE 1M */
+#ifndef DSPS_LL_PDU_OVERHEAD_US
+   #define DSPS_LL_PDU_OVERHEAD_US    (380)
+#endif
+
+/**
+ * Partial serial port reads are coalesced into frames of one notification payload. A partial
+ * frame is held back for at most the time needed to receive DSPS_COALESCE_FRAMES full frames at
+ * the UART baud rate, or for DSPS_COALESCE_DEADLINE_MS over USB. Set to 0 to send partial frames
+ * as soon as they are read.
+ */
+#ifndef DSPS_COALESCE_FRAMES
+   #define DSPS_COALESCE_FRAMES       (1)
+#endif
+
+#ifndef DSPS_COALESCE_DEADLINE_MS
+   #define DSPS_COALESCE_DEADLINE_MS  (10)
+#endif
+
+/**
+ * Credit-based SPS flow control. When the peer supports it, the receiver grants the free space of
+ * its RX queue to the sender, which never sends beyond it, instead of switching the flow on and
+ * off at the RX queue watermarks. The credit limit is raised once at least DSPS_CREDIT_GRANT_MIN
+ * bytes have been freed. Set to 0 to use ON/OFF flow control only.
+ */
+#ifndef DSPS_CREDIT_FLOW_CONTROL
+   #define DSPS_CREDIT_FLOW_CONTROL   (1)
+#endif
+
+#ifndef DSPS_CREDIT_GRANT_MIN
+   #define DSPS_CREDIT_GRANT_MIN      ((RX_SPS_QUEUE_SIZE) / 4)
+#endif
+
+/**
+ * Compression of the SPS payloads with the LZ codec of dsps_lz.h, negotiated with the peer. Each
+ * connection needs about 2 x DSPS_LZ_HISTORY_SIZE + 2^(DSPS_LZ_HASH_BITS + 1) bytes of RAM.
+ */
+#ifndef DSPS_COMPRESSION
+   #define DSPS_COMPRESSION           (0)
+#endif
+
+#ifndef DSPS_LZ_HISTORY_SIZE
+   #define DSPS_LZ_HISTORY_SIZE       (2048)
+#endif
+
+#ifndef DSPS_LZ_HASH_BITS
+   #define DSPS_LZ_HASH_BITS          (9)
+#endif
+
+/* Max number of data bytes compressed into one packet */
+#ifndef DSPS_LZ_PACKET_DATA_MAX
+   #define DSPS_LZ_PACKET_DATA_MAX    (512)
+#endif
+
 #define TX_QUEUE_HWM      ((TX_SPS_QUEUE_SIZE)*0.80)
 #define TX_QUEUE_LWM      ((TX_SPS_QUEUE_SIZE)*0.10)
 /* Because of packets on-the-air, be careful when increase the RX HWM */
@@ -0,0 +1,282 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_stats.c
+ *
+ * @brief DSPS statistics implementation
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "osal.h"
+#include "sdk_defs.h"
+#include "ble_bufops.h"
+#include "dsps_stats.h"
+
+#if DSPS_STATS_ENABLE
+
+__RETAINED static dsps_stats_t stats;
+
+static const char *const flow_name[DSPS_STATS_FLOW_MAX] = {
+        [DSPS_STATS_FLOW_SERIAL]    = "serial",
+        [DSPS_STATS_FLOW_SPS_LOCAL] = "SPS local",
+        [DSPS_STATS_FLOW_SPS_PEER]  = "SPS peer",
+};
+
+static uint32_t current_period(void)
+{
+        return OS_GET_TICK_COUNT() / OS_MS_2_TICKS(DSPS_STATS_PERIOD_MS);
+}
+
+/* Move the queue depth history of a direction forward, clearing the periods without samples */
+static void queue_history_advance(dsps_stats_t *s, SPS_DIRECTION direction, uint32_t period)
+{
+        uint32_t p = s->queue_period[direction];
+
+        for (int n = 0; p != period && n < DSPS_STATS_HISTORY_LEN; n++) {
+                p++;
+                s->queue_hwm[direction][p % DSPS_STATS_HISTORY_LEN] = 0;
+        }
+
+        s->queue_period[direction] = period;
+}
+
+static void latency_record(uint32_t ms)
+{
+        uint32_t bin = ms ? 32 - __CLZ(ms) : 0;
+
+        stats.latency_hist[MIN(bin, DSPS_STATS_LATENCY_BINS - 1)]++;
+        stats.latency_min = MIN(stats.latency_min, ms);
+        stats.latency_max = MAX(stats.latency_max, ms);
+        stats.latency_sum += ms;
+        stats.latency_cnt++;
+}
+
+void dsps_stats_reset(void)
+{
+        uint32_t period = current_period();
+
+        OS_ENTER_CRITICAL_SECTION();
+        memset(&stats, 0, sizeof(stats));
+        stats.start_time = OS_GET_TICK_COUNT();
+        stats.latency_min = UINT32_MAX;
+        for (int i = 0; i < SPS_DIRECTION_MAX; i++) {
+                stats.queue_period[i] = period;
+        }
+        OS_LEAVE_CRITICAL_SECTION();
+}
+
+void dsps_stats_get(dsps_stats_t *s)
+{
+        uint32_t period = current_period();
+
+        OS_ENTER_CRITICAL_SECTION();
+        memcpy(s, &stats, sizeof(*s));
+        OS_LEAVE_CRITICAL_SECTION();
+
+        for (int i = 0; i < SPS_DIRECTION_MAX; i++) {
+                queue_history_advance(s, i, period);
+        }
+}
+
+void dsps_stats_serial(SPS_DIRECTION direction, uint32_t len)
+{
+        stats.dir[direction].serial_bytes += len;
+        stats.dir[direction].serial_ops++;
+}
+
+void dsps_stats_ble(SPS_DIRECTION direction, uint32_t len)
+{
+        stats.dir[direction].ble_bytes += len;
+        stats.dir[direction].ble_packets++;
+}
+
+void dsps_stats_dropped(SPS_DIRECTION direction, uint32_t len)
+{
+        stats.dir[direction].dropped_bytes += len;
+}
+
+void dsps_stats_flow(DSPS_STATS_FLOW flow, bool on)
+{
+        /* Flow events may be raised from several tasks */
+        OS_ENTER_CRITICAL_SECTION();
+        if (on) {
+                stats.flow_on[flow]++;
+        } else {
+                stats.flow_off[flow]++;
+        }
+        OS_LEAVE_CRITICAL_SECTION();
+}
+
+void dsps_stats_queue_depth(SPS_DIRECTION direction, uint32_t depth)
+{
+        uint32_t period = current_period();
+        uint32_t *hwm;
+
+        if (period != stats.queue_period[direction]) {
+                queue_history_advance(&stats, direction, period);
+        }
+
+        hwm = &stats.queue_hwm[direction][period % DSPS_STATS_HISTORY_LEN];
+        *hwm = MAX(*hwm, depth);
+        stats.queue_peak[direction] = MAX(stats.queue_peak[direction], depth);
+}
+
+void dsps_stats_latency_reset(dsps_stats_latency_t *lat)
+{
+        lat->head = 0;
+        lat->tail = 0;
+}
+
+void dsps_stats_latency_start(dsps_stats_latency_t *lat, uint32_t end, OS_TICK_TIME start)
+{
+        uint8_t head = lat->head;
+
+        /* Not sampled if all slots are in use */
+        if ((uint8_t)(head - lat->tail) >= DSPS_STATS_LATENCY_SLOTS) {
+                return;
+        }
+
+        lat->end[head % DSPS_STATS_LATENCY_SLOTS] = end;
+        lat->start[head % DSPS_STATS_LATENCY_SLOTS] = start;
+        lat->head = head + 1;
+}
+
+void dsps_stats_latency_end(dsps_stats_latency_t *lat, uint32_t released)
+{
+        OS_TICK_TIME now = OS_GET_TICK_COUNT();
+        uint8_t tail = lat->tail;
+
+        /* Free-running indexes, a frame was sent once the read index is at or past its end */
+        while (tail != lat->head &&
+                        (int32_t)(released - lat->end[tail % DSPS_STATS_LATENCY_SLOTS]) >= 0) {
+                latency_record(OS_TICKS_2_MS(now - lat->start[tail % DSPS_STATS_LATENCY_SLOTS]));
+                tail++;
+        }
+
+        lat->tail = tail;
+}
+
+uint16_t dsps_stats_serialize(uint8_t *buf)
+{
+        dsps_stats_t s;
+        uint8_t *ptr = buf;
+        int i, j;
+
+        dsps_stats_get(&s);
+
+        put_u8_inc(&ptr, DSPS_STATS_FORMAT_VERSION);
+
+        for (i = 0; i < SPS_DIRECTION_MAX; i++) {
+                put_u32_inc(&ptr, s.dir[i].serial_bytes);
+                put_u32_inc(&ptr, s.dir[i].serial_ops);
+                put_u32_inc(&ptr, s.dir[i].ble_bytes);
+                put_u32_inc(&ptr, s.dir[i].ble_packets);
+                put_u32_inc(&ptr, s.dir[i].dropped_bytes);
+        }
+
+        for (i = 0; i < DSPS_STATS_FLOW_MAX; i++) {
+                put_u32_inc(&ptr, s.flow_off[i]);
+        }
+        for (i = 0; i < DSPS_STATS_FLOW_MAX; i++) {
+                put_u32_inc(&ptr, s.flow_on[i]);
+        }
+
+        for (i = 0; i < SPS_DIRECTION_MAX; i++) {
+                put_u32_inc(&ptr, s.queue_peak[i]);
+        }
+        for (i = 0; i < SPS_DIRECTION_MAX; i++) {
+                for (j = 1; j <= DSPS_STATS_HISTORY_LEN; j++) {
+                        put_u32_inc(&ptr, s.queue_hwm[i][(s.queue_period[i] + j) % DSPS_STATS_HISTORY_LEN]);
+                }
+        }
+
+        for (i = 0; i < DSPS_STATS_LATENCY_BINS; i++) {
+                put_u32_inc(&ptr, s.latency_hist[i]);
+        }
+        put_u32_inc(&ptr, s.latency_cnt ? s.latency_min : 0);
+        put_u32_inc(&ptr, s.latency_max);
+        put_u32_inc(&ptr, s.latency_sum);
+        put_u32_inc(&ptr, s.latency_cnt);
+
+        put_u32_inc(&ptr, OS_TICKS_2_MS(OS_GET_TICK_COUNT() - s.start_time));
+
+        return ptr - buf;
+}
+
+void dsps_stats_print(void)
+{
+        dsps_stats_t s;
+        uint32_t elapsed_ms;
+        int i, j;
+
+        dsps_stats_get(&s);
+        elapsed_ms = MAX(OS_TICKS_2_MS(OS_GET_TICK_COUNT() - s.start_time), 1);
+
+        printf("DSPS statistics over %lu ms\r\n", elapsed_ms);
+
+        for (i = 0; i < SPS_DIRECTION_MAX; i++) {
+                const dsps_stats_dir_t *d = &s.dir[i];
+
+                printf("%-3s: serial %lu bytes in %lu %s, BLE %lu bytes in %lu packets, "
+                                                "%lu bytes dropped, %lu bytes/s\r\n",
+                                                i == SPS_DIRECTION_IN ? "IN" : "OUT",
+                                                d->serial_bytes, d->serial_ops,
+                                                i == SPS_DIRECTION_IN ? "reads" : "writes",
+                                                d->ble_bytes, d->ble_packets, d->dropped_bytes,
+                                                (uint32_t)((uint64_t)d->ble_bytes * 1000 / elapsed_ms));
+        }
+
+        for (i = 0; i < DSPS_STATS_FLOW_MAX; i++) {
+                printf("%s flow: %lu off, %lu on\r\n", flow_name[i], s.flow_off[i], s.flow_on[i]);
+        }
+
+        for (i = 0; i < SPS_DIRECTION_MAX; i++) {
+                printf("%s queue HWM: peak %lu, last %u periods of %u ms:",
+                                                i == SPS_DIRECTION_IN ? "TX" : "RX", s.queue_peak[i],
+                                                DSPS_STATS_HISTORY_LEN, DSPS_STATS_PERIOD_MS);
+                for (j = 1; j <= DSPS_STATS_HISTORY_LEN; j++) {
+                        printf(" %lu", s.queue_hwm[i][(s.queue_period[i] + j) % DSPS_STATS_HISTORY_LEN]);
+                }
+                printf("\r\n");
+        }
+
+        if (s.latency_cnt == 0) {
+                printf("Latency: no samples\r\n");
+                return;
+        }
+
+        printf("Latency: %lu samples, min %lu ms, avg %lu ms, max %lu ms\r\n", s.latency_cnt,
+                                s.latency_min, s.latency_sum / s.latency_cnt, s.latency_max);
+        printf("   <1 ms: %lu\r\n", s.latency_hist[0]);
+        for (i = 1; i < DSPS_STATS_LATENCY_BINS; i++) {
+                printf("%s%5lu ms: %lu\r\n", i == DSPS_STATS_LATENCY_BINS - 1 ? ">=" : "  ",
+                                                1UL << (i - 1), s.latency_hist[i]);
+        }
+}
+
+#endif /* DSPS_STATS_ENABLE */
@@ -37,10 +37,12 @@
 #define UUID_DSPS_SERVER_TX      "0783b03e-8535-b5a0-7140-a304d2495cb8"
 #define UUID_DSPS_SERVER_RX      "0783b03e-8535-b5a0-7140-a304d2495cba"
 #define UUID_DSPS_FLOW_CTRL      "0783b03e-8535-b5a0-7140-a304d2495cb9"
+#define UUID_DSPS_STATS          "0783b03e-8535-b5a0-7140-a304d2495cbb"
 
 static const char dsps_tx_desc[] = "Server TX Data";
 static const char dsps_rx_desc[] = "Server RX Data";
 static const char dsps_flow_control_desc[] = "Flow Control";
+static const char dsps_stats_desc[] = "Statistics";
 
 /* Size of characteristics: match the MTU size */
 static const uint16_t dsps_server_tx_size = 250;
@@ -48,15 +50,35 @@ static const uint16_t dsps_server_rx_size = 250;
 
 /**
  * SPS Flow Control flags values
+ *
+ * DSPS_FLOW_CONTROL_CREDIT is followed by a little-endian uint32_t credit limit, that is the total
+ * number of bytes the receiver accepts since the sender started using credits. The client offers
+ * credit-based flow control by writing a limit of 0 and counts the bytes it sends from then on. A
+ * server supporting it answers with its own limit, and the bytes it sends are counted from that
+ * notification on. From then on each side never sends beyond the limit of the other.
+ *
+ * DSPS_FLOW_CONTROL_COMPRESS is followed by a codec identifier. The client offers compression by
+ * writing it, a server supporting the codec answers with the same value and compresses the
+ * notifications following the answer. The client then writes it once more and compresses the
+ * writes following it.
  */
 typedef enum {
         DSPS_FLOW_CONTROL_ON = 0x01,
         DSPS_FLOW_CONTROL_OFF = 0x02,
+        DSPS_FLOW_CONTROL_CREDIT = 0x03,
+        DSPS_FLOW_CONTROL_COMPRESS = 0x04,
 } DSPS_FLOW_CONTROL;
 
+/* Length of a credit limit written to or notified by the flow control characteristic */
+#define DSPS_FLOW_CONTROL_CREDIT_LEN    (5)
+
+/* Length of a compression request written to or notified by the flow control characteristic */
+#define DSPS_FLOW_CONTROL_COMPRESS_LEN  (2)
+
 typedef void (* dsps_set_flow_control_cb_t) (ble_service_t *svc, uint16_t conn_idx, DSPS_FLOW_CONTROL value);
 typedef void (* dsps_rx_data_cb_t) (ble_service_t *svc, uint16_t conn_idx, const uint8_t *value, uint16_t length);
 typedef void (* dsps_tx_done_cb_t) (ble_service_t *svc, uint16_t conn_idx);
+typedef void (* dsps_credit_limit_cb_t) (ble_service_t *svc, uint16_t conn_idx, uint32_t limit);
 
 /**
  * SPS application callbacks
@@ -68,6 +90,8 @@ typedef struct {
         dsps_rx_data_cb_t          rx_data;
         /** Service finished TX transaction */
         dsps_tx_done_cb_t          tx_done;
+        /** Remote client wrote a credit limit (credit-based flow control) */
+        dsps_credit_limit_cb_t     credit_limit;
 } dsps_callbacks_t;
 
 typedef struct {
@@ -82,6 +106,8 @@ typedef struct {
 
         uint16_t sps_flow_ctrl_val_h;
         uint16_t sps_flow_ctrl_ccc_h;
+
+        uint16_t sps_stats_val_h;
 } dsps_service_t;
 
 /**
@@ -108,6 +134,32 @@ ble_service_t *dsps_init(dsps_callbacks_t *cb);
  */
 void dsps_set_flow_control(dsps_service_t *sps, uint16_t conn_idx, DSPS_FLOW_CONTROL value);
 
+/**
+ * \brief Get flow control value
+ *
+ * \param [in] svc              service instance
+ * \param [in] conn_idx         connection index
+ *
+ * \return current flow control value of the connection
+ *
+ */
+DSPS_FLOW_CONTROL dsps_get_flow_control(dsps_service_t *sps, uint16_t conn_idx);
+
+/**
+ * \brief Send credit limit
+ *
+ * Function notifies the client of the total number of bytes it may send (credit-based flow
+ * control). Notifications for the flow control characteristic must be enabled by the client.
+ *
+ * \param [in] svc              service instance
+ * \param [in] conn_idx         connection index
+ * \param [in] limit            credit limit
+ *
+ * \return true if the limit was queued for transmission, false otherwise
+ *
+ */
+bool dsps_send_credit_limit(dsps_service_t *sps, uint16_t conn_idx, uint32_t limit);
+
 /**
  * \brief Send available TX data
  *
@@ -119,7 +171,28 @@ void dsps_set_flow_control(dsps_service_t *sps, uint16_t conn_idx, DSPS_FLOW_CON
  * \param [in] data             tx data
  * \param [in] length           tx data length
  *
+ * \return true if data were queued for transmission, false otherwise
+ *
  */
 bool dsps_tx_data(dsps_service_t *sps, uint16_t conn_idx, uint8_t *data, uint16_t length);
 
+/**
+ * \brief Send available TX data, compressed if negotiated
+ *
+ * Function sends as much of the TX data as fits in one notification, compressed if the client
+ * has negotiated compression and as is otherwise. After sending data, service will call tx_done
+ * callback.
+ *
+ * \param [in] svc              service instance
+ * \param [in] conn_idx         connection index
+ * \param [in] data             tx data
+ * \param [in] length           tx data length
+ * \param [in] max_len          max notification payload
+ *
+ * \return number of tx data bytes sent, 0 if data could not be queued for transmission
+ *
+ */
+uint32_t dsps_tx_data_compressed(dsps_service_t *sps, uint16_t conn_idx, const uint8_t *data,
+                                                        uint32_t length, uint16_t max_len);
+
 #endif /* DSPS_H_ */
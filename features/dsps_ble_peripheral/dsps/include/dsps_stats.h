@@ -0,0 +1,227 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_stats.h
+ *
+ * @brief DSPS statistics header
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+#ifndef DSPS_STATS_H_
+#define DSPS_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "osal.h"
+#include "dsps_common.h"
+
+/* Flow control signals whose on/off events are counted */
+typedef enum {
+        DSPS_STATS_FLOW_SERIAL    = 0x00,       /* Serial port flow, driven by the TX queue */
+        DSPS_STATS_FLOW_SPS_LOCAL       ,       /* SPS flow sent to the peer, driven by the RX queue */
+        DSPS_STATS_FLOW_SPS_PEER        ,       /* SPS flow received from the peer */
+        DSPS_STATS_FLOW_MAX
+} DSPS_STATS_FLOW;
+
+/* Counters of one data direction (SPS_DIRECTION_IN is serial port to BLE) */
+typedef struct {
+        uint32_t        serial_bytes;           /* Bytes read from (IN) or written to (OUT) the serial port */
+        uint32_t        serial_ops;             /* Serial port read or write operations */
+        uint32_t        ble_bytes;              /* Bytes sent (IN) or received (OUT) over BLE */
+        uint32_t        ble_packets;            /* Notifications or writes sent (IN) or received (OUT) */
+        uint32_t        dropped_bytes;          /* Bytes lost because a queue was full */
+} dsps_stats_dir_t;
+
+/*
+ * Bridge statistics.
+ *
+ * Each counter is updated by a single task, so no locking is needed on the data path; readers
+ * take a consistent copy with dsps_stats_get().
+ */
+typedef struct {
+        /* Time the statistics were last reset */
+        OS_TICK_TIME            start_time;
+
+        dsps_stats_dir_t        dir[SPS_DIRECTION_MAX];
+
+        /* Flow control events, indexed by DSPS_STATS_FLOW */
+        uint32_t                flow_off[DSPS_STATS_FLOW_MAX];
+        uint32_t                flow_on[DSPS_STATS_FLOW_MAX];
+
+        /*
+         * Queue depth high water marks (TX queue for IN, RX queue for OUT): one slot per
+         * DSPS_STATS_PERIOD_MS period for the last DSPS_STATS_HISTORY_LEN periods, plus the
+         * peak since the last reset.
+         */
+        uint32_t                queue_period[SPS_DIRECTION_MAX];
+        uint32_t                queue_hwm[SPS_DIRECTION_MAX][DSPS_STATS_HISTORY_LEN];
+        uint32_t                queue_peak[SPS_DIRECTION_MAX];
+
+        /*
+         * Serial port to BLE latency histogram in ms. Bin 0 counts latencies below 1 ms and
+         * bin n latencies in [2^(n-1), 2^n) ms; the last bin also counts all longer ones.
+         */
+        uint32_t                latency_hist[DSPS_STATS_LATENCY_BINS];
+        uint32_t                latency_min;
+        uint32_t                latency_max;
+        uint32_t                latency_sum;
+        uint32_t                latency_cnt;
+} dsps_stats_t;
+
+/*
+ * Serial port to BLE latency tracker of one TX queue.
+ *
+ * Frames are tracked by the free-running write index of the queue right after they were
+ * published. Once the read index of the queue passes it, the frame has been sent and the time
+ * since its first byte was read is recorded. Frames published while all slots are in use are
+ * not sampled.
+ */
+typedef struct {
+        uint32_t                end[DSPS_STATS_LATENCY_SLOTS];
+        OS_TICK_TIME            start[DSPS_STATS_LATENCY_SLOTS];
+        volatile uint8_t        head;           /* Updated by the serial port reader */
+        volatile uint8_t        tail;           /* Updated on BLE TX completion */
+} dsps_stats_latency_t;
+
+#if DSPS_STATS_ENABLE
+
+/**
+ * \brief Reset all statistics
+ */
+void dsps_stats_reset(void);
+
+/**
+ * \brief Get a consistent copy of the statistics
+ *
+ * \param [out] stats           statistics, queue history brought up to the current period
+ */
+void dsps_stats_get(dsps_stats_t *stats);
+
+/**
+ * \brief Account data that went through the serial port
+ *
+ * \param [in] direction        SPS_DIRECTION_IN for reads, SPS_DIRECTION_OUT for writes
+ * \param [in] len              number of bytes
+ */
+void dsps_stats_serial(SPS_DIRECTION direction, uint32_t len);
+
+/**
+ * \brief Account one packet that went through BLE
+ *
+ * \param [in] direction        SPS_DIRECTION_IN for sent, SPS_DIRECTION_OUT for received packets
+ * \param [in] len              packet payload length
+ */
+void dsps_stats_ble(SPS_DIRECTION direction, uint32_t len);
+
+/**
+ * \brief Account bytes lost because a queue was full
+ *
+ * \param [in] direction        direction of the queue
+ * \param [in] len              number of bytes
+ */
+void dsps_stats_dropped(SPS_DIRECTION direction, uint32_t len);
+
+/**
+ * \brief Account a flow control event
+ *
+ * \param [in] flow             flow control signal
+ * \param [in] on               true for flow on, false for flow off
+ */
+void dsps_stats_flow(DSPS_STATS_FLOW flow, bool on);
+
+/**
+ * \brief Sample the depth of a queue
+ *
+ * \param [in] direction        SPS_DIRECTION_IN for TX queues, SPS_DIRECTION_OUT for RX queues
+ * \param [in] depth            number of bytes in the queue
+ */
+void dsps_stats_queue_depth(SPS_DIRECTION direction, uint32_t depth);
+
+/**
+ * \brief Discard all frames tracked for latency
+ *
+ * Must be called whenever the tracked TX queue is reset.
+ *
+ * \param [in] lat              latency tracker
+ */
+void dsps_stats_latency_reset(dsps_stats_latency_t *lat);
+
+/**
+ * \brief Track a frame published to a TX queue
+ *
+ * \param [in] lat              latency tracker of the TX queue
+ * \param [in] end              write index of the TX queue after the frame was published
+ * \param [in] start            time the first byte of the frame was read from the serial port
+ */
+void dsps_stats_latency_start(dsps_stats_latency_t *lat, uint32_t end, OS_TICK_TIME start);
+
+/**
+ * \brief Record the latency of the tracked frames that were sent
+ *
+ * \param [in] lat              latency tracker of the TX queue
+ * \param [in] released         read index of the TX queue after data were released
+ */
+void dsps_stats_latency_end(dsps_stats_latency_t *lat, uint32_t released);
+
+/**
+ * \brief Serialize the statistics for the debug GATT characteristic
+ *
+ * All fields are little-endian uint32_t, after a one byte format version: the dir[] counters,
+ * flow_off[], flow_on[], queue_peak[], queue_hwm[] of each direction oldest period first,
+ * then latency_hist[], latency_min, latency_max, latency_sum, latency_cnt and the elapsed
+ * time in ms.
+ *
+ * \param [out] buf             buffer of at least DSPS_STATS_SERIALIZED_SIZE bytes
+ *
+ * \return number of bytes written
+ */
+uint16_t dsps_stats_serialize(uint8_t *buf);
+
+/**
+ * \brief Print the statistics
+ */
+void dsps_stats_print(void);
+
+#else
+
+#define dsps_stats_reset()
+#define dsps_stats_get(_stats)
+#define dsps_stats_serial(_direction, _len)
+#define dsps_stats_ble(_direction, _len)
+#define dsps_stats_dropped(_direction, _len)
+#define dsps_stats_flow(_flow, _on)
+#define dsps_stats_queue_depth(_direction, _depth)
+#define dsps_stats_latency_reset(_lat)
+#define dsps_stats_latency_start(_lat, _end, _start)
+#define dsps_stats_latency_end(_lat, _released)
+#define dsps_stats_print()
+
+#endif /* DSPS_STATS_ENABLE */
+
+#define DSPS_STATS_FORMAT_VERSION       (1)
+
+#define DSPS_STATS_SERIALIZED_SIZE      (1 + 4 * (SPS_DIRECTION_MAX * 5 + DSPS_STATS_FLOW_MAX * 2 + \
+                                        SPS_DIRECTION_MAX * (1 + DSPS_STATS_HISTORY_LEN) +      \
+                                        DSPS_STATS_LATENCY_BINS + 5))
+
+#endif /* DSPS_STATS_H_ */
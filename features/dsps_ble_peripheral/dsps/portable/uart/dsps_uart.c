@@ -92,6 +92,12 @@ uint32_t uart_read_timeout(HW_UART_BAUDRATE baud, uint32_t rx_size)
         return timeout;
 }
 
+uint32_t uart_coalesce_deadline(HW_UART_BAUDRATE baud, uint32_t rx_size)
+{
+        /* Scale with the time needed to receive full frames; 0 disables coalescing */
+        return byte_time(baud) * rx_size * DSPS_COALESCE_FRAMES / 1000;
+}
+
 int read_from_uart(ad_uart_handle_t handle, char *buf, uint32_t len, OS_TICK_TIME timeout)
 {
         ASSERT_WARNING(buf != NULL);
@@ -48,6 +48,7 @@
 # include "dsps_uart.h"
 #endif
 #include "dsps_queue.h"
+#include "dsps_stats.h"
 #include "misc.h"
 #include "dsps_common.h"
 #include "dsps_port.h"
@@ -67,6 +68,9 @@
 # include "platform_nvparam.h"
 # include "gap.h"
 #endif
+#if dg_configUSE_CLI
+# include "cli.h"
+#endif
 
 /**
  * Task notifications and handles
@@ -76,6 +80,8 @@
 #define SPS_BLE_TX_NOTIF        (1 << 3)
 #define SPS_DATA_WRITE_NOTIF    (1 << 4)
 #define UPDATE_CONN_PARAM_NOTIF (1 << 5)
+#define CLI_NOTIF               (1 << 6)
+#define SPS_TX_RESET_NOTIF      (1 << 7)
 
 #if dg_configSUOTA_SUPPORT
 /*
@@ -84,8 +90,68 @@
 __RETAINED_RW static bool suota_ongoing = false;
 #endif /* dg_configSUOTA_SUPPORT */
 
-__RETAINED static sps_queue_t *rx_queue;
-__RETAINED static sps_queue_t *tx_queue;
+/* Per connection state of the serial port bridge */
+typedef struct {
+        /* Connection index, BLE_CONN_IDX_INVALID if the link is not in use */
+        uint16_t        conn_idx;
+
+        /*
+         * Incremented by BLE task on connection and disconnection. The TX queue is written by the
+         * serial port RX task only, which resets it and sets tx_queue_generation when notified with
+         * SPS_TX_RESET_NOTIF. Until then, the queue holds data of a previous connection.
+         */
+        uint32_t        generation;
+        uint32_t        tx_queue_generation;
+
+        /* Queues buffering data between the serial port and this connection */
+        sps_queue_t     rx_queue;
+        sps_queue_t     tx_queue;
+
+        /* Max notification payload, follows the exchanged MTU */
+        uint16_t        tx_size;
+
+        /* Negotiated link parameters used for sizing the TX window */
+        uint16_t        conn_interval;
+        uint16_t        ll_tx_length;
+        uint16_t        ll_tx_time;
+
+        /* Max number of notifications allowed in flight, see update_tx_window() */
+        uint8_t         tx_window;
+
+        /* Lengths of notifications sent and not yet confirmed by tx_done_cb, oldest first */
+        uint16_t        tx_inflight[DSPS_TX_WINDOW_MAX];
+        uint8_t         tx_inflight_first;
+        uint8_t         tx_inflight_cnt;
+
+        /* Number of bytes sent out of TX queue and waiting for tx_done_cb */
+        uint32_t        tx_inflight_len;
+
+        /* Serial port bytes not queued for this link because its TX queue was full */
+        uint32_t        tx_dropped;
+
+        /* Serial port to BLE latency of the frames in the TX queue */
+        dsps_stats_latency_t tx_latency;
+
+        /*
+         * Credit-based flow control, used once the peer has offered it. Byte counts start when the
+         * offer is received (RX) and when the first credit limit is sent (TX).
+         */
+        bool            credit_mode;
+        bool            credit_pending;
+        uint32_t        rx_total;
+        uint32_t        rx_limit;
+        uint32_t        tx_total;
+        uint32_t        tx_limit;
+
+        /* OS timer for connection parameter update */
+        OS_TIMER        conn_param_timer;
+        bool            conn_param_pending;
+} dsps_link_t;
+
+__RETAINED static dsps_link_t links[DSPS_MAX_CONNECTIONS];
+/* Statically allocated storage of TX and RX SPS queues; the OS heap is too small for it */
+__RETAINED static uint8_t rx_queue_buf[DSPS_MAX_CONNECTIONS][RX_SPS_QUEUE_SIZE];
+__RETAINED static uint8_t tx_queue_buf[DSPS_MAX_CONNECTIONS][TX_SPS_QUEUE_SIZE];
 /* SPS Service instance */
 __RETAINED static dsps_service_t *dsps;
 __RETAINED static OS_TASK ble_periph_task_handle;
@@ -94,16 +160,16 @@ __RETAINED static OS_TASK dsps_tx_task_handle;
 #if defined(DSPS_UART)
 __RETAINED static ad_uart_handle_t uart_handle;
 #endif
-__RETAINED static uint8_t dsps_data[DSPS_RX_SIZE];
 
-/* OS timer for connection parameter update */
-__RETAINED static OS_TIMER conn_param_timer;
+/* Number of links in use */
+__RETAINED_RW static uint8_t links_connected = 0;
 
-/* Current connection index */
-__RETAINED_RW static uint16_t conn_idx = BLE_CONN_IDX_INVALID;
+/* Next link to be served first by the BLE TX and the serial port TX schedulers */
+__RETAINED_RW static uint8_t ble_tx_next = 0;
+__RETAINED_RW static uint8_t serial_tx_next = 0;
 
-/* Flag for TX in progress */
-__RETAINED_RW static bool dsps_tx_in_inprogress = false;
+/* Links whose TX queue exceeded the high watermark; serial port flow is off while not zero */
+__RETAINED_RW static uint32_t serial_flow_off_links = 0;
 
 /* Serial RX size */
 __RETAINED_RW static uint32_t dsps_rx_size = DSPS_RX_SIZE;
@@ -113,6 +179,9 @@ __RETAINED_RW static uint32_t dsps_rx_size = DSPS_RX_SIZE;
 __RETAINED_RW static uint32_t uart_rx_timeout = 1000;
 #endif
 
+/* Max time partial serial port reads are held back to be coalesced into full frames */
+__RETAINED_RW static OS_TICK_TIME coalesce_deadline = OS_MS_2_TICKS(DSPS_COALESCE_DEADLINE_MS);
+
 /* Flag for indicating UART is ready to read */
 __RETAINED_RW static bool dsps_read_ready = false;
 
@@ -181,6 +250,7 @@ static void throughput_calculation(uint32_t dataSize, SPS_DIRECTION direction)
 #if THROUGHPUT_CALCULATION_ENABLE
         static uint32_t former_ticks[SPS_DIRECTION_MAX] = { [0 ... SPS_DIRECTION_MAX - 1] = 0 };
         static uint32_t accumulated_size[SPS_DIRECTION_MAX] = { [0 ... SPS_DIRECTION_MAX - 1] = 0 };
+        static uint32_t accumulated_packets[SPS_DIRECTION_MAX] = { [0 ... SPS_DIRECTION_MAX - 1] = 0 };
 
         if (accumulated_size[direction] > DATA_THRESHOLD_TO_CAL_THROUGHPUT)
         {
@@ -196,10 +266,13 @@ static void throughput_calculation(uint32_t dataSize, SPS_DIRECTION direction)
                 {
                         passed_ms = OS_TICKS_2_MS(OS_TIMER_FOREVER - former_ticks[direction] + 1 + currentTicks);
                 }
-                DBG_LOG("%s throughput is %ld bytes/s.\r\n", direction == SPS_DIRECTION_IN ? "IN" : "OUT",
-                                                                        accumulated_size[direction] * 1000 / passed_ms);
+                DBG_LOG("%s throughput is %ld bytes/s, %ld bytes per packet.\r\n",
+                                                direction == SPS_DIRECTION_IN ? "IN" : "OUT",
+                                                accumulated_size[direction] * 1000 / passed_ms,
+                                                accumulated_size[direction] / accumulated_packets[direction]);
 
                 accumulated_size[direction] = 0;
+                accumulated_packets[direction] = 0;
         }
         else
         {
@@ -209,6 +282,7 @@ static void throughput_calculation(uint32_t dataSize, SPS_DIRECTION direction)
                 }
 
                 accumulated_size[direction] += dataSize;
+                accumulated_packets[direction]++;
         }
 #endif /* THROUGHPUT_CALCULATION_ENABLE */
 }
@@ -232,9 +306,31 @@ static const char *format_bd_address(const bd_address_t *addr)
         return buf;
 }
 
+static dsps_link_t *link_find(uint16_t conn_idx)
+{
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                if (links[i].conn_idx == conn_idx) {
+                        return &links[i];
+                }
+        }
+
+        return NULL;
+}
+
+static uint32_t link_bit(dsps_link_t *link)
+{
+        return 1 << (link - links);
+}
+
 /* Timer callback to notify task for connection parameters update */
 static void conn_params_timer_cb(OS_TIMER timer)
 {
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                if (links[i].conn_param_timer == timer) {
+                        links[i].conn_param_pending = true;
+                }
+        }
+
         OS_TASK_NOTIFY(ble_periph_task_handle, UPDATE_CONN_PARAM_NOTIF, OS_NOTIFY_SET_BITS);
 }
 
@@ -251,10 +347,63 @@ static void conn_param_update(uint16_t conn_idx)
         ble_gap_conn_param_update(conn_idx, &cp);
 }
 
+static void serial_port_flow_on(void)
+{
+        dsps_stats_flow(DSPS_STATS_FLOW_SERIAL, true);
+
+#if defined(DSPS_UART)
+# if defined(CFG_UART_HW_FLOW_CTRL)
+        SERIAL_PORT_SET_FLOW_ON(&UART_DEVICE);
+# elif defined(CFG_UART_SW_FLOW_CTRL)
+        SERIAL_PORT_SET_FLOW_ON(uart_handle);
+# endif
+#elif defined(DSPS_USBD)
+        USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
+
+        /* -1 means that the USB device has yet to be initialized (i.e. the device is not attached/enumerated). */
+        if (usbd_handle >= 0) {
+                SERIAL_PORT_SET_FLOW_ON(usbd_handle);
+        }
+#endif
+}
+
+static void serial_port_flow_off(void)
+{
+        dsps_stats_flow(DSPS_STATS_FLOW_SERIAL, false);
+
+#if defined(DSPS_UART)
+# if defined(CFG_UART_HW_FLOW_CTRL)
+        SERIAL_PORT_SET_FLOW_OFF(&UART_DEVICE);
+# elif defined(CFG_UART_SW_FLOW_CTRL)
+        SERIAL_PORT_SET_FLOW_OFF(uart_handle);
+# endif
+#elif defined(DSPS_USBD)
+        USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
+
+        /* -1 means that the USB device has yet to be initialized (i.e. the device is not attached/enumerated). */
+        if (usbd_handle >= 0) {
+                SERIAL_PORT_SET_FLOW_OFF(usbd_handle);
+        }
+#endif
+}
+
+/* Release the serial port flow control held by a link; returns true if the flow is on again */
+static bool serial_flow_release(dsps_link_t *link)
+{
+        bool flow_on;
+
+        OS_ENTER_CRITICAL_SECTION();
+        flow_on = (serial_flow_off_links == link_bit(link));
+        serial_flow_off_links &= ~link_bit(link);
+        OS_LEAVE_CRITICAL_SECTION();
+
+        return flow_on;
+}
+
 /* Function sets SPS flow control signal to server. */
-static void set_flow_control_cb(ble_service_t *svc, uint16_t conn_idx, DSPS_FLOW_CONTROL value)
+static void update_flow_control(uint16_t conn_idx, DSPS_FLOW_CONTROL value)
 {
-        dsps_set_flow_control((dsps_service_t *)svc, conn_idx, value);
+        dsps_set_flow_control(dsps, conn_idx, value);
 
         switch(value) {
         case DSPS_FLOW_CONTROL_ON:
@@ -274,22 +423,96 @@ static void set_flow_control_cb(ble_service_t *svc, uint16_t conn_idx, DSPS_FLOW
         }
 }
 
+/* SPS flow control written by a peer */
+static void set_flow_control_cb(ble_service_t *svc, uint16_t conn_idx, DSPS_FLOW_CONTROL value)
+{
+        dsps_stats_flow(DSPS_STATS_FLOW_SPS_PEER, value == DSPS_FLOW_CONTROL_ON);
+
+        update_flow_control(conn_idx, value);
+}
+
+/*
+ * Size the TX window so that the notifications in flight fill one connection event.
+ *
+ * The number of LL packets that fit in a connection event is estimated from the negotiated
+ * LL packet air time plus the inter-frame spaces and the empty packet from the peer.
+ */
+static void update_tx_window(dsps_link_t *link)
+{
+        uint32_t ci_us, pkt_us, ll_pkts_per_event, ll_pkts_per_ntf, window;
+
+        ci_us = (uint32_t)link->conn_interval * 1250;
+        pkt_us = link->ll_tx_time + DSPS_LL_PDU_OVERHEAD_US;
+        ll_pkts_per_event = ci_us / pkt_us;
+
+        /* One notification carries the ATT and L2CAP headers on top of the payload */
+        ll_pkts_per_ntf = (link->tx_size + 3 + 4 + link->ll_tx_length - 1) / link->ll_tx_length;
+
+        window = ll_pkts_per_event / ll_pkts_per_ntf;
+        window = MIN(MAX(window, 1), DSPS_TX_WINDOW_MAX);
+
+        if (window != link->tx_window) {
+                link->tx_window = window;
+                DBG_LOG("SPS TX window of conn_idx=%04x is %u notifications.\r\n", link->conn_idx,
+                                                                                link->tx_window);
+        }
+}
+
+/* Serial port reads are sized after the largest notification payload among the links */
+static void update_rx_size(void)
+{
+        uint32_t rx_size = 0;
+
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                if (links[i].conn_idx != BLE_CONN_IDX_INVALID) {
+                        rx_size = MAX(rx_size, links[i].tx_size);
+                }
+        }
+
+        dsps_rx_size = rx_size ? rx_size : DSPS_RX_SIZE;
+
+#if defined(DSPS_UART)
+        uart_rx_timeout = uart_read_timeout(CFG_UART_SPS_BAUDRATE, dsps_rx_size);
+        coalesce_deadline = OS_MS_2_TICKS(uart_coalesce_deadline(CFG_UART_SPS_BAUDRATE, dsps_rx_size));
+#endif
+}
+
+static void tx_inflight_reset(dsps_link_t *link)
+{
+        link->tx_inflight_first = 0;
+        link->tx_inflight_cnt = 0;
+        link->tx_inflight_len = 0;
+}
+
 static void rx_data_available(void)
 {
         bool send_flow_on = false;
-        msg rx_msg;
-        bool ret;
+        const uint8_t *rx_data = NULL;
+        uint32_t rx_size;
+        dsps_link_t *link = NULL;
+        int i;
 
         /**
-         * Pop data from RX queue. Make sure msg is not 0 size or queue is not empty.
+         * Serve the links round-robin, one MTU worth of data per turn, so that a busy peer
+         * cannot hold the output serial port. Make sure there are data in a RX queue.
          */
-        ret = sps_queue_pop_items(rx_queue, &rx_msg);
-        if (rx_msg.size == 0 || ret == false) {
+        for (i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                link = &links[(serial_tx_next + i) % DSPS_MAX_CONNECTIONS];
+                rx_data = sps_queue_read_ptr(&link->rx_queue, 0, &rx_size);
+                if (rx_data) {
+                        break;
+                }
+        }
+
+        if (rx_data == NULL) {
                 return;
         }
 
+        serial_tx_next = (link - links + 1) % DSPS_MAX_CONNECTIONS;
+        rx_size = MIN(rx_size, DSPS_RX_SIZE);
+
 #if defined(DSPS_UART)
-        SERIAL_PORT_WRITE_DATA(uart_handle, (const char *)rx_msg.data, rx_msg.size, 0/*Not used*/);
+        SERIAL_PORT_WRITE_DATA(uart_handle, (const char *)rx_data, rx_size, 0/*Not used*/);
 #elif defined(DSPS_USBD)
         USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
 
@@ -301,43 +524,71 @@ static void rx_data_available(void)
                  * operation will be performed asynchronously.
                  * Otherwise, the timeout is interpreted in millisecond (blocking operation).
                  */
-                SERIAL_PORT_WRITE_DATA(usbd_handle, (const void *)rx_msg.data, (unsigned)rx_msg.size, 0);
+                SERIAL_PORT_WRITE_DATA(usbd_handle, (const void *)rx_data, (unsigned)rx_size, 0);
         }
 
 #endif
         /* Here you can add some kind of check to make sure that all bytes requested were transmitted. */
 
-        throughput_calculation(rx_msg.size, SPS_DIRECTION_OUT);
+        throughput_calculation(rx_size, SPS_DIRECTION_OUT);
+        dsps_stats_serial(SPS_DIRECTION_OUT, rx_size);
 
-        msg_release(&rx_msg);
+        sps_queue_read_release(&link->rx_queue, rx_size);
 
-        /* Check if queue is almost empty and send SPS flow on if necessary */
-        send_flow_on = sps_queue_check_almost_empty(rx_queue);
-        if (send_flow_on) {
-                set_flow_control_cb((ble_service_t *)dsps, conn_idx, DSPS_FLOW_CONTROL_ON);
-
-                DBG_LOG("SPS flow on due to LWM\r\n");
+        if (link->credit_mode) {
+                /* Let BLE task raise the credit limit of this peer */
+                OS_TASK_NOTIFY(ble_periph_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
+        } else {
+                /* Check if queue is almost empty and send SPS flow on to this peer if necessary */
+                send_flow_on = sps_queue_check_almost_empty(&link->rx_queue);
+                if (send_flow_on) {
+                        dsps_stats_flow(DSPS_STATS_FLOW_SPS_LOCAL, true);
+                        update_flow_control(link->conn_idx, DSPS_FLOW_CONTROL_ON);
+
+                        DBG_LOG("SPS flow on due to LWM\r\n");
+                }
         }
 
-        /* More data in queue -> notify TX task for write */
-        if (sps_queue_item_count(rx_queue)) {
-                OS_TASK_NOTIFY(dsps_tx_task_handle, SPS_DATA_WRITE_NOTIF, OS_NOTIFY_SET_BITS);
+        /* More data in any queue -> notify TX task for write */
+        for (i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                if (sps_queue_item_count(&links[i].rx_queue)) {
+                        OS_TASK_NOTIFY(dsps_tx_task_handle, SPS_DATA_WRITE_NOTIF, OS_NOTIFY_SET_BITS);
+                        break;
+                }
         }
 }
 
 /* This callback notifies us that length number of bytes have been received from client */
 static void rx_data_cb(ble_service_t *svc, uint16_t conn_idx, const uint8_t *value, uint16_t length)
 {
-        dsps_service_t *sps = (dsps_service_t *) svc;
+        dsps_link_t *link = link_find(conn_idx);
         bool send_flow_off = false;
+        uint32_t written;
 
-        sps_queue_write_items(rx_queue, length, value);
+        if (link == NULL) {
+                return;
+        }
+
+        dsps_stats_ble(SPS_DIRECTION_OUT, length);
+
+        written = sps_queue_write_items(&link->rx_queue, length, value);
+        if (written < length) {
+                dsps_stats_dropped(SPS_DIRECTION_OUT, length - written);
+        }
+        dsps_stats_queue_depth(SPS_DIRECTION_OUT, sps_queue_item_count(&link->rx_queue));
 
-        /* Check if queue is almost full and issue flow off, if so. */
-        send_flow_off = sps_queue_check_almost_full(rx_queue);
+        /* The peer counts every byte it sends against the credit limit */
+        link->rx_total += length;
+
+        /*
+         * Check if queue is almost full and issue flow off to this peer, if so. With credits the
+         * peer cannot send more than the RX queue can take, so there is no need to.
+         */
+        send_flow_off = !link->credit_mode && sps_queue_check_almost_full(&link->rx_queue);
         if (send_flow_off) {
                 /* Note: Certain number of on-the-fly packets might come even after SPS flow off */
-                sps->cb->set_flow_control(svc, conn_idx, DSPS_FLOW_CONTROL_OFF);
+                dsps_stats_flow(DSPS_STATS_FLOW_SPS_LOCAL, false);
+                update_flow_control(conn_idx, DSPS_FLOW_CONTROL_OFF);
 
                 DBG_LOG("SPS flow off due to HWM\r\n");
         }
@@ -346,62 +597,124 @@ static void rx_data_cb(ble_service_t *svc, uint16_t conn_idx, const uint8_t *val
         OS_TASK_NOTIFY(dsps_tx_task_handle, SPS_DATA_WRITE_NOTIF, OS_NOTIFY_SET_BITS);
 }
 
-static void tx_data_available(void)
+/* Send one notification to a link if its TX window and credits allow; returns true if sent */
+static bool link_tx_data(dsps_link_t *link)
 {
-        __UNUSED msg tx_msg;
-        bool ret;
+        const uint8_t *tx_data;
+        uint32_t tx_size;
+        int32_t credits = INT32_MAX;
 
-        /* Do not continue if TX is already in progress */
-        if (dsps_tx_in_inprogress) {
+        if (link->conn_idx == BLE_CONN_IDX_INVALID || link->tx_inflight_cnt >= link->tx_window ||
+                                                link->tx_queue_generation != link->generation) {
+                return false;
+        }
+
+        if (link->credit_mode) {
+                credits = (int32_t)(link->tx_limit - link->tx_total);
+                if (credits <= 0) {
+                        return false;
+                }
+        }
+
+        /* Get up to one notification worth of data past those already in flight */
+        tx_data = sps_queue_read_ptr(&link->tx_queue, link->tx_inflight_len, &tx_size);
+        if (tx_data == NULL) {
+                return false;
+        }
+        tx_size = MIN(tx_size, (uint32_t)credits);
+
+        /* Send data through BLE, compressed if negotiated; data are copied by the BLE stack */
+        tx_size = dsps_tx_data_compressed(dsps, link->conn_idx, tx_data, tx_size, link->tx_size);
+        if (tx_size == 0) {
+                return false;
+        }
+
+        throughput_calculation(tx_size, SPS_DIRECTION_IN);
+        dsps_stats_ble(SPS_DIRECTION_IN, tx_size);
+
+        link->tx_inflight[(link->tx_inflight_first + link->tx_inflight_cnt) % DSPS_TX_WINDOW_MAX] = tx_size;
+        link->tx_inflight_cnt++;
+        link->tx_inflight_len += tx_size;
+        link->tx_total += tx_size;
+
+        return true;
+}
+
+/*
+ * Grant the free space of the RX queue of a link to its peer. The limit is only raised once at
+ * least DSPS_CREDIT_GRANT_MIN bytes have been freed, unless a previous grant is still pending.
+ */
+static void link_tx_credit(dsps_link_t *link)
+{
+        uint32_t limit;
+
+        if (link->conn_idx == BLE_CONN_IDX_INVALID || !link->credit_mode) {
                 return;
         }
 
-        /* Read one msg from TX queue */
-        ret = sps_queue_read_items(tx_queue, &tx_msg);
-        if (tx_msg.size == 0 || ret == false) {
+        /* RX queue is only written by this task, its free space can only grow meanwhile */
+        limit = link->rx_total + sps_queue_free_space(&link->rx_queue);
+        if (!link->credit_pending && limit - link->rx_limit < DSPS_CREDIT_GRANT_MIN) {
                 return;
         }
 
-        throughput_calculation(tx_msg.size, SPS_DIRECTION_IN);
+        /* If the BLE stack is busy, retry once it has confirmed a notification */
+        link->credit_pending = !dsps_send_credit_limit(dsps, link->conn_idx, limit);
+        if (link->credit_pending) {
+                return;
+        }
 
-        /* Send data through BLE */
-        ret = dsps_tx_data(dsps, conn_idx, tx_msg.data, tx_msg.size);
+        link->rx_limit = limit;
+        dsps_stats_flow(DSPS_STATS_FLOW_SPS_LOCAL, true);
+}
 
-        if (ret) {
-                dsps_tx_in_inprogress = true;
+static void tx_data_available(void)
+{
+        bool sent;
+
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                link_tx_credit(&links[i]);
         }
+
+        /*
+         * Round-robin over the links, one notification per link and turn, until every TX window
+         * is full. A slow or flow-controlled peer is skipped instead of holding back the others.
+         */
+        do {
+                sent = false;
+
+                for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                        sent |= link_tx_data(&links[(ble_tx_next + i) % DSPS_MAX_CONNECTIONS]);
+                }
+
+                ble_tx_next = (ble_tx_next + 1) % DSPS_MAX_CONNECTIONS;
+        } while (sent);
 }
 
 /* This callback notifies us that length number of bytes have been transferred to client. */
 static void tx_done_cb(ble_service_t *svc, uint16_t conn_idx)
 {
-        dsps_tx_in_inprogress = false;
-
-        msg m;
+        dsps_link_t *link = link_find(conn_idx);
         bool send_flow_on = false;
+        uint16_t tx_size;
 
-        /* Pop and release the transmitted msg */
-        sps_queue_pop_items(tx_queue, &m);
-        msg_release(&m);
+        /* Notifications are confirmed in order, release the oldest one in flight */
+        if (link == NULL || link->tx_inflight_cnt == 0) {
+                return;
+        }
 
-        /* Check if queue is almost empty and send SPS flow off if necessary */
-        send_flow_on = sps_queue_check_almost_empty(tx_queue);
-        if(send_flow_on) {
+        tx_size = link->tx_inflight[link->tx_inflight_first];
+        link->tx_inflight_first = (link->tx_inflight_first + 1) % DSPS_TX_WINDOW_MAX;
+        link->tx_inflight_cnt--;
+        link->tx_inflight_len -= tx_size;
 
-#if defined(DSPS_UART)
-# if defined(CFG_UART_HW_FLOW_CTRL)
-                SERIAL_PORT_SET_FLOW_ON(&UART_DEVICE);
-# elif defined(CFG_UART_SW_FLOW_CTRL)
-                SERIAL_PORT_SET_FLOW_ON(uart_handle);
-# endif
-#elif defined(DSPS_USBD)
-                USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
+        sps_queue_read_release(&link->tx_queue, tx_size);
+        dsps_stats_latency_end(&link->tx_latency, link->tx_queue.tail);
 
-                /* -1 means that the USB device has yet to be initialized (i.e. the device is not attached/enumerated). */
-                if (usbd_handle >= 0) {
-                        SERIAL_PORT_SET_FLOW_ON(usbd_handle);
-                }
-#endif
+        /* Check if queue is almost empty and send serial flow on if no other link holds it off */
+        send_flow_on = sps_queue_check_almost_empty(&link->tx_queue) && serial_flow_release(link);
+        if (send_flow_on) {
+                serial_port_flow_on();
 
                 dsps_read_ready = true;
                 OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_START_READ_NOTIF, OS_NOTIFY_SET_BITS); // Kickoff input serial port read when SPS flow is on
@@ -409,16 +722,54 @@ static void tx_done_cb(ble_service_t *svc, uint16_t conn_idx)
                 DBG_LOG("SERIAL flow on due to LWM\r\n");
         }
 
-        /* More data in queue -> notify BLE task for TX */
-        if (sps_queue_item_count(tx_queue)) {
+        /* More data in queue, not yet sent, or a pending credit limit -> notify BLE task for TX */
+        if ((uint32_t)sps_queue_item_count(&link->tx_queue) > link->tx_inflight_len ||
+                                                                        link->credit_pending) {
                 OS_TASK_NOTIFY(ble_periph_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
         }
 }
 
+#if DSPS_CREDIT_FLOW_CONTROL
+/* Credit limit written by a peer; the first one is its offer to use credit-based flow control */
+static void credit_limit_cb(ble_service_t *svc, uint16_t conn_idx, uint32_t limit)
+{
+        dsps_link_t *link = link_find(conn_idx);
+
+        if (link == NULL) {
+                return;
+        }
+
+        if (!link->credit_mode) {
+                /*
+                 * Answer with our own limit. Nothing is sent to the peer until it grants credits in
+                 * turn, so the bytes sent are counted from our first limit on.
+                 */
+                link->credit_mode = true;
+                link->credit_pending = true;
+                link->rx_total = 0;
+                link->rx_limit = 0;
+                link->tx_total = 0;
+
+                /* The flow is no longer switched off, make sure it is not left off */
+                dsps_set_flow_control(dsps, conn_idx, DSPS_FLOW_CONTROL_ON);
+
+                DBG_LOG("SPS credit-based flow control for conn_idx=%04x\r\n", conn_idx);
+        } else {
+                link->tx_limit = limit;
+                dsps_stats_flow(DSPS_STATS_FLOW_SPS_PEER, true);
+        }
+
+        OS_TASK_NOTIFY(ble_periph_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
+}
+#endif /* DSPS_CREDIT_FLOW_CONTROL */
+
 static dsps_callbacks_t sps_callbacks = {
         .set_flow_control = set_flow_control_cb,
         .rx_data = rx_data_cb,
         .tx_done = tx_done_cb,
+#if DSPS_CREDIT_FLOW_CONTROL
+        .credit_limit = credit_limit_cb,
+#endif
 };
 
 /*
@@ -426,20 +777,50 @@ static dsps_callbacks_t sps_callbacks = {
  */
 static void handle_evt_gap_connected(ble_evt_gap_connected_t *evt)
 {
-        conn_idx = evt->conn_idx;
+        dsps_link_t *link = link_find(BLE_CONN_IDX_INVALID);
+
         DBG_LOG("%s: conn_idx=%04x address=%s CI max is %u. \r\n", __func__, evt->conn_idx, \
                 format_bd_address(&evt->peer_address), evt->conn_params.interval_max);
 
+        /* Advertising is only restarted while there are free links */
+        OS_ASSERT(link != NULL);
+
+        link->conn_idx = evt->conn_idx;
+        link->generation++;
+        link->conn_interval = evt->conn_params.interval_max;
+        link->ll_tx_length = DSPS_LL_TX_LENGTH_DEFAULT;
+        link->ll_tx_time = DSPS_LL_TX_TIME_DEFAULT;
+        link->tx_size = DSPS_RX_SIZE;
+        link->tx_window = 1;
+        link->tx_dropped = 0;
+        link->credit_mode = false;
+        link->credit_pending = false;
+        link->tx_limit = 0;
+        tx_inflight_reset(link);
+        update_tx_window(link);
+        update_rx_size();
+
         /* Create and start one-time timer for connection parameter update */
-        conn_param_timer = OS_TIMER_CREATE("conn_param", OS_MS_2_TICKS(500),
-                                OS_TIMER_FAIL, (uint32_t) conn_idx, conn_params_timer_cb);
-        OS_TIMER_START(conn_param_timer, OS_TIMER_FOREVER);
+        link->conn_param_pending = false;
+        link->conn_param_timer = OS_TIMER_CREATE("conn_param", OS_MS_2_TICKS(500),
+                                OS_TIMER_FAIL, (uint32_t) evt->conn_idx, conn_params_timer_cb);
+        OS_TIMER_START(link->conn_param_timer, OS_TIMER_FOREVER);
 
         /**
-         * Create TX and RX SPS queues
+         * Start with empty TX and RX SPS queues, the TX one is reset by the serial port RX task
          */
-        rx_queue = sps_queue_new(RX_SPS_QUEUE_SIZE, RX_QUEUE_LWM, RX_QUEUE_HWM);
-        tx_queue = sps_queue_new(TX_SPS_QUEUE_SIZE, TX_QUEUE_LWM, TX_QUEUE_HWM);
+        sps_queue_reset(&link->rx_queue);
+        OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_TX_RESET_NOTIF, OS_NOTIFY_SET_BITS);
+
+        /* Keep accepting centrals while there are free links */
+        if (++links_connected < DSPS_MAX_CONNECTIONS) {
+                ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
+        }
+
+        /* The serial port is shared by all links, open it for the first one */
+        if (links_connected > 1) {
+                return;
+        }
 
 #if defined(DSPS_UART)
         uart_handle = SERIAL_PORT_OPEN(&UART_DEVICE);
@@ -447,111 +828,129 @@ static void handle_evt_gap_connected(ble_evt_gap_connected_t *evt)
 #elif defined(DSPS_USBD)
 #endif
 
-#if defined(DSPS_UART)
-# if defined(CFG_UART_HW_FLOW_CTRL)
-        SERIAL_PORT_SET_FLOW_ON(&UART_DEVICE);
-# elif defined(CFG_UART_SW_FLOW_CTRL)
-        SERIAL_PORT_SET_FLOW_ON(uart_handle);
-# endif
-#elif defined(DSPS_USBD)
-        USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
-
-        /* -1 means that the USB device has yet to be initialized (i.e. the device is not attached/enumerated). */
-        if (usbd_handle >= 0) {
-                SERIAL_PORT_SET_FLOW_ON(usbd_handle);
-        }
-#endif
+        serial_flow_off_links = 0;
+        serial_port_flow_on();
 
-       dsps_read_ready = true;
+        dsps_read_ready = true;
 }
 
 static void handle_evt_gap_mtu_exchanged(ble_evt_gattc_mtu_changed_t *evt)
 {
-        /* Update the UART read size and timeout accordingly */
-        dsps_rx_size = evt->mtu - 3;
-
-#if defined(DSPS_UART)
-        uart_rx_timeout = uart_read_timeout(CFG_UART_SPS_BAUDRATE, dsps_rx_size);
-#endif
+        dsps_link_t *link = link_find(evt->conn_idx);
 
         DBG_LOG("Peripheral exchanged MTU size is %u.\r\n", evt->mtu);
+
+        if (link == NULL) {
+                return;
+        }
+
+        /* Update the notification size and the UART read size and timeout accordingly */
+        link->tx_size = evt->mtu - 3;
+        update_rx_size();
+        update_tx_window(link);
 }
 
 static void handle_evt_gap_datalength_changed(ble_evt_gap_data_length_changed_t * evt)
 {
-        (void)evt;
+        dsps_link_t *link = link_find(evt->conn_idx);
 
         DBG_LOG("Peripheral exchanged tx data length is %u, rx data length is %u.\r\n",
                                                                 evt->max_tx_length, evt->max_rx_length);
+
+        if (link == NULL) {
+                return;
+        }
+
+        link->ll_tx_length = evt->max_tx_length;
+        link->ll_tx_time = evt->max_tx_time;
+        update_tx_window(link);
 }
 
 static void handle_evt_gap_conn_param_updated(ble_evt_gap_conn_param_updated_t * evt)
 {
-        (void)evt;
+        dsps_link_t *link = link_find(evt->conn_idx);
 
         DBG_LOG("Peripheral updated CI min is %u, CI max is %u.\r\n",
                                 evt->conn_params.interval_min, evt->conn_params.interval_max);
-        ble_gattc_exchange_mtu(conn_idx); // Exchange MTU with peer
+
+        if (link) {
+                link->conn_interval = evt->conn_params.interval_max;
+                update_tx_window(link);
+        }
+        ble_gattc_exchange_mtu(evt->conn_idx); // Exchange MTU with peer
 }
 
 static void handle_evt_gap_conn_param_update_completed(ble_evt_gap_conn_param_update_completed_t * evt)
 {
         if (evt->status != BLE_STATUS_OK) {
                 DBG_LOG("Peripheral update unsuccessful, status is %u.\r\n", evt->status);
-                ble_gattc_exchange_mtu(conn_idx); // Exchange MTU with peer
+                ble_gattc_exchange_mtu(evt->conn_idx); // Exchange MTU with peer
         }
 }
 
 static void handle_disconnected(ble_evt_gap_disconnected_t *evt)
 {
-        (void)evt;
+        dsps_link_t *link = link_find(evt->conn_idx);
+        bool send_flow_on;
 
         DBG_LOG("%s: conn_idx=%04x address=%s reason=%d\r\n", __func__, evt->conn_idx, format_bd_address(&evt->address), evt->reason);
 
-        /* Reset connection index (this will also stop sending UART_START_READ_NOTIF */
-        conn_idx = BLE_CONN_IDX_INVALID;
+        if (link == NULL) {
+                return;
+        }
 
-#if defined(DSPS_UART)
-# if defined(CFG_UART_HW_FLOW_CTRL)
-        SERIAL_PORT_SET_FLOW_OFF(&UART_DEVICE);
-# elif defined(CFG_UART_SW_FLOW_CTRL)
-        SERIAL_PORT_SET_FLOW_OFF(uart_handle);
-# endif
-#elif defined(DSPS_USBD)
-        USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
+        if (link->tx_dropped) {
+                DBG_LOG("%lu serial bytes were dropped for conn_idx=%04x\r\n", link->tx_dropped, evt->conn_idx);
+        }
 
-        /* -1 means that the USB device has yet to be initialized (i.e. the device is not attached/enumerated). */
-        if (usbd_handle >= 0) {
-                SERIAL_PORT_SET_FLOW_OFF(usbd_handle);
+        /* Reset connection index (this will also stop reading for this link) */
+        link->conn_idx = BLE_CONN_IDX_INVALID;
+        link->generation++;
+        links_connected--;
+        update_rx_size();
+
+        /* The link no longer holds the serial port flow off */
+        send_flow_on = serial_flow_release(link);
+
+        if (links_connected == 0) {
+                serial_port_flow_off();
+
+                dsps_read_ready = false;
+        } else if (send_flow_on) {
+                serial_port_flow_on();
+
+                dsps_read_ready = true;
+                OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_START_READ_NOTIF, OS_NOTIFY_SET_BITS);
         }
-#endif
 
-        dsps_read_ready = false;
         /*
          * Reset variable here. It might happen that the peer device (central) is disconnected
          * while the latter receives bytes and tx_done_cb() is never called to reset it.
          */
-        dsps_tx_in_inprogress = false;
+        tx_inflight_reset(link);
 
 #if defined(DSPS_UART)
-        /* Let UART activity finish */
-        OS_DELAY_MS(uart_rx_timeout);
+        if (links_connected == 0) {
+                /* Let UART activity finish */
+                OS_DELAY_MS(uart_rx_timeout);
 
-        SERIAL_PORT_CLOSE(uart_handle);
+                SERIAL_PORT_CLOSE(uart_handle);
+        }
 #elif defined(DSPS_USBD)
 #endif
 
-        /* Delete TX and RX queue */
-        sps_queue_free(tx_queue);
-        sps_queue_free(rx_queue);
-        tx_queue = NULL;
-        rx_queue = NULL;
+        /* Drop any data left in RX queue, and in TX queue once serial port RX task is done with it */
+        sps_queue_reset(&link->rx_queue);
+        OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_TX_RESET_NOTIF, OS_NOTIFY_SET_BITS);
 
         /* Delete timer for connection parameter update */
-        OS_TIMER_DELETE(conn_param_timer, OS_TIMER_FOREVER);
+        OS_TIMER_DELETE(link->conn_param_timer, OS_TIMER_FOREVER);
+        link->conn_param_pending = false;
 
-        /* Start advertising */
-        ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
+        /* Start advertising; it is already running unless all links were in use */
+        if (links_connected == DSPS_MAX_CONNECTIONS - 1) {
+                ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
+        }
 }
 
 #if (dg_configBLE_2MBIT_PHY == 1)
@@ -623,6 +1022,29 @@ static const dis_device_info_t dis_info = {
 };
 #endif /* dg_configSUOTA_SUPPORT */
 
+#if dg_configUSE_CLI
+static void clicmd_default_handler(int argc, const char *argv[], void *user_data)
+{
+        printf("Valid commands:\r\n");
+        printf("\tstats [reset]\r\n");
+}
+
+static void clicmd_stats_handler(int argc, const char *argv[], void *user_data)
+{
+        if (argc > 1 && !strcmp(argv[1], "reset")) {
+                dsps_stats_reset();
+                return;
+        }
+
+        dsps_stats_print();
+}
+
+static const cli_command_t clicmd[] = {
+        { .name = "stats",              .handler = clicmd_stats_handler, },
+        {},
+};
+#endif /* dg_configUSE_CLI */
+
 /*
  * main task code
  */
@@ -630,6 +1052,9 @@ void dsps_BLE_task(void *params)
 {
         att_uuid_t sps_uuid;
         int8_t wdog_id;
+#if dg_configUSE_CLI
+        cli_t cli;
+#endif
 
 #if dg_configSUOTA_SUPPORT
         ble_service_t *suota;
@@ -646,6 +1071,22 @@ void dsps_BLE_task(void *params)
 
         ble_periph_task_handle = OS_GET_CURRENT_TASK();
 
+        dsps_stats_reset();
+
+#if dg_configUSE_CLI
+        /* Register CLI for dumping the statistics */
+        cli = cli_register(CLI_NOTIF, clicmd, clicmd_default_handler);
+#endif
+
+        /**
+         * Create the per connection TX and RX SPS queues. Their storage is reused across connections.
+         */
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                links[i].conn_idx = BLE_CONN_IDX_INVALID;
+                sps_queue_init(&links[i].rx_queue, rx_queue_buf[i], RX_SPS_QUEUE_SIZE, RX_QUEUE_LWM, RX_QUEUE_HWM);
+                sps_queue_init(&links[i].tx_queue, tx_queue_buf[i], TX_SPS_QUEUE_SIZE, TX_QUEUE_LWM, TX_QUEUE_HWM);
+        }
+
         ble_peripheral_start();
         ble_register_app();
         ble_gap_mtu_size_set(MTU_SIZE);
@@ -802,14 +1243,111 @@ no_event:
                 }
 
                 if (notif & UPDATE_CONN_PARAM_NOTIF) {
-                        conn_param_update(conn_idx);
+                        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                                if (links[i].conn_param_pending) {
+                                        links[i].conn_param_pending = false;
+                                        conn_param_update(links[i].conn_idx);
+                                }
+                        }
+                }
+
+#if dg_configUSE_CLI
+                if (notif & CLI_NOTIF) {
+                        cli_handle_notified(cli);
+                }
+#endif
+        }
+}
+
+/* Publish data read from the serial port to every link; returns true if serial flow must go off */
+static bool serial_data_read(dsps_link_t *read_link, const uint8_t *data, uint32_t len,
+                                                                        OS_TICK_TIME read_start)
+{
+        bool send_flow_off = false;
+
+        /* Data stay in place until BLE releases them, so they can still be copied after commit */
+        sps_queue_write_commit(&read_link->tx_queue, len);
+        dsps_stats_latency_start(&read_link->tx_latency, read_link->tx_queue.head, read_start);
+
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                dsps_link_t *link = &links[i];
+
+                /* Skip links not connected, or connected and waiting for their TX queue reset */
+                if (link->conn_idx == BLE_CONN_IDX_INVALID ||
+                                                link->tx_queue_generation != link->generation) {
+                        continue;
+                }
+
+                /* Data were read straight into the TX queue of read_link, copy them to the others */
+                if (link != read_link) {
+                        if ((uint32_t)sps_queue_free_space(&link->tx_queue) < len) {
+                                link->tx_dropped += len;
+                                dsps_stats_dropped(SPS_DIRECTION_IN, len);
+                                continue;
+                        }
+                        sps_queue_write_items(&link->tx_queue, len, data);
+                        dsps_stats_latency_start(&link->tx_latency, link->tx_queue.head, read_start);
+                }
+
+                dsps_stats_queue_depth(SPS_DIRECTION_IN, sps_queue_item_count(&link->tx_queue));
+
+                /*
+                 * Check if queue is almost full. Unless it is the only link, a peer that has stopped
+                 * the flow does not hold the serial port off; data are dropped for it once its TX
+                 * queue is full so that the other links keep going.
+                 */
+                if (sps_queue_check_almost_full(&link->tx_queue) && (links_connected == 1 ||
+                                dsps_get_flow_control(dsps, link->conn_idx) == DSPS_FLOW_CONTROL_ON)) {
+                        OS_ENTER_CRITICAL_SECTION();
+                        send_flow_off |= (serial_flow_off_links == 0);
+                        serial_flow_off_links |= link_bit(link);
+                        OS_LEAVE_CRITICAL_SECTION();
                 }
         }
+
+        return send_flow_off;
+}
+
+/* Reset the TX queues of the links connected or disconnected since last time */
+static void tx_queues_reset(void)
+{
+        bool reset = false;
+
+        for (int i = 0; i < DSPS_MAX_CONNECTIONS; i++) {
+                dsps_link_t *link = &links[i];
+
+                if (link->tx_queue_generation == link->generation) {
+                        continue;
+                }
+
+                /* BLE task does not read the queue before it is empty and marked as reset */
+                OS_ENTER_CRITICAL_SECTION();
+                sps_queue_reset(&link->tx_queue);
+                dsps_stats_latency_reset(&link->tx_latency);
+                link->tx_queue_generation = link->generation;
+                OS_LEAVE_CRITICAL_SECTION();
+
+                reset = true;
+        }
+
+        /* A link may have been connected meanwhile, let BLE task and reading go on */
+        if (reset) {
+                OS_TASK_NOTIFY(ble_periph_task_handle, SPS_BLE_TX_NOTIF, OS_NOTIFY_SET_BITS);
+                OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_START_READ_NOTIF, OS_NOTIFY_SET_BITS);
+        }
 }
 
 void dsps_rx_task(void *params)
 {
-        static uint32_t ReadSize = 0;
+        static int ReadSize = 0;
+        /* Link whose TX queue the serial port is read into, and its generation when selected */
+        static dsps_link_t *read_link;
+        static uint32_t read_generation;
+        /* Frame of the TX queue being filled and number of bytes read into it so far */
+        static uint8_t *dsps_data;
+        static uint32_t frame_len;
+        static uint32_t pending_len = 0;
+        static OS_TICK_TIME coalesce_start;
 
         dsps_rx_task_handle = OS_GET_CURRENT_TASK();
 
@@ -824,29 +1362,29 @@ void dsps_rx_task(void *params)
                 /* Guaranteed to return since we're waiting forever */
                 OS_ASSERT(ret == OS_OK);
 
-                if (notif & SPS_DATA_READ_NOTIF) {
-                        sps_queue_write_items(tx_queue, ReadSize, dsps_data);
+                /* Drop a frame being read into a queue to be reset, before it is committed */
+                if (notif & SPS_TX_RESET_NOTIF) {
+                        if (pending_len && read_link->generation != read_generation) {
+                                pending_len = 0;
+                        }
+                        tx_queues_reset();
+                }
 
+                if (notif & SPS_DATA_READ_NOTIF) {
                         bool send_flow_off = false;
-                        /* Check if queue is almost full and issue to send a SPS flow off, if so. */
-                        send_flow_off = sps_queue_check_almost_full(tx_queue);
-
-                        if (send_flow_off) {
 
-#if defined(DSPS_UART)
-# if defined(CFG_UART_HW_FLOW_CTRL)
-                                SERIAL_PORT_SET_FLOW_OFF(&UART_DEVICE);
-# elif defined(CFG_UART_SW_FLOW_CTRL)
-                                SERIAL_PORT_SET_FLOW_OFF(uart_handle);
-# endif
-#elif defined(DSPS_USBD)
-                                USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
+                        /*
+                         * Drop the data if the link was disconnected while reading, even if the
+                         * connection index has been given again to a new connection
+                         */
+                        if (read_link->generation == read_generation) {
+                                send_flow_off = serial_data_read(read_link, dsps_data, pending_len,
+                                                                                        coalesce_start);
+                        }
+                        pending_len = 0;
 
-                                /* -1 means that the USB device has yet to be initialized (i.e. the device is not attached/enumerated). */
-                                if (usbd_handle >= 0) {
-                                        SERIAL_PORT_SET_FLOW_OFF(usbd_handle);
-                                }
-#endif
+                        if (send_flow_off) {
+                                serial_port_flow_off();
 
                                 dsps_read_ready = false;
 
@@ -861,12 +1399,53 @@ void dsps_rx_task(void *params)
                 }
                 if (notif & SPS_START_READ_NOTIF) {
                         /* Must be connected with peer and the SPS flow should be ON */
-                        if ((conn_idx != BLE_CONN_IDX_INVALID) && dsps_read_ready) {
+                        if ((links_connected > 0) && dsps_read_ready) {
+                                uint32_t read_len = 0;
+                                OS_TICK_TIME timeout = OS_MS_2_TICKS(uart_rx_timeout);
+
+                                /* Drop a partial frame left over from a disconnected link */
+                                if (pending_len && read_link->generation != read_generation) {
+                                        pending_len = 0;
+                                }
+
+                                if (pending_len == 0) {
+                                        /*
+                                         * Read into the free region of the TX queue of a connected link. If
+                                         * the queues are full, reading is resumed by tx_done_cb() once the
+                                         * low watermark is reached.
+                                         */
+                                        dsps_data = NULL;
+                                        for (int i = 0; i < DSPS_MAX_CONNECTIONS && dsps_data == NULL; i++) {
+                                                read_link = &links[i];
+                                                read_generation = read_link->generation;
+                                                if (read_link->conn_idx != BLE_CONN_IDX_INVALID &&
+                                                                read_link->tx_queue_generation == read_generation) {
+                                                        dsps_data = sps_queue_write_ptr(&read_link->tx_queue, &read_len);
+                                                }
+                                        }
+                                        if (dsps_data == NULL) {
+                                                continue;
+                                        }
+                                        frame_len = MIN(read_len, dsps_rx_size);
+                                        read_len = frame_len;
+                                } else {
+                                        /*
+                                         * Coalesce short bursts: wait for the rest of the frame, but do not
+                                         * hold the bytes already read for longer than the deadline.
+                                         */
+                                        OS_TICK_TIME elapsed = OS_GET_TICK_COUNT() - coalesce_start;
+
+                                        read_len = frame_len - pending_len;
+                                        timeout = elapsed < coalesce_deadline ? coalesce_deadline - elapsed : 0;
+                                }
+                                ReadSize = 0;
 
                                 /* Read from input serial port with calculated timeout */
 #if defined(DSPS_UART)
-                                ReadSize = SERIAL_PORT_READ_DATA(uart_handle,
-                                        (char *)dsps_data, dsps_rx_size, OS_MS_2_TICKS(uart_rx_timeout));
+                                if (timeout) {
+                                        ReadSize = SERIAL_PORT_READ_DATA(uart_handle,
+                                                (char *)dsps_data + pending_len, read_len, timeout);
+                                }
 #elif defined(DSPS_USBD)
                                 USB_CDC_HANDLE usbd_handle = cdc_usbd_get_handle();
 
@@ -878,11 +1457,26 @@ void dsps_rx_task(void *params)
                                          * from the internal EndPoint buffer (if any and up to the size requested or less).
                                          * Otherwise the timeout is interpreted in millisecond.
                                          */
-                                        ReadSize = SERIAL_PORT_READ_DATA(usbd_handle, (void *)dsps_data,
-                                                                                        (unsigned)dsps_rx_size, 0);
+                                        if (pending_len == 0) {
+                                                ReadSize = SERIAL_PORT_READ_DATA(usbd_handle, (void *)dsps_data,
+                                                                                        (unsigned)read_len, 0);
+                                        } else if (timeout) {
+                                                ReadSize = SERIAL_PORT_READ_DATA(usbd_handle, (void *)(dsps_data + pending_len),
+                                                                (unsigned)read_len, MAX(OS_TICKS_2_MS(timeout), 1));
+                                        }
                                 }
 #endif
                                 if (ReadSize > 0 /* In USB device the returned value might be negative indicating some kind of error */) {
+                                        if (pending_len == 0) {
+                                                coalesce_start = OS_GET_TICK_COUNT();
+                                        }
+                                        pending_len += ReadSize;
+                                        dsps_stats_serial(SPS_DIRECTION_IN, ReadSize);
+                                }
+
+                                /* Publish full frames, or partial ones once the deadline has expired */
+                                if (pending_len && (pending_len == frame_len ||
+                                                OS_GET_TICK_COUNT() - coalesce_start >= coalesce_deadline)) {
                                         OS_TASK_NOTIFY(dsps_rx_task_handle, SPS_DATA_READ_NOTIF, OS_NOTIFY_SET_BITS);
                                 }
                                 else {
@@ -0,0 +1,55 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ad_uart.h
+ *
+ * @brief Host replacement of the UART adapter used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef AD_UART_H_
+#define AD_UART_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "osal.h"
+#include "hw_uart.h"
+
+typedef struct {
+        HW_UART_ID id;
+} ad_uart_controller_conf_t;
+
+typedef void *ad_uart_handle_t;
+
+typedef enum {
+        AD_UART_ERROR_NONE              = 0,
+        AD_UART_ERROR_CONTROLLER_BUSY   = -1,
+} AD_UART_ERROR;
+
+ad_uart_handle_t ad_uart_open(const ad_uart_controller_conf_t *ad_uart_ctrl_conf);
+int ad_uart_close(ad_uart_handle_t handle, bool force);
+int ad_uart_read(ad_uart_handle_t handle, char *rd_buf, size_t len, OS_TICK_TIME timeout);
+int ad_uart_write(ad_uart_handle_t handle, const char *wr_buf, size_t len);
+
+#endif /* AD_UART_H_ */
@@ -0,0 +1,68 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_att.h
+ *
+ * @brief Host replacement of the ATT definitions used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_ATT_H_
+#define BLE_ATT_H_
+
+#include <stdint.h>
+
+#define ATT_UUID_LENGTH                 (16)
+
+typedef enum {
+        ATT_UUID_16,
+        ATT_UUID_128,
+} att_uuid_type_t;
+
+typedef struct {
+        att_uuid_type_t type;
+        union {
+                uint16_t uuid16;
+                uint8_t uuid128[ATT_UUID_LENGTH];
+        };
+} att_uuid_t;
+
+typedef enum {
+        ATT_PERM_NONE   = 0x00,
+        ATT_PERM_READ   = 0x01,
+        ATT_PERM_WRITE  = 0x02,
+        ATT_PERM_RW     = ATT_PERM_READ | ATT_PERM_WRITE,
+} att_perm_t;
+
+typedef enum {
+        ATT_ERROR_OK                    = 0x00,
+        ATT_ERROR_READ_NOT_PERMITTED    = 0x02,
+        ATT_ERROR_INVALID_OFFSET        = 0x07,
+        ATT_ERROR_ATTRIBUTE_NOT_FOUND   = 0x0A,
+        ATT_ERROR_ATTRIBUTE_NOT_LONG    = 0x0B,
+        ATT_ERROR_INVALID_VALUE_LENGTH  = 0x0D,
+        ATT_ERROR_APPLICATION_ERROR     = 0x80,
+} att_error_t;
+
+#endif /* BLE_ATT_H_ */
@@ -0,0 +1,67 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_bufops.h
+ *
+ * @brief Host replacement of the BLE buffer helpers used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_BUFOPS_H_
+#define BLE_BUFOPS_H_
+
+#include <stdint.h>
+
+static inline uint16_t get_u16(const uint8_t *buf)
+{
+        return buf[0] | (buf[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t *buf)
+{
+        return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static inline void put_u32(uint8_t *buf, uint32_t val)
+{
+        buf[0] = val;
+        buf[1] = val >> 8;
+        buf[2] = val >> 16;
+        buf[3] = val >> 24;
+}
+
+static inline void put_u8_inc(uint8_t **buf, uint8_t val)
+{
+        *(*buf)++ = val;
+}
+
+static inline void put_u32_inc(uint8_t **buf, uint32_t val)
+{
+        put_u8_inc(buf, val);
+        put_u8_inc(buf, val >> 8);
+        put_u8_inc(buf, val >> 16);
+        put_u8_inc(buf, val >> 24);
+}
+
+#endif /* BLE_BUFOPS_H_ */
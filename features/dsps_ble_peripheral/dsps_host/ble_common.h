@@ -0,0 +1,121 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_common.h
+ *
+ * @brief Host replacement of the common BLE API used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_COMMON_H_
+#define BLE_COMMON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_config.h"
+
+#define BLE_CONN_IDX_INVALID            (0xFFFF)
+
+/* Task notification bit of the BLE event queue, as set by ble_register_app() */
+#define BLE_APP_NOTIFY_MASK             (1 << 0)
+
+#define BD_ADDR_LEN                     (6)
+
+typedef enum {
+        BLE_STATUS_OK,
+        BLE_ERROR_FAILED,
+        BLE_ERROR_BUSY,
+        BLE_ERROR_CANCELED,
+        BLE_ERROR_NOT_FOUND,
+        BLE_ERROR_NOT_ACCEPTED,
+        BLE_ERROR_INVALID_PARAM,
+        BLE_ERROR_INS_RESOURCES,
+} ble_error_t;
+
+typedef enum {
+        PUBLIC_ADDRESS,
+        PRIVATE_ADDRESS,
+} addr_type_t;
+
+typedef enum {
+        PUBLIC_STATIC_ADDRESS,
+        PRIVATE_STATIC_ADDRESS,
+        PRIVATE_RANDOM_RESOLVABLE_ADDRESS,
+        PRIVATE_RANDOM_NONRESOLVABLE_ADDRESS,
+} own_addr_type_t;
+
+typedef struct {
+        addr_type_t addr_type;
+        uint8_t addr[BD_ADDR_LEN];
+} bd_address_t;
+
+typedef struct {
+        own_addr_type_t addr_type;
+        uint8_t addr[BD_ADDR_LEN];
+} own_address_t;
+
+/* Event codes the DSPS applications handle */
+enum ble_evt_code {
+        BLE_EVT_GAP_CONNECTED,
+        BLE_EVT_GAP_CONNECTION_COMPLETED,
+        BLE_EVT_GAP_DISCONNECTED,
+        BLE_EVT_GAP_ADV_REPORT,
+        BLE_EVT_GAP_SCAN_COMPLETED,
+        BLE_EVT_GAP_CONN_PARAM_UPDATE_REQ,
+        BLE_EVT_GAP_CONN_PARAM_UPDATED,
+        BLE_EVT_GAP_CONN_PARAM_UPDATE_COMPLETED,
+        BLE_EVT_GAP_DATA_LENGTH_CHANGED,
+        BLE_EVT_GAP_PAIR_REQ,
+        BLE_EVT_GAP_PAIR_COMPLETED,
+        BLE_EVT_GAP_SECURITY_REQUEST,
+        BLE_EVT_GAP_PHY_SET_COMPLETED,
+        BLE_EVT_GAP_PHY_CHANGED,
+        BLE_EVT_L2CAP_CONNECTED,
+        BLE_EVT_L2CAP_DISCONNECTED,
+        BLE_EVT_L2CAP_DATA_IND,
+        BLE_EVT_GATTS_READ_REQ,
+        BLE_EVT_GATTS_WRITE_REQ,
+        BLE_EVT_GATTS_EVENT_SENT,
+        BLE_EVT_GATTC_BROWSE_SVC,
+        BLE_EVT_GATTC_BROWSE_COMPLETED,
+        BLE_EVT_GATTC_READ_COMPLETED,
+        BLE_EVT_GATTC_WRITE_COMPLETED,
+        BLE_EVT_GATTC_NOTIFICATION,
+        BLE_EVT_GATTC_MTU_CHANGED,
+};
+
+typedef struct {
+        uint16_t evt_code;
+        uint16_t length;
+} ble_evt_hdr_t;
+
+ble_error_t ble_peripheral_start(void);
+ble_error_t ble_central_start(void);
+ble_error_t ble_register_app(void);
+ble_evt_hdr_t *ble_get_event(bool wait);
+bool ble_has_event(void);
+void ble_handle_event_default(ble_evt_hdr_t *hdr);
+const char *ble_address_to_string(const bd_address_t *address);
+
+#endif /* BLE_COMMON_H_ */
@@ -0,0 +1,196 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_gap.h
+ *
+ * @brief Host replacement of the GAP API used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_GAP_H_
+#define BLE_GAP_H_
+
+#include "ble_att.h"
+#include "ble_common.h"
+
+#define BLE_CONN_INTERVAL_FROM_MS(ms)           ((uint16_t)((ms) * 100 / 125))
+#define BLE_CONN_INTERVAL_TO_MS(val)            ((uint16_t)((val) * 125 / 100))
+#define BLE_SUPERVISION_TMO_FROM_MS(ms)         ((uint16_t)((ms) / 10))
+#define BLE_CONN_EVENT_LENGTH_FROM_MS(ms)       ((uint16_t)((ms) * 1000 / 625))
+#define BLE_SCAN_INTERVAL_FROM_MS(ms)           ((uint16_t)((ms) * 1000 / 625))
+#define BLE_SCAN_WINDOW_FROM_MS(ms)             ((uint16_t)((ms) * 1000 / 625))
+
+#define BLE_ADV_DATA_LEN_MAX            (31)
+
+#define GAP_DATA_TYPE_UUID16_LIST       (0x03)
+#define GAP_DATA_TYPE_UUID128_LIST      (0x07)
+#define GAP_DATA_TYPE_LOCAL_NAME        (0x09)
+
+#define BLE_GAP_PHY_PREF_2M             (1 << 1)
+
+typedef enum {
+        GAP_CONN_MODE_NON_CONN,
+        GAP_CONN_MODE_UNDIRECTED,
+} gap_conn_mode_t;
+
+typedef enum {
+        GAP_SCAN_ACTIVE,
+        GAP_SCAN_PASSIVE,
+} gap_scan_type_t;
+
+typedef enum {
+        GAP_SCAN_GEN_DISC_MODE,
+        GAP_SCAN_LIM_DISC_MODE,
+        GAP_SCAN_OBSERVER_MODE,
+} gap_scan_mode_t;
+
+typedef struct {
+        uint16_t interval_min;
+        uint16_t interval_max;
+        uint16_t slave_latency;
+        uint16_t sup_timeout;
+} gap_conn_params_t;
+
+typedef struct {
+        bd_address_t address;
+        uint16_t conn_idx;
+        bool connected;
+} gap_device_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        bd_address_t own_addr;
+        bd_address_t peer_address;
+        gap_conn_params_t conn_params;
+} ble_evt_gap_connected_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint8_t status;
+} ble_evt_gap_connection_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        bd_address_t address;
+        uint8_t reason;
+} ble_evt_gap_disconnected_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint8_t type;
+        bd_address_t address;
+        int8_t rssi;
+        uint8_t length;
+        uint8_t data[BLE_ADV_DATA_LEN_MAX];
+} ble_evt_gap_adv_report_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint8_t status;
+} ble_evt_gap_scan_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        gap_conn_params_t conn_params;
+} ble_evt_gap_conn_param_update_req_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        gap_conn_params_t conn_params;
+} ble_evt_gap_conn_param_updated_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint8_t status;
+} ble_evt_gap_conn_param_update_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t max_tx_length;
+        uint16_t max_tx_time;
+        uint16_t max_rx_length;
+        uint16_t max_rx_time;
+} ble_evt_gap_data_length_changed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        bool bond;
+} ble_evt_gap_pair_req_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint8_t status;
+        bool bond;
+        bool mitm;
+} ble_evt_gap_pair_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        bool bond;
+        bool mitm;
+} ble_evt_gap_security_request_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint8_t status;
+} ble_evt_gap_phy_set_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint8_t tx_phy;
+        uint8_t rx_phy;
+} ble_evt_gap_phy_changed_t;
+
+ble_error_t ble_gap_address_get(own_address_t *address);
+ble_error_t ble_gap_address_set(const own_address_t *address, uint16_t renew_dur);
+ble_error_t ble_gap_device_name_set(const char *name, att_perm_t perm);
+ble_error_t ble_gap_mtu_size_set(uint16_t mtu_size);
+ble_error_t ble_gap_adv_data_set(uint8_t adv_data_len, const uint8_t *adv_data,
+                                 uint8_t scan_rsp_data_len, const uint8_t *scan_rsp_data);
+ble_error_t ble_gap_adv_start(gap_conn_mode_t adv_type);
+ble_error_t ble_gap_scan_start(gap_scan_type_t type, gap_scan_mode_t mode, uint16_t interval,
+                               uint16_t window, bool filt_wlist, bool filt_dupl);
+ble_error_t ble_gap_scan_stop(void);
+ble_error_t ble_gap_connect_ce(const bd_address_t *peer_addr, const gap_conn_params_t *conn_params,
+                               uint16_t ce_len_min, uint16_t ce_len_max);
+ble_error_t ble_gap_connect_cancel(void);
+ble_error_t ble_gap_get_device_by_addr(const bd_address_t *addr, gap_device_t *gap_device);
+ble_error_t ble_gap_conn_param_update(uint16_t conn_idx, const gap_conn_params_t *conn_params);
+ble_error_t ble_gap_conn_param_update_reply(uint16_t conn_idx, bool accept);
+ble_error_t ble_gap_pair(uint16_t conn_idx, bool bond);
+ble_error_t ble_gap_pair_reply(uint16_t conn_idx, bool accept, bool bond);
+ble_error_t ble_gap_phy_set(uint16_t conn_idx, uint8_t tx_phy_pref, uint8_t rx_phy_pref);
+
+#endif /* BLE_GAP_H_ */
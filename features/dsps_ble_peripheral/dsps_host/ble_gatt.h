@@ -0,0 +1,58 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_gatt.h
+ *
+ * @brief Host replacement of the GATT definitions used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_GATT_H_
+#define BLE_GATT_H_
+
+typedef enum {
+        GATT_SERVICE_PRIMARY,
+        GATT_SERVICE_SECONDARY,
+} gatt_service_t;
+
+typedef enum {
+        GATT_PROP_NONE                  = 0x00,
+        GATT_PROP_BROADCAST             = 0x01,
+        GATT_PROP_READ                  = 0x02,
+        GATT_PROP_WRITE_NO_RESP         = 0x04,
+        GATT_PROP_WRITE                 = 0x08,
+        GATT_PROP_NOTIFY                = 0x10,
+        GATT_PROP_INDICATE              = 0x20,
+} gatt_prop_t;
+
+typedef enum {
+        GATT_EVENT_NOTIFICATION,
+        GATT_EVENT_INDICATION,
+} gatt_event_t;
+
+#define GATT_CCC_NONE                   (0x0000)
+#define GATT_CCC_NOTIFICATIONS          (0x0001)
+#define GATT_CCC_INDICATIONS            (0x0002)
+
+#endif /* BLE_GATT_H_ */
@@ -0,0 +1,116 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_gattc.h
+ *
+ * @brief Host replacement of the GATT client API used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_GATTC_H_
+#define BLE_GATTC_H_
+
+#include "ble_att.h"
+#include "ble_common.h"
+#include "ble_gatt.h"
+
+typedef enum {
+        GATTC_ITEM_TYPE_NONE,
+        GATTC_ITEM_TYPE_INCLUDE,
+        GATTC_ITEM_TYPE_CHARACTERISTIC,
+        GATTC_ITEM_TYPE_DESCRIPTOR,
+} gattc_item_type_t;
+
+typedef struct {
+        gattc_item_type_t type;
+        uint16_t handle;
+        att_uuid_t uuid;
+        union {
+                struct {
+                        uint16_t start_h;
+                        uint16_t end_h;
+                } i;
+                struct {
+                        uint16_t value_handle;
+                        uint8_t properties;
+                } c;
+        };
+} gattc_item_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        att_uuid_t uuid;
+        uint16_t start_h;
+        uint16_t end_h;
+        uint16_t num_items;
+        gattc_item_t items[];
+} ble_evt_gattc_browse_svc_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint8_t status;
+} ble_evt_gattc_browse_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t handle;
+        uint8_t status;
+        uint16_t offset;
+        uint16_t length;
+        uint8_t value[];
+} ble_evt_gattc_read_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t handle;
+        uint8_t status;
+        uint16_t operation;
+} ble_evt_gattc_write_completed_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t handle;
+        uint16_t length;
+        uint8_t value[];
+} ble_evt_gattc_notification_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t mtu;
+} ble_evt_gattc_mtu_changed_t;
+
+ble_error_t ble_gattc_browse(uint16_t conn_idx, const att_uuid_t *uuid);
+ble_error_t ble_gattc_write(uint16_t conn_idx, uint16_t handle, uint16_t offset, uint16_t length,
+                            const uint8_t *value);
+ble_error_t ble_gattc_write_no_resp(uint16_t conn_idx, uint16_t handle, bool signed_write,
+                                    uint16_t length, const uint8_t *value);
+ble_error_t ble_gattc_exchange_mtu(uint16_t conn_idx);
+
+#endif /* BLE_GATTC_H_ */
@@ -0,0 +1,81 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_gatts.h
+ *
+ * @brief Host replacement of the GATT server API used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_GATTS_H_
+#define BLE_GATTS_H_
+
+#include "ble_att.h"
+#include "ble_common.h"
+#include "ble_gatt.h"
+
+typedef enum {
+        GATTS_FLAG_CHAR_READ_REQ        = 0x01,
+} gatts_flag_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t handle;
+        uint16_t offset;
+} ble_evt_gatts_read_req_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t handle;
+        uint16_t offset;
+        uint16_t length;
+        uint8_t value[];
+} ble_evt_gatts_write_req_t;
+
+typedef struct {
+        ble_evt_hdr_t hdr;
+        uint16_t conn_idx;
+        uint16_t handle;
+        gatt_event_t type;
+        bool status;
+} ble_evt_gatts_event_sent_t;
+
+ble_error_t ble_gatts_add_service(const att_uuid_t *uuid, const gatt_service_t type, uint16_t num_attrs);
+ble_error_t ble_gatts_add_characteristic(const att_uuid_t *uuid, gatt_prop_t prop, att_perm_t perm,
+                                         uint16_t max_len, gatts_flag_t flags, uint16_t *h_offset,
+                                         uint16_t *h_val_offset);
+ble_error_t ble_gatts_add_descriptor(const att_uuid_t *uuid, att_perm_t perm, uint16_t max_len,
+                                     gatts_flag_t flags, uint16_t *h_offset);
+ble_error_t ble_gatts_register_service(uint16_t *handle, ...);
+uint16_t ble_gatts_get_num_attr(uint16_t include, uint16_t characteristics, uint16_t descriptors);
+ble_error_t ble_gatts_set_value(uint16_t handle, uint16_t length, const void *value);
+ble_error_t ble_gatts_read_cfm(uint16_t conn_idx, uint16_t handle, att_error_t status, uint16_t length,
+                               const void *value);
+ble_error_t ble_gatts_write_cfm(uint16_t conn_idx, uint16_t handle, att_error_t status);
+ble_error_t ble_gatts_send_event(uint16_t conn_idx, uint16_t handle, gatt_event_t type, uint16_t length,
+                                 const void *value);
+
+#endif /* BLE_GATTS_H_ */
@@ -0,0 +1,61 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_service.h
+ *
+ * @brief Host replacement of the BLE service framework used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_SERVICE_H_
+#define BLE_SERVICE_H_
+
+#include "ble_common.h"
+#include "ble_gap.h"
+#include "ble_gatts.h"
+
+typedef struct ble_service ble_service_t;
+
+typedef void (* connected_evt_t) (ble_service_t *svc, const ble_evt_gap_connected_t *evt);
+typedef void (* disconnected_evt_t) (ble_service_t *svc, const ble_evt_gap_disconnected_t *evt);
+typedef void (* read_req_t) (ble_service_t *svc, const ble_evt_gatts_read_req_t *evt);
+typedef void (* write_req_t) (ble_service_t *svc, const ble_evt_gatts_write_req_t *evt);
+typedef void (* event_sent_t) (ble_service_t *svc, const ble_evt_gatts_event_sent_t *evt);
+typedef void (* cleanup_t) (ble_service_t *svc);
+
+struct ble_service {
+        uint16_t start_h;
+        uint16_t end_h;
+        connected_evt_t connected_evt;
+        disconnected_evt_t disconnected_evt;
+        read_req_t read_req;
+        write_req_t write_req;
+        event_sent_t event_sent;
+        cleanup_t cleanup;
+};
+
+void ble_service_add(ble_service_t *svc);
+bool ble_service_handle_event(const ble_evt_hdr_t *evt);
+
+#endif /* BLE_SERVICE_H_ */
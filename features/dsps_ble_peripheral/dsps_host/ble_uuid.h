@@ -0,0 +1,44 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ble_uuid.h
+ *
+ * @brief Host replacement of the UUID API used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef BLE_UUID_H_
+#define BLE_UUID_H_
+
+#include <stdbool.h>
+#include "ble_att.h"
+
+#define UUID_GATT_CHAR_USER_DESCRIPTION         (0x2901)
+#define UUID_GATT_CLIENT_CHAR_CONFIGURATION     (0x2902)
+
+void ble_uuid_create16(uint16_t uuid16, att_uuid_t *uuid);
+bool ble_uuid_from_string(const char *str, att_uuid_t *uuid);
+bool ble_uuid_equal(const att_uuid_t *uuid1, const att_uuid_t *uuid2);
+
+#endif /* BLE_UUID_H_ */
@@ -0,0 +1,1850 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_sim.c
+ *
+ * @brief Host simulator of the DSPS serial port to BLE data path
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Models a DSPS bridge between two DA1469x devices: the serial port of the peripheral is read into
+ * its TX queue, sent over a simulated BLE link as notifications and written out of the RX queue of
+ * the central to its serial port. Both devices run the unchanged task sources of the projects,
+ * dsps_ble_peripheral_task.c and dsps_ble_central_task.c, with the DSPS service (dsps.c), the serial
+ * port glue (dsps_uart.c), the SPS queues (dsps_queue.c), the statistics (dsps_stats.c) and the
+ * codec (dsps_lz.c) of the target. dsps_sim_peripheral.c and dsps_sim_central.c build one device
+ * each, and the headers of this folder stand in for the OS, the UART adapter and the BLE stack.
+ *
+ * The six tasks run as coroutines on simulated time. A task runs until it waits for a notification,
+ * a delay or the serial port, so the tasks never preempt each other and their CPU time is not
+ * modelled. The BLE stack advertises, scans, connects and browses the DSPS service registered by
+ * the peripheral. The central rejects the connection parameter update of the peripheral, which then
+ * exchanges the MTU, as on the target. The connection interval, PHY, data length and MTU of the
+ * link are those of the command line. At each connection event, the link first delivers the
+ * writes of the central and then the notifications of the peripheral, at most the LL packets
+ * fitting in a connection interval.
+ *
+ * The serial port of the peripheral receives into the circular DMA buffer of the projects, and the
+ * sender stops as soon as RTS is deasserted or the buffer is full. The serial port of the central
+ * takes the transfer time of the data it writes out.
+ *
+ * The input starts once both devices have handled the MTU exchange. It is a repeating sequence (a
+ * byte pattern, ASCII telemetry lines or random data) that is checked at the output, so the tool
+ * exits with an error if data are lost, duplicated or reordered. With compression, the compression
+ * ratio and the host CPU time spent per KB of data are reported as well.
+ *
+ * Build with:
+ *      gcc -O2 -fshort-enums -I. -I../dsps -I../dsps/include -I../dsps/portable -I../dsps/portable/uart \
+ *              -o dsps_sim dsps_sim.c dsps_sim_peripheral.c dsps_sim_central.c ../dsps/dsps_queue.c \
+ *              ../dsps/dsps_lz.c
+ *
+ * -fshort-enums gives enums their size on the target, where the central writes a DSPS_FLOW_CONTROL
+ * value as a single byte. Build with -DDSPS_CREDIT_FLOW_CONTROL=0 to simulate ON/OFF flow control
+ * and with -DDSPS_COMPRESSION=1 to simulate compression, as the projects select both at build time.
+ *
+ * Run examples:
+ *      ./dsps_sim                              (default configuration of the projects)
+ *      ./dsps_sim -ci 24 -phy 1 -mtu 23        (30 ms connection interval, LE 1M, no DLE/MTU)
+ *      ./dsps_sim -sweep                       (connection interval sweep)
+ *      ./dsps_sim -data text -ci 36            (ASCII telemetry at 45 ms interval)
+ *      ./dsps_sim -time 2000 -log -verbose     (debug output and statistics of both devices)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/wait.h>
+
+#include "dsps_sim.h"
+#include "osal.h"
+#include "ble_common.h"
+#include "ble_gap.h"
+#include "ble_gatts.h"
+#include "ble_gattc.h"
+#include "ble_service.h"
+#include "ble_storage.h"
+#include "ble_uuid.h"
+#include "ad_uart.h"
+#include "dsps.h"
+#include "dsps_lz.h"
+
+/* Serial port glue of the projects, on top of the UART adapter of the simulator */
+#include "dsps_uart.c"
+
+/* Simulation time step (us), a divisor of the 1.25 ms connection interval unit */
+#define SIM_STEP_US             (10)
+
+/* Max time for the devices to connect and set up the link */
+#define SIM_SETUP_MS            (5000)
+
+/* Task switches within a time step after which the tasks are considered to spin */
+#define SIM_SWITCHES_MAX        (100000)
+
+#define SIM_TASKS               (SIM_DEVICE_MAX * 3)
+#define SIM_STACK_SIZE          (256 * 1024)
+#define SIM_TIMERS              (8)
+
+/* BLE stack: events per device, PDUs buffered per device, attributes and storage entries */
+#define SIM_BLE_EVENTS          (256)
+#define SIM_BLE_PDUS            (DSPS_TX_WINDOW_MAX + 4)
+#define SIM_GATT_ATTRS          (32)
+#define SIM_GATT_MTU_MAX        (512)
+#define SIM_STORAGE             (16)
+#define SIM_SERVICES            (4)
+
+/* Circular DMA buffer of the serial port (dg_configUART2_RX_CIRCULAR_DMA_BUF_SIZE) */
+#define SIM_UART_RX_BUF_SIZE    (1024)
+
+/* Max number of serial port chunks tracked for the end to end latency */
+#define SIM_CHUNKS              (65536)
+
+/* Size of the input sequence, repeated as long as the simulation runs */
+#define SIM_DATA_SIZE           (65536)
+
+typedef enum {
+        SIM_DATA_PATTERN,
+        SIM_DATA_TEXT,
+        SIM_DATA_RANDOM,
+} SIM_DATA;
+
+typedef struct {
+        uint32_t        baud_in;                /* Serial port baud rate of the peripheral */
+        uint32_t        baud_out;               /* Serial port baud rate of the central */
+        uint16_t        conn_interval;          /* Connection interval (1.25 ms units) */
+        uint16_t        mtu;                    /* Max MTU of the link */
+        uint16_t        ll_tx_length;           /* Negotiated LL data length */
+        uint8_t         phy;                    /* LE 1M or LE 2M */
+        SIM_DATA        data;
+        uint32_t        burst_len;              /* Bytes per burst, 0 for a continuous stream */
+        uint32_t        burst_gap_ms;           /* Idle time between bursts */
+        uint32_t        duration_ms;
+        bool            verbose;
+        bool            log;
+} sim_config_t;
+
+typedef struct {
+        uint32_t        bytes;                  /* Bytes written to the output serial port */
+        uint32_t        notifications;          /* Data notifications */
+        uint32_t        events;
+        uint32_t        tx_window;              /* Max data notifications queued in the stack */
+        uint32_t        latency_sum_ms;
+        uint32_t        latency_cnt;
+        uint32_t        latency_max_ms;
+        uint32_t        sps_flow_off;
+        uint32_t        serial_flow_off;
+        uint32_t        rx_overflow;            /* Bytes not fitting in the RX queue of the central */
+        uint32_t        errors;                 /* Bytes lost, duplicated or out of order */
+        uint32_t        payload_bytes;          /* Notification payload, compressed or not */
+        uint64_t        encode_ns;
+        uint64_t        decode_ns;
+        bool            setup_failed;
+} sim_result_t;
+
+typedef enum {
+        SIM_WAIT_NONE,                          /* Ready to run */
+        SIM_WAIT_NOTIFY,
+        SIM_WAIT_TIME,
+        SIM_WAIT_UART_READ,
+} SIM_WAIT;
+
+typedef struct sim_uart sim_uart_t;
+
+struct sim_task {
+        ucontext_t      ctx;
+        uint8_t         dev;
+        uint32_t        notif;
+        SIM_WAIT        wait;
+        uint64_t        wake_us;                /* End of a delay or of a read timeout */
+        sim_uart_t      *uart;                  /* Serial port being read */
+        uint32_t        read_len;
+        void            (*func)(void *params);
+        uint8_t         *stack;
+};
+
+struct sim_timer {
+        bool            used;
+        bool            active;
+        bool            reload;
+        OS_TICK_TIME    period;
+        uint64_t        expiry_us;
+        void            *id;
+        void            (*callback)(OS_TIMER timer);
+};
+
+struct sim_uart {
+        uint8_t         dev;
+        bool            open;
+        bool            rts;
+        uint32_t        baud;
+        uint8_t         rx_buf[SIM_UART_RX_BUF_SIZE];
+        uint32_t        rx_head;
+        uint32_t        rx_cnt;
+};
+
+/* PDU buffered in the BLE stack until a connection event delivers it */
+typedef struct {
+        uint16_t        handle;
+        uint16_t        len;
+        uint16_t        ll_left;                /* LL packets still to be sent */
+        uint8_t         value[SIM_GATT_MTU_MAX];
+} sim_pdu_t;
+
+typedef struct {
+        uint16_t        handle;
+        gattc_item_type_t type;
+        att_uuid_t      uuid;
+        uint8_t         prop;
+} sim_attr_t;
+
+typedef struct {
+        bool            used;
+        ble_storage_key_t key;
+        uint32_t        value;
+} sim_storage_t;
+
+typedef struct {
+        OS_TASK         app_task;
+        ble_evt_hdr_t   *evt[SIM_BLE_EVENTS];
+        uint32_t        evt_first;
+        uint32_t        evt_cnt;
+        uint16_t        mtu_size;
+        bool            advertising;
+        bool            scanning;
+        uint8_t         adv_data[BLE_ADV_DATA_LEN_MAX];
+        uint8_t         adv_len;
+        sim_pdu_t       pdu[SIM_BLE_PDUS];
+        uint32_t        pdu_first;
+        uint32_t        pdu_cnt;
+        sim_storage_t   storage[SIM_STORAGE];
+        ble_service_t   *services[SIM_SERVICES];
+        uint32_t        service_cnt;
+} sim_ble_t;
+
+/* GATT database of the peripheral, the only GATT server */
+typedef struct {
+        att_uuid_t      svc_uuid;
+        uint16_t        start_h;
+        uint16_t        end_h;
+        uint16_t        next_h;                 /* First free handle */
+        uint16_t        offset;                 /* Next offset in the service being added */
+        sim_attr_t      attr[SIM_GATT_ATTRS];
+        uint32_t        attr_cnt;
+        uint32_t        svc_attr_first;         /* First attribute of the service being added */
+        uint16_t        tx_val_h;               /* Data notifications */
+        uint16_t        flow_ctrl_val_h;        /* Flow control writes */
+} sim_gatt_t;
+
+typedef struct {
+        bool            connecting;
+        bool            connected;
+        bool            adv_reported;
+        bool            mtu_exchanged;
+        gap_conn_params_t conn_params;
+        uint64_t        anchor_us;              /* Time of the next connection event */
+        uint16_t        mtu;
+        uint32_t        pkts_per_event;
+} sim_link_t;
+
+/* Serial port chunk still on its way, for the end to end latency */
+typedef struct {
+        uint32_t        end;                    /* Sequence number past the last byte */
+        uint64_t        time_us;
+} sim_chunk_t;
+
+uint32_t sim_tick_count;
+int sim_baudrate[SIM_DEVICE_MAX];
+
+const ad_uart_controller_conf_t sim_uart_conf[SIM_DEVICE_MAX] = {
+        { .id = SIM_DEVICE_PERIPHERAL },
+        { .id = SIM_DEVICE_CENTRAL },
+};
+
+static const sim_device_t *const devices[SIM_DEVICE_MAX] = { &sim_peripheral, &sim_central };
+
+static sim_config_t cfg;
+static sim_result_t res;
+static uint64_t now_us;
+static bool measuring;
+
+static struct sim_task tasks[SIM_TASKS];
+static struct sim_task *current;
+static ucontext_t sched_ctx;
+static struct sim_timer timers[SIM_TIMERS];
+
+static sim_ble_t ble[SIM_DEVICE_MAX];
+static sim_gatt_t gatt;
+static sim_link_t conn;
+static sim_uart_t uarts[SIM_DEVICE_MAX];
+
+static uint8_t sim_data[SIM_DATA_SIZE];
+static sim_chunk_t chunks[SIM_CHUNKS];
+static uint32_t chunk_first, chunk_cnt;
+static uint32_t in_seq, out_seq;
+static uint64_t in_bits_us;             /* Bit times of the input not sent yet, in us units */
+static uint32_t burst_left, burst_idle_us;
+static bool log_line_start[SIM_DEVICE_MAX] = { true, true };
+
+static void sim_data_init(SIM_DATA data)
+{
+        uint32_t seed = 1, i = 0;
+
+        while (i < SIM_DATA_SIZE) {
+                seed = seed * 1103515245 + 12345;
+
+                switch (data) {
+                case SIM_DATA_TEXT:
+                {
+                        /* Slowly changing sensor readings, one line per sample */
+                        char line[64];
+                        int len = snprintf(line, sizeof(line), "$TLM,%06lu,T=%d.%d,H=%d,AX=%d,AY=%d*\r\n",
+                                                (unsigned long)(i / 40), 21 + (seed >> 30),
+                                                (seed >> 16) % 10, 45 + (seed >> 28) % 3,
+                                                (int)((seed >> 8) % 200) - 100, (int)(seed % 50) - 25);
+
+                        len = MIN(len, (int)(SIM_DATA_SIZE - i));
+                        memcpy(&sim_data[i], line, len);
+                        i += len;
+                        break;
+                }
+                case SIM_DATA_RANDOM:
+                        sim_data[i++] = seed >> 24;
+                        break;
+                default:
+                        sim_data[i] = (uint8_t)(i * 7 + (i >> 8));
+                        i++;
+                        break;
+                }
+        }
+}
+
+/* Same sequence as generated at the input, so the output can be checked */
+static uint8_t sim_pattern(uint32_t seq)
+{
+        return sim_data[seq % SIM_DATA_SIZE];
+}
+
+static uint64_t sim_cpu_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* LL packet air time (us), as reported by the data length changed event */
+static uint32_t ll_tx_time(uint16_t ll_tx_length, uint8_t phy)
+{
+        /* Preamble, access address, header and MIC-less CRC on top of the payload */
+        return (ll_tx_length + 14) * 8 / phy;
+}
+
+/* Same estimate as update_tx_window() of the peripheral */
+static uint32_t ll_pkts_per_event(void)
+{
+        uint32_t ci_us = (uint32_t)cfg.conn_interval * 1250;
+
+        return ci_us / (ll_tx_time(cfg.ll_tx_length, cfg.phy) + DSPS_LL_PDU_OVERHEAD_US);
+}
+
+static uint32_t ll_pkts_per_pdu(uint32_t len)
+{
+        /* An ATT PDU carries the ATT and L2CAP headers on top of the value */
+        return (len + 3 + 4 + cfg.ll_tx_length - 1) / cfg.ll_tx_length;
+}
+
+void sim_log(const char *fmt, ...)
+{
+        char buf[256];
+        va_list ap;
+        uint8_t dev = current ? current->dev : SIM_DEVICE_PERIPHERAL;
+
+        if (!cfg.log) {
+                return;
+        }
+
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+
+        /* Lines are prefixed with the simulated time (ms) and the device */
+        for (const char *c = buf; *c; c++) {
+                if (*c == '\r') {
+                        continue;
+                }
+                if (log_line_start[dev]) {
+                        printf("%10.3f %-10s ", now_us / 1000.0, devices[dev]->name);
+                }
+                putchar(*c);
+                log_line_start[dev] = *c == '\n';
+        }
+}
+
+/*
+ * Codec calls of the devices, timed on the host
+ */
+
+uint16_t sim_lz_encode(dsps_lz_enc_t *enc, const uint8_t *src, uint32_t src_len, uint8_t *dst,
+                                                        uint16_t dst_size, uint32_t *consumed)
+{
+        uint64_t start_ns = sim_cpu_ns();
+        uint16_t len = dsps_lz_encode(enc, src, src_len, dst, dst_size, consumed);
+
+        res.encode_ns += sim_cpu_ns() - start_ns;
+
+        return len;
+}
+
+int sim_lz_decode(dsps_lz_dec_t *dec, const uint8_t *src, uint16_t src_len, uint8_t *dst)
+{
+        uint64_t start_ns = sim_cpu_ns();
+        int len = dsps_lz_decode(dec, src, src_len, dst);
+
+        res.decode_ns += sim_cpu_ns() - start_ns;
+
+        return len;
+}
+
+/*
+ * OS: tasks, notifications and timers
+ */
+
+static void sim_task_entry(void)
+{
+        current->func(NULL);
+
+        /* DSPS tasks never return */
+        fprintf(stderr, "%s task returned\n", devices[current->dev]->name);
+        exit(1);
+}
+
+static void sim_task_create(struct sim_task *t, uint8_t dev, void (*func)(void *params))
+{
+        memset(t, 0, sizeof(*t));
+        t->dev = dev;
+        t->func = func;
+        t->stack = malloc(SIM_STACK_SIZE);
+        OS_ASSERT(t->stack);
+
+        getcontext(&t->ctx);
+        t->ctx.uc_stack.ss_sp = t->stack;
+        t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+        t->ctx.uc_link = NULL;
+        makecontext(&t->ctx, sim_task_entry, 0);
+}
+
+/* Give the CPU back to the scheduler until the wait condition of the current task is met */
+static void sim_task_block(SIM_WAIT wait)
+{
+        OS_ASSERT(current != NULL);
+
+        current->wait = wait;
+        swapcontext(&current->ctx, &sched_ctx);
+}
+
+static bool sim_task_ready(const struct sim_task *t)
+{
+        switch (t->wait) {
+        case SIM_WAIT_NONE:
+                return true;
+        case SIM_WAIT_NOTIFY:
+                return t->notif != 0;
+        case SIM_WAIT_TIME:
+                return now_us >= t->wake_us;
+        case SIM_WAIT_UART_READ:
+                return t->uart->rx_cnt >= t->read_len || now_us >= t->wake_us;
+        }
+
+        return false;
+}
+
+/* Run the tasks until all of them wait */
+static void sim_schedule(void)
+{
+        uint32_t switches = 0;
+        bool ran;
+
+        do {
+                ran = false;
+
+                for (int i = 0; i < SIM_TASKS; i++) {
+                        struct sim_task *t = &tasks[i];
+
+                        if (!sim_task_ready(t)) {
+                                continue;
+                        }
+
+                        if (++switches > SIM_SWITCHES_MAX) {
+                                fprintf(stderr, "%s tasks spin at %lu ms\n", devices[t->dev]->name,
+                                                                        (unsigned long)(now_us / 1000));
+                                exit(1);
+                        }
+
+                        t->wait = SIM_WAIT_NONE;
+                        current = t;
+                        swapcontext(&sched_ctx, &t->ctx);
+                        current = NULL;
+                        ran = true;
+                }
+        } while (ran);
+}
+
+OS_TASK sim_task_current(void)
+{
+        return current;
+}
+
+OS_BASE_TYPE sim_task_notify(OS_TASK task, uint32_t value)
+{
+        task->notif |= value;
+
+        return OS_OK;
+}
+
+OS_BASE_TYPE sim_task_notify_wait(uint32_t exit_bits, uint32_t *value)
+{
+        /* The DSPS tasks always wait forever */
+        while (current->notif == 0) {
+                sim_task_block(SIM_WAIT_NOTIFY);
+        }
+
+        *value = current->notif;
+        current->notif &= ~exit_bits;
+
+        return OS_OK;
+}
+
+void sim_delay_ms(uint32_t ms)
+{
+        current->wake_us = now_us + (uint64_t)ms * 1000;
+        sim_task_block(SIM_WAIT_TIME);
+}
+
+OS_TIMER sim_timer_create(OS_TICK_TIME period, bool reload, void *timer_id,
+                          void (*callback)(OS_TIMER timer))
+{
+        for (int i = 0; i < SIM_TIMERS; i++) {
+                struct sim_timer *timer = &timers[i];
+
+                if (!timer->used) {
+                        *timer = (struct sim_timer){ .used = true, .reload = reload, .period = period,
+                                                        .id = timer_id, .callback = callback };
+                        return timer;
+                }
+        }
+
+        return NULL;
+}
+
+OS_BASE_TYPE sim_timer_start(OS_TIMER timer)
+{
+        timer->active = true;
+        timer->expiry_us = now_us + (uint64_t)OS_TICKS_2_MS(timer->period) * 1000;
+
+        return OS_TIMER_SUCCESS;
+}
+
+OS_BASE_TYPE sim_timer_stop(OS_TIMER timer)
+{
+        timer->active = false;
+
+        return OS_TIMER_SUCCESS;
+}
+
+OS_BASE_TYPE sim_timer_delete(OS_TIMER timer)
+{
+        timer->used = false;
+        timer->active = false;
+
+        return OS_TIMER_SUCCESS;
+}
+
+bool sim_timer_is_active(OS_TIMER timer)
+{
+        return timer->active;
+}
+
+void *sim_timer_get_id(OS_TIMER timer)
+{
+        return timer->id;
+}
+
+/* Timer callbacks run outside of the tasks, as in the timer task of the OS */
+static void sim_timers_run(void)
+{
+        for (int i = 0; i < SIM_TIMERS; i++) {
+                struct sim_timer *timer = &timers[i];
+
+                if (timer->used && timer->active && now_us >= timer->expiry_us) {
+                        timer->active = timer->reload;
+                        timer->expiry_us += (uint64_t)OS_TICKS_2_MS(timer->period) * 1000;
+                        timer->callback(timer);
+                }
+        }
+}
+
+/*
+ * Serial ports
+ */
+
+ad_uart_handle_t ad_uart_open(const ad_uart_controller_conf_t *ad_uart_ctrl_conf)
+{
+        sim_uart_t *uart = &uarts[ad_uart_ctrl_conf->id];
+
+        /* The adapter enables the automatic flow control, RTS follows the receive buffer */
+        uart->open = true;
+        uart->rts = true;
+        uart->rx_head = 0;
+        uart->rx_cnt = 0;
+
+        return uart;
+}
+
+int ad_uart_close(ad_uart_handle_t handle, bool force)
+{
+        sim_uart_t *uart = handle;
+
+        uart->open = false;
+        uart->rts = false;
+
+        return AD_UART_ERROR_NONE;
+}
+
+int ad_uart_read(ad_uart_handle_t handle, char *rd_buf, size_t len, OS_TICK_TIME timeout)
+{
+        sim_uart_t *uart = handle;
+        uint32_t n;
+
+        if (uart->rx_cnt < len) {
+                current->uart = uart;
+                current->read_len = len;
+                current->wake_us = now_us + (uint64_t)OS_TICKS_2_MS(timeout) * 1000;
+                sim_task_block(SIM_WAIT_UART_READ);
+        }
+
+        n = MIN(len, uart->rx_cnt);
+        for (uint32_t i = 0; i < n; i++) {
+                rd_buf[i] = uart->rx_buf[(uart->rx_head + i) % SIM_UART_RX_BUF_SIZE];
+        }
+        uart->rx_head = (uart->rx_head + n) % SIM_UART_RX_BUF_SIZE;
+        uart->rx_cnt -= n;
+
+        return n;
+}
+
+/* Check the output of the central against the input sequence */
+static void sim_serial_out(const uint8_t *data, uint32_t len, uint64_t start_us, uint32_t baud)
+{
+        for (uint32_t i = 0; i < len; i++) {
+                if (data[i] != sim_pattern(out_seq + i)) {
+                        res.errors++;
+                }
+        }
+
+        /* End to end latency of the chunks whose last byte is written out */
+        while (chunk_cnt && (int32_t)(out_seq + len - chunks[chunk_first].end) >= 0) {
+                uint32_t bytes = chunks[chunk_first].end - out_seq;
+                uint64_t end_us = start_us + (uint64_t)bytes * 10000000 / baud;
+                uint32_t ms = (end_us - chunks[chunk_first].time_us) / 1000;
+
+                if (measuring) {
+                        res.latency_sum_ms += ms;
+                        res.latency_cnt++;
+                        res.latency_max_ms = MAX(res.latency_max_ms, ms);
+                }
+                chunk_first = (chunk_first + 1) % SIM_CHUNKS;
+                chunk_cnt--;
+        }
+
+        out_seq += len;
+}
+
+int ad_uart_write(ad_uart_handle_t handle, const char *wr_buf, size_t len)
+{
+        sim_uart_t *uart = handle;
+        uint64_t start_us = now_us;
+
+        if (uart->dev == SIM_DEVICE_CENTRAL) {
+                sim_serial_out((const uint8_t *)wr_buf, len, start_us, uart->baud);
+        } else {
+                /* Nothing is sent the other way */
+                res.errors += len;
+        }
+
+        /* 8N1, 10 bits per byte */
+        current->wake_us = start_us + ((uint64_t)len * 10000000 + uart->baud - 1) / uart->baud;
+        sim_task_block(SIM_WAIT_TIME);
+
+        if (uart->dev == SIM_DEVICE_CENTRAL && measuring) {
+                res.bytes += len;
+        }
+
+        return len;
+}
+
+void hw_uart_rts_setf(HW_UART_ID id, uint8_t rts)
+{
+        if (uarts[id].rts && !rts && measuring) {
+                res.serial_flow_off++;
+        }
+        uarts[id].rts = rts;
+}
+
+void hw_uart_afce_setf(HW_UART_ID id, uint8_t afce)
+{
+}
+
+/* Serial port input of the peripheral, paused while RTS is deasserted */
+static void sim_serial_in(void)
+{
+        sim_uart_t *uart = &uarts[SIM_DEVICE_PERIPHERAL];
+        uint32_t n;
+
+        if (!measuring) {
+                return;
+        }
+
+        if (burst_idle_us) {
+                burst_idle_us -= MIN(burst_idle_us, SIM_STEP_US);
+                return;
+        }
+
+        if (!uart->open || !uart->rts || uart->rx_cnt == SIM_UART_RX_BUF_SIZE) {
+                in_bits_us = 0;
+                return;
+        }
+
+        in_bits_us += (uint64_t)uart->baud * SIM_STEP_US;
+        n = in_bits_us / 10000000;
+        in_bits_us %= 10000000;
+
+        n = MIN(n, SIM_UART_RX_BUF_SIZE - uart->rx_cnt);
+        if (cfg.burst_len) {
+                n = MIN(n, burst_left);
+                burst_left -= n;
+                if (burst_left == 0) {
+                        burst_left = cfg.burst_len;
+                        burst_idle_us = cfg.burst_gap_ms * 1000;
+                }
+        }
+
+        if (n == 0) {
+                return;
+        }
+
+        if (chunk_cnt < SIM_CHUNKS) {
+                chunks[(chunk_first + chunk_cnt++) % SIM_CHUNKS] =
+                                        (sim_chunk_t){ .end = in_seq + n, .time_us = now_us };
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+                uart->rx_buf[(uart->rx_head + uart->rx_cnt++) % SIM_UART_RX_BUF_SIZE] = sim_pattern(in_seq++);
+        }
+}
+
+/*
+ * BLE stack
+ */
+
+static uint8_t sim_dev(void)
+{
+        OS_ASSERT(current != NULL);
+
+        return current->dev;
+}
+
+static void *sim_evt_new(uint16_t evt_code, size_t size)
+{
+        ble_evt_hdr_t *hdr = calloc(1, size);
+
+        OS_ASSERT(hdr);
+        hdr->evt_code = evt_code;
+        hdr->length = size - sizeof(*hdr);
+
+        return hdr;
+}
+
+static void sim_evt_post(uint8_t dev, void *evt)
+{
+        sim_ble_t *b = &ble[dev];
+
+        if (b->evt_cnt == SIM_BLE_EVENTS) {
+                fprintf(stderr, "%s BLE event queue overflow\n", devices[dev]->name);
+                exit(1);
+        }
+
+        b->evt[(b->evt_first + b->evt_cnt++) % SIM_BLE_EVENTS] = evt;
+        if (b->app_task) {
+                sim_task_notify(b->app_task, BLE_APP_NOTIFY_MASK);
+        }
+}
+
+static void sim_device_address(uint8_t dev, bd_address_t *addr)
+{
+        static const uint8_t addrs[SIM_DEVICE_MAX][BD_ADDR_LEN] = {
+                { 0x01, 0x00, 0xF4, 0x35, 0x23, 0x48 },
+                { 0x02, 0x00, 0xF4, 0x35, 0x23, 0x48 },
+        };
+
+        addr->addr_type = PRIVATE_ADDRESS;
+        memcpy(addr->addr, addrs[dev], BD_ADDR_LEN);
+}
+
+ble_error_t ble_peripheral_start(void)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_central_start(void)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_register_app(void)
+{
+        ble[sim_dev()].app_task = current;
+
+        return BLE_STATUS_OK;
+}
+
+ble_evt_hdr_t *ble_get_event(bool wait)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+        ble_evt_hdr_t *hdr;
+
+        if (b->evt_cnt == 0) {
+                return NULL;
+        }
+
+        hdr = b->evt[b->evt_first];
+        b->evt_first = (b->evt_first + 1) % SIM_BLE_EVENTS;
+        b->evt_cnt--;
+
+        return hdr;
+}
+
+bool ble_has_event(void)
+{
+        return ble[sim_dev()].evt_cnt != 0;
+}
+
+void ble_handle_event_default(ble_evt_hdr_t *hdr)
+{
+}
+
+const char *ble_address_to_string(const bd_address_t *address)
+{
+        static char buf[18];
+        const uint8_t *a = address->addr;
+
+        snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", a[5], a[4], a[3], a[2], a[1], a[0]);
+
+        return buf;
+}
+
+ble_error_t ble_gap_address_get(own_address_t *address)
+{
+        bd_address_t addr;
+
+        sim_device_address(sim_dev(), &addr);
+        address->addr_type = PRIVATE_STATIC_ADDRESS;
+        memcpy(address->addr, addr.addr, BD_ADDR_LEN);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_address_set(const own_address_t *address, uint16_t renew_dur)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_device_name_set(const char *name, att_perm_t perm)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_mtu_size_set(uint16_t mtu_size)
+{
+        ble[sim_dev()].mtu_size = mtu_size;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_adv_data_set(uint8_t adv_data_len, const uint8_t *adv_data,
+                                 uint8_t scan_rsp_data_len, const uint8_t *scan_rsp_data)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+
+        b->adv_len = MIN(adv_data_len, BLE_ADV_DATA_LEN_MAX);
+        memcpy(b->adv_data, adv_data, b->adv_len);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_adv_start(gap_conn_mode_t adv_type)
+{
+        ble[sim_dev()].advertising = true;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_scan_start(gap_scan_type_t type, gap_scan_mode_t mode, uint16_t interval,
+                               uint16_t window, bool filt_wlist, bool filt_dupl)
+{
+        ble[sim_dev()].scanning = true;
+        conn.adv_reported = false;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_scan_stop(void)
+{
+        ble_evt_gap_scan_completed_t *evt;
+        uint8_t dev = sim_dev();
+
+        ble[dev].scanning = false;
+
+        evt = sim_evt_new(BLE_EVT_GAP_SCAN_COMPLETED, sizeof(*evt));
+        evt->status = BLE_ERROR_CANCELED;
+        sim_evt_post(dev, evt);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_connect_ce(const bd_address_t *peer_addr, const gap_conn_params_t *conn_params,
+                               uint16_t ce_len_min, uint16_t ce_len_max)
+{
+        conn.connecting = true;
+        conn.conn_params = *conn_params;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_connect_cancel(void)
+{
+        conn.connecting = false;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_get_device_by_addr(const bd_address_t *addr, gap_device_t *gap_device)
+{
+        return BLE_ERROR_NOT_FOUND;
+}
+
+ble_error_t ble_gap_conn_param_update(uint16_t conn_idx, const gap_conn_params_t *conn_params)
+{
+        ble_evt_gap_conn_param_update_req_t *evt;
+
+        evt = sim_evt_new(BLE_EVT_GAP_CONN_PARAM_UPDATE_REQ, sizeof(*evt));
+        evt->conn_idx = conn_idx;
+        evt->conn_params = *conn_params;
+        sim_evt_post(SIM_DEVICE_CENTRAL, evt);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_conn_param_update_reply(uint16_t conn_idx, bool accept)
+{
+        ble_evt_gap_conn_param_update_completed_t *evt;
+
+        /* The link keeps the connection interval of the command line either way */
+        if (accept) {
+                ble_evt_gap_conn_param_updated_t *upd;
+
+                for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                        upd = sim_evt_new(BLE_EVT_GAP_CONN_PARAM_UPDATED, sizeof(*upd));
+                        upd->conn_idx = conn_idx;
+                        upd->conn_params = conn.conn_params;
+                        sim_evt_post(dev, upd);
+                }
+        }
+
+        evt = sim_evt_new(BLE_EVT_GAP_CONN_PARAM_UPDATE_COMPLETED, sizeof(*evt));
+        evt->conn_idx = conn_idx;
+        evt->status = accept ? BLE_STATUS_OK : BLE_ERROR_NOT_ACCEPTED;
+        sim_evt_post(SIM_DEVICE_PERIPHERAL, evt);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_pair(uint16_t conn_idx, bool bond)
+{
+        return BLE_ERROR_NOT_ACCEPTED;
+}
+
+ble_error_t ble_gap_pair_reply(uint16_t conn_idx, bool accept, bool bond)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gap_phy_set(uint16_t conn_idx, uint8_t tx_phy_pref, uint8_t rx_phy_pref)
+{
+        return BLE_STATUS_OK;
+}
+
+/* Advertising, scanning and connection setup */
+static void sim_gap_run(void)
+{
+        sim_ble_t *p = &ble[SIM_DEVICE_PERIPHERAL], *c = &ble[SIM_DEVICE_CENTRAL];
+
+        if (p->advertising && c->scanning && !conn.adv_reported) {
+                ble_evt_gap_adv_report_t *evt = sim_evt_new(BLE_EVT_GAP_ADV_REPORT, sizeof(*evt));
+
+                sim_device_address(SIM_DEVICE_PERIPHERAL, &evt->address);
+                evt->rssi = -50;
+                evt->length = p->adv_len;
+                memcpy(evt->data, p->adv_data, p->adv_len);
+                sim_evt_post(SIM_DEVICE_CENTRAL, evt);
+                conn.adv_reported = true;
+        }
+
+        if (p->advertising && conn.connecting) {
+                p->advertising = false;
+                conn.connecting = false;
+                conn.connected = true;
+                conn.mtu = 23;
+                conn.conn_params.interval_min = cfg.conn_interval;
+                conn.conn_params.interval_max = cfg.conn_interval;
+                conn.pkts_per_event = MAX(ll_pkts_per_event(), 1);
+                conn.anchor_us = now_us + (uint64_t)cfg.conn_interval * 1250;
+
+                for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                        ble_evt_gap_connected_t *evt = sim_evt_new(BLE_EVT_GAP_CONNECTED, sizeof(*evt));
+                        ble_evt_gap_data_length_changed_t *dle;
+
+                        evt->conn_idx = 0;
+                        sim_device_address(dev, &evt->own_addr);
+                        sim_device_address(SIM_DEVICE_MAX - 1 - dev, &evt->peer_address);
+                        evt->conn_params = conn.conn_params;
+                        sim_evt_post(dev, evt);
+
+                        dle = sim_evt_new(BLE_EVT_GAP_DATA_LENGTH_CHANGED, sizeof(*dle));
+                        dle->conn_idx = 0;
+                        dle->max_tx_length = cfg.ll_tx_length;
+                        dle->max_tx_time = ll_tx_time(cfg.ll_tx_length, cfg.phy);
+                        dle->max_rx_length = cfg.ll_tx_length;
+                        dle->max_rx_time = dle->max_tx_time;
+                        sim_evt_post(dev, dle);
+                }
+        }
+}
+
+ble_error_t ble_storage_put_u32(uint16_t conn_idx, ble_storage_key_t key, uint32_t value,
+                                bool persistent)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+        sim_storage_t *free_entry = NULL;
+
+        for (int i = 0; i < SIM_STORAGE; i++) {
+                sim_storage_t *s = &b->storage[i];
+
+                if (s->used && s->key == key) {
+                        s->value = value;
+                        return BLE_STATUS_OK;
+                }
+                if (!s->used && !free_entry) {
+                        free_entry = s;
+                }
+        }
+
+        if (!free_entry) {
+                return BLE_ERROR_INS_RESOURCES;
+        }
+
+        *free_entry = (sim_storage_t){ .used = true, .key = key, .value = value };
+
+        return BLE_STATUS_OK;
+}
+
+static sim_storage_t *sim_storage_find(ble_storage_key_t key)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+
+        for (int i = 0; i < SIM_STORAGE; i++) {
+                if (b->storage[i].used && b->storage[i].key == key) {
+                        return &b->storage[i];
+                }
+        }
+
+        return NULL;
+}
+
+ble_error_t ble_storage_get_u8(uint16_t conn_idx, ble_storage_key_t key, uint8_t *value)
+{
+        sim_storage_t *s = sim_storage_find(key);
+
+        if (!s) {
+                return BLE_ERROR_NOT_FOUND;
+        }
+        *value = s->value;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_storage_get_u16(uint16_t conn_idx, ble_storage_key_t key, uint16_t *value)
+{
+        sim_storage_t *s = sim_storage_find(key);
+
+        if (!s) {
+                return BLE_ERROR_NOT_FOUND;
+        }
+        *value = s->value;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_storage_remove_all(ble_storage_key_t key)
+{
+        sim_storage_t *s = sim_storage_find(key);
+
+        if (s) {
+                s->used = false;
+        }
+
+        return BLE_STATUS_OK;
+}
+
+void ble_service_add(ble_service_t *svc)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+
+        OS_ASSERT(b->service_cnt < SIM_SERVICES);
+        b->services[b->service_cnt++] = svc;
+}
+
+bool ble_service_handle_event(const ble_evt_hdr_t *evt)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+
+        for (uint32_t i = 0; i < b->service_cnt; i++) {
+                ble_service_t *svc = b->services[i];
+
+                switch (evt->evt_code) {
+                case BLE_EVT_GAP_CONNECTED:
+                        if (svc->connected_evt) {
+                                svc->connected_evt(svc, (const ble_evt_gap_connected_t *)evt);
+                        }
+                        break;
+                case BLE_EVT_GAP_DISCONNECTED:
+                        if (svc->disconnected_evt) {
+                                svc->disconnected_evt(svc, (const ble_evt_gap_disconnected_t *)evt);
+                        }
+                        break;
+                case BLE_EVT_GATTS_READ_REQ:
+                {
+                        const ble_evt_gatts_read_req_t *req = (const void *)evt;
+
+                        if (req->handle >= svc->start_h && req->handle <= svc->end_h && svc->read_req) {
+                                svc->read_req(svc, req);
+                                return true;
+                        }
+                        break;
+                }
+                case BLE_EVT_GATTS_WRITE_REQ:
+                {
+                        const ble_evt_gatts_write_req_t *req = (const void *)evt;
+
+                        if (req->handle >= svc->start_h && req->handle <= svc->end_h && svc->write_req) {
+                                svc->write_req(svc, req);
+                                return true;
+                        }
+                        break;
+                }
+                case BLE_EVT_GATTS_EVENT_SENT:
+                {
+                        const ble_evt_gatts_event_sent_t *sent = (const void *)evt;
+
+                        if (sent->handle >= svc->start_h && sent->handle <= svc->end_h && svc->event_sent) {
+                                svc->event_sent(svc, sent);
+                                return true;
+                        }
+                        break;
+                }
+                default:
+                        break;
+                }
+        }
+
+        return false;
+}
+
+void ble_uuid_create16(uint16_t uuid16, att_uuid_t *uuid)
+{
+        memset(uuid, 0, sizeof(*uuid));
+        uuid->type = ATT_UUID_16;
+        uuid->uuid16 = uuid16;
+}
+
+bool ble_uuid_from_string(const char *str, att_uuid_t *uuid)
+{
+        int n = 0;
+
+        memset(uuid, 0, sizeof(*uuid));
+        uuid->type = ATT_UUID_128;
+
+        /* Stored little endian, as on air */
+        for (; *str && n < 2 * ATT_UUID_LENGTH; str++) {
+                unsigned int digit;
+
+                if (*str == '-') {
+                        continue;
+                }
+                if (sscanf(str, "%1x", &digit) != 1) {
+                        return false;
+                }
+                uuid->uuid128[ATT_UUID_LENGTH - 1 - n / 2] |= digit << (n % 2 ? 0 : 4);
+                n++;
+        }
+
+        return n == 2 * ATT_UUID_LENGTH;
+}
+
+bool ble_uuid_equal(const att_uuid_t *uuid1, const att_uuid_t *uuid2)
+{
+        if (uuid1->type != uuid2->type) {
+                return false;
+        }
+
+        return uuid1->type == ATT_UUID_16 ? uuid1->uuid16 == uuid2->uuid16 :
+                                        !memcmp(uuid1->uuid128, uuid2->uuid128, ATT_UUID_LENGTH);
+}
+
+/* Handles are allocated once the service is registered, attributes record their offset until then */
+static sim_attr_t *sim_gatt_add(gattc_item_type_t type, const att_uuid_t *uuid, uint16_t offset)
+{
+        sim_attr_t *attr;
+
+        OS_ASSERT(gatt.attr_cnt < SIM_GATT_ATTRS);
+        attr = &gatt.attr[gatt.attr_cnt++];
+        attr->type = type;
+        attr->uuid = *uuid;
+        attr->handle = offset;
+
+        return attr;
+}
+
+ble_error_t ble_gatts_add_service(const att_uuid_t *uuid, const gatt_service_t type, uint16_t num_attrs)
+{
+        gatt.svc_uuid = *uuid;
+        gatt.svc_attr_first = gatt.attr_cnt;
+        gatt.start_h = gatt.next_h;
+        gatt.end_h = gatt.next_h + num_attrs - 1;
+
+        /* The service declaration takes the first handle */
+        gatt.offset = 1;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gatts_add_characteristic(const att_uuid_t *uuid, gatt_prop_t prop, att_perm_t perm,
+                                         uint16_t max_len, gatts_flag_t flags, uint16_t *h_offset,
+                                         uint16_t *h_val_offset)
+{
+        sim_attr_t *attr = sim_gatt_add(GATTC_ITEM_TYPE_CHARACTERISTIC, uuid, gatt.offset);
+
+        attr->prop = prop;
+        if (h_offset) {
+                *h_offset = gatt.offset;
+        }
+        if (h_val_offset) {
+                *h_val_offset = gatt.offset + 1;
+        }
+        gatt.offset += 2;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gatts_add_descriptor(const att_uuid_t *uuid, att_perm_t perm, uint16_t max_len,
+                                     gatts_flag_t flags, uint16_t *h_offset)
+{
+        sim_gatt_add(GATTC_ITEM_TYPE_DESCRIPTOR, uuid, gatt.offset);
+        if (h_offset) {
+                *h_offset = gatt.offset;
+        }
+        gatt.offset++;
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gatts_register_service(uint16_t *handle, ...)
+{
+        att_uuid_t tx_uuid, flow_ctrl_uuid;
+        uint16_t *h;
+        va_list ap;
+
+        *handle = gatt.start_h;
+
+        va_start(ap, handle);
+        while ((h = va_arg(ap, uint16_t *)) != NULL) {
+                *h += gatt.start_h;
+        }
+        va_end(ap);
+
+        ble_uuid_from_string(UUID_DSPS_SERVER_TX, &tx_uuid);
+        ble_uuid_from_string(UUID_DSPS_FLOW_CTRL, &flow_ctrl_uuid);
+
+        for (uint32_t i = gatt.svc_attr_first; i < gatt.attr_cnt; i++) {
+                sim_attr_t *attr = &gatt.attr[i];
+
+                attr->handle += gatt.start_h;
+
+                /* Characteristics the results are taken from */
+                if (attr->type == GATTC_ITEM_TYPE_CHARACTERISTIC && ble_uuid_equal(&attr->uuid, &tx_uuid)) {
+                        gatt.tx_val_h = attr->handle + 1;
+                }
+                if (attr->type == GATTC_ITEM_TYPE_CHARACTERISTIC &&
+                                                ble_uuid_equal(&attr->uuid, &flow_ctrl_uuid)) {
+                        gatt.flow_ctrl_val_h = attr->handle + 1;
+                }
+        }
+        gatt.next_h = gatt.end_h + 1;
+
+        return BLE_STATUS_OK;
+}
+
+uint16_t ble_gatts_get_num_attr(uint16_t include, uint16_t characteristics, uint16_t descriptors)
+{
+        return 1 + include + 2 * characteristics + descriptors;
+}
+
+ble_error_t ble_gatts_set_value(uint16_t handle, uint16_t length, const void *value)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gatts_read_cfm(uint16_t conn_idx, uint16_t handle, att_error_t status, uint16_t length,
+                               const void *value)
+{
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gatts_write_cfm(uint16_t conn_idx, uint16_t handle, att_error_t status)
+{
+        return BLE_STATUS_OK;
+}
+
+/* Buffer a PDU of the current device for the next connection events */
+static ble_error_t sim_pdu_queue(uint16_t conn_idx, uint16_t handle, uint16_t length, const void *value)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+        sim_pdu_t *pdu;
+
+        if (!conn.connected || conn_idx != 0) {
+                return BLE_ERROR_FAILED;
+        }
+        if (length > conn.mtu - 3) {
+                return BLE_ERROR_INVALID_PARAM;
+        }
+        if (b->pdu_cnt == SIM_BLE_PDUS) {
+                return BLE_ERROR_INS_RESOURCES;
+        }
+
+        pdu = &b->pdu[(b->pdu_first + b->pdu_cnt++) % SIM_BLE_PDUS];
+        pdu->handle = handle;
+        pdu->len = length;
+        pdu->ll_left = ll_pkts_per_pdu(length);
+        memcpy(pdu->value, value, length);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gatts_send_event(uint16_t conn_idx, uint16_t handle, gatt_event_t type, uint16_t length,
+                                 const void *value)
+{
+        sim_ble_t *b = &ble[sim_dev()];
+        ble_error_t status = sim_pdu_queue(conn_idx, handle, length, value);
+
+        if (status == BLE_STATUS_OK && handle == gatt.tx_val_h && measuring) {
+                uint32_t queued = 0;
+
+                for (uint32_t i = 0; i < b->pdu_cnt; i++) {
+                        queued += b->pdu[(b->pdu_first + i) % SIM_BLE_PDUS].handle == gatt.tx_val_h;
+                }
+                res.tx_window = MAX(res.tx_window, queued);
+        }
+
+        return status;
+}
+
+ble_error_t ble_gattc_browse(uint16_t conn_idx, const att_uuid_t *uuid)
+{
+        ble_evt_gattc_browse_svc_t *evt;
+        ble_evt_gattc_browse_completed_t *done;
+        uint8_t dev = sim_dev();
+
+        if (uuid == NULL || ble_uuid_equal(uuid, &gatt.svc_uuid)) {
+                uint32_t n = gatt.attr_cnt;
+
+                evt = sim_evt_new(BLE_EVT_GATTC_BROWSE_SVC, sizeof(*evt) + n * sizeof(gattc_item_t));
+                evt->conn_idx = conn_idx;
+                evt->uuid = gatt.svc_uuid;
+                evt->start_h = gatt.start_h;
+                evt->end_h = gatt.end_h;
+                evt->num_items = n;
+                for (uint32_t i = 0; i < n; i++) {
+                        gattc_item_t *item = &evt->items[i];
+
+                        item->type = gatt.attr[i].type;
+                        item->handle = gatt.attr[i].handle;
+                        item->uuid = gatt.attr[i].uuid;
+                        if (item->type == GATTC_ITEM_TYPE_CHARACTERISTIC) {
+                                item->c.value_handle = item->handle + 1;
+                                item->c.properties = gatt.attr[i].prop;
+                        }
+                }
+                sim_evt_post(dev, evt);
+        }
+
+        done = sim_evt_new(BLE_EVT_GATTC_BROWSE_COMPLETED, sizeof(*done));
+        done->conn_idx = conn_idx;
+        sim_evt_post(dev, done);
+
+        return BLE_STATUS_OK;
+}
+
+ble_error_t ble_gattc_write(uint16_t conn_idx, uint16_t handle, uint16_t offset, uint16_t length,
+                            const uint8_t *value)
+{
+        return sim_pdu_queue(conn_idx, handle, length, value);
+}
+
+ble_error_t ble_gattc_write_no_resp(uint16_t conn_idx, uint16_t handle, bool signed_write,
+                                    uint16_t length, const uint8_t *value)
+{
+        return sim_pdu_queue(conn_idx, handle, length, value);
+}
+
+ble_error_t ble_gattc_exchange_mtu(uint16_t conn_idx)
+{
+        conn.mtu = MIN(cfg.mtu, MIN(ble[SIM_DEVICE_PERIPHERAL].mtu_size, ble[SIM_DEVICE_CENTRAL].mtu_size));
+        conn.mtu_exchanged = true;
+
+        for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                ble_evt_gattc_mtu_changed_t *evt = sim_evt_new(BLE_EVT_GATTC_MTU_CHANGED, sizeof(*evt));
+
+                evt->conn_idx = conn_idx;
+                evt->mtu = conn.mtu;
+                sim_evt_post(dev, evt);
+        }
+
+        return BLE_STATUS_OK;
+}
+
+/* Deliver a write of the central to the peripheral */
+static void sim_deliver_write(const sim_pdu_t *pdu)
+{
+        ble_evt_gatts_write_req_t *req;
+        ble_evt_gattc_write_completed_t *done;
+
+        req = sim_evt_new(BLE_EVT_GATTS_WRITE_REQ, sizeof(*req) + pdu->len);
+        req->conn_idx = 0;
+        req->handle = pdu->handle;
+        req->length = pdu->len;
+        memcpy(req->value, pdu->value, pdu->len);
+        sim_evt_post(SIM_DEVICE_PERIPHERAL, req);
+
+        done = sim_evt_new(BLE_EVT_GATTC_WRITE_COMPLETED, sizeof(*done));
+        done->conn_idx = 0;
+        done->handle = pdu->handle;
+        done->status = ATT_ERROR_OK;
+        sim_evt_post(SIM_DEVICE_CENTRAL, done);
+
+        if (measuring && pdu->handle == gatt.flow_ctrl_val_h && pdu->len == 1 &&
+                                                        pdu->value[0] == DSPS_FLOW_CONTROL_OFF) {
+                res.sps_flow_off++;
+        }
+}
+
+/* Deliver a notification of the peripheral to the central */
+static void sim_deliver_notification(const sim_pdu_t *pdu)
+{
+        ble_evt_gattc_notification_t *ntf;
+        ble_evt_gatts_event_sent_t *sent;
+
+        ntf = sim_evt_new(BLE_EVT_GATTC_NOTIFICATION, sizeof(*ntf) + pdu->len);
+        ntf->conn_idx = 0;
+        ntf->handle = pdu->handle;
+        ntf->length = pdu->len;
+        memcpy(ntf->value, pdu->value, pdu->len);
+        sim_evt_post(SIM_DEVICE_CENTRAL, ntf);
+
+        sent = sim_evt_new(BLE_EVT_GATTS_EVENT_SENT, sizeof(*sent));
+        sent->conn_idx = 0;
+        sent->handle = pdu->handle;
+        sent->type = GATT_EVENT_NOTIFICATION;
+        sent->status = true;
+        sim_evt_post(SIM_DEVICE_PERIPHERAL, sent);
+
+        if (measuring && pdu->handle == gatt.tx_val_h) {
+                res.notifications++;
+                res.payload_bytes += pdu->len;
+        }
+}
+
+/* Send the PDUs of a device within the LL packets left in the connection event */
+static uint32_t sim_conn_event_tx(uint8_t dev, uint32_t pkts)
+{
+        sim_ble_t *b = &ble[dev];
+
+        while (b->pdu_cnt && pkts) {
+                sim_pdu_t *pdu = &b->pdu[b->pdu_first];
+
+                if (pkts < pdu->ll_left) {
+                        /* Fragments of a long PDU continue in the next connection event */
+                        pdu->ll_left -= pkts;
+                        return 0;
+                }
+                pkts -= pdu->ll_left;
+
+                if (dev == SIM_DEVICE_CENTRAL) {
+                        sim_deliver_write(pdu);
+                } else {
+                        sim_deliver_notification(pdu);
+                }
+                b->pdu_first = (b->pdu_first + 1) % SIM_BLE_PDUS;
+                b->pdu_cnt--;
+        }
+
+        return pkts;
+}
+
+static void sim_conn_event(void)
+{
+        uint32_t pkts = conn.pkts_per_event;
+
+        if (measuring) {
+                res.events++;
+        }
+
+        /* The central goes first */
+        pkts = sim_conn_event_tx(SIM_DEVICE_CENTRAL, pkts);
+        sim_conn_event_tx(SIM_DEVICE_PERIPHERAL, pkts);
+
+        conn.anchor_us += (uint64_t)cfg.conn_interval * 1250;
+}
+
+/*
+ * Simulation
+ */
+
+static void sim_reset(void)
+{
+        now_us = 0;
+        sim_tick_count = 0;
+        measuring = false;
+        current = NULL;
+        memset(&res, 0, sizeof(res));
+        memset(timers, 0, sizeof(timers));
+        memset(ble, 0, sizeof(ble));
+        memset(&gatt, 0, sizeof(gatt));
+        gatt.next_h = 1;
+        memset(&conn, 0, sizeof(conn));
+        memset(uarts, 0, sizeof(uarts));
+        chunk_first = chunk_cnt = 0;
+        in_seq = out_seq = 0;
+        in_bits_us = 0;
+        burst_left = cfg.burst_len;
+        burst_idle_us = 0;
+
+        sim_baudrate[SIM_DEVICE_PERIPHERAL] = cfg.baud_in;
+        sim_baudrate[SIM_DEVICE_CENTRAL] = cfg.baud_out;
+        for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                uarts[dev].dev = dev;
+                uarts[dev].baud = sim_baudrate[dev];
+                ble[dev].mtu_size = 23;
+        }
+}
+
+static void sim_run(void)
+{
+        uint64_t end_us = 0;
+
+        sim_reset();
+
+        /* The BLE, RX and TX tasks of each device, created in the order of main.c */
+        for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                for (int i = 0; i < 3; i++) {
+                        sim_task_create(&tasks[dev * 3 + i], dev, devices[dev]->task[i]);
+                }
+        }
+
+        for (;; now_us += SIM_STEP_US) {
+                sim_tick_count = now_us / 1000;
+
+                if (measuring && now_us >= end_us) {
+                        break;
+                }
+
+                sim_timers_run();
+                sim_gap_run();
+                sim_serial_in();
+                if (conn.connected && now_us >= conn.anchor_us) {
+                        sim_conn_event();
+                }
+                sim_schedule();
+
+                /* Start the input once the devices have taken the MTU exchange in */
+                if (!measuring && conn.mtu_exchanged && ble[SIM_DEVICE_PERIPHERAL].evt_cnt == 0 &&
+                                                        ble[SIM_DEVICE_CENTRAL].evt_cnt == 0) {
+                        measuring = true;
+                        end_us = now_us + SIM_STEP_US + (uint64_t)cfg.duration_ms * 1000;
+                        res.encode_ns = 0;
+                        res.decode_ns = 0;
+                        for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                                devices[dev]->stats_reset();
+                        }
+                }
+
+                if (!measuring && now_us >= (uint64_t)SIM_SETUP_MS * 1000) {
+                        res.setup_failed = true;
+                        return;
+                }
+        }
+
+        /* Bytes the central had to drop show up as a gap in the sequence at the output */
+        for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                dsps_stats_t stats;
+
+                devices[dev]->stats_get(&stats);
+                if (dev == SIM_DEVICE_CENTRAL) {
+                        res.rx_overflow = stats.dir[SPS_DIRECTION_OUT].dropped_bytes;
+                }
+        }
+
+        if (cfg.verbose) {
+                for (uint8_t dev = 0; dev < SIM_DEVICE_MAX; dev++) {
+                        printf("%s:\n", devices[dev]->name);
+                        devices[dev]->stats_print();
+                }
+        }
+}
+
+/* Run in a child process, so that each run starts from the initial state of the task sources */
+static bool sim_run_isolated(void)
+{
+        int fds[2], status;
+        pid_t pid;
+        bool ok;
+
+        fflush(stdout);
+        if (pipe(fds) != 0 || (pid = fork()) < 0) {
+                perror("fork");
+                return false;
+        }
+
+        if (pid == 0) {
+                close(fds[0]);
+                sim_run();
+                fflush(stdout);
+                ok = write(fds[1], &res, sizeof(res)) == sizeof(res);
+                _exit(ok ? 0 : 1);
+        }
+
+        close(fds[1]);
+        ok = read(fds[0], &res, sizeof(res)) == sizeof(res);
+        close(fds[0]);
+        waitpid(pid, &status, 0);
+
+        return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void print_header(void)
+{
+        printf("%8s %6s %9s %8s %9s %9s %8s %8s %8s\n", "CI(ms)", "window", "bytes/s", "ntf/evt",
+                        "lat avg", "lat max", "SPS off", "UART off", "overflow");
+}
+
+static void print_result(void)
+{
+        uint32_t kb = MAX(res.bytes / 1024, 1);
+
+        printf("%8.2f %6lu %9lu %8.2f %6lu ms %6lu ms %8lu %8lu %8lu\n",
+                        cfg.conn_interval * 1.25, (unsigned long)res.tx_window,
+                        (unsigned long)((uint64_t)res.bytes * 1000 / cfg.duration_ms),
+                        res.events ? (double)res.notifications / res.events : 0.0,
+                        (unsigned long)(res.latency_cnt ? res.latency_sum_ms / res.latency_cnt : 0),
+                        (unsigned long)res.latency_max_ms, (unsigned long)res.sps_flow_off,
+                        (unsigned long)res.serial_flow_off, (unsigned long)res.rx_overflow);
+
+        if (DSPS_COMPRESSION && res.payload_bytes) {
+                printf("%8s compression ratio %.2f, host CPU %lu ns/KB to encode, %lu ns/KB to decode\n",
+                                "", (double)res.bytes / res.payload_bytes,
+                                (unsigned long)(res.encode_ns / kb), (unsigned long)(res.decode_ns / kb));
+        }
+}
+
+static bool valid_baudrate(uint32_t baud)
+{
+        switch (baud) {
+        case HW_UART_BAUDRATE_1000000:
+        case HW_UART_BAUDRATE_500000:
+        case HW_UART_BAUDRATE_230400:
+        case HW_UART_BAUDRATE_115200:
+        case HW_UART_BAUDRATE_57600:
+        case HW_UART_BAUDRATE_38400:
+        case HW_UART_BAUDRATE_28800:
+        case HW_UART_BAUDRATE_19200:
+        case HW_UART_BAUDRATE_14400:
+        case HW_UART_BAUDRATE_9600:
+        case HW_UART_BAUDRATE_4800:
+                return true;
+        default:
+                return false;
+        }
+}
+
+static void usage(const char *name)
+{
+        printf("Usage: %s [options]\n"
+                "  -baud <bps>         serial port baud rate of the peripheral (default 1000000)\n"
+                "  -out-baud <bps>     serial port baud rate of the central (default same as -baud)\n"
+                "  -ci <units>         connection interval in 1.25 ms units (default 12)\n"
+                "  -mtu <bytes>        max MTU of the link (default %u)\n"
+                "  -dle <bytes>        LL data length (default 251)\n"
+                "  -phy <1|2>          LE 1M or LE 2M PHY (default 2)\n"
+                "  -data <pattern|text|random> input data (default pattern)\n"
+                "  -burst <bytes> <ms> bursts of data separated by idle time (default continuous)\n"
+                "  -time <ms>          simulated time (default 10000)\n"
+                "  -sweep              sweep the connection interval\n"
+                "  -verbose            print the statistics of both devices after each run\n"
+                "  -log                print the debug output of both devices\n",
+                name, MTU_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+        static const uint16_t sweep_ci[] = { 6, 8, 12, 16, 24, 36, 48, 80, 160 };
+        bool sweep = false, failed = false;
+        int i;
+
+        cfg = (sim_config_t){
+                .baud_in = 1000000,
+                .baud_out = 0,
+                .conn_interval = 12,
+                .mtu = MTU_SIZE,
+                .ll_tx_length = dg_configBLE_DATA_LENGTH_TX_MAX,
+                .phy = 2,
+                .duration_ms = 10000,
+        };
+
+        for (i = 1; i < argc; i++) {
+                const char *arg = argv[i];
+                bool has_val = i + 1 < argc;
+
+                if (!strcmp(arg, "-baud") && has_val) {
+                        cfg.baud_in = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-out-baud") && has_val) {
+                        cfg.baud_out = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-ci") && has_val) {
+                        cfg.conn_interval = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-mtu") && has_val) {
+                        cfg.mtu = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-dle") && has_val) {
+                        cfg.ll_tx_length = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-phy") && has_val) {
+                        cfg.phy = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-data") && has_val) {
+                        arg = argv[++i];
+                        cfg.data = !strcmp(arg, "text") ? SIM_DATA_TEXT :
+                                        !strcmp(arg, "random") ? SIM_DATA_RANDOM : SIM_DATA_PATTERN;
+                } else if (!strcmp(arg, "-burst") && i + 2 < argc) {
+                        cfg.burst_len = strtoul(argv[++i], NULL, 0);
+                        cfg.burst_gap_ms = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-time") && has_val) {
+                        cfg.duration_ms = strtoul(argv[++i], NULL, 0);
+                } else if (!strcmp(arg, "-sweep")) {
+                        sweep = true;
+                } else if (!strcmp(arg, "-verbose")) {
+                        cfg.verbose = true;
+                } else if (!strcmp(arg, "-log")) {
+                        cfg.log = true;
+                } else {
+                        usage(argv[0]);
+                        return 2;
+                }
+        }
+
+        if (cfg.baud_out == 0) {
+                cfg.baud_out = cfg.baud_in;
+        }
+
+        /* The serial port glue of the projects supports the baud rates of the UART driver only */
+        if (!valid_baudrate(cfg.baud_in) || !valid_baudrate(cfg.baud_out) || cfg.conn_interval < 6 ||
+                        cfg.mtu < 23 || cfg.ll_tx_length < 27 || cfg.ll_tx_length > 251 ||
+                        (cfg.phy != 1 && cfg.phy != 2) || cfg.duration_ms == 0) {
+                usage(argv[0]);
+                return 2;
+        }
+
+        sim_data_init(cfg.data);
+
+        printf("DSPS %s flow control%s, UART %lu/%lu bps, MTU %u, DLE %u, LE %uM, TX/RX queues %u/%u bytes\n",
+                        DSPS_CREDIT_FLOW_CONTROL ? "credit-based" : "ON/OFF",
+                        DSPS_COMPRESSION ? ", compression" : "", (unsigned long)cfg.baud_in,
+                        (unsigned long)cfg.baud_out, cfg.mtu, cfg.ll_tx_length, cfg.phy,
+                        TX_SPS_QUEUE_SIZE, RX_SPS_QUEUE_SIZE);
+        if (!cfg.verbose && !cfg.log) {
+                print_header();
+        }
+
+        for (i = 0; i < (sweep ? (int)(sizeof(sweep_ci) / sizeof(sweep_ci[0])) : 1); i++) {
+                if (sweep) {
+                        cfg.conn_interval = sweep_ci[i];
+                }
+
+                if (!sim_run_isolated()) {
+                        printf("ERROR: simulation aborted\n");
+                        failed = true;
+                        continue;
+                }
+
+                if (res.setup_failed) {
+                        printf("ERROR: link not set up within %u ms\n", SIM_SETUP_MS);
+                        failed = true;
+                        continue;
+                }
+
+                if (cfg.verbose || cfg.log) {
+                        print_header();
+                }
+                print_result();
+
+                /* Bytes lost on the way show up as a gap in the sequence at the output */
+                if (res.errors || res.rx_overflow) {
+                        printf("ERROR: %lu bytes lost or corrupted\n",
+                                                        (unsigned long)(res.errors + res.rx_overflow));
+                        failed = true;
+                }
+        }
+
+        return failed ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_sim.h
+ *
+ * @brief Configuration and device interface of the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef DSPS_SIM_H_
+#define DSPS_SIM_H_
+
+/*
+ * Configuration of the simulated devices, the settings of custom_config_qspi.h of the DSPS
+ * projects that the task and service sources depend on
+ */
+#define CONFIG_USE_BLE_SERVICES
+#define DSPS_UART
+#define CFG_UART_HW_FLOW_CTRL
+#define dg_configUART_ADAPTER                   (1)
+#define dg_configBLE_DATA_LENGTH_TX_MAX         (251)
+#define dg_configBLE_2MBIT_PHY                  (0)
+#define dg_configSUOTA_SUPPORT                  (0)
+#define dg_configUSE_CLI                        (0)
+#define GENERATE_RANDOM_DEVICE_ADDRESS          (0)
+#define DBG_LOG_ENABLE                          (1)
+
+#define SIM_DEVICE_PERIPHERAL                   (0)
+#define SIM_DEVICE_CENTRAL                      (1)
+#define SIM_DEVICE_MAX                          (2)
+
+/* Baud rate of the serial port of each device, set from the command line */
+extern int sim_baudrate[SIM_DEVICE_MAX];
+
+#define CFG_UART_SPS_BAUDRATE                   ((HW_UART_BAUDRATE) sim_baudrate[SIM_DEVICE])
+
+#if defined(SIM_DEVICE_PREFIX)
+/*
+ * Both devices link into one program, so the device sources prefix the external symbols that
+ * the task sources and dsps_stats.c define
+ */
+#define SIM_NAME__(prefix, name)                prefix ## _ ## name
+#define SIM_NAME_(prefix, name)                 SIM_NAME__(prefix, name)
+#define SIM_NAME(name)                          SIM_NAME_(SIM_DEVICE_PREFIX, name)
+
+#define dsps_BLE_task                           SIM_NAME(dsps_BLE_task)
+#define dsps_rx_task                            SIM_NAME(dsps_rx_task)
+#define dsps_tx_task                            SIM_NAME(dsps_tx_task)
+#define dsps_stats_reset                        SIM_NAME(dsps_stats_reset)
+#define dsps_stats_get                          SIM_NAME(dsps_stats_get)
+#define dsps_stats_serial                       SIM_NAME(dsps_stats_serial)
+#define dsps_stats_ble                          SIM_NAME(dsps_stats_ble)
+#define dsps_stats_dropped                      SIM_NAME(dsps_stats_dropped)
+#define dsps_stats_flow                         SIM_NAME(dsps_stats_flow)
+#define dsps_stats_queue_depth                  SIM_NAME(dsps_stats_queue_depth)
+#define dsps_stats_latency_reset                SIM_NAME(dsps_stats_latency_reset)
+#define dsps_stats_latency_start                SIM_NAME(dsps_stats_latency_start)
+#define dsps_stats_latency_end                  SIM_NAME(dsps_stats_latency_end)
+#define dsps_stats_serialize                    SIM_NAME(dsps_stats_serialize)
+#define dsps_stats_print                        SIM_NAME(dsps_stats_print)
+
+/* The codec calls of the devices are timed by the simulator */
+#define dsps_lz_encode                          sim_lz_encode
+#define dsps_lz_decode                          sim_lz_decode
+#endif /* SIM_DEVICE_PREFIX */
+
+#include "dsps_stats.h"
+
+/* A simulated device, the three tasks of a DSPS project and its statistics */
+typedef struct {
+        const char *name;
+        void (*task[3])(void *params);
+        void (*stats_reset)(void);
+        void (*stats_get)(dsps_stats_t *stats);
+        void (*stats_print)(void);
+} sim_device_t;
+
+extern const sim_device_t sim_peripheral;
+extern const sim_device_t sim_central;
+
+#endif /* DSPS_SIM_H_ */
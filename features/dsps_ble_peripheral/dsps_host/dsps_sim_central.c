@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_sim_central.c
+ *
+ * @brief DSPS central device of the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Builds the task sources of the central project unchanged, see dsps_sim.c
+ */
+
+#define SIM_DEVICE                      (SIM_DEVICE_CENTRAL)
+#define SIM_DEVICE_PREFIX               central
+
+#include "dsps_sim.h"
+
+#include "../../dsps_ble_central/dsps_ble_central_task.c"
+#include "../../dsps_ble_central/dsps/dsps_stats.c"
+
+const sim_device_t sim_central = {
+        .name           = "central",
+        .task           = { dsps_BLE_task, dsps_rx_task, dsps_tx_task },
+        .stats_reset    = dsps_stats_reset,
+        .stats_get      = dsps_stats_get,
+        .stats_print    = dsps_stats_print,
+};
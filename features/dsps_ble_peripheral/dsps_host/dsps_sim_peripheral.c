@@ -0,0 +1,50 @@
+/**
+ ****************************************************************************************
+ *
+ * @file dsps_sim_peripheral.c
+ *
+ * @brief DSPS peripheral device of the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Builds the task and service sources of the peripheral project unchanged, see dsps_sim.c
+ */
+
+#define SIM_DEVICE                      (SIM_DEVICE_PERIPHERAL)
+#define SIM_DEVICE_PREFIX               peripheral
+
+#include "dsps_sim.h"
+
+#include "../dsps_ble_peripheral_task.c"
+#include "../dsps/dsps.c"
+#include "../dsps/dsps_stats.c"
+
+const sim_device_t sim_peripheral = {
+        .name           = "peripheral",
+        .task           = { dsps_BLE_task, dsps_rx_task, dsps_tx_task },
+        .stats_reset    = dsps_stats_reset,
+        .stats_get      = dsps_stats_get,
+        .stats_print    = dsps_stats_print,
+};
@@ -0,0 +1,57 @@
+/**
+ ****************************************************************************************
+ *
+ * @file hw_uart.h
+ *
+ * @brief Host replacement of the UART driver used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef HW_UART_H_
+#define HW_UART_H_
+
+#include <stdint.h>
+
+/* The simulator takes the baud rate from the enum value */
+typedef enum {
+        HW_UART_BAUDRATE_1000000        = 1000000,
+        HW_UART_BAUDRATE_500000         = 500000,
+        HW_UART_BAUDRATE_230400         = 230400,
+        HW_UART_BAUDRATE_115200         = 115200,
+        HW_UART_BAUDRATE_57600          = 57600,
+        HW_UART_BAUDRATE_38400          = 38400,
+        HW_UART_BAUDRATE_28800          = 28800,
+        HW_UART_BAUDRATE_19200          = 19200,
+        HW_UART_BAUDRATE_14400          = 14400,
+        HW_UART_BAUDRATE_9600           = 9600,
+        HW_UART_BAUDRATE_4800           = 4800,
+} HW_UART_BAUDRATE;
+
+/* One simulated UART per device */
+typedef uint8_t HW_UART_ID;
+
+void hw_uart_rts_setf(HW_UART_ID uart, uint8_t rts);
+void hw_uart_afce_setf(HW_UART_ID uart, uint8_t afce);
+
+#endif /* HW_UART_H_ */
@@ -0,0 +1,51 @@
+/**
+ ****************************************************************************************
+ *
+ * @file misc.h
+ *
+ * @brief Host replacement of the DSPS debug helpers used by the DSPS simulator
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef MISC_H_
+#define MISC_H_
+
+#include <stdint.h>
+#include "osal.h"
+
+/* Debug output of the simulated devices, printed with -log */
+void sim_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#if DBG_LOG_ENABLE
+#define DBG_LOG(_f, args...)            sim_log(_f, ## args)
+#else
+#define DBG_LOG(_f, args...)
+#endif
+
+__STATIC_INLINE uint64_t __sys_ticks_timestamp(void)
+{
+        return OS_GET_TICK_COUNT();
+}
+
+#endif /* MISC_H_ */
@@ -0,0 +1,112 @@
+/**
+ ****************************************************************************************
+ *
+ * @file osal.h
+ *
+ * @brief Host replacement of the OS abstraction layer used by the DSPS host tools
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef OSAL_H_
+#define OSAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "sdk_defs.h"
+
+/* Simulated OS tick count, one tick per ms, advanced by the simulator */
+extern uint32_t sim_tick_count;
+
+typedef uint32_t OS_TICK_TIME;
+typedef uint32_t TickType_t;
+typedef int OS_BASE_TYPE;
+typedef struct sim_task *OS_TASK;
+typedef struct sim_timer *OS_TIMER;
+
+#define OS_OK                           (1)
+#define OS_FAIL                         (0)
+
+#define OS_GET_TICK_COUNT()             (sim_tick_count)
+#define OS_MS_2_TICKS(ms)               ((OS_TICK_TIME)(ms))
+#define OS_TICKS_2_MS(ticks)            ((uint32_t)(ticks))
+
+/* Tasks are coroutines that only give up the CPU when they block, see dsps_sim.c */
+#define OS_ENTER_CRITICAL_SECTION()
+#define OS_LEAVE_CRITICAL_SECTION()
+
+#define OS_MALLOC(size)                 malloc(size)
+#define OS_FREE(addr)                   free(addr)
+
+#define OS_TASK_NOTIFY_FOREVER          (0xFFFFFFFF)
+#define OS_TASK_NOTIFY_ALL_BITS         (0xFFFFFFFF)
+#define OS_NOTIFY_SET_BITS              (1)
+
+#define OS_GET_CURRENT_TASK()           sim_task_current()
+#define OS_TASK_NOTIFY(task, value, action) \
+                                        sim_task_notify((task), (value))
+#define OS_TASK_NOTIFY_WAIT(entry_bits, exit_bits, value, ticks) \
+                                        sim_task_notify_wait((exit_bits), (value))
+#define OS_DELAY_MS(ms)                 sim_delay_ms(ms)
+
+#define OS_TIMER_FOREVER                (0xFFFFFFFF)
+#define OS_TIMER_SUCCESS                (1)
+#define OS_TIMER_FAIL                   (0)
+
+#define OS_TIMER_CREATE(name, period, reload, timer_id, callback) \
+                                        sim_timer_create((period), (reload), \
+                                                         (void *)(uintptr_t)(timer_id), (callback))
+#define OS_TIMER_START(timer, ticks)    sim_timer_start(timer)
+#define OS_TIMER_STOP(timer, ticks)     sim_timer_stop(timer)
+#define OS_TIMER_DELETE(timer, ticks)   sim_timer_delete(timer)
+#define OS_TIMER_IS_ACTIVE(timer)       sim_timer_is_active(timer)
+#define OS_TIMER_GET_TIMER_ID(timer)    sim_timer_get_id(timer)
+
+OS_TASK sim_task_current(void);
+OS_BASE_TYPE sim_task_notify(OS_TASK task, uint32_t value);
+OS_BASE_TYPE sim_task_notify_wait(uint32_t exit_bits, uint32_t *value);
+void sim_delay_ms(uint32_t ms);
+
+OS_TIMER sim_timer_create(OS_TICK_TIME period, bool reload, void *timer_id,
+                          void (*callback)(OS_TIMER timer));
+OS_BASE_TYPE sim_timer_start(OS_TIMER timer);
+OS_BASE_TYPE sim_timer_stop(OS_TIMER timer);
+OS_BASE_TYPE sim_timer_delete(OS_TIMER timer);
+bool sim_timer_is_active(OS_TIMER timer);
+void *sim_timer_get_id(OS_TIMER timer);
+
+#define OS_ASSERT(cond)                 assert(cond)
+
+#define __RETAINED
+#define __RETAINED_RW
+
+#ifndef MIN
+#define MIN(a, b)                       (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)                       (((a) > (b)) ? (a) : (b))
+#endif
+
+#endif /* OSAL_H_ */
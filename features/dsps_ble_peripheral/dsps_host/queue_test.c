@@ -0,0 +1,569 @@
+/**
+ ****************************************************************************************
+ *
+ * @file queue_test.c
+ *
+ * @brief Host test and benchmark of the SPS queue of dsps_queue.c
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Tests the byte ring of dsps_queue.c (the central project has the same file):
+ *  - empty and full queue, free space and item count, and writes to a full queue,
+ *  - data written and read back across the end of the ring, at every start offset,
+ *  - contiguous regions returned by the write and read pointers, and data peeked at an offset
+ *    only released when committed,
+ *  - watermark hysteresis,
+ *  - a producer and a consumer thread moving a checked sequence through the queue, as the
+ *    serial port and BLE tasks do.
+ *
+ * Then compares the TX path over the ring with the one over the msg_queue based SPS queue it
+ * replaced (kept below as legacy_*), for several serial port read sizes: the read is copied to
+ * the queue, one notification payload at a time is copied out of it and released. The legacy
+ * queue allocates and copies each read into a message and sends one notification per message,
+ * the ring is read into directly and sends full MTU payloads. Both run on glibc malloc() and
+ * without the critical sections of the OS queues, so the gain on the target is larger.
+ *
+ * Build with:
+ *      gcc -O2 -pthread -I. -I../dsps -I../dsps/include -o queue_test queue_test.c ../dsps/dsps_queue.c
+ *
+ * Run examples:
+ *      ./queue_test                    (1 MB per read size, best of 10 rounds)
+ *      ./queue_test -size 4096 -rounds 20
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "osal.h"
+#include "dsps_queue.h"
+
+#define TEST_QUEUE_SIZE         (256)
+#define TEST_THREAD_BYTES       (16 * 1024 * 1024)
+
+/* Projects configuration, see dsps_common.h */
+#define BENCH_QUEUE_SIZE        (16384)
+#define BENCH_PAYLOAD_MAX       (244)
+
+#define LEGACY_QUEUE_LEN        (60)
+
+#define FAIL(...)               do { printf("FAIL: " __VA_ARGS__); printf("\n"); return 1; } while (0)
+
+static uint8_t test_buf[TEST_QUEUE_SIZE];
+
+/* msg of msg_queues.h */
+typedef struct {
+        uint16_t        id;
+        uint16_t        type;
+        uint16_t        size;
+        uint8_t         *data;
+        void            (*free_cb)(void *ptr);
+} legacy_msg;
+
+/* sps_queue_t of the original dsps_queue.c, over an OS queue of messages */
+typedef struct {
+        legacy_msg      items[LEGACY_QUEUE_LEN];
+        uint32_t        head;
+        uint32_t        tail;
+} legacy_queue_t;
+
+static bool legacy_queue_write_items(legacy_queue_t *q, uint16_t size, const uint8_t *data)
+{
+        legacy_msg m;
+
+        if (q->head - q->tail == LEGACY_QUEUE_LEN) {
+                return false;
+        }
+
+        /* msg_queue_send() */
+        m.id = 0;
+        m.type = 0;
+        m.size = size;
+        m.data = malloc(size);
+        m.free_cb = free;
+        memcpy(m.data, data, size);
+
+        q->items[q->head++ % LEGACY_QUEUE_LEN] = m;
+        return true;
+}
+
+static bool legacy_queue_read_items(legacy_queue_t *q, legacy_msg *m)
+{
+        if (q->head == q->tail) {
+                return false;
+        }
+
+        *m = q->items[q->tail % LEGACY_QUEUE_LEN];
+        return true;
+}
+
+static void legacy_queue_pop_release(legacy_queue_t *q)
+{
+        legacy_msg m = q->items[q->tail++ % LEGACY_QUEUE_LEN];
+
+        m.free_cb(m.data);
+}
+
+static uint8_t pattern(uint32_t seq)
+{
+        return (uint8_t)(seq * 7 + (seq >> 8));
+}
+
+static int test_empty_full(void)
+{
+        sps_queue_t q;
+        uint8_t data[TEST_QUEUE_SIZE + 1];
+        const uint8_t *rptr;
+        uint8_t *wptr;
+        uint32_t len;
+
+        memset(data, 0x5A, sizeof(data));
+        sps_queue_init(&q, test_buf, TEST_QUEUE_SIZE, 16, 200);
+
+        if (sps_queue_item_count(&q) != 0 || sps_queue_free_space(&q) != TEST_QUEUE_SIZE) {
+                FAIL("new queue is not empty");
+        }
+        if (sps_queue_read_ptr(&q, 0, &len) != NULL || len != 0) {
+                FAIL("read pointer of an empty queue");
+        }
+
+        wptr = sps_queue_write_ptr(&q, &len);
+        if (wptr != test_buf || len != TEST_QUEUE_SIZE) {
+                FAIL("write pointer of an empty queue");
+        }
+
+        if (sps_queue_write_items(&q, TEST_QUEUE_SIZE, data) != TEST_QUEUE_SIZE) {
+                FAIL("queue not filled");
+        }
+        if (sps_queue_item_count(&q) != TEST_QUEUE_SIZE || sps_queue_free_space(&q) != 0) {
+                FAIL("full queue count %d free %d", sps_queue_item_count(&q),
+                                                                sps_queue_free_space(&q));
+        }
+        if (sps_queue_write_ptr(&q, &len) != NULL || len != 0) {
+                FAIL("write pointer of a full queue");
+        }
+        if (sps_queue_write_items(&q, 1, data) != 0) {
+                FAIL("write to a full queue");
+        }
+
+        rptr = sps_queue_read_ptr(&q, 0, &len);
+        if (rptr != test_buf || len != TEST_QUEUE_SIZE) {
+                FAIL("read pointer of a full queue");
+        }
+
+        sps_queue_read_release(&q, TEST_QUEUE_SIZE);
+        if (sps_queue_item_count(&q) != 0) {
+                FAIL("queue not empty after release");
+        }
+
+        /* Indexes keep running, the ring restarts at the same physical offset */
+        wptr = sps_queue_write_ptr(&q, &len);
+        if (wptr != test_buf || len != TEST_QUEUE_SIZE) {
+                FAIL("write pointer after a full turn");
+        }
+
+        /* Only what fits is written, the caller counts the rest as dropped */
+        sps_queue_write_items(&q, TEST_QUEUE_SIZE - 10, data);
+        if (sps_queue_write_items(&q, 20, data) != 10 || sps_queue_free_space(&q) != 0) {
+                FAIL("write of 20 bytes with 10 free");
+        }
+
+        sps_queue_reset(&q);
+        if (sps_queue_item_count(&q) != 0 || sps_queue_free_space(&q) != TEST_QUEUE_SIZE) {
+                FAIL("queue not empty after reset");
+        }
+
+        return 0;
+}
+
+static int test_wrap(void)
+{
+        sps_queue_t q;
+        uint8_t data[TEST_QUEUE_SIZE];
+        uint8_t out[TEST_QUEUE_SIZE];
+        const uint8_t *rptr;
+        uint8_t *wptr;
+        uint32_t start, size, len, got, i;
+
+        for (i = 0; i < TEST_QUEUE_SIZE; i++) {
+                data[i] = pattern(i);
+        }
+
+        for (start = 0; start < TEST_QUEUE_SIZE; start++) {
+                for (size = 1; size <= TEST_QUEUE_SIZE; size += (size < 8) ? 1 : 37) {
+                        sps_queue_init(&q, test_buf, TEST_QUEUE_SIZE, 16, 200);
+                        memset(test_buf, 0, sizeof(test_buf));
+
+                        /* Move the indexes to the start offset */
+                        sps_queue_write_items(&q, start, data);
+                        sps_queue_read_release(&q, start);
+
+                        /* Contiguous free region up to the end of the ring */
+                        wptr = sps_queue_write_ptr(&q, &len);
+                        if (wptr != &test_buf[start] || len != TEST_QUEUE_SIZE - start) {
+                                FAIL("write pointer at %u: %u bytes", start, len);
+                        }
+
+                        if (sps_queue_write_items(&q, size, data) != size) {
+                                FAIL("write of %u at %u", size, start);
+                        }
+
+                        /* At most two regions to read back */
+                        got = 0;
+                        while ((rptr = sps_queue_read_ptr(&q, got, &len)) != NULL) {
+                                if (rptr != &test_buf[(start + got) % TEST_QUEUE_SIZE]) {
+                                        FAIL("read pointer at %u offset %u", start, got);
+                                }
+                                memcpy(&out[got], rptr, len);
+                                got += len;
+                        }
+                        if (got != size || memcmp(out, data, size)) {
+                                FAIL("data of %u bytes at %u read back as %u bytes", size,
+                                                                                start, got);
+                        }
+                        if (start + size > TEST_QUEUE_SIZE
+                                && sps_queue_read_ptr(&q, 0, &len) && len != TEST_QUEUE_SIZE - start) {
+                                FAIL("first region of %u bytes at %u is %u bytes", size, start,
+                                                                                        len);
+                        }
+
+                        sps_queue_read_release(&q, size);
+                        if (sps_queue_item_count(&q) != 0) {
+                                FAIL("queue not empty after %u bytes at %u", size, start);
+                        }
+                }
+        }
+
+        return 0;
+}
+
+static int test_peek_commit(void)
+{
+        sps_queue_t q;
+        uint8_t data[64];
+        const uint8_t *rptr;
+        uint8_t *wptr;
+        uint32_t len, i;
+
+        for (i = 0; i < sizeof(data); i++) {
+                data[i] = pattern(i);
+        }
+
+        sps_queue_init(&q, test_buf, TEST_QUEUE_SIZE, 16, 200);
+
+        /* Written data are not visible before the commit */
+        wptr = sps_queue_write_ptr(&q, &len);
+        memcpy(wptr, data, 40);
+        if (sps_queue_item_count(&q) != 0 || sps_queue_read_ptr(&q, 0, &len) != NULL) {
+                FAIL("uncommitted data visible");
+        }
+        sps_queue_write_commit(&q, 30);
+        if (sps_queue_item_count(&q) != 30) {
+                FAIL("committed %d bytes instead of 30", sps_queue_item_count(&q));
+        }
+
+        /* The rest is written again after the committed part */
+        wptr = sps_queue_write_ptr(&q, &len);
+        if (wptr != &test_buf[30] || len != TEST_QUEUE_SIZE - 30) {
+                FAIL("write pointer after a partial commit");
+        }
+        memcpy(wptr, &data[30], 34);
+        sps_queue_write_commit(&q, 34);
+
+        /* Peeking at an offset leaves the data in the queue, as notifications in flight */
+        rptr = sps_queue_read_ptr(&q, 20, &len);
+        if (rptr != &test_buf[20] || len != 44 || memcmp(rptr, &data[20], 44)) {
+                FAIL("peek at offset 20");
+        }
+        if (sps_queue_read_ptr(&q, 64, &len) != NULL || sps_queue_item_count(&q) != 64) {
+                FAIL("peek past the data");
+        }
+
+        sps_queue_read_release(&q, 20);
+        rptr = sps_queue_read_ptr(&q, 0, &len);
+        if (rptr != &test_buf[20] || len != 44 || sps_queue_item_count(&q) != 44) {
+                FAIL("release of 20 bytes");
+        }
+
+        return 0;
+}
+
+static int test_watermarks(void)
+{
+        sps_queue_t q;
+        uint8_t data[TEST_QUEUE_SIZE];
+
+        memset(data, 0, sizeof(data));
+        sps_queue_init(&q, test_buf, TEST_QUEUE_SIZE, 16, 200);
+
+        sps_queue_write_items(&q, 200, data);
+        if (sps_queue_check_almost_full(&q) || sps_queue_check_almost_empty(&q)) {
+                FAIL("watermark crossed at the high watermark");
+        }
+        sps_queue_write_items(&q, 1, data);
+        if (!sps_queue_check_almost_full(&q)) {
+                FAIL("high watermark not reported");
+        }
+        if (sps_queue_check_almost_full(&q)) {
+                FAIL("high watermark reported twice");
+        }
+
+        sps_queue_read_release(&q, 184);
+        if (sps_queue_check_almost_empty(&q)) {
+                FAIL("low watermark reported above it");
+        }
+        sps_queue_read_release(&q, 1);
+        if (!sps_queue_check_almost_empty(&q) || sps_queue_check_almost_empty(&q)) {
+                FAIL("low watermark not reported once");
+        }
+
+        return 0;
+}
+
+static void *producer(void *arg)
+{
+        sps_queue_t *q = arg;
+        uint32_t seq = 0;
+        uint32_t len, i;
+        uint8_t *ptr;
+
+        while (seq < TEST_THREAD_BYTES) {
+                ptr = sps_queue_write_ptr(q, &len);
+                if (ptr == NULL) {
+                        sched_yield();
+                        continue;
+                }
+
+                /* Serial port reads of varying size */
+                len = MIN(len, 1 + seq % 97);
+                len = MIN(len, TEST_THREAD_BYTES - seq);
+                for (i = 0; i < len; i++) {
+                        ptr[i] = pattern(seq + i);
+                }
+                sps_queue_write_commit(q, len);
+                seq += len;
+        }
+
+        return NULL;
+}
+
+static int test_threads(void)
+{
+        static uint8_t buf[TEST_QUEUE_SIZE];
+        sps_queue_t q;
+        pthread_t thread;
+        const uint8_t *ptr;
+        uint32_t seq = 0;
+        uint32_t len, i;
+
+        sps_queue_init(&q, buf, TEST_QUEUE_SIZE, 16, 200);
+        if (pthread_create(&thread, NULL, producer, &q)) {
+                FAIL("producer thread not started");
+        }
+
+        while (seq < TEST_THREAD_BYTES) {
+                ptr = sps_queue_read_ptr(&q, 0, &len);
+                if (ptr == NULL) {
+                        sched_yield();
+                        continue;
+                }
+
+                /* Notification payloads */
+                len = MIN(len, BENCH_PAYLOAD_MAX);
+                for (i = 0; i < len; i++) {
+                        if (ptr[i] != pattern(seq + i)) {
+                                pthread_join(thread, NULL);
+                                FAIL("byte %u is %02x instead of %02x", seq + i, ptr[i],
+                                                                        pattern(seq + i));
+                        }
+                }
+                sps_queue_read_release(&q, len);
+                seq += len;
+        }
+
+        pthread_join(thread, NULL);
+        if (sps_queue_item_count(&q) != 0) {
+                FAIL("%d bytes left after the producer thread", sps_queue_item_count(&q));
+        }
+
+        return 0;
+}
+
+static double now_us(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Serial port data through the legacy queue, one notification per message */
+static double bench_legacy(const uint8_t *data, uint32_t size, uint32_t read_size, int rounds,
+                                                                        uint32_t *notifications)
+{
+        static legacy_queue_t q;
+        static uint8_t dsps_data[BENCH_PAYLOAD_MAX];
+        static uint8_t ntf[BENCH_PAYLOAD_MAX];
+        volatile uint32_t sum = 0;
+        legacy_msg m;
+        uint32_t pos, len;
+        double best = 0;
+        double t;
+        int r;
+
+        for (r = 0; r < rounds; r++) {
+                *notifications = 0;
+                q.head = q.tail = 0;
+                t = now_us();
+                for (pos = 0; pos < size; pos += len) {
+                        /* Serial port read into the read buffer, then queued */
+                        len = MIN(read_size, size - pos);
+                        memcpy(dsps_data, &data[pos], len);
+                        legacy_queue_write_items(&q, len, dsps_data);
+
+                        /* BLE side keeps up, the notification is sent and its message released */
+                        while (legacy_queue_read_items(&q, &m)) {
+                                memcpy(ntf, m.data, m.size);
+                                sum += ntf[0];
+                                legacy_queue_pop_release(&q);
+                                (*notifications)++;
+                        }
+                }
+                t = now_us() - t;
+                if (r == 0 || t < best) {
+                        best = t;
+                }
+        }
+
+        return best;
+}
+
+/* Serial port data through the ring, full MTU payloads once enough data are queued */
+static double bench_ring(const uint8_t *data, uint32_t size, uint32_t read_size, int rounds,
+                                                                        uint32_t *notifications)
+{
+        static uint8_t buf[BENCH_QUEUE_SIZE];
+        static uint8_t ntf[BENCH_PAYLOAD_MAX];
+        volatile uint32_t sum = 0;
+        const uint8_t *rptr;
+        sps_queue_t q;
+        uint8_t *wptr;
+        uint32_t pos, len, n, got;
+        double best = 0;
+        double t;
+        int r;
+
+        for (r = 0; r < rounds; r++) {
+                *notifications = 0;
+                sps_queue_init(&q, buf, BENCH_QUEUE_SIZE, BENCH_QUEUE_SIZE / 10,
+                                                                BENCH_QUEUE_SIZE * 8 / 10);
+                t = now_us();
+                for (pos = 0; pos < size; pos += len) {
+                        /* Serial port read straight into the ring */
+                        wptr = sps_queue_write_ptr(&q, &len);
+                        len = MIN(len, MIN(read_size, size - pos));
+                        memcpy(wptr, &data[pos], len);
+                        sps_queue_write_commit(&q, len);
+
+                        /* Full payloads, or what is left at the end of the data */
+                        while (sps_queue_item_count(&q) >= BENCH_PAYLOAD_MAX
+                                || (pos + len == size && sps_queue_item_count(&q) > 0)) {
+                                got = 0;
+                                while (got < BENCH_PAYLOAD_MAX
+                                        && (rptr = sps_queue_read_ptr(&q, got, &n)) != NULL) {
+                                        n = MIN(n, BENCH_PAYLOAD_MAX - got);
+                                        memcpy(&ntf[got], rptr, n);
+                                        got += n;
+                                }
+                                sum += ntf[0];
+                                sps_queue_read_release(&q, got);
+                                (*notifications)++;
+                        }
+                }
+                t = now_us() - t;
+                if (r == 0 || t < best) {
+                        best = t;
+                }
+        }
+
+        return best;
+}
+
+int main(int argc, char **argv)
+{
+        static const uint32_t read_sizes[] = { 1, 16, 64, 244 };
+        uint32_t size = 1024 * 1024;
+        uint32_t ntf_legacy, ntf_ring;
+        double t_legacy, t_ring;
+        uint8_t *data;
+        int rounds = 10;
+        uint32_t i;
+        int arg;
+
+        for (arg = 1; arg < argc; arg++) {
+                if (!strcmp(argv[arg], "-size") && arg + 1 < argc) {
+                        size = strtoul(argv[++arg], NULL, 0) * 1024;
+                } else if (!strcmp(argv[arg], "-rounds") && arg + 1 < argc) {
+                        rounds = atoi(argv[++arg]);
+                } else {
+                        printf("usage: %s [-size <KB>] [-rounds <n>]\n", argv[0]);
+                        return 1;
+                }
+        }
+
+        if (test_empty_full() || test_wrap() || test_peek_commit() || test_watermarks()
+                || test_threads()) {
+                return 1;
+        }
+        printf("Test: empty/full, wrap at every offset, peek/commit, watermarks and %u MB "
+                "between two threads passed\n", TEST_THREAD_BYTES / (1024 * 1024));
+
+        data = malloc(size);
+        if (!data || size == 0 || rounds < 1) {
+                return 1;
+        }
+        for (i = 0; i < size; i++) {
+                data[i] = rand();
+        }
+
+        printf("%u KB of serial port data to notifications of up to %u bytes, best of %d rounds:\n",
+                                        size / 1024, BENCH_PAYLOAD_MAX, rounds);
+        printf("  read size   msg_queue us/MB  ntf    ring us/MB  ntf    speedup\n");
+        for (i = 0; i < sizeof(read_sizes) / sizeof(read_sizes[0]); i++) {
+                t_legacy = bench_legacy(data, size, read_sizes[i], rounds, &ntf_legacy);
+                t_ring = bench_ring(data, size, read_sizes[i], rounds, &ntf_ring);
+                printf("  %9u   %15.1f  %-7u %9.1f  %-7u %6.2fx\n", read_sizes[i],
+                        t_legacy * 1024 * 1024 / size, ntf_legacy,
+                        t_ring * 1024 * 1024 / size, ntf_ring, t_legacy / t_ring);
+        }
+
+        free(data);
+
+        return 0;
+}
@@ -0,0 +1,50 @@
+/**
+ ****************************************************************************************
+ *
+ * @file sdk_defs.h
+ *
+ * @brief Host replacement of the SDK definitions used by the DSPS host tools
+ *
+ * Copyright (c) 2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef SDK_DEFS_H_
+#define SDK_DEFS_H_
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ * The SPS queue only needs its data accesses ordered with the index accesses, which on the host
+ * is an acquire/release fence, not the full barrier that __sync_synchronize() would be
+ */
+#define __DMB()                         __atomic_thread_fence(__ATOMIC_ACQ_REL)
+#define __CLZ(x)                        ((uint32_t)__builtin_clz(x))
+
+#define __STATIC_INLINE                 static inline
+#define __UNUSED                        __attribute__((unused))
+
+#define ASSERT_WARNING(cond)            assert(cond)
+#define OPT_MEMCPY                      memcpy
+
+#endif /* SDK_DEFS_H_ */
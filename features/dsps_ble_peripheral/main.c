@@ -38,6 +38,9 @@
 #include "sys_clock_mgr.h"
 #include "sys_power_mgr.h"
 #include "sys_watchdog.h"
+#if dg_configUSE_CLI
+   #include "cli.h"
+#endif
 #if dg_configUART_ADAPTER
    #include "ad_uart.h"
 #endif
@@ -152,6 +155,11 @@ static void system_init( void *pvParameters )
         /* Initialize BLE Manager */
         ble_mgr_init();
 
+#if dg_configUSE_CLI
+        /* Initialize cli framework */
+        cli_init();
+#endif
+
         /* Start the DSPS BLE application task. */
         OS_TASK_CREATE("DSPS-BLE",                 /* The text name assigned to the task, for
                                                       debug only; not used by the kernel. */
@@ -23,8 +23,13 @@
 }
   
   async function incomingData(event){
-    // Data was received from BLE peer
-	log(ab2str(event.target.value.buffer), 'log');
+    // Data was received from BLE peer, one or more null terminated log lines
+	var lines = ab2str(event.target.value.buffer).split('\0');
+	for (var i = 0; i < lines.length; i++) {
+		if (lines[i].length) {
+			log(lines[i], 'log');
+		}
+	}
 	// Write to console for debugging
 	// console.log(event.target.value);
   }
@@ -41,6 +41,7 @@
 #include "ble_uuid.h"
 #include "osal.h"
 #include "logging.h"
+#include "mod_logging.h"
 #include "sys_watchdog.h"
 #include "ble_bufops.h"
 #include "ble_storage.h"
@@ -48,8 +49,10 @@
 
 /* Define the maximum MTU that will be used from the application */
 #define APP_MAX_MTU_SIZE                512
-/* The rate at which the device checks and send notifications */
-#define send_ntf_log_FREQUENCY_MS       OS_MS_2_TICKS(1000)
+/* Max number of log notifications in flight */
+#define LOG_NTF_WINDOW                  4
+/* Notification of the BLE task when log records are written */
+#define LOG_RING_NOTIF                  (1 << 1)
 /*
  * BLE adv demo advertising data
  */
@@ -60,10 +63,30 @@ const uint8_t adv_data[] = {
         'B','L','E',' ','L', 'o', 'g', 'g', 'i', 'n', 'g'
 };
 
-__RETAINED static OS_TIMER send_ntf_timer;
+/*
+ * Log streaming state. As many records as fit in the MTU are packed in each notification, and up to
+ * LOG_NTF_WINDOW notifications are kept in flight. Records are released from the ring once their
+ * notification has been sent, so that they are sent again if it fails.
+ */
+typedef struct {
+        uint16_t        conn_idx;               // Connection log is streamed to, BLE_CONN_IDX_INVALID if none
+        uint16_t        ntf_size;               // Max notification payload, follows the exchanged MTU
+        bool            enabled;                // Notifications enabled by the peer
+        bool            failed;                 // A notification failed, resend once none is in flight
+        uint32_t        pos;                    // Ring read cursor past the records sent
+        /* Ring read cursor past the records of each notification in flight, and their number */
+        uint32_t        tx_inflight_end[LOG_NTF_WINDOW];
+        uint16_t        tx_inflight_records[LOG_NTF_WINDOW];
+        uint8_t         tx_inflight_first;
+        uint8_t         tx_inflight_cnt;
+        uint32_t        delivered;              // Records sent since log_init()
+} log_stream_t;
+
+__RETAINED static log_stream_t log_stream;
+
+/* Notification payload being packed, copied by the BLE stack when sent */
+__RETAINED static uint8_t log_ntf_buf[APP_MAX_MTU_SIZE - 3];
 
-extern OS_QUEUE xLogQueue;                      // queue holding all the logging data
-extern  uint32_t suppressed_messages;           // variable holding the suppressed messages
 extern logging_severity_e logging_min_severity; // variable holding the current min severity
 
 /* Characteristic value */
@@ -75,6 +98,7 @@ __RETAINED ble_service_t *log_svc_hnd;
 static const char char_descr_log[]              = "Log Output";
 static const char char_descr_disc_log_cnt[]     = "Discarded Log Count";
 static const char char_descr_severity[]         = "Severity";
+static const char char_descr_delivered_cnt[]    = "Delivered Log Count";
 
 /* Callback functions */
 typedef void (* queue_get_value_cb_t) (ble_service_t *svc, uint16_t conn_idx);
@@ -87,6 +111,7 @@ typedef struct {
         queue_get_value_cb_t read_dis_cnt;
         queue_get_value_cb_t read_severity;
         queue_set_value_cb_t write_severity;
+        queue_get_value_cb_t read_delivered_cnt;
 }logging_queue_service_cb_t;
 
 typedef struct {
@@ -97,6 +122,7 @@ typedef struct {
         uint16_t                                log_char_value_ccc_h;
         uint16_t                                dis_log_cnt_value_h;
         uint16_t                                severity_char_value_h;
+        uint16_t                                delivered_cnt_value_h;
 
 }logging_queue_service_t;
 
@@ -109,7 +135,9 @@ static void log_get_char_val_cb(ble_service_t *svc, uint16_t conn_idx)
 static void dis_cnt_get_val_cb(ble_service_t *svc, uint16_t conn_idx)
 {
         logging_queue_service_t *log = (logging_queue_service_t *)svc;
-        ble_gatts_read_cfm(conn_idx, log->dis_log_cnt_value_h, ATT_ERROR_OK, sizeof(uint32_t), &suppressed_messages);
+        uint32_t dropped = log_ring_get_dropped();
+
+        ble_gatts_read_cfm(conn_idx, log->dis_log_cnt_value_h, ATT_ERROR_OK, sizeof(uint32_t), &dropped);
 }
 
 static void severity_get_val_cb(ble_service_t *svc, uint16_t conn_idx)
@@ -118,6 +146,13 @@ static void severity_get_val_cb(ble_service_t *svc, uint16_t conn_idx)
         ble_gatts_read_cfm(conn_idx, log->severity_char_value_h, ATT_ERROR_OK, sizeof(logging_severity_e), &logging_min_severity);
 }
 
+static void delivered_cnt_get_val_cb(ble_service_t *svc, uint16_t conn_idx)
+{
+        logging_queue_service_t *log = (logging_queue_service_t *)svc;
+
+        ble_gatts_read_cfm(conn_idx, log->delivered_cnt_value_h, ATT_ERROR_OK, sizeof(uint32_t), &log_stream.delivered);
+}
+
 /* Handler for write requests */
 static void severity_set_val_cb(ble_service_t *svc, uint16_t conn_idx, const uint8_t *value)
 {
@@ -133,6 +168,7 @@ static const logging_queue_service_cb_t log_callbacks = {
         .read_dis_cnt = dis_cnt_get_val_cb,
         .read_severity = severity_get_val_cb,
         .write_severity = severity_set_val_cb,
+        .read_delivered_cnt = delivered_cnt_get_val_cb,
 };
 
 /* This function is called upon write requests to CCC attribute value */
@@ -171,6 +207,9 @@ static void do_char_value_read(logging_queue_service_t *log, const ble_evt_gatts
         else if (evt->handle == log->severity_char_value_h && log->cb->read_severity) {
                 log->cb->read_severity(&log->svc, evt->conn_idx);
         }
+        else if (evt->handle == log->delivered_cnt_value_h && log->cb->read_delivered_cnt) {
+                log->cb->read_delivered_cnt(&log->svc, evt->conn_idx);
+        }
         else {
                 ble_gatts_read_cfm(evt->conn_idx, evt->handle, ATT_ERROR_READ_NOT_PERMITTED, 0, NULL);
         }
@@ -188,7 +227,7 @@ static att_error_t do_char_value_write(logging_queue_service_t *log, const ble_e
 }
 
 /* Notify the peer device that characteristic attribute value has been updated */
-bool log_notify_char_value(ble_service_t *svc, uint16_t conn_idx, uint8_t *value, uint8_t size)
+bool log_notify_char_value(ble_service_t *svc, uint16_t conn_idx, uint8_t *value, uint16_t size)
 {
         logging_queue_service_t *log = (logging_queue_service_t *) svc;
 
@@ -210,6 +249,142 @@ bool log_notify_char_value(ble_service_t *svc, uint16_t conn_idx, uint8_t *value
         return true;
 }
 
+/*
+ * Append log record to notification payload, formatted as text unless raw binary records are sent.
+ * Each line is null terminated and each raw record framed as over UART. Returns number of bytes
+ * appended, or -1 if the record does not fit, unless truncate is set.
+ */
+static int log_pack_record(uint8_t *buf, uint16_t size, const char *data, uint16_t len, bool truncate)
+{
+#if LOGGING_BINARY && LOGGING_BINARY_RAW_OUTPUT
+        if (len + 3 > size) {
+                if (!truncate) {
+                        return -1;
+                }
+                len = size - 3;
+        }
+
+        buf[0] = LOGGING_BINARY_FRAME_SYNC;
+        buf[1] = len & 0xFF;
+        buf[2] = len >> 8;
+        memcpy(&buf[3], data, len);
+
+        return len + 3;
+#elif LOGGING_BINARY
+        int n = log_record_format((char *) buf, size, data, len);
+
+        if (n >= size) {
+                return truncate ? size : -1;
+        }
+
+        return n + 1;
+#else
+        if (len > size) {
+                if (!truncate) {
+                        return -1;
+                }
+                len = size;
+                buf[len - 1] = '\0';
+                memcpy(buf, data, len - 1);
+
+                return len;
+        }
+
+        memcpy(buf, data, len);
+
+        return len;
+#endif
+}
+
+/* Send notifications of the records written, until the window is full */
+static void log_stream_send(void)
+{
+        logging_queue_service_t *log = (logging_queue_service_t *) log_svc_hnd;
+        uint16_t size = MIN(log_stream.ntf_size, sizeof(log_ntf_buf));
+        const char *data;
+        uint32_t next;
+        uint32_t pos;
+        uint16_t records;
+        uint16_t fill;
+        uint16_t len;
+        uint8_t slot;
+        int n;
+
+        if (!log_stream.enabled || log_stream.conn_idx == BLE_CONN_IDX_INVALID || log_stream.failed) {
+                return;
+        }
+
+        while (log_stream.tx_inflight_cnt < LOG_NTF_WINDOW) {
+                /* Pack records past those in flight. A record longer than a notification is truncated */
+                pos = log_stream.pos;
+                records = 0;
+                fill = 0;
+
+                for (;;) {
+                        next = pos;
+                        if (!log_ring_peek(&next, &data, &len)) {
+                                break;
+                        }
+
+                        n = log_pack_record(&log_ntf_buf[fill], size - fill, data, len, fill == 0);
+                        if (n < 0) {
+                                break;
+                        }
+
+                        fill += n;
+                        records++;
+                        pos = next;
+                }
+
+                if (!records) {
+                        return;
+                }
+
+                if (ble_gatts_send_event(log_stream.conn_idx, log->log_char_value_h,
+                                GATT_EVENT_NOTIFICATION, fill, log_ntf_buf) != BLE_STATUS_OK) {
+                        /* Try again once a notification in flight has been sent */
+                        return;
+                }
+
+                slot = (log_stream.tx_inflight_first + log_stream.tx_inflight_cnt) % LOG_NTF_WINDOW;
+                log_stream.tx_inflight_end[slot] = pos;
+                log_stream.tx_inflight_records[slot] = records;
+                log_stream.tx_inflight_cnt++;
+                log_stream.pos = pos;
+        }
+}
+
+static void log_stream_start(uint16_t conn_idx)
+{
+        uint16_t mtu = 23;
+
+        if (log_stream.conn_idx != conn_idx) {
+                ble_gattc_get_mtu(conn_idx, &mtu);
+
+                log_stream.conn_idx = conn_idx;
+                log_stream.ntf_size = mtu - 3;
+                log_stream.tx_inflight_first = 0;
+                log_stream.tx_inflight_cnt = 0;
+                log_stream.failed = false;
+        }
+
+        if (log_stream.tx_inflight_cnt == 0) {
+                log_stream.pos = log_ring_begin();
+        }
+
+        log_stream.enabled = true;
+        log_stream_send();
+}
+
+static void log_stream_stop(void)
+{
+        log_stream.conn_idx = BLE_CONN_IDX_INVALID;
+        log_stream.enabled = false;
+        log_stream.tx_inflight_first = 0;
+        log_stream.tx_inflight_cnt = 0;
+        log_stream.failed = false;
+}
+
 /*
  * This function should be called by the application as a response to write requests
  */
@@ -231,8 +406,9 @@ static void handle_read_req(ble_service_t *svc, const ble_evt_gatts_read_req_t *
          * and call the appropriate function.
          */
 
-        /* If the read is for one of the two readable characteristics */
-        if (evt->handle == log->log_char_value_h || evt->handle == log->dis_log_cnt_value_h || evt->handle == log->severity_char_value_h) {
+        /* If the read is for one of the readable characteristics */
+        if (evt->handle == log->log_char_value_h || evt->handle == log->dis_log_cnt_value_h ||
+                        evt->handle == log->severity_char_value_h || evt->handle == log->delivered_cnt_value_h) {
                 do_char_value_read(log, evt);
         /* Else if the read is for the ccc descriptor */
         } else if (evt->handle == log->log_char_value_ccc_h) {
@@ -264,11 +440,12 @@ static void handle_write_req(ble_service_t *svc, const ble_evt_gatts_write_req_t
          */
         if (evt->handle == log->log_char_value_ccc_h) {
                 status = do_char_value_ccc_write(log, evt->conn_idx, evt->offset, evt->length, evt->value);
-                // If the notifications are triggered start a timer for checking for available items in the queue
-                if(get_u16(evt->value) == GATT_CCC_NOTIFICATIONS)
-                        OS_TIMER_START(send_ntf_timer, OS_TIMER_FOREVER);
-                else
-                        OS_TIMER_STOP(send_ntf_timer, OS_TIMER_FOREVER);
+                // If the notifications are enabled start streaming the records in the ring
+                if (status == ATT_ERROR_OK && (get_u16(evt->value) & GATT_CCC_NOTIFICATIONS)) {
+                        log_stream_start(evt->conn_idx);
+                } else if (status == ATT_ERROR_OK && evt->conn_idx == log_stream.conn_idx) {
+                        log_stream.enabled = false;
+                }
                 goto done;
         }
 
@@ -290,23 +467,31 @@ done:
 static void handle_evt_send_ind(ble_service_t *svc, const ble_evt_gatts_event_sent_t *evt)
 {
         logging_queue_service_t *log = (logging_queue_service_t *) svc;
-        struct mcif_message_s *current_message;
+        uint8_t slot = log_stream.tx_inflight_first;
 
-        /* Check if the handle is the proper one and the status has no error */
-        if (evt->handle == log->log_char_value_h && evt->status)
-        {
-                if(OS_QUEUE_MESSAGES_WAITING(xLogQueue) != 0)
-                {
-                        OS_QUEUE_GET(xLogQueue, &current_message, OS_QUEUE_NO_WAIT);
-                        log_notify_char_value(log_svc_hnd, evt->conn_idx, (uint8_t*)current_message->buffer, current_message->len);
-                        OS_FREE(current_message);
-                }
-                else
-                {
-                        // If no more messages in the queue restart the timer
-                        OS_TIMER_START(send_ntf_timer, OS_TIMER_FOREVER);
-                }
+        /* Notifications are confirmed in order, release the records of the oldest one in flight */
+        if (evt->handle != log->log_char_value_h || evt->conn_idx != log_stream.conn_idx ||
+                                                                log_stream.tx_inflight_cnt == 0) {
+                return;
+        }
+
+        log_stream.tx_inflight_first = (slot + 1) % LOG_NTF_WINDOW;
+        log_stream.tx_inflight_cnt--;
+
+        if (evt->status && !log_stream.failed) {
+                log_ring_release(log_stream.tx_inflight_end[slot]);
+                log_stream.delivered += log_stream.tx_inflight_records[slot];
+        } else {
+                log_stream.failed = true;
         }
+
+        /* After a failure, send again the records not released once the window has drained */
+        if (log_stream.failed && log_stream.tx_inflight_cnt == 0) {
+                log_stream.failed = false;
+                log_stream.pos = log_ring_begin();
+        }
+
+        log_stream_send();
 }
 
 /* Function to be called after a cleanup event */
@@ -328,6 +513,7 @@ ble_service_t *log_service_init(const uint8_t *variable_value ,const logging_que
         uint16_t char_descr_log_h;
         uint16_t char_descr_disc_log_cnt_h;
         uint16_t char_descr_severity_h;
+        uint16_t char_descr_delivered_cnt_h;
 
         log_srv = (logging_queue_service_t *)OS_MALLOC(sizeof(*log_srv));
         memset(log_srv, 0, sizeof(*log_srv));
@@ -341,11 +527,11 @@ ble_service_t *log_service_init(const uint8_t *variable_value ,const logging_que
 
         /********************************* Service declaration *********************************/
         ble_uuid_from_string("00000000-1111-2222-2222-333333333333", &uuid);
-        ble_gatts_add_service(&uuid, GATT_SERVICE_PRIMARY, ble_gatts_get_num_attr(0, 3, 4));
+        ble_gatts_add_service(&uuid, GATT_SERVICE_PRIMARY, ble_gatts_get_num_attr(0, 4, 5));
 
         /******************************** 1st Characteristic declaration ********************************/
         ble_uuid_from_string("11111111-0000-0000-0000-111111111111", &uuid);
-        ble_gatts_add_characteristic(&uuid, GATT_PROP_NOTIFY, ATT_PERM_RW, LOGGING_MIN_MSG_SIZE, 0, NULL, &log_srv->log_char_value_h);
+        ble_gatts_add_characteristic(&uuid, GATT_PROP_NOTIFY, ATT_PERM_RW, sizeof(log_ntf_buf), 0, NULL, &log_srv->log_char_value_h);
 
         /* Define descriptor of type Client Characteristic Configuration (CCC) */
         ble_uuid_create16(UUID_GATT_CLIENT_CHAR_CONFIGURATION, &uuid);
@@ -371,6 +557,14 @@ ble_service_t *log_service_init(const uint8_t *variable_value ,const logging_que
         ble_uuid_create16(UUID_GATT_CHAR_USER_DESCRIPTION, &uuid);
         ble_gatts_add_descriptor(&uuid, ATT_PERM_READ, sizeof(char_descr_severity), 0, &char_descr_severity_h);
 
+        /******************************** 4th Characteristic Declaration ********************************/
+        ble_uuid_from_string("11111111-0000-0000-0000-444444444444", &uuid);
+        ble_gatts_add_characteristic(&uuid, GATT_PROP_READ, ATT_PERM_RW, 4, GATTS_FLAG_CHAR_READ_REQ, NULL, &log_srv->delivered_cnt_value_h);
+
+        /* Descriptor declaration - Characteristic User Description (CUD) */
+        ble_uuid_create16(UUID_GATT_CHAR_USER_DESCRIPTION, &uuid);
+        ble_gatts_add_descriptor(&uuid, ATT_PERM_READ, sizeof(char_descr_delivered_cnt), 0, &char_descr_delivered_cnt_h);
+
         /*
          * Register all the attribute handles so that they can be updated
          * by the BLE manager automatically.
@@ -383,10 +577,12 @@ ble_service_t *log_service_init(const uint8_t *variable_value ,const logging_que
                                         &char_descr_disc_log_cnt_h,     // Discarded log count user descriptor handle
                                         &log_srv->severity_char_value_h,// Severity characteristic handle
                                         &char_descr_severity_h,         // Severity user descriptor handle
+                                        &log_srv->delivered_cnt_value_h,// Delivered log count handle
+                                        &char_descr_delivered_cnt_h,    // Delivered log count user descriptor handle
                                         0);                             // Ending byte
 
         /* Calculate the last attribute handle of the BLE service */
-        log_srv->svc.end_h = log_srv->svc.start_h + ble_gatts_get_num_attr(0, 3, 4);
+        log_srv->svc.end_h = log_srv->svc.start_h + ble_gatts_get_num_attr(0, 4, 5);
 
         /* Set default attribute values TODO*/
         //ble_gatts_set_value(log_srv->log_char_value_h, 1, variable_value);
@@ -397,6 +593,7 @@ ble_service_t *log_service_init(const uint8_t *variable_value ,const logging_que
         ble_gatts_set_value(char_descr_log_h,  sizeof(char_descr_log), char_descr_log);
         ble_gatts_set_value(char_descr_disc_log_cnt_h, sizeof(char_descr_disc_log_cnt), char_descr_disc_log_cnt);
         ble_gatts_set_value(char_descr_severity_h, sizeof(char_descr_severity), char_descr_severity);
+        ble_gatts_set_value(char_descr_delivered_cnt_h, sizeof(char_descr_delivered_cnt), char_descr_delivered_cnt);
 
         /* Register the BLE service in BLE framework */
         ble_service_add(&log_srv->svc);
@@ -412,8 +609,10 @@ static void handle_evt_gap_connected(ble_evt_gap_connected_t *evt)
 
 static void handle_evt_gap_disconnected(ble_evt_gap_disconnected_t *evt)
 {
-        // Stop the notification timer
-        OS_TIMER_STOP(send_ntf_timer, OS_TIMER_FOREVER);
+        // Stop streaming, records not sent are kept in the ring for the next connection
+        if (evt->conn_idx == log_stream.conn_idx) {
+                log_stream_stop();
+        }
         // Restart advertising
         ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
 }
@@ -423,27 +622,12 @@ static void handle_evt_gap_adv_completed(ble_evt_gap_adv_completed_t *evt)
 
 }
 
-static void send_ntf_timer_cb(OS_TIMER timer)
+static void handle_evt_gattc_mtu_changed(ble_evt_gattc_mtu_changed_t *evt)
 {
-        struct mcif_message_s *current_message = NULL;
-        uint8_t conn_dev_cnt = 0;
-        uint16_t *conn_dev;
-        // Get the current established connections
-        ble_gap_get_connected(&conn_dev_cnt, &conn_dev);
-        // Check if the device is connected and if there are messages in the queue
-        if (conn_dev_cnt && OS_QUEUE_MESSAGES_WAITING(xLogQueue) != 0){
-                OS_QUEUE_GET(xLogQueue, &current_message, OS_QUEUE_NO_WAIT);
-                // Send the first notification message, the rest will be send out from the completion handler
-                log_notify_char_value(log_svc_hnd, conn_dev[conn_dev_cnt-1], (uint8_t*)current_message->buffer, current_message->len);
-                OS_FREE(current_message);
-        }
-        else
-        {
-                OS_TIMER_START(send_ntf_timer, OS_TIMER_FOREVER);
+        if (evt->conn_idx == log_stream.conn_idx) {
+                log_stream.ntf_size = evt->mtu - 3;
+                log_stream_send();
         }
-
-        if(conn_dev)
-                OS_FREE(conn_dev);
 }
 
 void queued_ble_task( void *pvParameters )
@@ -475,9 +659,9 @@ void queued_ble_task( void *pvParameters )
         /* Start advertising */
         ble_gap_adv_start(GAP_CONN_MODE_UNDIRECTED);
 
-        // Create timer for checking available entries in the queue, timer starts when notifications are enabled
-        send_ntf_timer = OS_TIMER_CREATE("ntf_timer", send_ntf_log_FREQUENCY_MS, OS_TIMER_FAIL, (void *) OS_GET_CURRENT_TASK(), send_ntf_timer_cb);
-        OS_ASSERT(send_ntf_timer);
+        // Get notified of the records written in the ring, sent while notifications are enabled
+        log_stream_stop();
+        log_ring_set_consumer(OS_GET_CURRENT_TASK(), LOG_RING_NOTIF);
 
         for( ;; ){
 
@@ -520,6 +704,9 @@ void queued_ble_task( void *pvParameters )
                         case BLE_EVT_GAP_ADV_COMPLETED:
                                 handle_evt_gap_adv_completed((ble_evt_gap_adv_completed_t *)hdr);
                                 break;
+                        case BLE_EVT_GATTC_MTU_CHANGED:
+                                handle_evt_gattc_mtu_changed((ble_evt_gattc_mtu_changed_t *) hdr);
+                                break;
                         default:
                                 ble_handle_event_default(hdr);
                                 break;
@@ -533,6 +720,10 @@ no_event:
                                 OS_TASK_NOTIFY(OS_GET_CURRENT_TASK(), BLE_APP_NOTIFY_MASK, eSetBits);
                         }
                 }
+
+                if (notif & LOG_RING_NOTIF) {
+                        log_stream_send();
+                }
         }
 }
 
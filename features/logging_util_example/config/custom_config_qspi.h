@@ -105,7 +105,9 @@
 #define LOGGING_MIN_DEFAULT_SEVERITY            LOG_DEBUG       // This is the default minimum severity level (if not changed in runtime using
 
 #define LOGGING_MIN_MSG_SIZE                    100
-#define LOGGING_QUEUE_LENGTH                    12              // The amount of messages that will be pushed into the queue before discarding additional messages
+#define LOGGING_RING_SIZE                       2048            // Size in bytes of the ring holding the log records, additional messages are discarded when full
+#define LOGGING_BINARY                          0               // Store format string address and arguments instead of the formatted line (see mod_logging.h)
+#define LOGGING_BINARY_RAW_OUTPUT               0               // Send binary records as they are, to be decoded on the host by logging_host/log_decode
 #endif
 
 /* Include bsp default values */
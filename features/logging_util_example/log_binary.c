@@ -0,0 +1,370 @@
+/**
+ ****************************************************************************************
+ *
+ * @file log_binary.c
+ *
+ * @brief Binary encoding of log line arguments
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_binary.h"
+
+/* Conversion specification of a format string */
+typedef struct {
+        const char *start;      /* First character after '%' */
+        const char *end;        /* Conversion character */
+        uint8_t stars;          /* Number of '*' widths and precisions */
+        bool wide;              /* 64-bit integer (ll or j length modifier) */
+        bool lng;               /* long integer (l, z or t length modifier) */
+} conv_spec_t;
+
+static const char *parse_spec(const char *p, conv_spec_t *spec)
+{
+        memset(spec, 0, sizeof(*spec));
+        spec->start = p;
+
+        for (; *p; p++) {
+                switch (*p) {
+                case '-': case '+': case ' ': case '#': case '.':
+                case '0': case '1': case '2': case '3': case '4':
+                case '5': case '6': case '7': case '8': case '9':
+                case 'h':
+                case 'L':
+                        break;
+                case '*':
+                        spec->stars++;
+                        break;
+                case 'l':
+                        spec->wide = spec->lng;
+                        spec->lng = true;
+                        break;
+                case 'j':
+                        spec->wide = true;
+                        break;
+                case 'z':
+                case 't':
+                        spec->lng = true;
+                        break;
+                default:
+                        spec->end = p;
+                        return p;
+                }
+        }
+
+        /* Incomplete specification at end of string */
+        spec->end = p;
+
+        return NULL;
+}
+
+static void put_bytes(uint8_t *buf, size_t size, size_t *len, const void *data, size_t n)
+{
+        /* Truncated encoding is a prefix of the whole one, cut within the last argument */
+        if (*len < size) {
+                memcpy(buf + *len, data, (n < size - *len) ? n : size - *len);
+        }
+
+        *len += n;
+}
+
+static void put_uint(uint8_t *buf, size_t size, size_t *len, uint64_t v)
+{
+        do {
+                uint8_t b = (v & 0x7F) | ((v > 0x7F) ? 0x80 : 0);
+
+                put_bytes(buf, size, len, &b, 1);
+                v >>= 7;
+        } while (v);
+}
+
+static void put_int(uint8_t *buf, size_t size, size_t *len, int64_t v)
+{
+        put_uint(buf, size, len, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+size_t log_binary_encode(uint8_t *buf, size_t size, const char *fmt, va_list args)
+{
+        conv_spec_t spec;
+        size_t len = 0;
+        const char *p;
+        uint8_t i;
+
+        for (p = fmt; (p = strchr(p, '%')) && parse_spec(p + 1, &spec); p = spec.end + 1) {
+                for (i = 0; i < spec.stars; i++) {
+                        put_int(buf, size, &len, va_arg(args, int));
+                }
+
+                switch (*spec.end) {
+                case '%':
+                        break;
+                case 'd':
+                case 'i':
+                        put_int(buf, size, &len, spec.wide ? va_arg(args, long long) :
+                                        spec.lng ? va_arg(args, long) : va_arg(args, int));
+                        break;
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X':
+                        put_uint(buf, size, &len, spec.wide ? va_arg(args, unsigned long long) :
+                                spec.lng ? va_arg(args, unsigned long) : va_arg(args, unsigned));
+                        break;
+                case 'c':
+                        put_uint(buf, size, &len, (uint8_t) va_arg(args, int));
+                        break;
+                case 'p':
+                        put_uint(buf, size, &len, (uintptr_t) va_arg(args, void *));
+                        break;
+                case 's':
+                {
+                        const char *s = va_arg(args, const char *);
+                        uint8_t n = s ? strnlen(s, UINT8_MAX) : 0;
+
+                        put_bytes(buf, size, &len, &n, 1);
+                        put_bytes(buf, size, &len, s, n);
+                        break;
+                }
+                case 'f': case 'F': case 'e': case 'E':
+                case 'g': case 'G': case 'a': case 'A':
+                {
+                        double d = va_arg(args, double);
+
+                        put_bytes(buf, size, &len, &d, sizeof(d));
+                        break;
+                }
+                case 'n':
+                        (void) va_arg(args, void *);
+                        break;
+                default:
+                        /* Unknown conversion, the type of its argument is unknown too */
+                        return len;
+                }
+        }
+
+        return len;
+}
+
+static bool get_uint(const uint8_t **args, const uint8_t *end, uint64_t *v)
+{
+        unsigned shift = 0;
+
+        *v = 0;
+
+        while (*args < end && shift < 64) {
+                uint8_t b = *(*args)++;
+
+                *v |= (uint64_t) (b & 0x7F) << shift;
+                if (!(b & 0x80)) {
+                        return true;
+                }
+                shift += 7;
+        }
+
+        return false;
+}
+
+static bool get_int(const uint8_t **args, const uint8_t *end, int64_t *v)
+{
+        uint64_t u;
+
+        if (!get_uint(args, end, &u)) {
+                return false;
+        }
+
+        *v = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+
+        return true;
+}
+
+static void put_text(char *buf, size_t size, int *len, const char *fmt, ...)
+{
+        size_t avail = ((size_t) *len < size) ? size - *len : 0;
+        va_list args;
+        int n;
+
+        va_start(args, fmt);
+        n = vsnprintf(avail ? buf + *len : NULL, avail, fmt, args);
+        va_end(args);
+
+        if (n > 0) {
+                *len += n;
+        }
+}
+
+int log_binary_format(char *buf, size_t size, const char *fmt, const uint8_t *args, size_t len)
+{
+        const uint8_t *end = args + len;
+        conv_spec_t spec;
+        char conv[32];
+        const char *p;
+        int out = 0;
+
+        if (size) {
+                buf[0] = '\0';
+        }
+
+        for (p = fmt; *p; p = spec.end + 1) {
+                const char *s;
+                size_t n = 0;
+
+                /* Literal text up to next conversion */
+                s = strchr(p, '%');
+                if (!s) {
+                        put_text(buf, size, &out, "%s", p);
+                        break;
+                }
+                put_text(buf, size, &out, "%.*s", (int) (s - p), p);
+
+                if (!parse_spec(s + 1, &spec)) {
+                        break;
+                }
+
+                /*
+                 * Rebuild the specification for the decoding side: '*' replaced by the value of
+                 * its argument, length modifiers dropped in favor of a fixed argument type.
+                 */
+                conv[n++] = '%';
+                for (s = spec.start; s < spec.end && n < sizeof(conv) - 24; s++) {
+                        int64_t v;
+
+                        if (*s == '*') {
+                                if (!get_int(&args, end, &v)) {
+                                        return out;
+                                }
+                                n += snprintf(conv + n, sizeof(conv) - n, "%d", (int) v);
+                        } else if (!strchr("hlLjzt", *s)) {
+                                conv[n++] = *s;
+                        }
+                }
+
+                switch (*spec.end) {
+                case '%':
+                        put_text(buf, size, &out, "%%");
+                        break;
+                case 'd':
+                case 'i':
+                {
+                        int64_t v;
+
+                        if (!get_int(&args, end, &v)) {
+                                return out;
+                        }
+                        memcpy(conv + n, "lld", 4);
+                        put_text(buf, size, &out, conv, (long long) v);
+                        break;
+                }
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X':
+                {
+                        uint64_t v;
+
+                        if (!get_uint(&args, end, &v)) {
+                                return out;
+                        }
+                        conv[n++] = 'l';
+                        conv[n++] = 'l';
+                        conv[n++] = *spec.end;
+                        conv[n] = '\0';
+                        put_text(buf, size, &out, conv, (unsigned long long) v);
+                        break;
+                }
+                case 'c':
+                case 'p':
+                {
+                        uint64_t v;
+
+                        if (!get_uint(&args, end, &v)) {
+                                return out;
+                        }
+                        if (*spec.end == 'c') {
+                                memcpy(conv + n, "c", 2);
+                                put_text(buf, size, &out, conv, (int) v);
+                        } else {
+                                /* Pointers are printed as the target does, whatever the host */
+                                memcpy(conv + n, "#lx", 4);
+                                put_text(buf, size, &out, conv, (unsigned long) v);
+                        }
+                        break;
+                }
+                case 's':
+                {
+                        uint8_t slen;
+                        int prec;
+                        char *dot;
+
+                        if ((args >= end) || (end - args < 1 + *args)) {
+                                return out;
+                        }
+                        slen = *args++;
+
+                        /*
+                         * String is not null terminated in the record, it is printed in place with
+                         * its length as precision, or the precision of the format if smaller
+                         */
+                        prec = slen;
+                        conv[n] = '\0';
+                        dot = strchr(conv, '.');
+                        if (dot) {
+                                int v = atoi(dot + 1);
+
+                                if (v >= 0 && v < prec) {
+                                        prec = v;
+                                }
+                                n = dot - conv;
+                        }
+                        memcpy(conv + n, ".*s", 4);
+                        put_text(buf, size, &out, conv, prec, (const char *) args);
+                        args += slen;
+                        break;
+                }
+                case 'f': case 'F': case 'e': case 'E':
+                case 'g': case 'G': case 'a': case 'A':
+                {
+                        double d;
+
+                        if (end - args < (int) sizeof(d)) {
+                                return out;
+                        }
+                        memcpy(&d, args, sizeof(d));
+                        args += sizeof(d);
+                        conv[n++] = *spec.end;
+                        conv[n] = '\0';
+                        put_text(buf, size, &out, conv, d);
+                        break;
+                }
+                case 'n':
+                        break;
+                default:
+                        return out;
+                }
+        }
+
+        return out;
+}
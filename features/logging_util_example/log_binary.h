@@ -0,0 +1,76 @@
+/**
+ ****************************************************************************************
+ *
+ * @file log_binary.h
+ *
+ * @brief Binary encoding of log line arguments
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef LOG_BINARY_H_
+#define LOG_BINARY_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Arguments of a log line are stored in the order of the conversions of its format string.
+ * Integers (including '*' widths and precisions, characters and pointers) are stored as LEB128
+ * variable length integers, signed ones zigzag encoded, so that small values take a single byte.
+ * Floating point values are stored as 8-byte doubles, strings as a length byte followed by up to
+ * 255 characters. The format string itself is not part of the encoding; as it is needed again to
+ * decode the arguments, it must be constant (e.g. a string literal).
+ */
+
+/**
+ * \brief Encode arguments of log line
+ *
+ * \param [out] buf  buffer for encoded arguments
+ * \param [in]  size size of buffer
+ * \param [in]  fmt  printf() format string
+ * \param [in]  args arguments
+ *
+ * \return length of encoded arguments; if larger than size, arguments have been truncated
+ *
+ */
+size_t log_binary_encode(uint8_t *buf, size_t size, const char *fmt, va_list args);
+
+/**
+ * \brief Format log line from encoded arguments
+ *
+ * Decoding stops at the first argument which is missing or truncated.
+ *
+ * \param [out] buf  buffer for null terminated line
+ * \param [in]  size size of buffer
+ * \param [in]  fmt  format string used to encode arguments
+ * \param [in]  args encoded arguments
+ * \param [in]  len  length of encoded arguments
+ *
+ * \return length of line, which has been truncated if not less than size (as snprintf())
+ *
+ */
+int log_binary_format(char *buf, size_t size, const char *fmt, const uint8_t *args, size_t len);
+
+#endif /* LOG_BINARY_H_ */
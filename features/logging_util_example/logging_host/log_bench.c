@@ -0,0 +1,365 @@
+/**
+ ****************************************************************************************
+ *
+ * @file log_bench.c
+ *
+ * @brief Host benchmark of the log record ring against the original queue of messages
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Measures the time spent in log_printf_raw() by the caller, for the log record ring of
+ * mod_logging.c and for the original path, which allocated each message from the heap and
+ * queued a pointer to it (kept below as legacy_log_printf_raw()). Lines are consumed in bursts,
+ * as the BLE or UART transport would do, and consumer time is not included. Formatting alone is
+ * measured as well, and the cost of each path above it is reported as overhead. Paths are run in
+ * alternating rounds and the fastest round of each is kept. Host heap and queue are much faster
+ * than those of the target, so the gap on target is larger than reported here.
+ *
+ * Build with -DLOGGING_BINARY=1 to benchmark binary logging, which stores the arguments of the
+ * line instead of formatting it. The average record length is reported as well.
+ *
+ * The ring is also checked with several producer threads logging at the same time as the
+ * consumer: every record must be intact and in order per thread, and records received plus
+ * records dropped must add up to records logged.
+ *
+ * Build with:
+ *      gcc -O2 -I. -I.. -o log_bench log_bench.c ../mod_logging.c ../log_binary.c -lpthread
+ *
+ * Run examples:
+ *      ./log_bench                     (100000 lines, consumed in bursts of 8)
+ *      ./log_bench -burst 32 -threads 4
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "osal.h"
+#include "sdk_defs.h"
+#include "logging.h"
+#include "mod_logging.h"
+
+/* Line logged by the tasks of the example, as expanded by log_printf() */
+#define BENCH_FMT       "[%lu] %c %d Task %d is running, place some extra characters for fun " \
+                        "current counter value %d.\n\r"
+
+uint32_t bench_tick_count;
+
+/* Original path: message allocated from the heap, pointer queued */
+static struct mcif_message_s *legacy_queue[LOGGING_QUEUE_LENGTH];
+static unsigned legacy_queue_head;
+static unsigned legacy_queue_tail;
+static uint32_t suppressed_messages;
+
+static unsigned legacy_spaces_available(void)
+{
+        return LOGGING_QUEUE_LENGTH - (legacy_queue_head - legacy_queue_tail);
+}
+
+static bool legacy_queue_put(struct mcif_message_s *msg)
+{
+        OS_ENTER_CRITICAL_SECTION();
+        if (!legacy_spaces_available()) {
+                OS_LEAVE_CRITICAL_SECTION();
+                return false;
+        }
+        legacy_queue[legacy_queue_head++ % LOGGING_QUEUE_LENGTH] = msg;
+        OS_LEAVE_CRITICAL_SECTION();
+
+        return true;
+}
+
+static void legacy_log_printf_raw(const char *fmt, ...)
+{
+        va_list args;
+        int n;
+        struct mcif_message_s *msg;
+
+        if (legacy_spaces_available() == 0) {
+                OS_ENTER_CRITICAL_SECTION();
+                suppressed_messages++;
+                OS_LEAVE_CRITICAL_SECTION();
+                return;
+        }
+
+        msg = OS_MALLOC(sizeof(struct mcif_message_s) + LOGGING_MIN_MSG_SIZE);
+
+        va_start(args, fmt);
+        n = vsnprintf(msg->buffer, LOGGING_MIN_MSG_SIZE, fmt, args);
+        va_end(args);
+
+        if (n >= LOGGING_MIN_MSG_SIZE) {
+                OS_FREE(msg);
+                msg = OS_MALLOC(sizeof(struct mcif_message_s) + n + 1);
+                va_start(args, fmt);
+                vsnprintf(msg->buffer, n + 1, fmt, args);
+                va_end(args);
+        }
+        msg->len = n + 1;
+
+        if (!legacy_queue_put(msg)) {
+                OS_FREE(msg);
+                OS_ENTER_CRITICAL_SECTION();
+                suppressed_messages++;
+                OS_LEAVE_CRITICAL_SECTION();
+        }
+}
+
+static size_t legacy_drain(void)
+{
+        size_t bytes = 0;
+
+        while (legacy_queue_tail != legacy_queue_head) {
+                struct mcif_message_s *msg = legacy_queue[legacy_queue_tail++ % LOGGING_QUEUE_LENGTH];
+
+                bytes += msg->len;
+                OS_FREE(msg);
+        }
+
+        return bytes;
+}
+
+static size_t ring_drain(void)
+{
+        uint32_t pos = log_ring_begin();
+        const char *data;
+        uint16_t len;
+        size_t bytes = 0;
+
+        while (log_ring_peek(&pos, &data, &len)) {
+                bytes += len;
+        }
+        log_ring_release(pos);
+
+        return bytes;
+}
+
+/* Formatting only, as a baseline */
+static void format_only(const char *fmt, ...)
+{
+        static char buffer[LOGGING_MIN_MSG_SIZE];
+        va_list args;
+
+        va_start(args, fmt);
+        vsnprintf(buffer, sizeof(buffer), fmt, args);
+        va_end(args);
+
+        __asm__ volatile ("" : : "r" (buffer) : "memory");
+}
+
+static size_t format_drain(void)
+{
+        return 0;
+}
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double bench(void (*log)(const char *, ...), size_t (*drain)(void), int count, int burst,
+                                                                                size_t *bytes)
+{
+        uint64_t ns = 0;
+        int i, j;
+
+        *bytes = 0;
+
+        for (i = 0; i < count; i += burst) {
+                uint64_t start = now_ns();
+
+                for (j = 0; j < burst; j++) {
+                        log(BENCH_FMT, (unsigned long) bench_tick_count, 'D', j % 5, j % 5, i + j);
+                }
+                ns += now_ns() - start;
+
+                *bytes += drain();
+        }
+
+        return (double) ns / count;
+}
+
+/* Multi-producer check */
+typedef struct {
+        int id;
+        int count;
+} producer_t;
+
+static int producers_done;
+
+static void *producer(void *arg)
+{
+        const producer_t *p = arg;
+        int i;
+
+        for (i = 0; i < p->count; i++) {
+                log_printf_raw("%d %d %s", p->id, i, (i & 7) ? "" :
+                                        "with some padding to vary the length of records");
+
+                /* Let the consumer and other producers run, even on a single CPU */
+                if ((i & 15) == 15) {
+                        sched_yield();
+                }
+        }
+
+        __atomic_fetch_add(&producers_done, 1, __ATOMIC_RELEASE);
+
+        return NULL;
+}
+
+static bool check_threads(int threads, int count)
+{
+        pthread_t tid[threads];
+        producer_t p[threads];
+        int next[threads];
+        uint32_t received = 0;
+        uint32_t pos;
+        const char *data;
+        uint16_t len;
+        bool done = false;
+        int i;
+
+        log_init();
+        producers_done = 0;
+
+        for (i = 0; i < threads; i++) {
+                p[i].id = i;
+                p[i].count = count;
+                next[i] = 0;
+                pthread_create(&tid[i], NULL, producer, &p[i]);
+        }
+
+        while (!done) {
+                /* Drain once more after all producers have finished */
+                done = (__atomic_load_n(&producers_done, __ATOMIC_ACQUIRE) == threads);
+                pos = log_ring_begin();
+
+                while (log_ring_peek(&pos, &data, &len)) {
+                        const char *line = data;
+                        int id, seq;
+#if LOGGING_BINARY
+                        char text[LOGGING_MAX_MSG_SIZE];
+
+                        log_record_format(text, sizeof(text), data, len);
+                        line = text;
+#else
+                        if (len != strlen(data) + 1) {
+                                printf("Corrupted record\r\n");
+                                return false;
+                        }
+#endif
+
+                        /* Suppressed messages reports are not checked */
+                        if (line[0] == '[') {
+                                continue;
+                        }
+
+                        if ((sscanf(line, "%d %d", &id, &seq) != 2) || (id < 0) ||
+                                                        (id >= threads) || (seq < next[id])) {
+                                printf("Unexpected record: %s\r\n", line);
+                                return false;
+                        }
+
+                        next[id] = seq + 1;
+                        received++;
+                        log_ring_release(pos);
+                }
+
+                sched_yield();
+        }
+
+        for (i = 0; i < threads; i++) {
+                pthread_join(tid[i], NULL);
+        }
+
+        printf("threads  %d x %d lines: %u received, %u dropped\r\n", threads, count, received,
+                                                                        log_ring_get_dropped());
+
+        return received + log_ring_get_dropped() == (uint32_t) (threads * count);
+}
+
+int main(int argc, char *argv[])
+{
+        int count = 100000;
+        int burst = 8;
+        int threads = 4;
+        int rounds = 5;
+        double format_ns = 1e9, queue_ns = 1e9, ring_ns = 1e9;
+        size_t queue_bytes, ring_bytes;
+        int i;
+
+        for (i = 1; i < argc - 1; i += 2) {
+                if (!strcmp(argv[i], "-n")) {
+                        count = atoi(argv[i + 1]);
+                } else if (!strcmp(argv[i], "-burst")) {
+                        burst = atoi(argv[i + 1]);
+                } else if (!strcmp(argv[i], "-threads")) {
+                        threads = atoi(argv[i + 1]);
+                } else if (!strcmp(argv[i], "-rounds")) {
+                        rounds = atoi(argv[i + 1]);
+                } else {
+                        break;
+                }
+        }
+
+        if ((i < argc) || (count <= 0) || (burst <= 0) || (threads <= 0) || (rounds <= 0)) {
+                printf("usage: log_bench [-n lines] [-burst lines] [-threads producers] "
+                                                                        "[-rounds rounds]\r\n");
+                return 1;
+        }
+
+        log_init();
+
+        for (i = 0; i < rounds; i++) {
+                format_ns = MIN(format_ns, bench(format_only, format_drain, count, burst,
+                                                                                &queue_bytes));
+                queue_ns = MIN(queue_ns, bench(legacy_log_printf_raw, legacy_drain, count,
+                                                MIN(burst, LOGGING_QUEUE_LENGTH), &queue_bytes));
+                ring_ns = MIN(ring_ns, bench(log_printf_raw, ring_drain, count, burst,
+                                                                                &ring_bytes));
+        }
+
+        printf("format   %8.1f ns/call\r\n", format_ns);
+        printf("queue    %8.1f ns/call  %8.1f ns overhead  %6.1f bytes/line\r\n", queue_ns,
+                                        queue_ns - format_ns, (double) queue_bytes / count);
+        printf("%-8s %8.1f ns/call  %8.1f ns overhead  %6.1f bytes/line\r\n",
+                                        LOGGING_BINARY ? "binary" : "ring", ring_ns,
+                                        ring_ns - format_ns, (double) ring_bytes / count);
+
+        if (suppressed_messages || log_ring_get_dropped()) {
+                printf("Lines dropped: queue %u, ring %u\r\n", suppressed_messages,
+                                                                        log_ring_get_dropped());
+        }
+
+        return check_threads(threads, count) ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/**
+ ****************************************************************************************
+ *
+ * @file log_decode.c
+ *
+ * @brief Host decoder of binary log records
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Rebuilds the log lines of an application built with LOGGING_BINARY and
+ * LOGGING_BINARY_RAW_OUTPUT set, from the UART output captured to a file (or piped from a serial
+ * terminal program). Each record holds the address of its format string, which is looked up in
+ * the sections of the ELF file of the application, so the ELF file must be that of the running
+ * firmware. Data between records, e.g. output of the boot loader, are skipped.
+ *
+ * Build with:
+ *      gcc -O2 -I.. -o log_decode log_decode.c ../log_binary.c
+ *
+ * Run examples:
+ *      ./log_decode logging_util_example.elf capture.bin
+ *      cat /dev/ttyUSB0 | ./log_decode logging_util_example.elf
+ */
+
+#include <elf.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_binary.h"
+
+/* As LOGGING_BINARY_FRAME_SYNC in mod_logging.h */
+#define FRAME_SYNC      0x1E
+
+/* Longest record accepted, any longer length is taken as a false sync byte */
+#define FRAME_MAX_LEN   1024
+
+static uint8_t *elf;
+static size_t elf_size;
+
+static bool load_elf(const char *path)
+{
+        const Elf32_Ehdr *ehdr;
+        FILE *f = fopen(path, "rb");
+
+        if (!f) {
+                perror(path);
+                return false;
+        }
+
+        fseek(f, 0, SEEK_END);
+        elf_size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        elf = malloc(elf_size);
+
+        if (!elf || fread(elf, 1, elf_size, f) != elf_size) {
+                fprintf(stderr, "%s: read error\n", path);
+                fclose(f);
+                return false;
+        }
+        fclose(f);
+
+        ehdr = (const Elf32_Ehdr *) elf;
+        if ((elf_size < sizeof(*ehdr)) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+                                                (ehdr->e_ident[EI_CLASS] != ELFCLASS32) ||
+                                                (ehdr->e_ident[EI_DATA] != ELFDATA2LSB) ||
+                                                (ehdr->e_shoff + (size_t) ehdr->e_shnum *
+                                                        sizeof(Elf32_Shdr) > elf_size)) {
+                fprintf(stderr, "%s: not a 32-bit little endian ELF file\n", path);
+                return false;
+        }
+
+        return true;
+}
+
+/* Find string at given address in the loaded sections of the application */
+static const char *find_string(uint32_t addr)
+{
+        const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *) elf;
+        const Elf32_Shdr *shdr = (const Elf32_Shdr *) (elf + ehdr->e_shoff);
+        int i;
+
+        for (i = 0; i < ehdr->e_shnum; i++) {
+                const char *s;
+
+                if (!(shdr[i].sh_flags & SHF_ALLOC) || (shdr[i].sh_type == SHT_NOBITS) ||
+                                (addr < shdr[i].sh_addr) ||
+                                (addr - shdr[i].sh_addr >= shdr[i].sh_size) ||
+                                (shdr[i].sh_offset + shdr[i].sh_size > elf_size)) {
+                        continue;
+                }
+
+                s = (const char *) elf + shdr[i].sh_offset + (addr - shdr[i].sh_addr);
+
+                /* String must be terminated within the section */
+                if (memchr(s, '\0', shdr[i].sh_size - (addr - shdr[i].sh_addr))) {
+                        return s;
+                }
+        }
+
+        return NULL;
+}
+
+static void decode_record(const uint8_t *data, size_t len)
+{
+        char line[1024];
+        const char *fmt;
+        uint32_t addr;
+
+        addr = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+
+        fmt = find_string(addr);
+        if (!fmt) {
+                printf("<unknown format string at 0x%08x>\n", addr);
+                return;
+        }
+
+        log_binary_format(line, sizeof(line), fmt, data + sizeof(addr), len - sizeof(addr));
+        fputs(line, stdout);
+
+        /* Truncated record */
+        if (!line[0] || (line[strlen(line) - 1] != '\n')) {
+                putchar('\n');
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        static uint8_t record[FRAME_MAX_LEN];
+        FILE *in = stdin;
+        unsigned records = 0;
+        unsigned skipped = 0;
+        int c;
+
+        if ((argc < 2) || (argc > 3)) {
+                fprintf(stderr, "usage: log_decode <application.elf> [capture]\n");
+                return 1;
+        }
+
+        if (!load_elf(argv[1])) {
+                return 1;
+        }
+
+        if ((argc == 3) && !(in = fopen(argv[2], "rb"))) {
+                perror(argv[2]);
+                return 1;
+        }
+
+        while ((c = fgetc(in)) != EOF) {
+                int lo, hi;
+                size_t len;
+
+                if (c != FRAME_SYNC) {
+                        skipped++;
+                        continue;
+                }
+
+                lo = fgetc(in);
+                hi = fgetc(in);
+                if ((lo == EOF) || (hi == EOF)) {
+                        break;
+                }
+
+                len = lo | (hi << 8);
+                if ((len < sizeof(uint32_t)) || (len > sizeof(record))) {
+                        skipped += 3;
+                        continue;
+                }
+
+                if (fread(record, 1, len, in) != len) {
+                        break;
+                }
+
+                decode_record(record, len);
+                records++;
+        }
+
+        fflush(stdout);
+        fprintf(stderr, "%u records, %u bytes skipped\n", records, skipped);
+
+        return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ ****************************************************************************************
+ *
+ * @file logging.h
+ *
+ * @brief Host replacement of the SDK logging API, configured as the logging example
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef LOGGING_H_
+#define LOGGING_H_
+
+#include <stdint.h>
+
+#define LOGGING_ENABLED
+#define LOGGING_MODE_QUEUE
+
+typedef enum {
+        LOG_DEBUG,
+        LOG_NOTICE,
+        LOG_WARNING,
+        LOG_ERROR,
+        LOG_CRITICAL,
+} logging_severity_e;
+
+#define LOGGING_MIN_COMPILED_SEVERITY           LOG_DEBUG
+#define LOGGING_MIN_DEFAULT_SEVERITY            LOG_DEBUG
+#define LOGGING_MIN_MSG_SIZE                    100
+#define LOGGING_QUEUE_LENGTH                    12
+
+#define LOGGING_SUPPRESSED_COUNT_ENABLE         1
+#define LOGGING_SUPPRESSED_MIN_COUNT            1
+#define LOGGING_SUPPRESSED_SEVERITY             LOG_WARNING
+#define LOGGING_SUPPRESSED_TAG                  0
+#define LOGGING_SUPPRESSED_MSG_TMPL             "Suppressed %lu messages"
+
+/* Message of the queue used before the log record ring */
+struct mcif_message_s {
+        uint16_t len;
+        char buffer[];
+};
+
+extern const char logging_severity_chars[];
+extern logging_severity_e logging_min_severity;
+
+void log_init(void);
+void log_set_severity(logging_severity_e severity);
+void log_printf_raw(const char *fmt, ...);
+
+#endif /* LOGGING_H_ */
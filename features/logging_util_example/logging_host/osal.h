@@ -0,0 +1,63 @@
+/**
+ ****************************************************************************************
+ *
+ * @file osal.h
+ *
+ * @brief Host replacement of the OS abstraction layer used by the logging benchmark
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef OSAL_H_
+#define OSAL_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+typedef void *OS_TASK;
+typedef uint32_t OS_TICK_TIME;
+
+/* Incremented on every read, so that consecutive log lines differ */
+extern uint32_t bench_tick_count;
+
+#define OS_GET_TICK_COUNT()             (bench_tick_count++)
+
+#define OS_MALLOC(size)                 malloc(size)
+#define OS_FREE(ptr)                    free(ptr)
+
+/* Critical sections only matter for the old path, which is benchmarked single threaded */
+#define OS_ENTER_CRITICAL_SECTION()     __asm__ volatile ("" ::: "memory")
+#define OS_LEAVE_CRITICAL_SECTION()     __asm__ volatile ("" ::: "memory")
+
+/* No consumer task is set by the benchmark */
+#define OS_NOTIFY_SET_BITS              0
+#define OS_TASK_NOTIFY(task, value, action)             ((void) 0)
+#define OS_TASK_NOTIFY_FROM_ISR(task, value, action)    ((void) 0)
+
+#define OS_ASSERT(cond)                 assert(cond)
+
+#define __RETAINED
+#define __RETAINED_RW
+
+#endif /* OSAL_H_ */
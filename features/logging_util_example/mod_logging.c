@@ -40,6 +40,8 @@
 
 #include "sdk_defs.h"
 #include "logging.h"
+#include "mod_logging.h"
+#include "log_binary.h"
 
 #include "hw_sys.h"
 
@@ -72,8 +74,17 @@
 #endif
 
 #ifdef LOGGING_MODE_STANDALONE
-/* Task stack size */
+/*
+ * Task stack size. Binary records are formatted by the task into the batch, through
+ * log_batch_fill(), log_batch_add() and log_record_format() down to vsnprintf(), which needs about
+ * as much stack as in the tasks of the example (200 words). The rest covers the frames above it
+ * and the context saved on the stack when the task is switched out with FPU registers in use.
+ */
+#if LOGGING_BINARY && !LOGGING_BINARY_RAW_OUTPUT
+#define mainTASK_STACK_SIZE 300
+#else
 #define mainTASK_STACK_SIZE 100
+#endif
 
 /* Task priorities */
 #define mainTASK_PRIORITY               ( tskIDLE_PRIORITY + 1 )
@@ -82,15 +93,36 @@
 
 #ifdef USE_QUEUE
 
-//__RETAINED static OS_QUEUE xLogQueue;
-/* SDK change from static in order to access from application level */
-__RETAINED OS_QUEUE xLogQueue;
+#if (LOGGING_RING_SIZE & (LOGGING_RING_SIZE - 1)) || (LOGGING_RING_SIZE < 4 * LOGGING_MAX_MSG_SIZE)
+#error "LOGGING_RING_SIZE must be a power of two and at least 4 x LOGGING_MAX_MSG_SIZE"
+#endif
+
+/*
+ * Each record starts with a 32-bit header holding its length and flags, and is padded to a
+ * multiple of 4 bytes. A record never wraps around the end of the ring, the space left there is
+ * skipped with a padding record. Released space is zeroed, so that the header of a record being
+ * written reads as not committed.
+ */
+#define LOG_RECORD_COMMITTED    (1UL << 31)
+#define LOG_RECORD_PADDING      (1UL << 30)
+#define LOG_RECORD_LEN_MASK     (0xFFFF)
+#define LOG_RECORD_SIZE(len)    ((sizeof(uint32_t) + (len) + 3) & ~3UL)
+
+__RETAINED static uint32_t log_ring[LOGGING_RING_SIZE / sizeof(uint32_t)];
+
+/* Free-running indexes of reserved and released space */
+__RETAINED static uint32_t log_ring_head;
+__RETAINED static uint32_t log_ring_tail;
 
-//__RETAINED static uint32_t suppressed_messages;
+/* Records dropped, and how many of them have been reported with a suppressed messages log */
+__RETAINED static uint32_t log_ring_dropped;
 #if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-__RETAINED uint32_t suppressed_messages;
+__RETAINED static uint32_t log_ring_dropped_reported;
 #endif /* LOGGING_SUPPRESSED_COUNT_ENABLE == 1 */
 
+__RETAINED static OS_TASK log_ring_consumer;
+__RETAINED static uint32_t log_ring_consumer_mask;
+
 #endif /* USE_QUEUE */
 
 #ifdef LOGGING_ENABLED
@@ -121,15 +153,26 @@ __RETAINED logging_severity_e logging_min_severity;
 #       define LOGGING_STANDALONE_UART_PARITY      HW_UART_PARITY_NONE
 #endif
 
-#if LOGGING_USE_DMA == 1
+#ifndef LOGGING_STANDALONE_BATCH_SIZE
+#       define LOGGING_STANDALONE_BATCH_SIZE       512
+#endif
+
+#if LOGGING_STANDALONE_BATCH_SIZE < LOGGING_MAX_MSG_SIZE + 3
+#error "LOGGING_STANDALONE_BATCH_SIZE must be at least LOGGING_MAX_MSG_SIZE + 3"
+#endif
 
+#if LOGGING_USE_DMA == 1
 #if HW_UART_USE_DMA_SUPPORT == 0
 #error "Cannot Use DMA if HW_UART_USE_DMA_SUPPORT is set to 0"
 #endif
+#endif /* LOGGING_USE_DMA == 1 */
 
 
 __RETAINED static bool is_active;
 
+/* Records drained from the ring, sent with a single UART transfer */
+__RETAINED static char log_batch[LOGGING_STANDALONE_BATCH_SIZE];
+
 static void uart_init(void)
 {
         hw_gpio_set_pin_function(LOGGING_STANDALONE_GPIO_PORT_UART_TX,
@@ -156,6 +199,24 @@ static void uart_init(void)
 
 }
 
+/**
+ * @brief Power up the UART before sending a backlog, or down once it has been sent
+ */
+static void uart_power(bool on)
+{
+        if (on) {
+                hw_sys_pd_com_enable();
+                hw_gpio_pad_latch_enable(LOGGING_STANDALONE_GPIO_PORT_UART_TX, LOGGING_STANDALONE_GPIO_PIN_UART_TX);
+                uart_init();
+        } else {
+                /* The last character may still be shifted out when the transfer completes */
+                while (hw_uart_is_busy(LOGGING_STANDALONE_UART)) {}
+
+                hw_gpio_pad_latch_disable(LOGGING_STANDALONE_GPIO_PORT_UART_TX, LOGGING_STANDALONE_GPIO_PIN_UART_TX);
+                hw_sys_pd_com_disable();
+        }
+}
+
 static bool ad_prepare_for_sleep(void)
 {
         return !is_active;
@@ -175,8 +236,6 @@ static void ad_xtalm_ready_ind(void)
 {
 }
 
-__RETAINED static OS_MUTEX xSemaphore;
-
 static const adapter_call_backs_t sleep_cbs = {
         .ad_prepare_for_sleep = ad_prepare_for_sleep,
         .ad_sleep_canceled = ad_sleep_canceled,
@@ -185,6 +244,8 @@ static const adapter_call_backs_t sleep_cbs = {
         .ad_sleep_preparation_time = 0
 };
 
+#if LOGGING_USE_DMA == 1
+__RETAINED static OS_MUTEX xSemaphore;
 
 /**
  * @brief uart tx cb routine
@@ -196,40 +257,130 @@ static void uart_tx_cb(void *user_data, uint16_t written)
 }
 #endif /* LOGGING_USE_DMA == 1 */
 
+/**
+ * @brief Append record to batch
+ *
+ * @return number of bytes appended, -1 if the record does not fit in the space left
+ */
+static int log_batch_add(char *buf, uint16_t size, const char *data, uint16_t len)
+{
+#if LOGGING_BINARY && LOGGING_BINARY_RAW_OUTPUT
+        /* Framed for the host decoder */
+        if (len + 3 > size) {
+                return -1;
+        }
+
+        buf[0] = LOGGING_BINARY_FRAME_SYNC;
+        buf[1] = len & 0xFF;
+        buf[2] = len >> 8;
+        memcpy(&buf[3], data, len);
+
+        return len + 3;
+#elif LOGGING_BINARY
+        int n = log_record_format(buf, size, data, len);
+
+        if (n >= size) {
+                /* A line longer than a whole batch is sent truncated */
+                if (size < sizeof(log_batch)) {
+                        return -1;
+                }
+                n = size - 1;
+        }
+
+        return n;
+#else
+        /* The terminating null character is not sent */
+        len--;
+
+        if (len > size) {
+                return -1;
+        }
+
+        memcpy(buf, data, len);
+
+        return len;
+#endif
+}
+
+/**
+ * @brief Copy as many records as fit in the batch, moving the read cursor past them
+ *
+ * @return length of batch
+ */
+static uint16_t log_batch_fill(uint32_t *pos)
+{
+        const char *data;
+        uint32_t next = *pos;
+        uint16_t fill = 0;
+        uint16_t len;
+        int n;
+
+        while (log_ring_peek(&next, &data, &len)) {
+                n = log_batch_add(&log_batch[fill], sizeof(log_batch) - fill, data, len);
+                if (n < 0) {
+                        break;
+                }
+
+                fill += n;
+                *pos = next;
+        }
+
+        return fill;
+}
+
 /**
  * @brief Main Logging task. Only used for standalone or queue
  * logging modes
  */
 static void prvLogTask(void *pvParameters)
 {
-        struct mcif_message_s *current_message;
+        bool powered = false;
+        uint32_t start;
+        uint32_t pos;
+        uint16_t len;
 
-#if LOGGING_USE_DMA == 1
-        hw_uart_tx_callback cb = uart_tx_cb;
-#else
-        hw_uart_tx_callback cb = NULL;
-#endif
+        log_ring_set_consumer(OS_GET_CURRENT_TASK(), 1);
 
         for (;;) {
-                is_active = false;
-                OS_QUEUE_GET(xLogQueue, &current_message, portMAX_DELAY);
-                is_active = true;
+                /*
+                 * Drain the ring into the batch. The records are copied, so that they are released
+                 * before the batch is sent and logging does not stall while the UART is busy.
+                 */
+                start = log_ring_begin();
+                pos = start;
+                len = log_batch_fill(&pos);
+
+                if (pos == start) {
+                        /* Backlog sent, keep the UART down until more records are written */
+                        if (powered) {
+                                uart_power(false);
+                                powered = false;
+                        }
+
+                        is_active = false;
+                        OS_TASK_NOTIFY_WAIT(0, OS_TASK_NOTIFY_ALL_BITS, NULL, OS_TASK_NOTIFY_FOREVER);
+                        is_active = true;
+                        continue;
+                }
 
-                hw_sys_pd_com_enable();
-                hw_gpio_pad_latch_enable(LOGGING_STANDALONE_GPIO_PORT_UART_TX, LOGGING_STANDALONE_GPIO_PIN_UART_TX);
-                uart_init();
+                log_ring_release(pos);
 
-                hw_uart_send(LOGGING_STANDALONE_UART, current_message->buffer, current_message->len,
-                        cb, NULL);
-                while (hw_uart_is_busy(LOGGING_STANDALONE_UART)) {}
+                if (!len) {
+                        continue;
+                }
 
-                hw_gpio_pad_latch_disable(LOGGING_STANDALONE_GPIO_PORT_UART_TX, LOGGING_STANDALONE_GPIO_PIN_UART_TX);
-                hw_sys_pd_com_disable();
+                if (!powered) {
+                        uart_power(true);
+                        powered = true;
+                }
 
 #if LOGGING_USE_DMA == 1
+                /* Sleep until the whole batch has been sent */
+                hw_uart_send(LOGGING_STANDALONE_UART, log_batch, len, uart_tx_cb, NULL);
                 OS_EVENT_WAIT(xSemaphore, OS_EVENT_FOREVER);
+#else
+                hw_uart_send(LOGGING_STANDALONE_UART, log_batch, len, NULL, NULL);
 #endif
-                OS_FREE(current_message);
         }
 }
 
@@ -250,14 +401,13 @@ void log_init(void)
 #endif /* LOGGING_ENABLED */
 
 #ifdef USE_QUEUE
+        memset(log_ring, 0, sizeof(log_ring));
+        log_ring_head = 0;
+        log_ring_tail = 0;
+        log_ring_dropped = 0;
 #if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-        OS_ENTER_CRITICAL_SECTION();
-        suppressed_messages = 0;
-        OS_LEAVE_CRITICAL_SECTION();
+        log_ring_dropped_reported = 0;
 #endif
-
-        OS_QUEUE_CREATE(xLogQueue, sizeof(struct mcif_message_s *), LOGGING_QUEUE_LENGTH);
-        OS_ASSERT(xLogQueue);
 #endif
 
 #ifdef LOGGING_MODE_STANDALONE
@@ -290,151 +440,249 @@ void log_set_severity(logging_severity_e severity)
 
 #ifdef USE_QUEUE
 
-#if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-#define SUPPRESSED_BUFFER_SZ sizeof(LOGGING_SUPPRESSED_MSG_TMPL) + 24
-__STATIC_INLINE void log_suppressed(void)
+/*
+ * Reserve space for a record of given length. Producers race on the head index only, so tasks
+ * and interrupts may interleave at any point; a record reserved by a preempted producer just
+ * holds back the following ones from the consumer until it is committed.
+ */
+static uint32_t *log_ring_reserve(uint16_t len)
 {
-        struct mcif_message_s *msg;
-        uint32_t suppressed_count;
+        uint32_t head, tail, pos, pad;
+        uint32_t size = LOG_RECORD_SIZE(len);
 
-        if ((LOGGING_SUPPRESSED_SEVERITY < LOGGING_MIN_COMPILED_SEVERITY) ||
-                (LOGGING_SUPPRESSED_SEVERITY < logging_min_severity))
+        head = __atomic_load_n(&log_ring_head, __ATOMIC_RELAXED);
+        do {
+                tail = __atomic_load_n(&log_ring_tail, __ATOMIC_ACQUIRE);
+                pos = head & (LOGGING_RING_SIZE - 1);
+                pad = (pos + size > LOGGING_RING_SIZE) ? LOGGING_RING_SIZE - pos : 0;
+
+                if (head + pad + size - tail > LOGGING_RING_SIZE) {
+                        return NULL;
+                }
+        } while (!__atomic_compare_exchange_n(&log_ring_head, &head, head + pad + size, true,
+                                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+        if (pad) {
+                __atomic_store_n(&log_ring[pos / sizeof(uint32_t)], LOG_RECORD_COMMITTED |
+                                LOG_RECORD_PADDING | (pad - sizeof(uint32_t)), __ATOMIC_RELEASE);
+                pos = 0;
+        }
+
+        return &log_ring[pos / sizeof(uint32_t)];
+}
+
+static void log_ring_commit(uint32_t *hdr, uint16_t len)
+{
+        __atomic_store_n(hdr, LOG_RECORD_COMMITTED | len, __ATOMIC_RELEASE);
+
+        if (!log_ring_consumer) {
                 return;
+        }
 
+        if (in_interrupt()) {
+                OS_TASK_NOTIFY_FROM_ISR(log_ring_consumer, log_ring_consumer_mask,
+                                                                        OS_NOTIFY_SET_BITS);
+        } else {
+                OS_TASK_NOTIFY(log_ring_consumer, log_ring_consumer_mask, OS_NOTIFY_SET_BITS);
+        }
+}
 
-        /* Get a local, thread-safe reference of suppressed_messages. We don't want to
-         * close interrupts while calling snprintf
-         */
-        OS_ENTER_CRITICAL_SECTION();
-        suppressed_count = suppressed_messages;
-        OS_LEAVE_CRITICAL_SECTION();
+uint32_t log_ring_begin(void)
+{
+        return log_ring_tail;
+}
 
-        /* If suppressed messages >= LOGGING_SUPPRESSED_MIN_COUNT
-         * try to queue a suppressed messages log
-         */
-        if (suppressed_count >= LOGGING_SUPPRESSED_MIN_COUNT) {
+bool log_ring_peek(uint32_t *pos, const char **data, uint16_t *len)
+{
+        uint32_t *hdr;
+        uint32_t val;
 
-                /* Early check to skip unneeded (and perhaps catastrophic)
-                 * allocations and snprintf processing
-                 */
-                if (uxQueueSpacesAvailable(xLogQueue) == 0) {
-                        return;
+        for (;;) {
+                /* Position of head is that of the oldest record when the ring is full */
+                if (*pos == __atomic_load_n(&log_ring_head, __ATOMIC_RELAXED)) {
+                        return false;
                 }
 
-                /* allocate a few bytes more to account for the
-                 * "header" string AND the bytes in the actual
-                 * suppressed count.
-                 */
-                msg = OS_MALLOC(sizeof(struct mcif_message_s) +
-                SUPPRESSED_BUFFER_SZ);
-
-                msg->len = 1 + snprintf(msg->buffer, SUPPRESSED_BUFFER_SZ,
-                        "[%lu] %c %d " LOGGING_SUPPRESSED_MSG_TMPL,
-                        OS_GET_TICK_COUNT(),
-                        logging_severity_chars[LOGGING_SUPPRESSED_SEVERITY],
-                        LOGGING_SUPPRESSED_TAG,
-                        suppressed_count);
+                hdr = &log_ring[(*pos & (LOGGING_RING_SIZE - 1)) / sizeof(uint32_t)];
+                val = __atomic_load_n(hdr, __ATOMIC_ACQUIRE);
 
-                /* Attempt to queue the message. If it succeeds, subtract the printed
-                 * suppressed_messages counter from the total suppressed messages (because
-                 * in the meanwhile, more messages may get suppressed).
-                 */
-                if (OS_QUEUE_PUT(xLogQueue, &msg, 0) != pdPASS) {
-                        /* Still full. Try later */
-                        OS_FREE(msg);
+                if (!(val & LOG_RECORD_COMMITTED)) {
+                        return false;
                 }
-                else {
-                        OS_ENTER_CRITICAL_SECTION();
-                        suppressed_messages -= suppressed_count;
-                        OS_LEAVE_CRITICAL_SECTION();
+
+                *pos += LOG_RECORD_SIZE(val & LOG_RECORD_LEN_MASK);
+
+                if (!(val & LOG_RECORD_PADDING)) {
+                        break;
                 }
+        }
+
+        *data = (const char *) (hdr + 1);
+        *len = val & LOG_RECORD_LEN_MASK;
 
+        return true;
+}
+
+void log_ring_release(uint32_t pos)
+{
+        uint32_t tail = log_ring_tail;
+        uint32_t offset = tail & (LOGGING_RING_SIZE - 1);
+        uint32_t size = pos - tail;
+
+        if (offset + size > LOGGING_RING_SIZE) {
+                memset((uint8_t *) log_ring + offset, 0, LOGGING_RING_SIZE - offset);
+                memset(log_ring, 0, offset + size - LOGGING_RING_SIZE);
+        } else {
+                memset((uint8_t *) log_ring + offset, 0, size);
         }
+
+        __atomic_store_n(&log_ring_tail, pos, __ATOMIC_RELEASE);
+}
+
+uint32_t log_ring_get_dropped(void)
+{
+        return __atomic_load_n(&log_ring_dropped, __ATOMIC_RELAXED);
 }
-#endif
 
-__STATIC_INLINE void log_send(struct mcif_message_s *msg)
+void log_ring_set_consumer(OS_TASK task, uint32_t mask)
 {
+        log_ring_consumer_mask = mask;
+        log_ring_consumer = task;
+}
 
-        /* Even though we checked before for space in the queue, some other
-         * task may get it before we reach this point
-         */
-        if (OS_QUEUE_PUT(xLogQueue, &msg, 0) != pdPASS) {
-                OS_FREE(msg);
-#if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-                OS_ENTER_CRITICAL_SECTION();
-                suppressed_messages++;
-                OS_LEAVE_CRITICAL_SECTION();
+/*
+ * Encode line as text, or in binary format. Returns the length of the whole record, which has
+ * been truncated if larger than size.
+ */
+static size_t log_record_encode(char *buf, size_t size, const char *fmt, va_list args)
+{
+#if LOGGING_BINARY
+        memcpy(buf, &fmt, sizeof(fmt));
+
+        return sizeof(fmt) + log_binary_encode((uint8_t *) buf + sizeof(fmt), size - sizeof(fmt),
+                                                                                fmt, args);
+#else
+        int n = vsnprintf(buf, size, fmt, args);
+
+        return (n < 0) ? 0 : n + 1;
 #endif
-                return;
+}
+
+static bool log_vwrite(const char *fmt, va_list args)
+{
+        char buffer[LOGGING_MIN_MSG_SIZE];
+        va_list args_copy;
+        uint32_t *hdr;
+        size_t len;
+
+        /*
+         * Encode on the stack first, as the length must be known to reserve space in the ring.
+         * Longer records are encoded again, directly into the ring.
+         */
+        va_copy(args_copy, args);
+        len = log_record_encode(buffer, sizeof(buffer), fmt, args_copy);
+        va_end(args_copy);
+
+        if (!len) {
+                return true;
         }
 
-#if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-        log_suppressed();
-#endif
+        hdr = log_ring_reserve(MIN(len, LOGGING_MAX_MSG_SIZE));
+        if (!hdr) {
+                return false;
+        }
+
+        if (len <= sizeof(buffer)) {
+                memcpy(hdr + 1, buffer, len);
+        } else {
+                len = MIN(log_record_encode((char *) (hdr + 1), LOGGING_MAX_MSG_SIZE, fmt, args),
+                                                                        LOGGING_MAX_MSG_SIZE);
+        }
+
+        log_ring_commit(hdr, len);
+
+        return true;
 }
 
-void log_printf_raw(const char *fmt, ...)
+#if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
+static bool log_write(const char *fmt, ...)
 {
         va_list args;
-        int n;
-        struct mcif_message_s *msg;
+        bool written;
 
-        /* Check for space (although some other task may still get the available slot later)
-         * to save some time (and memory peaking) from the malloc and copy
-         */
-        if (uxQueueSpacesAvailable(xLogQueue) == 0) {
-#if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-                OS_ENTER_CRITICAL_SECTION();
-                suppressed_messages++;
-                OS_LEAVE_CRITICAL_SECTION();
-#endif
+        va_start(args, fmt);
+        written = log_vwrite(fmt, args);
+        va_end(args);
+
+        return written;
+}
+
+__STATIC_INLINE void log_suppressed(void)
+{
+        uint32_t reported;
+        uint32_t suppressed_count;
+
+        if ((LOGGING_SUPPRESSED_SEVERITY < LOGGING_MIN_COMPILED_SEVERITY) ||
+                (LOGGING_SUPPRESSED_SEVERITY < logging_min_severity))
+                return;
+
+        reported = __atomic_load_n(&log_ring_dropped_reported, __ATOMIC_RELAXED);
+        suppressed_count = __atomic_load_n(&log_ring_dropped, __ATOMIC_RELAXED) - reported;
+
+        if (suppressed_count < LOGGING_SUPPRESSED_MIN_COUNT) {
                 return;
         }
 
-#if LOGGING_MIN_ALLOWED_FREE_HEAP
-        OS_ENTER_CRITICAL_SECTION();
-        if (xPortGetFreeHeapSize() <= LOGGING_MIN_ALLOWED_FREE_HEAP) {
-#if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-                suppressed_messages++;
-#endif
-                OS_LEAVE_CRITICAL_SECTION();
+        /* Claim the count, so that a single caller reports it even if more log at the same time */
+        if (!__atomic_compare_exchange_n(&log_ring_dropped_reported, &reported,
+                        reported + suppressed_count, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
                 return;
         }
+
+        if (!log_write("[%lu] %c %d " LOGGING_SUPPRESSED_MSG_TMPL,
+                        OS_GET_TICK_COUNT(),
+                        logging_severity_chars[LOGGING_SUPPRESSED_SEVERITY],
+                        LOGGING_SUPPRESSED_TAG,
+                        suppressed_count)) {
+                /* Still full. Try later */
+                __atomic_fetch_sub(&log_ring_dropped_reported, suppressed_count, __ATOMIC_RELAXED);
+        }
+}
 #endif
-        msg = OS_MALLOC(
-                sizeof(struct mcif_message_s) + LOGGING_MIN_MSG_SIZE);
-#if LOGGING_MIN_ALLOWED_FREE_HEAP
-        OS_LEAVE_CRITICAL_SECTION();
-#endif
+
+void log_printf_raw(const char *fmt, ...)
+{
+        va_list args;
+        bool written;
 
         va_start(args, fmt);
-        n = vsnprintf(msg->buffer, LOGGING_MIN_MSG_SIZE, fmt, args);
+        written = log_vwrite(fmt, args);
         va_end(args);
 
-        if (n >= LOGGING_MIN_MSG_SIZE) {
-                OS_FREE(msg);
-#if LOGGING_MIN_ALLOWED_FREE_HEAP
-                OS_ENTER_CRITICAL_SECTION();
-                if (xPortGetFreeHeapSize() <= LOGGING_MIN_ALLOWED_FREE_HEAP) {
+        if (!written) {
+                __atomic_fetch_add(&log_ring_dropped, 1, __ATOMIC_RELAXED);
+                return;
+        }
+
 #if LOGGING_SUPPRESSED_COUNT_ENABLE == 1
-                        suppressed_messages++;
-#endif
-                        OS_LEAVE_CRITICAL_SECTION();
-                        return;
-                }
-#endif
-                msg = OS_MALLOC(sizeof(struct mcif_message_s) + n + 1);
-#if LOGGING_MIN_ALLOWED_FREE_HEAP
-                OS_LEAVE_CRITICAL_SECTION();
+        log_suppressed();
 #endif
-                va_start(args, fmt);
-                vsnprintf(msg->buffer, n + 1, fmt, args);
-                va_end(args);
+}
+
+#if LOGGING_BINARY
+int log_record_format(char *buf, size_t size, const char *data, uint16_t len)
+{
+        const char *fmt;
+
+        if (len < sizeof(fmt)) {
+                return log_binary_format(buf, size, "", NULL, 0);
         }
-        msg->len = n + 1;
-        log_send(msg);
+
+        memcpy(&fmt, data, sizeof(fmt));
+
+        return log_binary_format(buf, size, fmt, (const uint8_t *) data + sizeof(fmt),
+                                                                        len - sizeof(fmt));
 }
+#endif /* LOGGING_BINARY */
 
 #endif /* USE_QUEUE */
-
@@ -0,0 +1,157 @@
+/**
+ ****************************************************************************************
+ *
+ * @file mod_logging.h
+ *
+ * @brief Log record ring of the logging module
+ *
+ * Copyright (C) 2015-2021 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef MOD_LOGGING_H_
+#define MOD_LOGGING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "osal.h"
+
+/*
+ * In LOGGING_MODE_STANDALONE and LOGGING_MODE_QUEUE log lines are stored as variable length
+ * records in a statically allocated ring of LOGGING_RING_SIZE bytes. Any number of tasks and
+ * interrupts may log at the same time, space is reserved lock-free and a record becomes visible
+ * to the consumer once written. Records which do not fit are dropped and counted.
+ *
+ * There is a single consumer, which walks the records with a cursor and releases them once done:
+ *
+ *      uint32_t pos = log_ring_begin();
+ *
+ *      while (log_ring_peek(&pos, &data, &len)) {
+ *              ...
+ *              log_ring_release(pos);
+ *      }
+ *
+ * Record data stay valid until released, so several records may be peeked before releasing all
+ * of them at once.
+ */
+
+/**
+ * Size of the log record ring in bytes (power of two)
+ */
+#ifndef LOGGING_RING_SIZE
+#define LOGGING_RING_SIZE               2048
+#endif
+
+/**
+ * Max length of a log record, including the terminating null character. Longer lines are
+ * truncated.
+ */
+#ifndef LOGGING_MAX_MSG_SIZE
+#define LOGGING_MAX_MSG_SIZE            256
+#endif
+
+/**
+ * Binary logging. Instead of the formatted line, a record holds the address of the format string
+ * followed by the arguments encoded as in log_binary.h, so that the caller does not spend time
+ * formatting and records take several times less space. Records are formatted by the consumer
+ * with log_record_format(), or sent as they are when LOGGING_BINARY_RAW_OUTPUT is set, in which
+ * case lines are rebuilt on the host by logging_host/log_decode from the ELF file of the
+ * application. Format strings must be constant, string arguments are copied into the record.
+ */
+#ifndef LOGGING_BINARY
+#define LOGGING_BINARY                  0
+#endif
+
+#ifndef LOGGING_BINARY_RAW_OUTPUT
+#define LOGGING_BINARY_RAW_OUTPUT       0
+#endif
+
+/**
+ * Sync byte starting each record sent over UART in raw binary output, followed by the record
+ * length (16-bit little endian) and the record.
+ */
+#define LOGGING_BINARY_FRAME_SYNC       0x1E
+
+/**
+ * \brief Get read cursor of the oldest record not released yet
+ *
+ * \return read cursor
+ *
+ */
+uint32_t log_ring_begin(void);
+
+/**
+ * \brief Get record at read cursor
+ *
+ * On success, cursor is moved past the returned record.
+ *
+ * \param [in,out] pos  read cursor
+ * \param [out]    data record data
+ * \param [out]    len  record length in bytes
+ *
+ * \return true if record was returned, false if there are no more records written yet
+ *
+ */
+bool log_ring_peek(uint32_t *pos, const char **data, uint16_t *len);
+
+/**
+ * \brief Release records up to read cursor
+ *
+ * \param [in] pos read cursor returned by log_ring_peek()
+ *
+ */
+void log_ring_release(uint32_t pos);
+
+/**
+ * \brief Get number of log records dropped because ring was full
+ *
+ * \return number of dropped records since log_init()
+ *
+ */
+uint32_t log_ring_get_dropped(void);
+
+#if LOGGING_BINARY
+/**
+ * \brief Format binary log record
+ *
+ * \param [out] buf  buffer for null terminated line
+ * \param [in]  size size of buffer
+ * \param [in]  data record data
+ * \param [in]  len  record length
+ *
+ * \return length of line, which has been truncated if not less than size (as snprintf())
+ *
+ */
+int log_record_format(char *buf, size_t size, const char *data, uint16_t len);
+#endif /* LOGGING_BINARY */
+
+/**
+ * \brief Set task notified when records are written
+ *
+ * \param [in] task task to notify, NULL to disable notifications
+ * \param [in] mask notification bits set
+ *
+ */
+void log_ring_set_consumer(OS_TASK task, uint32_t mask);
+
+#endif /* MOD_LOGGING_H_ */
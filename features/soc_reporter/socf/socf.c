@@ -35,6 +35,7 @@
 #include "socfi.h"
 #include "socf_config.h"
 #include "socf_profile_data.h"
+#include "socf_lut.h"
 #include "sdk_defs.h"
 
 //#define SOCF_ENABLE_DEBUG_COFF
@@ -54,6 +55,7 @@
 #define SOCF_MS_TIME            (1000 / SOCF_TIME_NORM)
 #define SOCF_MIN_SOC_CAP        20
 #define SOCF_1_HOUR_SEC         3600
+#define SOCF_TEMP_Q             15
 #define SOCF_INTERPOL(Xlow,Ylow,Xhigh,Yhigh,Xvalue)     (Ylow + ((Yhigh - Ylow) * (Xvalue - Xlow)) / (Xhigh - Xlow))
 #define SOCF_M_CAL(Imin,Imax,Vmin,Vmax,Vdiff)   (Imin - (Vdiff * (Imax - Imin))/(Vmax - Vmin))
 
@@ -64,7 +66,11 @@ __RETAINED static int16_t socfi_lv_e;
 __RETAINED static int16_t socfi_pre_deg;
 __RETAINED static int16_t socfi_estimated_cap;
 __RETAINED static int16_t socfi_rlut[VOL2SOC_LUT_SIZE];
+__RETAINED static int16_t socfi_hlut[VOL2SOC_LUT_SIZE];
+__RETAINED static int16_t socfi_clut[VOL2SOC_LUT_SIZE];
 __RETAINED static int16_t socfi_cur_comp_lut[SOCF_M_CAL_NUM];
+__RETAINED static int16_t socfi_cv_index;
+__RETAINED static socf_lut_t socfi_rlut_lut;
 static const int16_t socfi_ref[VOL2SOC_LUT_SIZE] = {
         0, 50, 100, 150, 200, 250, 300, 350, 400, 450, 500, 550, 600, 650, 700, 750, 800, 850, 900,
         950, 1000
@@ -75,52 +81,6 @@ __RETAINED static int16_t socfi_vbat, socfi_temp;
 __RETAINED static int32_t socfi_dv, socfi_curr, socfi_ddv, socfi_dvolt;
 #endif
 
-static int16_t socfi_chk_lut(int16_t* x, int16_t* y, int16_t v, int16_t l)
-{
-        int16_t i;
-        int16_t ret;
-
-        for (i = 0; i < l; i++) {
-                if (v < x[i]) {
-                        break;
-                }
-        }
-        i--;
-
-        if (i < 0) {
-                i = 0;
-        }
-
-        ret = y[i] + (int16_t)(((int32_t)(v - x[i])
-                * (int32_t)(y[i + 1] - y[i]))
-                / (int32_t)(x[i + 1] - x[i]));
-
-        return ret;
-}
-
-static int16_t socfi_chk_lut_inv(int16_t* x, int16_t* y, int16_t v, int16_t l)
-{
-        int16_t i;
-        int16_t ret;
-
-        for (i = l - 1; i > -1; i--) {
-                if (v < x[i]) {
-                        break;
-                }
-        }
-        i++;
-
-        if (i > l - 2) {
-                i = l - 2;
-        }
-
-        ret = y[i] + (int16_t)(((int32_t)(v - x[i])
-                * (int32_t)(y[i + 1] - y[i]))
-                / (int32_t)(x[i + 1] - x[i]));
-
-        return ret;
-}
-
 //time for 1%  = (capacitance *3600 * 1 / 100) / 200
 int32_t socfi_soc_get_sec_to_charged()
 {
@@ -154,16 +114,52 @@ void socfi_init(void)
         socfi_estimated_cap = socf_conf.socf_cap_p[socf_conf.socf_25c_num];
 }
 
-static int16_t socfi_get_rlut()
+static int16_t socfi_temp_interpol(int16_t low, int16_t high, int32_t weight)
+{
+        return low + (((int32_t)(high - low) * weight + (1 << (SOCF_TEMP_Q - 1)))
+                >> SOCF_TEMP_Q);
+}
+
+// LUTs at the temperature, interpolated between the tables of the nearest temperatures
+static int16_t socfi_get_rlut(int16_t deg)
 {
-        int i;
+        int i, lo = 0, hi = 0;
+        int32_t weight = 0;
+        const int16_t *temp = socf_conf.socf_temp_p;
+        int16_t num = socf_conf.socf_temp_num;
+
+        if (num > 1) {
+                lo = socf_lut_find(temp, num, deg);
+                hi = lo + 1;
+
+                if (deg >= temp[hi]) {
+                        weight = 1 << SOCF_TEMP_Q;
+                } else if (deg > temp[lo]) {
+                        weight = ((int32_t)(deg - temp[lo]) << SOCF_TEMP_Q) / (temp[hi] - temp[lo]);
+                }
+        }
 
         for (i = 0; i < VOL2SOC_LUT_SIZE; i++) {
-                socfi_rlut[i] = socf_conf.socf_lluts_p[0][i];
+                socfi_rlut[i] = socfi_temp_interpol(socf_conf.socf_lluts_p[lo][i],
+                        socf_conf.socf_lluts_p[hi][i], weight);
+                socfi_hlut[i] = socfi_temp_interpol(socf_conf.socf_hluts_p[lo][i],
+                        socf_conf.socf_hluts_p[hi][i], weight);
+                socfi_clut[i] = socfi_temp_interpol(socf_conf.socf_cluts_p[lo][i],
+                        socf_conf.socf_cluts_p[hi][i], weight);
         }
         for (i = 0; i < SOCF_M_CAL_NUM; i++) {
-                socfi_cur_comp_lut[i] = socf_conf.socf_cur_comp[0][i];
+                socfi_cur_comp_lut[i] = socfi_temp_interpol(socf_conf.socf_cur_comp[lo][i],
+                        socf_conf.socf_cur_comp[hi][i], weight);
         }
+
+        // last point of charging LUT below CV level, for the charging current near it
+        for (socfi_cv_index = VOL2SOC_LUT_SIZE - 1; socfi_cv_index > 0; socfi_cv_index--) {
+                if (socfi_clut[socfi_cv_index] < (socf_conf.socf_chg_cv - 5)) {
+                        break;
+                }
+        }
+
+        socf_lut_init(&socfi_rlut_lut, socfi_ref, socfi_rlut, VOL2SOC_LUT_SIZE);
         return 0;
 }
 
@@ -193,7 +189,7 @@ static int16_t socfi_get_soc_from_vbat_profile_with_no_temp(int16_t vbat,
 
     if (vbat >= socfi_lv_e) {
         if (socfi_soc < 0) {
-            dvolt = socf_conf.socf_cluts_p[0][0];
+            dvolt = socfi_clut[0];
 
             if (vbat >= dvolt)  {
                 socfi_soc = 0;
@@ -202,17 +198,11 @@ static int16_t socfi_get_soc_from_vbat_profile_with_no_temp(int16_t vbat,
             }
         }
 
-        dvolt = socf_conf.socf_cluts_p[0][index];
-
-        if (socf_conf.socf_cluts_p[0][index] > (socf_conf.socf_chg_cv - 5)) {
-            for (now_m = VOL2SOC_LUT_SIZE - 1; now_m >= 0; now_m--)     {
-                if (socf_conf.socf_cluts_p[0][now_m] < (socf_conf.socf_chg_cv - 5)) {
-                    break;
-                }
-            }
+        dvolt = socfi_clut[index];
 
+        if (socfi_clut[index] > (socf_conf.socf_chg_cv - 5)) {
             now_m = (socf_conf.socf_chg_cc[0] * (dvolt - socfi_rlut[index]))
-                / ((socf_conf.socf_cluts_p[0][now_m] - socf_conf.socf_lluts_p[0][now_m]));
+                / ((socfi_clut[socfi_cv_index] - socfi_rlut[socfi_cv_index]));
         } else {
             now_m = socf_conf.socf_chg_cc[0];
         }
@@ -242,7 +232,7 @@ static int16_t socfi_get_soc_from_vbat_profile_with_no_temp(int16_t vbat,
     }
     else {
 
-        dvolt = socf_conf.socf_hluts_p[0][index];
+        dvolt = socfi_hlut[index];
 
         if (socfi_rlut[index] == dvolt) {
             now_m = 0;
@@ -302,8 +292,7 @@ static int16_t socfi_get_soc_from_vbat_profile_with_no_temp(int16_t vbat,
 
     socfi_coulomb -= (now_m * duration_ms * SOCF_TIME_NORM);
     socfi_soc = (((socfi_now_cap * 3600000) - socfi_coulomb)) / (socfi_now_cap * 3600);
-    socfi_lv_e = socfi_chk_lut((int16_t *)socfi_ref,
-        (int16_t *)socfi_rlut, socfi_soc, VOL2SOC_LUT_SIZE);
+    socfi_lv_e = socf_lut_get(&socfi_rlut_lut, socfi_soc);
 
     if (socfi_lv_e < SOCF_SYS_MIN_VOLTAGE) {
         socfi_lv_e = SOCF_SYS_MIN_VOLTAGE;
@@ -320,13 +309,13 @@ static int16_t socfi_get_soc_from_vbat_ibat_profile(int16_t vbat,
         int16_t vol[VOL2SOC_LUT_SIZE];
         int16_t *max_volt_table, max_cur;
 
-        socfi_get_rlut();
+        socfi_get_rlut(deg);
 
         if (is_charging == false) {
-                max_volt_table = (int16_t *)socf_conf.socf_hluts_p[0];
+                max_volt_table = socfi_hlut;
                 max_cur = socf_conf.socf_dis_high;
         } else {
-                max_volt_table = (int16_t *)socf_conf.socf_cluts_p[0];
+                max_volt_table = socfi_clut;
                 max_cur = socf_conf.socf_chg_cc[0];
         }
         for (i = 0; i < VOL2SOC_LUT_SIZE; i++) {
@@ -336,7 +325,7 @@ static int16_t socfi_get_soc_from_vbat_ibat_profile(int16_t vbat,
                         - socfi_rlut[i]))
                         / (max_cur - socf_conf.socf_dis_low);
         }
-        return (socfi_chk_lut(vol, (int16_t *)socfi_ref, vbat,
+        return (socf_lut_interpolate(vol, socfi_ref, vbat,
                 VOL2SOC_LUT_SIZE));
 }
 
@@ -350,16 +339,15 @@ void socfi_soc_init_calculation(int16_t voltage, int16_t current,
 #endif
 
         if (soc != -1) {
-                socfi_get_rlut();
+                socfi_get_rlut(deg);
                 socfi_soc = soc;
-                socfi_lv_e = socfi_chk_lut((int16_t *)socfi_ref,
-                        (int16_t *)socfi_rlut, socfi_soc, VOL2SOC_LUT_SIZE);
+                socfi_lv_e = socf_lut_get(&socfi_rlut_lut, socfi_soc);
 
                 goto InitCal;
         }
 
         if (voltage < SOCF_SYS_MIN_VOLTAGE) {
-                socfi_get_rlut();
+                socfi_get_rlut(deg);
                 socfi_soc = 0;
                 socfi_lv_e = voltage;
                 goto InitCal;
@@ -371,13 +359,12 @@ void socfi_soc_init_calculation(int16_t voltage, int16_t current,
         if (socfi_soc == 0) {
                 socfi_lv_e = voltage;
         } else {
-                socfi_lv_e = socfi_chk_lut((int16_t *)socfi_ref,
-                (int16_t *)socfi_rlut, socfi_soc, VOL2SOC_LUT_SIZE);
+                socfi_lv_e = socf_lut_get(&socfi_rlut_lut, socfi_soc);
         }
 
 InitCal:
-        socfi_now_cap = socfi_chk_lut_inv((int16_t *)socf_conf.socf_temp_p,
-                (int16_t *)socf_conf.socf_cap_p, deg, socf_conf.socf_temp_num);
+        socfi_now_cap = socf_lut_interpolate_clamped(socf_conf.socf_temp_p,
+                socf_conf.socf_cap_p, deg, socf_conf.socf_temp_num);
         socfi_coulomb = (1000 - socfi_soc) * socfi_now_cap * 3600; // (cap * 3600 * 1000)
 }
 
@@ -394,6 +381,11 @@ int16_t socf_process_fg_cal(uint32_t duration_ms, uint16_t voltage,
                 return 0;
         }
 
+        if (deg != socfi_pre_deg) {
+                socfi_get_rlut(deg);
+                socfi_pre_deg = deg;
+        }
+
         return (socfi_get_soc_from_vbat_profile_with_no_temp(voltage,
         duration_ms, is_charging));
 
@@ -403,7 +395,7 @@ void socfi_full_charged_notification(void)
 {
         if (socfi_soc < SOCF_MAX_SOC_VAL) {
                 socfi_soc = SOCF_MAX_SOC_VAL;
-                socfi_lv_e = socf_conf.socf_lluts_p[0][VOL2SOC_LUT_SIZE - 1];
+                socfi_lv_e = socfi_rlut[VOL2SOC_LUT_SIZE - 1];
         }
 }
 
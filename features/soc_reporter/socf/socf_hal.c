@@ -41,6 +41,7 @@
 #include "socf_config.h"
 #include "socfi.h"
 #include "socf_hal.h"
+#include "socf_lut.h"
 #include "socf_client.h"
 #include "sys_usb.h"
 #include "hw_sys.h"
@@ -121,25 +122,7 @@ static const adapter_call_backs_t ad_socf_pm_call_backs = {
 
 int16_t socf_get_lut(int16_t* x, int16_t* y, int16_t v, int16_t l)
 {
-        int16_t i;
-        int16_t ret;
-
-        if (v < x[0]) {
-                ret = y[0];
-        } else if (v >= x[l - 1]) {
-                ret = y[l - 1];
-        } else {
-                for (i = 1; i < l; i++) {
-                        if (v < x[i]) {
-                                break;
-                        }
-                }
-                ret = y[i - 1];
-                ret = ret + (int16_t)((int32_t)(v - x[i - 1])
-                        * (int32_t)(y[i] - y[i - 1]))
-                        / (int32_t)(x[i] - x[i - 1]);
-        }
-        return ret;
+        return socf_lut_interpolate_clamped(x, y, v, l);
 }
 
 #if USE_SDADC_FOR_VBAT
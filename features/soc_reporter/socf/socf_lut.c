@@ -0,0 +1,195 @@
+/**
+ ****************************************************************************************
+ *
+ * @file socf_lut.c
+ *
+ * @brief SOC function lookup tables
+ *
+ * Copyright (C) 2015-2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "socf_lut.h"
+
+/* Smallest shift with (1 << shift) >= v */
+static uint8_t socf_lut_log2_ceil(uint64_t v)
+{
+        uint8_t shift = 0;
+
+        while (shift < 63 && ((uint64_t)1 << shift) < v) {
+                shift++;
+        }
+
+        return shift;
+}
+
+/*
+ * Reciprocal of div in Q(shift), rounded up, so that (n * recip) >> shift == n / div for any n
+ * from 0 to n_max. With recip * div == (1 << shift) + e, 0 <= e < div, the error of the product
+ * is n * e / (1 << shift) / div, less than 1 / div if n_max * div <= (1 << shift), which is not
+ * enough to reach the next integer.
+ */
+static bool socf_lut_recip(uint32_t div, uint32_t n_max, uint32_t *recip, uint8_t *shift)
+{
+        uint64_t m;
+
+        *shift = socf_lut_log2_ceil((uint64_t)n_max * div);
+        m = (((uint64_t)1 << *shift) + div - 1) / div;
+        if (m > UINT32_MAX) {
+                return false;
+        }
+        *recip = (uint32_t)m;
+
+        return true;
+}
+
+static int16_t socf_lut_segment(const int16_t *x, const int16_t *y, int16_t i, int16_t v)
+{
+        if (x[i + 1] == x[i]) {
+                return (v < x[i]) ? y[i] : y[i + 1];
+        }
+
+        return y[i] + (int16_t)(((int32_t)(v - x[i])
+                * (int32_t)(y[i + 1] - y[i]))
+                / (int32_t)(x[i + 1] - x[i]));
+}
+
+void socf_lut_init(socf_lut_t *lut, const int16_t *x, const int16_t *y, int16_t len)
+{
+        int16_t i;
+        int32_t step;
+
+        lut->x = x;
+        lut->y = y;
+        lut->len = len;
+
+        for (i = 0; i < len - 1 && i < SOCF_LUT_MAX_SIZE - 1; i++) {
+                int32_t dx = x[i + 1] - x[i];
+                int32_t dy = y[i + 1] - y[i];
+                uint32_t recip;
+
+                lut->shift[i] = SOCF_LUT_NO_SLOPE;
+                if (dx <= 0) {
+                        continue;
+                }
+
+                if (dy < 0) {
+                        dy = -dy;
+                }
+
+                /* n = (v - x0) * |dy| is up to dx * |dy| within the segment */
+                if (socf_lut_recip(dx, (uint32_t)dx * (uint32_t)dy, &recip, &lut->shift[i])
+                        && (uint64_t)recip * dy <= UINT32_MAX) {
+                        lut->slope[i] = recip * dy;
+                } else {
+                        lut->shift[i] = SOCF_LUT_NO_SLOPE;
+                }
+        }
+
+        /* Evenly spaced x, e.g. SOC steps, are indexed directly */
+        lut->index_recip = 0;
+        if (len < 2) {
+                return;
+        }
+
+        step = x[1] - x[0];
+        for (i = 2; i < len; i++) {
+                if (x[i] - x[i - 1] != step) {
+                        return;
+                }
+        }
+
+        if (step > 0 && !socf_lut_recip(step, x[len - 1] - x[0], &lut->index_recip,
+                                                                        &lut->index_shift)) {
+                lut->index_recip = 0;
+        }
+}
+
+int16_t socf_lut_find(const int16_t *x, int16_t len, int16_t v)
+{
+        int16_t i;
+
+        /*
+         * Last of x[0] to x[len - 2] not above v. Tables have up to VOL2SOC_LUT_SIZE points, which
+         * are scanned faster than searched by halves, consecutive lookups being in nearby segments.
+         */
+        for (i = 1; i < len - 1 && x[i] <= v; i++) {
+        }
+
+        return i - 1;
+}
+
+int16_t socf_lut_get(const socf_lut_t *lut, int16_t v)
+{
+        const int16_t *x = lut->x;
+        const int16_t *y = lut->y;
+        int16_t i;
+        uint32_t q;
+
+        if (lut->len < 2) {
+                return y[0];
+        }
+
+        if (v < x[0] || v > x[lut->len - 1]) {
+                i = (v < x[0]) ? 0 : lut->len - 2;
+                return socf_lut_segment(x, y, i, v);
+        }
+
+        if (lut->index_recip) {
+                i = ((uint64_t)(uint16_t)(v - x[0]) * lut->index_recip) >> lut->index_shift;
+                if (i > lut->len - 2) {
+                        i = lut->len - 2;
+                }
+        } else {
+                i = socf_lut_find(x, lut->len, v);
+        }
+
+        if (i >= SOCF_LUT_MAX_SIZE - 1 || lut->shift[i] == SOCF_LUT_NO_SLOPE) {
+                return socf_lut_segment(x, y, i, v);
+        }
+
+        q = ((uint64_t)(uint16_t)(v - x[i]) * lut->slope[i]) >> lut->shift[i];
+
+        return (y[i + 1] >= y[i]) ? y[i] + (int16_t)q : y[i] - (int16_t)q;
+}
+
+int16_t socf_lut_interpolate(const int16_t *x, const int16_t *y, int16_t v, int16_t len)
+{
+        if (len < 2) {
+                return y[0];
+        }
+
+        return socf_lut_segment(x, y, socf_lut_find(x, len, v), v);
+}
+
+int16_t socf_lut_interpolate_clamped(const int16_t *x, const int16_t *y, int16_t v, int16_t len)
+{
+        if (v < x[0]) {
+                return y[0];
+        } else if (v >= x[len - 1]) {
+                return y[len - 1];
+        }
+
+        return socf_lut_interpolate(x, y, v, len);
+}
@@ -0,0 +1,134 @@
+/**
+ ****************************************************************************************
+ *
+ * @file socf_lut.h
+ *
+ * @brief SOC function lookup tables
+ *
+ * Copyright (C) 2015-2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef SOCF_LUT_H_
+#define SOCF_LUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "socfi.h"
+
+/*
+ * Piecewise linear lookup tables of the SOC function, x in ascending order.
+ *
+ * The segment of a value is found by a linear scan, or directly if x is evenly spaced. Tables
+ * looked up on every sample are set up once with socf_lut_init(), which precomputes the slope of
+ * each segment in Q-format, so that interpolation is a multiply and a shift. The slope of a
+ * segment is the reciprocal of its width rounded up, times its height, with a shift large enough
+ * for the result to be exactly the one of the integer divide. Interpolation gives bit-exact the
+ * same results as y0 + (v - x0) * (y1 - y0) / (x1 - x0).
+ */
+
+/* Max number of points of a table set up with socf_lut_init() */
+#define SOCF_LUT_MAX_SIZE       VOL2SOC_LUT_SIZE
+
+/* Shift of a segment which has no exact slope, interpolated with a divide */
+#define SOCF_LUT_NO_SLOPE       (0xFF)
+
+typedef struct {
+        const int16_t *x;
+        const int16_t *y;
+        int16_t len;
+        uint8_t index_shift;
+        uint32_t index_recip;                   /* reciprocal of the spacing of x if even, else 0 */
+        uint32_t slope[SOCF_LUT_MAX_SIZE - 1];  /* |y1 - y0| / (x1 - x0) in Q(shift) */
+        uint8_t shift[SOCF_LUT_MAX_SIZE - 1];
+} socf_lut_t;
+
+/**
+ * \brief Set up a table for socf_lut_get().
+ *
+ * \details The table keeps pointers to x and y, which are to be set up again if y change.
+ *
+ * \param [out] lut table.
+ * \param [in] x values, in ascending order.
+ * \param [in] y values.
+ * \param [in] len number of points, up to SOCF_LUT_MAX_SIZE.
+ *
+ */
+void socf_lut_init(socf_lut_t *lut, const int16_t *x, const int16_t *y, int16_t len);
+
+/**
+ * \brief Interpolate a table set up with socf_lut_init().
+ *
+ * \details Outside x, the first or last segment is extrapolated.
+ *
+ * \param [in] lut table.
+ * \param [in] v x value.
+ *
+ * \return y value.
+ *
+ */
+int16_t socf_lut_get(const socf_lut_t *lut, int16_t v);
+
+/**
+ * \brief Find the segment of a value.
+ *
+ * \param [in] x values, in ascending order.
+ * \param [in] len number of points, at least 2.
+ * \param [in] v x value.
+ *
+ * \return index of the last x not above v, within 0 and len - 2.
+ *
+ */
+int16_t socf_lut_find(const int16_t *x, int16_t len, int16_t v);
+
+/**
+ * \brief Interpolate a table once.
+ *
+ * \details For tables looked up only once, interpolated with a divide. Outside x, the first or
+ *        last segment is extrapolated.
+ *
+ * \param [in] x values, in ascending order.
+ * \param [in] y values.
+ * \param [in] v x value.
+ * \param [in] len number of points.
+ *
+ * \return y value.
+ *
+ */
+int16_t socf_lut_interpolate(const int16_t *x, const int16_t *y, int16_t v, int16_t len);
+
+/**
+ * \brief Interpolate a table once, clamped.
+ *
+ * \details As socf_lut_interpolate(), but outside x the first or last y is returned.
+ *
+ * \param [in] x values, in ascending order.
+ * \param [in] y values.
+ * \param [in] v x value.
+ * \param [in] len number of points.
+ *
+ * \return y value.
+ *
+ */
+int16_t socf_lut_interpolate_clamped(const int16_t *x, const int16_t *y, int16_t v, int16_t len);
+
+#endif /* SOCF_LUT_H_ */
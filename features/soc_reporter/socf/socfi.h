@@ -37,7 +37,7 @@
 typedef struct {
         /* the number of temperature table */
         int16_t socf_temp_num;
-        /* the capacitance of a battery (mAh) */
+        /* the temperatures of the tables (C), in ascending order */
         const int16_t *socf_temp_p;
         /* the capacitance of a battery (mAh) */
         const int16_t *socf_cap_p;
@@ -0,0 +1,575 @@
+/**
+ ****************************************************************************************
+ *
+ * @file socf_lut_bench.c
+ *
+ * @brief Host check and benchmark of the SOC function lookup tables of socf_lut.c
+ *
+ * Copyright (C) 2015-2023 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+/*
+ * Checks that the lookups of socf_lut.c give bit-exact the same results as the original linear
+ * scan and divide (kept below as legacy_chk_lut() and legacy_get_lut()):
+ *  - over every value around each table of the profile, SOC to voltage and voltage to SOC, and
+ *    the voltage tables at currents from the high discharging to the charging current,
+ *  - over random tables, evenly spaced or not, with steep and flat segments,
+ *  - for every lookup made by socf.c while replaying a trace of samples through
+ *    socf_process_fg_cal(), socf.c being built in this file with its lookups checked.
+ * Values the original read past the end of the tables for are extrapolated, and only counted.
+ *
+ * Then measures the lookups as socf.c makes them, socf_lut_get() for SOC to voltage and
+ * socf_lut_interpolate() for voltage to SOC, against the original ones, and socf_process_fg_cal()
+ * over the trace, in CPU cycles on x86 (else in ns). The fastest of several rounds is kept. Cycles are of the host, not of the
+ * DA1469x, but show the ratio between the scan and divide and the multiply-shift.
+ *
+ * A trace is a CSV file of samples "duration_ms,vbat_mv,ibat_ma,charging,deg", lines not
+ * starting with a digit being skipped. The first sample starts the calculation. Without a
+ * trace, a discharge at 20 mA and a charge at 40 mA of the profile battery, 1 s apart with
+ * 30 minutes of rest in between, are replayed.
+ *
+ * Build with:
+ *      gcc -O2 -I. -I../socf -o socf_lut_bench socf_lut_bench.c ../socf/socf_lut.c
+ *
+ * Run examples:
+ *      ./socf_lut_bench                        (synthetic trace, 20 rounds)
+ *      ./socf_lut_bench -trace vbat.csv -rounds 50 -verbose
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "socf_lut.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICKS_UNIT      "cycles"
+#else
+#define TICKS_UNIT      "ns"
+#endif
+
+#define RANDOM_TABLES   5000
+#define TRACE_MAX       200000
+#define LOOKUP_CALLS    100000
+
+/* Lookups of socf.c go through the checks below */
+static int16_t checked_lut_get(const socf_lut_t *lut, int16_t v);
+static int16_t checked_lut_interpolate(const int16_t *x, const int16_t *y, int16_t v, int16_t len);
+static int16_t checked_lut_interpolate_clamped(const int16_t *x, const int16_t *y, int16_t v,
+                                                                                int16_t len);
+
+#define socf_lut_get                    checked_lut_get
+#define socf_lut_interpolate            checked_lut_interpolate
+#define socf_lut_interpolate_clamped    checked_lut_interpolate_clamped
+#include "socf.c"
+#undef socf_lut_get
+#undef socf_lut_interpolate
+#undef socf_lut_interpolate_clamped
+
+typedef struct {
+        uint32_t duration_ms;
+        uint16_t vbat;
+        int16_t ibat;
+        bool charging;
+        int16_t deg;
+} sample_t;
+
+static bool checking;
+static unsigned long checked;
+static unsigned long extrapolated;
+static unsigned long mismatches;
+
+static sample_t *trace;
+static int trace_len;
+
+/* socfi_chk_lut() of socf.c */
+static int16_t legacy_chk_lut(int16_t* x, int16_t* y, int16_t v, int16_t l)
+{
+        int16_t i;
+        int16_t ret;
+
+        for (i = 0; i < l; i++) {
+                if (v < x[i]) {
+                        break;
+                }
+        }
+        i--;
+
+        if (i < 0) {
+                i = 0;
+        }
+
+        ret = y[i] + (int16_t)(((int32_t)(v - x[i])
+                * (int32_t)(y[i + 1] - y[i]))
+                / (int32_t)(x[i + 1] - x[i]));
+
+        return ret;
+}
+
+/* socf_get_lut() of socf_hal.c, but for the cast of the product to int16_t before the divide */
+static int16_t legacy_get_lut(int16_t* x, int16_t* y, int16_t v, int16_t l)
+{
+        int16_t i;
+        int16_t ret;
+
+        if (v < x[0]) {
+                ret = y[0];
+        } else if (v >= x[l - 1]) {
+                ret = y[l - 1];
+        } else {
+                for (i = 1; i < l; i++) {
+                        if (v < x[i]) {
+                                break;
+                        }
+                }
+                ret = y[i - 1];
+                ret = ret + (int16_t)(((int32_t)(v - x[i - 1])
+                        * (int32_t)(y[i] - y[i - 1]))
+                        / (int32_t)(x[i] - x[i - 1]));
+        }
+        return ret;
+}
+
+static void check_value(const char *what, const int16_t *x, const int16_t *y, int16_t len,
+                                                                        int16_t v, int16_t ret)
+{
+        int16_t expected;
+
+        if (len < 2 || v > x[len - 1]) {
+                extrapolated++;
+                return;
+        }
+
+        /* The original read y[len] times 0 there */
+        expected = (v == x[len - 1]) ? y[len - 1] : legacy_chk_lut((int16_t *)x, (int16_t *)y, v,
+                                                                                        len);
+        checked++;
+        if (ret != expected) {
+                if (mismatches++ < 10) {
+                        printf("FAIL: %s at %d: %d != %d\n", what, v, ret, expected);
+                }
+        }
+}
+
+static int16_t checked_lut_get(const socf_lut_t *lut, int16_t v)
+{
+        int16_t ret = socf_lut_get(lut, v);
+
+        if (checking) {
+                check_value("socf_lut_get", lut->x, lut->y, lut->len, v, ret);
+        }
+        return ret;
+}
+
+static int16_t checked_lut_interpolate(const int16_t *x, const int16_t *y, int16_t v, int16_t len)
+{
+        int16_t ret = socf_lut_interpolate(x, y, v, len);
+
+        if (checking) {
+                check_value("socf_lut_interpolate", x, y, len, v, ret);
+        }
+        return ret;
+}
+
+static int16_t checked_lut_interpolate_clamped(const int16_t *x, const int16_t *y, int16_t v,
+                                                                                int16_t len)
+{
+        int16_t ret = socf_lut_interpolate_clamped(x, y, v, len);
+
+        if (checking) {
+                checked++;
+                if (ret != legacy_get_lut((int16_t *)x, (int16_t *)y, v, len)) {
+                        if (mismatches++ < 10) {
+                                printf("FAIL: socf_lut_interpolate_clamped at %d: %d\n", v, ret);
+                        }
+                }
+        }
+        return ret;
+}
+
+static uint64_t ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/* Every value from 500 below the table to its end, both ways */
+static void sweep_table(const int16_t *x, const int16_t *y, int16_t len)
+{
+        socf_lut_t lut;
+        int32_t v;
+
+        socf_lut_init(&lut, x, y, len);
+        for (v = x[0] - 500; v <= x[len - 1] + 100; v++) {
+                if (v < INT16_MIN || v > INT16_MAX) {
+                        continue;
+                }
+                checked_lut_get(&lut, v);
+                checked_lut_interpolate(x, y, v, len);
+                checked_lut_interpolate_clamped(x, y, v, len);
+        }
+}
+
+static void check_profile(void)
+{
+        int16_t vol[VOL2SOC_LUT_SIZE];
+        int16_t max_cur;
+        int16_t cur;
+        int t;
+        int i;
+
+        for (t = 0; t < socf_conf.socf_temp_num; t++) {
+                sweep_table(socfi_ref, socf_conf.socf_lluts_p[t], VOL2SOC_LUT_SIZE);
+                sweep_table(socfi_ref, socf_conf.socf_hluts_p[t], VOL2SOC_LUT_SIZE);
+                sweep_table(socfi_ref, socf_conf.socf_cluts_p[t], VOL2SOC_LUT_SIZE);
+                sweep_table(socf_conf.socf_lluts_p[t], socfi_ref, VOL2SOC_LUT_SIZE);
+                sweep_table(socf_conf.socf_hluts_p[t], socfi_ref, VOL2SOC_LUT_SIZE);
+                sweep_table(socf_conf.socf_cluts_p[t], socfi_ref, VOL2SOC_LUT_SIZE);
+
+                /* As socfi_get_soc_from_vbat_ibat_profile() */
+                for (cur = socf_conf.socf_dis_high; cur <= socf_conf.socf_chg_cc[0]; cur++) {
+                        const int16_t *max_volt_table = (cur < socf_conf.socf_dis_low) ?
+                                socf_conf.socf_hluts_p[t] : socf_conf.socf_cluts_p[t];
+
+                        max_cur = (cur < socf_conf.socf_dis_low) ? socf_conf.socf_dis_high :
+                                                                        socf_conf.socf_chg_cc[0];
+                        if (max_cur == socf_conf.socf_dis_low) {
+                                continue;
+                        }
+                        for (i = 0; i < VOL2SOC_LUT_SIZE; i++) {
+                                vol[i] = socf_conf.socf_lluts_p[t][i]
+                                        + ((cur - socf_conf.socf_dis_low)
+                                        * (max_volt_table[i] - socf_conf.socf_lluts_p[t][i]))
+                                        / (max_cur - socf_conf.socf_dis_low);
+                        }
+                        sweep_table(vol, socfi_ref, VOL2SOC_LUT_SIZE);
+                }
+        }
+
+        sweep_table(socf_conf.socf_temp_p, socf_conf.socf_cap_p, socf_conf.socf_temp_num);
+}
+
+static void check_random(void)
+{
+        int16_t x[SOCF_LUT_MAX_SIZE];
+        int16_t y[SOCF_LUT_MAX_SIZE];
+        int16_t len;
+        int16_t step;
+        int n;
+        int i;
+
+        for (n = 0; n < RANDOM_TABLES; n++) {
+                len = 2 + rand() % (SOCF_LUT_MAX_SIZE - 1);
+                step = 1 + rand() % ((n % 3) ? 100 : 1500);
+                x[0] = rand() % 8000 - 4000;
+                y[0] = rand() % 32000 - 16000;
+                for (i = 1; i < len; i++) {
+                        /* Evenly spaced one time out of three, else random with flat segments */
+                        if (n % 3 == 0) {
+                                x[i] = x[i - 1] + step;
+                        } else {
+                                x[i] = x[i - 1] + ((i > 1 && i < len - 1 && rand() % 20 == 0) ? 0 :
+                                                                        1 + rand() % 1500);
+                        }
+                        y[i] = (rand() % 8 == 0) ? y[i - 1] : rand() % 32000 - 16000;
+                }
+                sweep_table(x, y, len);
+        }
+}
+
+static void check_rlut(int16_t deg)
+{
+        int16_t cv_index;
+        int t;
+
+        for (t = 0; t < socf_conf.socf_temp_num; t++) {
+                if (socf_conf.socf_temp_p[t] != deg) {
+                        continue;
+                }
+
+                checked++;
+                if (memcmp(socfi_rlut, socf_conf.socf_lluts_p[t], sizeof(socfi_rlut))
+                        || memcmp(socfi_hlut, socf_conf.socf_hluts_p[t], sizeof(socfi_hlut))
+                        || memcmp(socfi_clut, socf_conf.socf_cluts_p[t], sizeof(socfi_clut))
+                        || memcmp(socfi_cur_comp_lut, socf_conf.socf_cur_comp[t],
+                                                                sizeof(socfi_cur_comp_lut))) {
+                        mismatches++;
+                        printf("FAIL: tables at %d C are not the ones of the profile\n", deg);
+                }
+
+                for (cv_index = VOL2SOC_LUT_SIZE - 1; cv_index >= 0; cv_index--) {
+                        if (socf_conf.socf_cluts_p[t][cv_index] < (socf_conf.socf_chg_cv - 5)) {
+                                break;
+                        }
+                }
+                if (cv_index >= 0 && cv_index != socfi_cv_index) {
+                        mismatches++;
+                        printf("FAIL: CV index %d != %d\n", socfi_cv_index, cv_index);
+                }
+        }
+}
+
+static int load_trace(const char *path)
+{
+        char line[128];
+        unsigned long duration;
+        int vbat, ibat, charging, deg;
+        FILE *f = fopen(path, "r");
+
+        if (!f) {
+                printf("Cannot open %s\n", path);
+                return 1;
+        }
+
+        while (fgets(line, sizeof(line), f) && trace_len < TRACE_MAX) {
+                if (line[0] < '0' || line[0] > '9') {
+                        continue;
+                }
+                if (sscanf(line, "%lu,%d,%d,%d,%d", &duration, &vbat, &ibat, &charging,
+                                                                                &deg) != 5) {
+                        printf("Bad sample: %s", line);
+                        fclose(f);
+                        return 1;
+                }
+                trace[trace_len].duration_ms = duration;
+                trace[trace_len].vbat = vbat;
+                trace[trace_len].ibat = ibat;
+                trace[trace_len].charging = charging;
+                trace[trace_len].deg = deg;
+                trace_len++;
+        }
+
+        fclose(f);
+        return trace_len ? 0 : 1;
+}
+
+static void add_sample(uint32_t duration_ms, int32_t soc, int16_t ibat, bool charging)
+{
+        const int16_t *lut = charging ? socf_conf.socf_cluts_p[0] : socf_conf.socf_hluts_p[0];
+        int16_t vbat;
+
+        vbat = socf_lut_interpolate_clamped(socfi_ref, lut, soc, VOL2SOC_LUT_SIZE);
+        if (vbat > socf_conf.socf_chg_cv) {
+                vbat = socf_conf.socf_chg_cv;
+        }
+        trace[trace_len].duration_ms = duration_ms;
+        trace[trace_len].vbat = vbat + rand() % 7 - 3;
+        trace[trace_len].ibat = ibat;
+        trace[trace_len].charging = charging;
+        trace[trace_len].deg = SOCF_REF_TEMP;
+        trace_len++;
+}
+
+static void make_trace(void)
+{
+        int16_t cap = socf_conf.socf_cap_p[0];
+        int32_t charge;
+
+        /* Charge left in mAs, to SOC in 0.1 %, from 99 % as the tables meet at 100 % */
+        charge = (int32_t)cap * 36 * 99;
+        add_sample(1000, 990, -20, false);
+        while (charge > 0 && trace_len < TRACE_MAX / 2) {
+                charge -= 20;
+                add_sample(1000, charge * 1000 / (cap * 3600), -20, false);
+        }
+
+        add_sample(1800001, 0, 0, false);
+        while (charge < (int32_t)cap * 3600 && trace_len < TRACE_MAX) {
+                charge += socf_conf.socf_chg_cc[0];
+                add_sample(1000, charge * 1000 / (cap * 3600), socf_conf.socf_chg_cc[0], true);
+        }
+}
+
+static uint64_t replay(int16_t *soc, bool verbose)
+{
+        uint64_t total = 0;
+        uint64_t t;
+        int i;
+
+        socfi_init();
+        socfi_soc_init_calculation(trace[0].vbat, trace[0].ibat, trace[0].charging, -1,
+                                                                                trace[0].deg);
+        if (checking) {
+                check_rlut(trace[0].deg);
+        }
+
+        for (i = 1; i < trace_len; i++) {
+                t = ticks();
+                socf_process_fg_cal(trace[i].duration_ms, trace[i].vbat, trace[i].ibat,
+                                                        trace[i].charging, trace[i].deg);
+                total += ticks() - t;
+
+                soc[i] = socfi_get_soc();
+                if (verbose && (i % 600 == 0 || i == trace_len - 1)) {
+                        printf("  %6d  vbat %4u  ibat %5d  %s  SOC %4d  lv_e %4d\n", i,
+                                trace[i].vbat, trace[i].ibat, trace[i].charging ? "chg" : "dis",
+                                soc[i], socfi_lv_e);
+                }
+        }
+
+        return total;
+}
+
+/* Lookups measured by bench_lookups() */
+typedef enum {
+        LOOKUP_SCAN,            /* legacy_chk_lut() */
+        LOOKUP_GET,             /* socf_lut_get(), as SOC to voltage in socf.c */
+        LOOKUP_INTERPOLATE,     /* socf_lut_interpolate(), as voltage to SOC in socf.c */
+} lookup_t;
+
+static uint64_t bench_lookups(lookup_t lookup, const int16_t *x, const int16_t *y, int32_t from,
+                                                                int32_t to, int rounds)
+{
+        volatile int32_t sum = 0;
+        uint64_t best = 0;
+        uint64_t t;
+        socf_lut_t lut;
+        int32_t v;
+        int n;
+        int r;
+
+        socf_lut_init(&lut, x, y, VOL2SOC_LUT_SIZE);
+        for (r = 0; r < rounds; r++) {
+                v = from;
+                t = ticks();
+                for (n = 0; n < LOOKUP_CALLS; n++) {
+                        switch (lookup) {
+                        case LOOKUP_SCAN:
+                                sum += legacy_chk_lut((int16_t *)x, (int16_t *)y, v,
+                                                                        VOL2SOC_LUT_SIZE);
+                                break;
+                        case LOOKUP_GET:
+                                sum += socf_lut_get(&lut, v);
+                                break;
+                        case LOOKUP_INTERPOLATE:
+                                sum += socf_lut_interpolate(x, y, v, VOL2SOC_LUT_SIZE);
+                                break;
+                        }
+                        if (++v >= to) {
+                                v = from;
+                        }
+                }
+                t = ticks() - t;
+                if (r == 0 || t < best) {
+                        best = t;
+                }
+        }
+
+        return best;
+}
+
+int main(int argc, char **argv)
+{
+        const char *path = NULL;
+        bool verbose = false;
+        int rounds = 20;
+        int16_t *soc_checked;
+        int16_t *soc;
+        uint64_t best = 0;
+        uint64_t t;
+        uint64_t t_legacy;
+        uint64_t t_new;
+        int arg;
+        int r;
+        int i;
+
+        for (arg = 1; arg < argc; arg++) {
+                if (!strcmp(argv[arg], "-trace") && arg + 1 < argc) {
+                        path = argv[++arg];
+                } else if (!strcmp(argv[arg], "-rounds") && arg + 1 < argc) {
+                        rounds = atoi(argv[++arg]);
+                } else if (!strcmp(argv[arg], "-verbose")) {
+                        verbose = true;
+                } else {
+                        printf("usage: %s [-trace <csv>] [-rounds <n>] [-verbose]\n", argv[0]);
+                        return 1;
+                }
+        }
+
+        trace = malloc(TRACE_MAX * sizeof(*trace));
+        soc_checked = malloc(TRACE_MAX * sizeof(*soc_checked));
+        soc = malloc(TRACE_MAX * sizeof(*soc));
+        if (!trace || !soc_checked || !soc || rounds < 1) {
+                return 1;
+        }
+
+        checking = true;
+        check_profile();
+        check_random();
+        printf("Check: %lu lookups over the profile and %d random tables, %lu extrapolated, "
+                "%lu mismatches\n", checked, RANDOM_TABLES, extrapolated, mismatches);
+
+        if (path ? load_trace(path) : (make_trace(), 0)) {
+                return 1;
+        }
+
+        checked = extrapolated = 0;
+        replay(soc_checked, verbose);
+        checking = false;
+        printf("Trace: %d samples, %lu lookups checked, %lu extrapolated, final SOC %d\n",
+                                                trace_len, checked, extrapolated, socfi_get_soc());
+
+        for (r = 0; r < rounds; r++) {
+                t = replay(soc, false);
+                if (r == 0 || t < best) {
+                        best = t;
+                }
+                for (i = 1; i < trace_len; i++) {
+                        if (soc[i] != soc_checked[i]) {
+                                printf("FAIL: SOC of sample %d changed between replays\n", i);
+                                return 1;
+                        }
+                }
+        }
+
+        printf("Best of %d rounds, in " TICKS_UNIT " per call:\n", rounds);
+        t_legacy = bench_lookups(LOOKUP_SCAN, socfi_ref, socf_conf.socf_lluts_p[0], 0, 1000,
+                                                                                        rounds);
+        t_new = bench_lookups(LOOKUP_GET, socfi_ref, socf_conf.socf_lluts_p[0], 0, 1000, rounds);
+        printf("  SOC to voltage      scan %6.1f  LUT %6.1f  speedup %5.2fx\n",
+                (double)t_legacy / LOOKUP_CALLS, (double)t_new / LOOKUP_CALLS,
+                (double)t_legacy / t_new);
+        t_legacy = bench_lookups(LOOKUP_SCAN, socf_conf.socf_lluts_p[0], socfi_ref,
+                socf_conf.socf_lluts_p[0][0], socf_conf.socf_lluts_p[0][VOL2SOC_LUT_SIZE - 1],
+                rounds);
+        t_new = bench_lookups(LOOKUP_INTERPOLATE, socf_conf.socf_lluts_p[0], socfi_ref,
+                socf_conf.socf_lluts_p[0][0], socf_conf.socf_lluts_p[0][VOL2SOC_LUT_SIZE - 1],
+                rounds);
+        printf("  voltage to SOC      scan %6.1f  LUT %6.1f  speedup %5.2fx\n",
+                (double)t_legacy / LOOKUP_CALLS, (double)t_new / LOOKUP_CALLS,
+                (double)t_legacy / t_new);
+        printf("  socf_process_fg_cal %6.1f\n", (double)best / (trace_len - 1));
+
+        free(soc);
+        free(soc_checked);
+        free(trace);
+
+        return mismatches ? 1 : 0;
+}
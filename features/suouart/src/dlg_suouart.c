@@ -39,10 +39,74 @@
 #include "suota.h"
 #include "sdk_crc16.h"
 #include "dlg_suouart.h"
+#include "suouart_crc.h"
 
 #define SUOUART_MAX_IMAGE_SIZE   (503 * 1024)
 #define SUOUART_BUFFER_SIZE      (512)
 
+/*
+ * Image data are written to flash by a separate task, so that more data can be received into the
+ * next buffer while one is written. Must be a power of two, from 2 to 128.
+ */
+#ifndef SUOUART_FLASH_BUFFERS
+#define SUOUART_FLASH_BUFFERS    (2)
+#endif
+
+/* Request indexes are free running uint8_t, taken modulo the number of buffers */
+#if (SUOUART_FLASH_BUFFERS < 2) || (SUOUART_FLASH_BUFFERS > 128) || \
+                                        (SUOUART_FLASH_BUFFERS & (SUOUART_FLASH_BUFFERS - 1))
+#error "SUOUART_FLASH_BUFFERS must be a power of two, from 2 to 128"
+#endif
+
+#define SUOUART_FLASH_TASK_PRIORITY    ( OS_TASK_PRIORITY_NORMAL )
+
+/*
+ * Resume checkpoints. Each time image data are written up to a multiple of SUOUART_RESUME_INTERVAL
+ * bytes, flash task appends a record of the image header, the address and the CRC up to it to a
+ * resume sector. After an interrupted transfer, the initiator asks with suouart_resume_req()
+ * where to continue, and sends only the rest of the image. Interval must be a multiple of the flash
+ * sector size, 0 disables checkpoints.
+ *
+ * The resume sector is the last SUOUART_RESUME_SIZE bytes of the update partition, i.e. the one of
+ * NVMS_FW_EXEC_PART and NVMS_FW_UPDATE_PART that is not running. It is reserved for checkpoints,
+ * so an image must end before it.
+ */
+#ifndef SUOUART_RESUME_INTERVAL
+#define SUOUART_RESUME_INTERVAL  (32 * 1024)
+#endif
+
+#define SUOUART_RESUME_SIZE      (AD_FLASH_SECTOR_SIZE)
+
+#define SUOUART_RESUME_MAGIC     (0x4D525553)   // "SURM"
+#define SUOUART_RESUME_SLOTS     (SUOUART_RESUME_SIZE / sizeof(suouart_resume_record_t))
+
+/*
+ * Delta images. After suouart_delta_req(), image data are received as operations rebuilding the
+ * image from the active one, each starting with a 32-bit little endian word:
+ *  - ADD, bit 31 clear: bits 0..30 give the number of image bytes following it
+ *  - COPY, bit 31 set: followed by a 32-bit little endian offset in the active image, from which
+ *    bits 0..30 give the number of image bytes
+ * Rebuilt data are processed as received ones of a full image, header and CRC checks included.
+ */
+#define SUOUART_DELTA_COPY       (0x80000000)
+#define SUOUART_DELTA_OP_SIZE    (8)
+
+/*
+ * Compressed images. After suouart_compress_req(), image data (or delta operations) are received
+ * as an LZ77 stream of tokens:
+ *
+ *   0LLLLLLL                           L + 1 literal bytes follow (1..128)
+ *   1LLLDDDD DDDDDDDD                  match of L + 3 bytes (3..9) at distance D + 1
+ *   1111DDDD DDDDDDDD LLLLLLLL         match of L + 10 bytes (10..265) at distance D + 1
+ *
+ * Matches reach at most SUOUART_LZ_WINDOW bytes back, so only that much of the decompressed
+ * stream is kept in RAM. Tokens may be split between chunks.
+ */
+#define SUOUART_LZ_CODEC         (0x01)
+#define SUOUART_LZ_WINDOW        (4096)
+#define SUOUART_LZ_MIN_MATCH     (3)
+#define SUOUART_LZ_TOKEN_SIZE    (3)
+
 /* Size of fixed-place data in product header (identifier ... length of flash config. section) */
 #define PH_STATIC_DATA_SIZE            (22)
 #define PH_UPDATE_FW_ADDRESS_OFFSET    (6)
@@ -145,6 +209,28 @@ typedef enum {
         SUOUART_MEM_SERVICE_EXIT   = 0xFF,
 } suouart_commands_t;
 
+typedef enum {
+        SUOUART_FLASH_REQ_SETUP,        // start of image at 'addr', 'len' bytes to erase ahead, checkpoints cleared
+        SUOUART_FLASH_REQ_RESUME,       // as SUOUART_FLASH_REQ_SETUP, checkpoints kept
+        SUOUART_FLASH_REQ_WRITE,        // write 'len' bytes of 'data' at 'addr'
+        SUOUART_FLASH_REQ_IMAGE,        // as SUOUART_FLASH_REQ_WRITE, and add written data to CRC
+} suouart_flash_req_type_t;
+
+typedef struct {
+        suouart_flash_req_type_t type;
+        uint8_t *data;
+        uint32_t addr;
+        uint32_t len;
+} suouart_flash_req_t;
+
+typedef struct {
+        uint32_t magic;
+        uint32_t addr;                  // image data are written up to this address
+        uint32_t crc;                   // CRC of image data up to 'addr', not final
+        suota_1_1_image_header_da1469x_t header;
+        uint32_t record_crc;            // CRC of record up to here
+} __attribute__((packed)) suouart_resume_record_t;
+
 typedef struct suouart_service suouart_service_t;
 
 /** SUOUART status callback during image transfer */
@@ -162,8 +248,9 @@ typedef struct suouart_service {
         suouart_chunk_cb_t chunk_cb;       // called on every 'patch_len' bytes of data received
         suouart_error_cb_t error_cb;       // called in case of error during image transfer
 
-        uint8_t *buffer;
+        uint8_t *buffer;                // buffer being filled, one of 'buffers'
         uint16_t buffer_len;
+        uint8_t *buffers;               // SUOUART_FLASH_BUFFERS buffers of SUOUART_BUFFER_SIZE bytes
 
         suota_1_1_image_header_da1469x_t header;
         uint32_t product_header_address;
@@ -175,6 +262,15 @@ typedef struct suouart_service {
         uint32_t recv_image_len;        // length of received image
         uint32_t flash_write_addr;      // flash address where data will be written to
         uint32_t flash_erase_addr;      // flash address which is not yet erased (assume everything prior to this address is erased)
+        volatile uint32_t flash_end_addr; // flash address up to which flash task erases ahead
+
+        /* Requests to flash task, owned by it from 'flash_req_tail' to 'flash_req_head' */
+        suouart_flash_req_t flash_req[SUOUART_FLASH_BUFFERS];
+        volatile uint8_t flash_req_head;
+        volatile uint8_t flash_req_tail;
+        volatile bool flash_error;      // a write failed, set by flash task until next image
+        OS_TASK flash_task;
+        OS_EVENT flash_done;            // signaled by flash task when a request is completed
         uint16_t pending_credits;       // number of credits to give back to app
 
         uint16_t patch_len;
@@ -183,6 +279,21 @@ typedef struct suouart_service {
         suouart_active_img_t active_img;
 
         nvms_t  nvms;
+        nvms_t  resume_nvms;            // update partition holding checkpoints, NULL if not supported
+        uint32_t resume_addr;           // address of resume sector in it
+
+        nvms_t  delta_base;             // active image partition for delta image, NULL for full image
+        uint32_t delta_base_len;        // length of active image
+        uint8_t delta_op[SUOUART_DELTA_OP_SIZE]; // operation being received
+        uint8_t delta_op_len;
+        uint32_t delta_len;             // ADD bytes still to be received
+
+        bool    lz;                     // image data are compressed
+        uint8_t *lz_history;            // last SUOUART_LZ_WINDOW bytes of decompressed data
+        uint32_t lz_pos;                // length of decompressed data
+        uint8_t lz_token[SUOUART_LZ_TOKEN_SIZE]; // token being received
+        uint8_t lz_token_len;
+        uint8_t lz_literals;            // literal bytes still to be received
 } suouart_service_t;
 
 typedef struct {
@@ -198,62 +309,8 @@ static suouart_notify_cb_t ext_notify_cb;
 
 static uint16_t suouart_external_status;
 
-static const uint32_t crc32_tab[] = {
-        0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
-        0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-        0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
-        0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-        0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
-        0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-        0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
-        0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-        0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
-        0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-        0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
-        0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-        0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
-        0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-        0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
-        0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-        0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
-        0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-        0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
-        0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-        0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
-        0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-        0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
-        0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-        0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
-        0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-        0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
-        0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-        0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
-        0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-        0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
-        0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-        0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
-        0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-        0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
-        0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-        0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
-        0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-        0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
-        0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-        0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
-        0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-        0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
-};
-
 static nvms_t suouart_open_suota_fw_partition(uint32_t* product_header_address);
 
-uint32_t suouart_update_crc(uint32_t crc, const uint8_t *data, size_t len)
-{
-        while (len--) {
-                crc = crc32_tab[(crc ^ *data++) & 0xff] ^ (crc >> 8);
-        }
-        return crc;
-}
-
 static inline uint16_t suouart_get_u16(const uint8_t *buffer)
 {
         return (buffer[0]) | (buffer[1] << 8);
@@ -401,12 +458,12 @@ static bool suouart_set_active_img_ptr(suouart_service_t *suota)
 
 }
 
-static void suouart_prepare_flash(suouart_service_t *suota, size_t write_size)
+static void suouart_prepare_flash(suouart_service_t *suota, uint32_t write_addr, size_t write_size)
 {
         uint32_t* absolute_start_addr;
         uint32_t* absolute_end_addr;
         bool already_erased = true;
-        uint32_t end_addr = suota->flash_write_addr + write_size - 1;
+        uint32_t end_addr = write_addr + write_size - 1;
         size_t erase_size;
 
         /* If flash is already erased in required range, do nothing */
@@ -440,6 +497,220 @@ static void suouart_prepare_flash(suouart_service_t *suota, size_t write_size)
         suota->flash_erase_addr++;
 }
 
+static void suouart_resume_clear(suouart_service_t *suota)
+{
+        uint32_t magic;
+
+        if (!suota->resume_nvms) {
+                return;
+        }
+
+        /* Records are appended from the start of the sector, it is erased if it begins with one */
+        if (ad_nvms_read(suota->resume_nvms, suota->resume_addr, (uint8_t *) &magic,
+                                sizeof(magic)) == sizeof(magic) && magic == SUOUART_RESUME_MAGIC) {
+                ad_nvms_erase_region(suota->resume_nvms, suota->resume_addr, SUOUART_RESUME_SIZE);
+        }
+}
+
+static void suouart_resume_save(suouart_service_t *suota, uint32_t addr, uint32_t crc)
+{
+        suouart_resume_record_t rec;
+        uint32_t magic;
+        uint32_t slot;
+
+        if (!suota->resume_nvms) {
+                return;
+        }
+
+        /* Sector not erased and holding no checkpoint is left as is, no checkpoint is saved */
+        if (ad_nvms_read(suota->resume_nvms, suota->resume_addr, (uint8_t *) &magic,
+                                                                sizeof(magic)) != sizeof(magic) ||
+                                (magic != 0xFFFFFFFF && magic != SUOUART_RESUME_MAGIC)) {
+                return;
+        }
+
+        for (slot = 0; slot < SUOUART_RESUME_SLOTS; slot++) {
+                if (ad_nvms_read(suota->resume_nvms, suota->resume_addr + slot * sizeof(rec),
+                                (uint8_t *) &magic, sizeof(magic)) == sizeof(magic) && magic == 0xFFFFFFFF) {
+                        break;
+                }
+        }
+
+        if (slot == SUOUART_RESUME_SLOTS) {
+                ad_nvms_erase_region(suota->resume_nvms, suota->resume_addr, SUOUART_RESUME_SIZE);
+                slot = 0;
+        }
+
+        rec.magic = SUOUART_RESUME_MAGIC;
+        rec.addr = addr;
+        rec.crc = crc;
+        memcpy(&rec.header, &suota->header, sizeof(rec.header));
+        rec.record_crc = suouart_crc32((const uint8_t *) &rec, offsetof(suouart_resume_record_t, record_crc));
+
+        ad_nvms_write(suota->resume_nvms, suota->resume_addr + slot * sizeof(rec), (const uint8_t *) &rec,
+                                                                                        sizeof(rec));
+}
+
+/* Get last checkpoint saved, if any */
+static bool suouart_resume_load(suouart_service_t *suota, suouart_resume_record_t *rec)
+{
+        suouart_resume_record_t slot_rec;
+        bool found = false;
+        uint32_t slot;
+
+        if (!suota->resume_nvms) {
+                return false;
+        }
+
+        for (slot = 0; slot < SUOUART_RESUME_SLOTS; slot++) {
+                if (ad_nvms_read(suota->resume_nvms, suota->resume_addr + slot * sizeof(slot_rec),
+                                (uint8_t *) &slot_rec, sizeof(slot_rec)) != sizeof(slot_rec)) {
+                        break;
+                }
+
+                if (slot_rec.magic == 0xFFFFFFFF) {
+                        break;
+                }
+
+                /* Skip record of which writing was interrupted */
+                if (slot_rec.magic == SUOUART_RESUME_MAGIC && slot_rec.record_crc ==
+                                suouart_crc32((const uint8_t *) &slot_rec,
+                                                offsetof(suouart_resume_record_t, record_crc))) {
+                        *rec = slot_rec;
+                        found = true;
+                }
+        }
+
+        return found;
+}
+
+/*
+ * Add written image data to CRC. A checkpoint is saved when data reach a multiple of
+ * SUOUART_RESUME_INTERVAL, with the CRC up to that address.
+ */
+static void suouart_update_image_crc(suouart_service_t *suota, uint32_t addr, const uint8_t *data,
+                                                                                uint32_t len)
+{
+#if SUOUART_RESUME_INTERVAL
+        uint32_t checkpoint = (addr + len) - ((addr + len) % SUOUART_RESUME_INTERVAL);
+
+        if (checkpoint > addr) {
+                suota->image_crc = suouart_crc32_update(suota->image_crc, data, checkpoint - addr);
+                suouart_resume_save(suota, checkpoint, suota->image_crc);
+
+                data += checkpoint - addr;
+                len -= checkpoint - addr;
+        }
+#endif
+        suota->image_crc = suouart_crc32_update(suota->image_crc, data, len);
+}
+
+/*
+ * Flash task, runs the requests queued by suouart_queue_flash_req(). When there is nothing to
+ * write, the sectors following the write address are erased ahead up to the end of the image. The
+ * NVMS driver erases in background and suspends the erase whenever code has to be executed from
+ * flash, so reception goes on meanwhile and the sectors are ready when data arrive.
+ */
+static bool suouart_flash_write(suouart_service_t *suota, const suouart_flash_req_t *req)
+{
+        int written;
+
+        suouart_prepare_flash(suota, req->addr, req->len);
+
+        written = ad_nvms_write(suota->nvms, req->addr, req->data, req->len);
+        if (written != req->len) {
+                return false;
+        }
+
+        if (req->type == SUOUART_FLASH_REQ_IMAGE) {
+                /* Calculate CRC based on the contents of NVMS */
+                if (ad_nvms_read(suota->nvms, req->addr, req->data, req->len) != req->len) {
+                        return false;
+                }
+                suouart_update_image_crc(suota, req->addr, req->data, req->len);
+        }
+
+        return true;
+}
+
+static void suouart_flash_task(void *params)
+{
+        suouart_service_t *suota = params;
+        const suouart_flash_req_t *req;
+
+        for (;;) {
+                if (suota->flash_req_tail == suota->flash_req_head) {
+                        if (suota->flash_erase_addr < suota->flash_end_addr) {
+                                suouart_prepare_flash(suota, suota->flash_erase_addr, 1);
+                        } else {
+                                OS_TASK_NOTIFY_WAIT(0, OS_TASK_NOTIFY_ALL_BITS, NULL,
+                                                                        OS_TASK_NOTIFY_FOREVER);
+                        }
+                        continue;
+                }
+
+                req = &suota->flash_req[suota->flash_req_tail % SUOUART_FLASH_BUFFERS];
+
+                switch (req->type) {
+                case SUOUART_FLASH_REQ_SETUP:
+                        suouart_resume_clear(suota);
+                        /* no break */
+                case SUOUART_FLASH_REQ_RESUME:
+                        suota->flash_erase_addr = req->addr;
+                        suota->flash_end_addr = req->addr + req->len;
+                        break;
+                case SUOUART_FLASH_REQ_WRITE:
+                case SUOUART_FLASH_REQ_IMAGE:
+                        if (!suota->flash_error && !suouart_flash_write(suota, req)) {
+                                suota->flash_error = true;
+                        }
+                        break;
+                }
+
+                suota->flash_req_tail++;
+                OS_EVENT_SIGNAL(suota->flash_done);
+        }
+}
+
+/*
+ * Queue request to flash task. Data of write requests are taken from the buffer being filled,
+ * which is handed over to flash task, and the next buffer is returned once it is free.
+ */
+static bool suouart_queue_flash_req(suouart_service_t *suota, suouart_flash_req_type_t type,
+                                                                        uint32_t addr, uint32_t len)
+{
+        suouart_flash_req_t *req = &suota->flash_req[suota->flash_req_head % SUOUART_FLASH_BUFFERS];
+
+        req->type = type;
+        req->data = suota->buffer;
+        req->addr = addr;
+        req->len = len;
+
+        suota->flash_req_head++;
+        OS_TASK_NOTIFY(suota->flash_task, 1, OS_NOTIFY_SET_BITS);
+
+        while ((uint8_t) (suota->flash_req_head - suota->flash_req_tail) == SUOUART_FLASH_BUFFERS) {
+                OS_EVENT_WAIT(suota->flash_done, OS_EVENT_FOREVER);
+        }
+
+        if (suota->buffers) {
+                suota->buffer = suota->buffers +
+                        (suota->flash_req_head % SUOUART_FLASH_BUFFERS) * SUOUART_BUFFER_SIZE;
+        }
+
+        return !suota->flash_error;
+}
+
+/* Wait until flash task has run all queued requests */
+static bool suouart_flush_flash_reqs(suouart_service_t *suota)
+{
+        while (suota->flash_req_tail != suota->flash_req_head) {
+                OS_EVENT_WAIT(suota->flash_done, OS_EVENT_FOREVER);
+        }
+
+        return !suota->flash_error;
+}
+
 static void suouart_error_cb(suouart_service_t *suouart, suouart_status_t status)
 {
         //OS_ASSERT(0);
@@ -498,9 +769,15 @@ static uint32_t suouart_get_exec_location(suota_1_1_image_header_da1469x_t *hdr)
 
 static bool suouart_validate_img_size(suouart_service_t *suota)
 {
+        uint32_t size = ad_nvms_get_size(suota->nvms);
+
+        /* Resume sector at the end of update partition is not available for image */
+        if (suota->nvms == suota->resume_nvms) {
+                size = suota->resume_addr;
+        }
 
         /* SUOTA 1.1 header + header extension + application code */
-        return suouart_get_exec_location(&suota->header) + suouart_get_code_size(&suota->header) <= ad_nvms_get_size(suota->nvms);
+        return suouart_get_exec_location(&suota->header) + suouart_get_code_size(&suota->header) <= size;
 }
 
 static bool suouart_state_w4_header(suouart_service_t *suota)
@@ -545,8 +822,12 @@ static bool suouart_state_w4_header(suouart_service_t *suota)
 //                return true;
 //        }
 
-        /* Erase flash for header, but don't write now - postpone until image is downloaded */
-        suouart_prepare_flash(suota, sizeof(suota->header));
+        /*
+         * Let flash task erase ahead up to the end of image, including the header, which is not
+         * written now - postpone until image is downloaded
+         */
+        suouart_queue_flash_req(suota, SUOUART_FLASH_REQ_SETUP, suota->flash_write_addr,
+                suouart_get_exec_location(&suota->header) + suouart_get_code_size(&suota->header));
         suota->flash_write_addr += sizeof(suota->header);
 
         suota->state = SUOUART_STATE_W4_HEADER_EXT;
@@ -556,48 +837,39 @@ static bool suouart_state_w4_header(suouart_service_t *suota)
 
 static bool suouart_state_w4_header_ext(suouart_service_t *suota)
 {
-        int written;
+        uint16_t len = suota->buffer_len;
 
         /* Write header extension before image's data */
-        suouart_prepare_flash(suota, suota->buffer_len);
-        written = ad_nvms_write(suota->nvms, suota->flash_write_addr, suota->buffer, suota->buffer_len);
-        if (written < 0) {
+        if (!suouart_queue_flash_req(suota, SUOUART_FLASH_REQ_WRITE, suota->flash_write_addr, len)) {
                 return false;
         }
 
-        suota->flash_write_addr += written;
-        suota->recv_hdr_ext_len += written;
+        suota->flash_write_addr += len;
+        suota->recv_hdr_ext_len += len;
 
         if (suota->recv_hdr_ext_len == suouart_get_exec_location(&suota->header) - sizeof(suota->header)) {
                 suota->state = SUOUART_STATE_W4_IMAGE_DATA;
         }
 
-        return (written == suota->buffer_len);
+        return true;
 }
 
 static bool suouart_state_w4_image_data(suouart_service_t *suota)
 {
-        int write_count;
-        int read_count;
+        uint16_t len = suota->buffer_len;
 
-        suouart_prepare_flash(suota, suota->buffer_len);
+        /* Written and added to CRC by flash task, while next data are received */
+        if (!suouart_queue_flash_req(suota, SUOUART_FLASH_REQ_IMAGE, suota->flash_write_addr, len)) {
+                return false;
+        }
 
-        write_count = ad_nvms_write(suota->nvms, suota->flash_write_addr, suota->buffer, suota->buffer_len);
-        if (write_count == suota->buffer_len) {
-                /* Calculate CRC based on the contents of NVMS */
-                read_count = ad_nvms_read(suota->nvms, suota->flash_write_addr, suota->buffer, suota->buffer_len);
-                if (read_count == suota->buffer_len) {
-                        suota->flash_write_addr += write_count;
-                        suota->image_crc = suouart_update_crc(suota->image_crc, suota->buffer, write_count);
-                        suota->recv_image_len += write_count;
-                        if (suota->recv_image_len == suouart_get_code_size(&suota->header)) {
-                                suota->state = SUOUART_STATE_DONE;
-                        }
-                        return true;
-                }
+        suota->flash_write_addr += len;
+        suota->recv_image_len += len;
+        if (suota->recv_image_len == suouart_get_code_size(&suota->header)) {
+                suota->state = SUOUART_STATE_DONE;
         }
 
-        return false;
+        return true;
 }
 
 static bool suouart_process_patch_data(suouart_service_t *suouart, const uint8_t *data, size_t len, size_t *consumed)
@@ -676,6 +948,173 @@ static bool suouart_process_patch_data(suouart_service_t *suouart, const uint8_t
         return ret;
 }
 
+/* Rebuild image data from delta operations, see SUOUART_DELTA_COPY */
+static bool suouart_process_delta_data(suouart_service_t *suouart, const uint8_t *data, size_t len,
+                                                                                size_t *consumed)
+{
+        const uint8_t *src;
+        uint32_t op_size;
+        uint32_t copy_len;
+        uint32_t offset;
+        size_t copied = 0;
+        size_t done;
+        bool ret = true;
+
+        /* Bytes of ADD go through as they are */
+        if (suouart->delta_len) {
+                if (len > suouart->delta_len) {
+                        len = suouart->delta_len;
+                }
+
+                ret = suouart_process_patch_data(suouart, data, len, consumed);
+                suouart->delta_len -= *consumed;
+
+                return ret;
+        }
+
+        /* Operation may be split between chunks, so it is collected first, offset of COPY too */
+        op_size = (suouart->delta_op_len >= 4 && (suouart->delta_op[3] & 0x80)) ? 8 : 4;
+        *consumed = op_size - suouart->delta_op_len;
+        if (*consumed > len) {
+                *consumed = len;
+        }
+
+        memcpy(&suouart->delta_op[suouart->delta_op_len], data, *consumed);
+        suouart->delta_op_len += *consumed;
+
+        if (suouart->delta_op_len < op_size || (op_size == 4 && (suouart->delta_op[3] & 0x80))) {
+                return true;
+        }
+
+        suouart->delta_op_len = 0;
+
+        if (!(suouart->delta_op[3] & 0x80)) {
+                suouart->delta_len = suouart_get_u32(suouart->delta_op);
+                return true;
+        }
+
+        copy_len = suouart_get_u32(suouart->delta_op) & ~SUOUART_DELTA_COPY;
+        offset = suouart_get_u32(&suouart->delta_op[4]);
+
+        /* Active image is mapped, its data are processed straight from flash */
+        if (offset > suouart->delta_base_len || copy_len > suouart->delta_base_len - offset ||
+                ad_nvms_get_pointer(suouart->delta_base, offset, copy_len,
+                                                        (const void **) &src) != copy_len) {
+                suouart->error_cb(suouart, SUOUART_EXT_MEM_READ_ERR);
+                return false;
+        }
+
+        for (done = 0; ret && done < copy_len; done += copied) {
+                ret = suouart_process_patch_data(suouart, src + done, copy_len - done, &copied);
+        }
+
+        return ret;
+}
+
+/* Process image data or delta operations, all of them unless an error occurs */
+static bool suouart_process_stream_data(suouart_service_t *suouart, const uint8_t *data, size_t len,
+                                                                                size_t *consumed)
+{
+        bool ret;
+
+        *consumed = 0;
+
+        do {
+                size_t n = 0;
+
+                if (suouart->delta_base) {
+                        ret = suouart_process_delta_data(suouart, data + *consumed, len - *consumed, &n);
+                } else {
+                        ret = suouart_process_patch_data(suouart, data + *consumed, len - *consumed, &n);
+                }
+                *consumed += n;
+        } while (ret && *consumed < len);
+
+        return ret;
+}
+
+/* Decompress received data, see SUOUART_LZ_WINDOW */
+static bool suouart_process_lz_data(suouart_service_t *suouart, const uint8_t *data, size_t len,
+                                                                                size_t *consumed)
+{
+        const uint8_t *end = data + len;
+        uint32_t offset;
+        uint32_t dist;
+        uint32_t n;
+        size_t done;
+
+        *consumed = 0;
+
+        while (data < end) {
+                /* Literals go through as they are, and are kept for matches to come */
+                if (suouart->lz_literals) {
+                        n = MIN((uint32_t) (end - data), suouart->lz_literals);
+                        offset = suouart->lz_pos & (SUOUART_LZ_WINDOW - 1);
+                        if (n > SUOUART_LZ_WINDOW - offset) {
+                                n = SUOUART_LZ_WINDOW - offset;
+                        }
+
+                        memcpy(&suouart->lz_history[offset], data, n);
+                        if (!suouart_process_stream_data(suouart, data, n, &done)) {
+                                return false;
+                        }
+
+                        suouart->lz_pos += n;
+                        suouart->lz_literals -= n;
+                        data += n;
+                        *consumed += n;
+                        continue;
+                }
+
+                suouart->lz_token[suouart->lz_token_len++] = *data++;
+                *consumed += 1;
+
+                if (!(suouart->lz_token[0] & 0x80)) {
+                        suouart->lz_literals = suouart->lz_token[0] + 1;
+                        suouart->lz_token_len = 0;
+                        continue;
+                }
+
+                if (suouart->lz_token_len < ((suouart->lz_token[0] & 0xF0) == 0xF0 ? 3 : 2)) {
+                        continue;
+                }
+                suouart->lz_token_len = 0;
+
+                n = ((suouart->lz_token[0] >> 4) & 0x07) + SUOUART_LZ_MIN_MATCH;
+                if (n == SUOUART_LZ_MIN_MATCH + 7) {
+                        n += suouart->lz_token[2];
+                }
+                dist = (((suouart->lz_token[0] & 0x0F) << 8) | suouart->lz_token[1]) + 1;
+
+                /* Match must not reach before start of stream */
+                if (dist > suouart->lz_pos) {
+                        suouart->error_cb(suouart, SUOUART_APP_ERROR);
+                        return false;
+                }
+
+                /* Byte by byte, since a match may overlap the data it produces */
+                while (n) {
+                        uint32_t chunk;
+
+                        offset = suouart->lz_pos & (SUOUART_LZ_WINDOW - 1);
+                        chunk = MIN(n, SUOUART_LZ_WINDOW - offset);
+                        for (uint32_t k = 0; k < chunk; k++) {
+                                suouart->lz_history[offset + k] =
+                                        suouart->lz_history[(suouart->lz_pos + k - dist) & (SUOUART_LZ_WINDOW - 1)];
+                        }
+
+                        if (!suouart_process_stream_data(suouart, &suouart->lz_history[offset], chunk, &done)) {
+                                return false;
+                        }
+
+                        suouart->lz_pos += chunk;
+                        n -= chunk;
+                }
+        }
+
+        return true;
+}
+
 static bool suouart_handle_patch_data(suouart_service_t *suouart, const uint8_t *data, size_t recv_len)
 {
         size_t len = 0;
@@ -687,12 +1126,11 @@ static bool suouart_handle_patch_data(suouart_service_t *suouart, const uint8_t
 
         suouart->recv_total_len += recv_len;
 
-        do {
-                size_t consumed = 0;
-
-                ret = suouart_process_patch_data(suouart, data + len, recv_len - len, &consumed);
-                len += consumed;
-        } while (ret && len < recv_len);
+        if (suouart->lz) {
+                ret = suouart_process_lz_data(suouart, data, recv_len, &len);
+        } else {
+                ret = suouart_process_stream_data(suouart, data, recv_len, &len);
+        }
 
         if (suouart->chunk_cb) {
                 suouart->chunk_len += len;
@@ -723,28 +1161,36 @@ static suouart_error_t suouart_do_mem_dev_write(suouart_service_t *suouart, uint
 
         if (cmd < SUOUART_MEM_INVAL_DEV) {
                 suouart->flash_write_addr = suouart_get_update_addr(suouart);
-                suouart->flash_erase_addr = suouart->flash_write_addr;
         }
 
         switch (cmd) {
         case SUOUART_IMG_SPI_FLASH:
-                if (!suouart->buffer)
-                        suouart->buffer = OS_MALLOC((sizeof(uint8_t) * SUOUART_BUFFER_SIZE) + 2);
+                /* Stop erasing ahead for previous image, if any */
+                suouart_flush_flash_reqs(suouart);
+                suouart->flash_end_addr = 0;
+                suouart->flash_error = false;
 
-                if (!suouart->buffer) {
+                if (!suouart->buffers)
+                        suouart->buffers = OS_MALLOC((sizeof(uint8_t) * SUOUART_BUFFER_SIZE) * SUOUART_FLASH_BUFFERS);
+
+                if (!suouart->buffers) {
                         suouart_notify_client_status(suouart, SUOUART_SRV_EXIT);
                         return SUOUART_ERROR_OK;
                 }
 
+                suouart->buffer = suouart->buffers +
+                        (suouart->flash_req_head % SUOUART_FLASH_BUFFERS) * SUOUART_BUFFER_SIZE;
 
                 suouart->recv_hdr_ext_len = 0;
+                suouart->delta_base = NULL;
+                suouart->lz = false;
 
                 suouart->buffer_len = 0;
                 suouart->state = SUOUART_STATE_W4_HEADER;
                 suouart->chunk_len = 0;
                 suouart->recv_total_len = 0;
                 suouart->recv_image_len = 0;
-                suouart->image_crc = 0xFFFFFFFF;
+                suouart->image_crc = SUOUART_CRC32_INIT;
 
                 suouart_notify_client_status(suouart, SUOUART_IMG_STARTED);
 
@@ -756,7 +1202,17 @@ static suouart_error_t suouart_do_mem_dev_write(suouart_service_t *suouart, uint
                 break;
 
         case SUOUART_IMG_END:
-                suouart->image_crc ^= 0xFFFFFFFF;
+                if (!suouart_flush_flash_reqs(suouart)) {
+                        suouart_notify_client_status(suouart, SUOUART_EXT_MEM_WRITE_ERR);
+                        break;
+                }
+
+                suouart->image_crc = suouart_crc32_final(suouart->image_crc);
+
+                /* Image is checked, its checkpoints are not needed anymore */
+                suouart_queue_flash_req(suouart, SUOUART_FLASH_REQ_SETUP, 0, 0);
+                suouart_flush_flash_reqs(suouart);
+
                 if (suouart->image_crc != suouart->header.crc) {
                         suouart_notify_client_status(suouart, SUOUART_CRC_ERR);
                 } else {
@@ -785,11 +1241,20 @@ static suouart_error_t suouart_do_mem_dev_write(suouart_service_t *suouart, uint
                 break;
 
         case SUOUART_MEM_SERVICE_EXIT:
-                if (suouart->buffer) {
-                        OS_FREE(suouart->buffer);
+                suouart_flush_flash_reqs(suouart);
+                suouart->flash_end_addr = 0;
+
+                if (suouart->buffers) {
+                        OS_FREE(suouart->buffers);
+                        suouart->buffers = NULL;
                         suouart->buffer = NULL;
                 }
 
+                if (suouart->lz_history) {
+                        OS_FREE(suouart->lz_history);
+                        suouart->lz_history = NULL;
+                }
+
                 suouart_notify_client_status(suouart, SUOUART_SRV_EXIT);
                 break;
         }
@@ -832,6 +1297,129 @@ static suouart_error_t suouart_do_patch_len_write(suouart_service_t *suouart, ui
         return SUOUART_ERROR_OK;
 }
 
+static suouart_error_t suouart_do_resume(suouart_service_t *suota, uint16_t length,
+                                                const uint8_t *value, uint32_t *offset)
+{
+        suouart_resume_record_t rec;
+        uint32_t exec_location;
+        uint32_t end_addr;
+
+        *offset = 0;
+
+        if (length < sizeof(suota->header)) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        /* Image must be started, with no data received yet */
+        if (suota->state != SUOUART_STATE_W4_HEADER || suota->buffer_len) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        /* Without checkpoint of this image, whole image is to be sent */
+        if (!suouart_resume_load(suota, &rec) || memcmp(&rec.header, value, sizeof(rec.header))) {
+                return SUOUART_ERROR_OK;
+        }
+
+        if (NULL == (suota->nvms = suouart_open_suota_fw_partition(NULL))) {
+                return SUOUART_ERROR_OK;
+        }
+
+        memcpy(&suota->header, &rec.header, sizeof(suota->header));
+        exec_location = suouart_get_exec_location(&suota->header);
+        end_addr = exec_location + suouart_get_code_size(&suota->header);
+
+        if (rec.addr < exec_location || rec.addr > end_addr || !suouart_validate_img_size(suota)) {
+                return SUOUART_ERROR_OK;
+        }
+
+        /* Header extension and image data up to checkpoint are in flash, continue from there */
+        suota->flash_write_addr = rec.addr;
+        suota->recv_hdr_ext_len = exec_location - sizeof(suota->header);
+        suota->recv_image_len = rec.addr - exec_location;
+        suota->recv_total_len = rec.addr;
+        suota->image_crc = rec.crc;
+        suota->state = (rec.addr == end_addr) ? SUOUART_STATE_DONE : SUOUART_STATE_W4_IMAGE_DATA;
+
+        /* Data written after checkpoint are erased again */
+        suouart_queue_flash_req(suota, SUOUART_FLASH_REQ_RESUME, rec.addr, end_addr - rec.addr);
+
+        *offset = rec.addr;
+
+        return SUOUART_ERROR_OK;
+}
+
+static nvms_t suouart_open_active_fw_partition(suouart_service_t *suota)
+{
+        switch (suota->active_img) {
+        case SUOUART_ACTIVE_IMG_FIRST:
+                return ad_nvms_open(NVMS_FW_EXEC_PART);
+        case SUOUART_ACTIVE_IMG_SECOND:
+                return ad_nvms_open(NVMS_FW_UPDATE_PART);
+        default:
+                return NULL;
+        }
+}
+
+static suouart_error_t suouart_do_delta(suouart_service_t *suota, uint16_t length, const uint8_t *value)
+{
+        suota_1_1_image_header_da1469x_t base_header;
+        nvms_t base;
+
+        if (length < sizeof(base_header)) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        /* Image must be started, with no data received yet */
+        if (suota->state != SUOUART_STATE_W4_HEADER || suota->buffer_len) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        base = suouart_open_active_fw_partition(suota);
+        if (!base || ad_nvms_read(base, 0, (uint8_t *) &base_header,
+                                                sizeof(base_header)) != sizeof(base_header)) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        /* Delta must have been made against the active image */
+        if (!suouart_validate_img_hdr(&base_header) || memcmp(&base_header, value, sizeof(base_header))) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        suota->delta_base = base;
+        suota->delta_base_len = suouart_get_exec_location(&base_header) + suouart_get_code_size(&base_header);
+        suota->delta_op_len = 0;
+        suota->delta_len = 0;
+
+        return SUOUART_ERROR_OK;
+}
+
+static suouart_error_t suouart_do_compress(suouart_service_t *suota, uint16_t length, const uint8_t *value)
+{
+        if (length < 1 || value[0] != SUOUART_LZ_CODEC) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        /* Image must be started, decompression starts with next data */
+        if (!suota->buffer || suota->state == SUOUART_STATE_IDLE || suota->state == SUOUART_STATE_ERROR ||
+                                                                                        suota->lz) {
+                return SUOUART_ERROR_APPLICATION_ERROR;
+        }
+
+        if (!suota->lz_history) {
+                suota->lz_history = OS_MALLOC(SUOUART_LZ_WINDOW);
+                if (!suota->lz_history) {
+                        return SUOUART_ERROR_APPLICATION_ERROR;
+                }
+        }
+
+        suota->lz = true;
+        suota->lz_pos = 0;
+        suota->lz_token_len = 0;
+        suota->lz_literals = 0;
+
+        return SUOUART_ERROR_OK;
+}
+
 static suouart_error_t suouart_do_patch_data_write(suouart_service_t *suouart, uint16_t offset, uint16_t length, const uint8_t *value)
 {
         bool ret;
@@ -861,6 +1449,21 @@ suouart_error_t suouart_read_req(suouart_write_request_t req, uint32_t *value)
         return status;
 }
 
+suouart_error_t suouart_resume_req(uint16_t length, const uint8_t *value, uint32_t *offset)
+{
+        return suouart_do_resume(pSUoUART_svc, length, value, offset);
+}
+
+suouart_error_t suouart_delta_req(uint16_t length, const uint8_t *value)
+{
+        return suouart_do_delta(pSUoUART_svc, length, value);
+}
+
+suouart_error_t suouart_compress_req(uint16_t length, const uint8_t *value)
+{
+        return suouart_do_compress(pSUoUART_svc, length, value);
+}
+
 suouart_error_t suouart_write_req(suouart_write_request_t req, uint16_t offset, uint16_t length, const uint8_t *value)
 {
         suouart_error_t status = SUOUART_ERROR_ATTRIBUTE_NOT_FOUND;
@@ -965,13 +1568,21 @@ static nvms_t suouart_open_suota_fw_partition(uint32_t* product_header_address)
 
 static suouart_active_img_t get_active_img(nvms_t nvms)
 {
-        return SUOUART_ACTIVE_IMG_FIRST;
+        /* 'nvms' is the partition for update, active image is in the other one */
+        if (nvms == ad_nvms_open(NVMS_FW_UPDATE_PART)) {
+                return SUOUART_ACTIVE_IMG_FIRST;
+        } else if (nvms == ad_nvms_open(NVMS_FW_EXEC_PART)) {
+                return SUOUART_ACTIVE_IMG_SECOND;
+        }
+
+        return SUOUART_ACTIVE_IMG_ERROR;
 }
 
 int suouart_init(suouart_notify_cb_t cb)
 {
         nvms_t nvms = NULL;
         suouart_active_img_t img;
+        OS_BASE_TYPE status;
 
         uint32_t product_header_address;
 
@@ -992,6 +1603,22 @@ int suouart_init(suouart_notify_cb_t cb)
         pSUoUART_svc->active_img = img;
         pSUoUART_svc->product_header_address = product_header_address;
 
+#if SUOUART_RESUME_INTERVAL
+        pSUoUART_svc->resume_nvms = nvms;
+        pSUoUART_svc->resume_addr = ad_nvms_get_size(nvms) - SUOUART_RESUME_SIZE;
+#endif
+
+        OS_EVENT_CREATE(pSUoUART_svc->flash_done);
+
+        status = OS_TASK_CREATE("SuoUartFlash",         /* The text name assigned to the task, for
+                                                           debug only; not used by the kernel. */
+                        suouart_flash_task,             /* The function that implements the task. */
+                        pSUoUART_svc,                   /* The parameter passed to the task. */
+                        2048,                           /* The number of bytes to allocate to the
+                                                           stack of the task. */
+                        SUOUART_FLASH_TASK_PRIORITY,    /* The priority assigned to the task. */
+                        pSUoUART_svc->flash_task);      /* The task handle. */
+        OS_ASSERT(status == OS_TASK_CREATE_SUCCESS);
 
         return 1;
 }
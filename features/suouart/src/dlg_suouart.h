@@ -72,22 +72,51 @@ suouart_error_t suouart_write_req(suouart_write_request_t req, uint16_t offset,
 suouart_error_t suouart_read_req(suouart_write_request_t req, uint32_t *value);
 
 /**
- * Initialization of SUOUART Service instance
+ * Resume interrupted image transfer
+ *
+ * To be requested after image is started with SUOUART_WRITE_MEMDEV, before any image data. If a
+ * checkpoint of the image with the given header was saved, image data are expected from it.
+ *
+ * \param [in]  length length of value, at least size of image header
+ * \param [in]  value  start of image, with its header
+ * \param [out] offset offset in image to send data from, 0 if whole image is to be sent
  *
  * \return error
  */
-int suouart_init(suouart_notify_cb_t cb);
+suouart_error_t suouart_resume_req(uint16_t length, const uint8_t *value, uint32_t *offset);
 
 /**
- * Update CRC
+ * Receive image as delta against active image
  *
- * param [in] crc current value of CRC
- * param [in] data pointer to data to compute CRC over
- * param [in] len number of bytes pointed by data
+ * To be requested after image is started with SUOUART_WRITE_MEMDEV, before any image data. Image
+ * data are then operations rebuilding the image from the active one (see dlg_suouart.c).
  *
- * \return new value of CRC
+ * \param [in]  length length of value, at least size of image header
+ * \param [in]  value  start of image the delta was made against, with its header
  *
+ * \return error, SUOUART_ERROR_APPLICATION_ERROR if active image is not the given one
  */
-uint32_t suouart_update_crc(uint32_t crc, const uint8_t *data, size_t len);
+suouart_error_t suouart_delta_req(uint16_t length, const uint8_t *value);
+
+/**
+ * Receive compressed image data
+ *
+ * To be requested after image is started with SUOUART_WRITE_MEMDEV, and after any resume or delta
+ * request. Image data (or delta operations) are then received compressed (see dlg_suouart.c), and
+ * checked once decompressed.
+ *
+ * \param [in]  length length of value, 1
+ * \param [in]  value  codec, only 0x01 (LZ77 with 4 KB window) is supported
+ *
+ * \return error, SUOUART_ERROR_APPLICATION_ERROR if codec is not supported
+ */
+suouart_error_t suouart_compress_req(uint16_t length, const uint8_t *value);
+
+/**
+ * Initialization of SUOUART Service instance
+ *
+ * \return error
+ */
+int suouart_init(suouart_notify_cb_t cb);
 #endif
 #endif /* DLG_SUOUART_H_ */
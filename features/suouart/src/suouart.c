@@ -50,6 +50,7 @@
 #include "platform_devices.h"
 
 #include "dlg_suouart.h"
+#include "suouart_crc.h"
 
 
 /* Calculate CLI overhead:
@@ -68,6 +69,61 @@ it can be less for other commands, but we expect to have to receive and work on
 RX buffer's worth when pulling in data for SUOUART */
 #define CLI_BUFF_SIZE           (SUOUART_BUFFER_SIZE + CLI_PATCH_DATA_CMD_SZ)
 
+/*
+ * Binary frames of the firmware update ('fwupdatebin' command), received in the CLI buffer:
+ *
+ *      sync (1) | type (1) | sequence number (1) | payload length (2, LE) | payload | CRC32 (4, LE)
+ *
+ * The CRC covers type to payload. Payload is binary, up to SUOUART_BUFFER_SIZE bytes. Responses
+ * are the same lines as for the CLI, a bad frame is answered with "ERROR FRAME_CRC <seq>", or
+ * "ERROR FRAME_SEQ <seq>" if not the expected one, and must be sent again.
+ *
+ * The host may send several PATCH_DATA frames without waiting for a response. Each one written is
+ * acknowledged with "ACK <seq>", which also acknowledges all frames before it. Frames following a
+ * lost one are discarded, reporting "ERROR FRAME_SEQ <seq>" once, so the host sends them again from
+ * the lost one. A frame received again after it was written is acknowledged again.
+ *
+ * Without any frame for SUOUART_FRAME_IDLE_TIMEOUT_MS, e.g. host gone while sending an image, the
+ * CLI is back, so that the transfer can be resumed later (see suouart_resume_req()).
+ */
+#define SUOUART_FRAME_SYNC              0xA5
+#define SUOUART_FRAME_HDR_SIZE          4       /* following sync */
+#define SUOUART_FRAME_CRC_SIZE          4
+#define SUOUART_FRAME_MAX_SIZE          (1 + SUOUART_FRAME_HDR_SIZE + SUOUART_BUFFER_SIZE + SUOUART_FRAME_CRC_SIZE)
+#define SUOUART_FRAME_TIMEOUT_MS        1000
+#define SUOUART_FRAME_IDLE_TIMEOUT_MS   10000
+
+typedef enum {
+        SUOUART_FRAME_WRITE_STATUS      = 0x01,
+        SUOUART_FRAME_MEM_DEV           = 0x02,
+        SUOUART_FRAME_GPIO_MAP          = 0x03,
+        SUOUART_FRAME_PATCH_LEN         = 0x04,
+        SUOUART_FRAME_PATCH_DATA        = 0x05,
+        SUOUART_FRAME_READ_STATUS       = 0x06,
+        SUOUART_FRAME_READ_MEMINFO      = 0x07,
+        SUOUART_FRAME_RESUME            = 0x08,
+        SUOUART_FRAME_DELTA             = 0x09,
+        SUOUART_FRAME_COMPRESS          = 0x0A,
+        SUOUART_FRAME_EXIT              = 0x7F,
+} suouart_frame_type_t;
+
+/* Firmware update requests, as CLI commands */
+static const struct {
+        const char *name;
+        suouart_frame_type_t type;
+} suouart_fwupdate_cmds[] = {
+        { "SUOUART_WRITE_STATUS",       SUOUART_FRAME_WRITE_STATUS },
+        { "SUOUART_MEM_DEV",            SUOUART_FRAME_MEM_DEV },
+        { "SUOUART_GPIO_MAP",           SUOUART_FRAME_GPIO_MAP },
+        { "SUOUART_PATCH_LEN",          SUOUART_FRAME_PATCH_LEN },
+        { "SUOUART_PATCH_DATA",         SUOUART_FRAME_PATCH_DATA },
+        { "SUOUART_READ_STATUS",        SUOUART_FRAME_READ_STATUS },
+        { "SUOUART_READ_MEMINFO",       SUOUART_FRAME_READ_MEMINFO },
+        { "SUOUART_RESUME",             SUOUART_FRAME_RESUME },
+        { "SUOUART_DELTA",              SUOUART_FRAME_DELTA },
+        { "SUOUART_COMPRESS",           SUOUART_FRAME_COMPRESS },
+};
+
 /*********************************************************************
  *
  *       Defines, configurable
@@ -80,11 +136,22 @@ __RETAINED_RW volatile static uint8 run_task = 0;
 ad_uart_handle_t uart_handle;
 static uint8_t cli_buffer[CLI_BUFF_SIZE];
 
+/*
+ * There is no flow control on the UART, so while a frame is processed, the data following it are
+ * received ahead in the background, see uart_read_ahead_start()
+ */
+static uint8_t rx_ahead[SUOUART_FRAME_MAX_SIZE];
+static uint16_t rx_ahead_pos;
+static volatile uint16_t rx_ahead_len;
+static OS_EVENT rx_ahead_event;
+
 static uint8_t asciibyte2nibble(uint8_t *src);
 static uint32_t suouart_alloc_execution(char *argv, uint8_t **buf);
 static void suouart_callback(const char *status);
 static char *suouart_err_str(suouart_error_t err);
+static suouart_error_t suouart_fwupdate_request(suouart_frame_type_t type, uint16_t offs, uint16_t size, uint8_t *buf);
 static void suouart_fwupdate_execution(int32_t pkt_length, char *argv[10], uint8_t *buf, uint32_t buf_size);
+static void suouart_fwupdate_bin_execution(void);
 static void suouart_task(void *params);
 __USED static void uart_printfln(const char *fmt, ...);
 static inline int32_t uart_readline(uint8_t *buf, size_t size, bool echo);
@@ -163,6 +230,232 @@ static char *suouart_err_str(suouart_error_t err)
         }
 }
 
+/**
+ * Brief:  Execute firmware update request and send response
+ * Param:  request type, unknown types are not supported
+ * Param:  offset, size and data of request
+ * Return: error of request
+ */
+static suouart_error_t suouart_fwupdate_request(suouart_frame_type_t type, uint16_t offs, uint16_t size, uint8_t *buf)
+{
+        suouart_error_t err;
+        uint32_t value;
+        bool read = false;
+
+        switch (type) {
+        case SUOUART_FRAME_WRITE_STATUS:
+                printf("fwupdate: SUOUART_WRITE_STATUS\r\n");
+                err = suouart_write_req(SUOUART_WRITE_STATUS, offs, size, buf);
+                break;
+        case SUOUART_FRAME_MEM_DEV:
+                printf("fwupdate: SUOUART_MEM_DEV\r\n");
+                err = suouart_write_req(SUOUART_WRITE_MEMDEV, offs, size, buf);
+                break;
+        case SUOUART_FRAME_GPIO_MAP:
+                printf("fwupdate: SUOUART_GPIO_MAP\r\n");
+                err = suouart_write_req(SUOUART_WRITE_GPIO_MAP, offs, size, buf);
+                break;
+        case SUOUART_FRAME_PATCH_LEN:
+                printf("fwupdate: SUOUART_PATCH_LEN\r\n");
+                err = suouart_write_req(SUOUART_WRITE_PATCH_LEN, offs, size, buf);
+                break;
+        case SUOUART_FRAME_PATCH_DATA:
+                err = suouart_write_req(SUOUART_WRITE_PATCH_DATA, offs, size, buf);
+                break;
+        case SUOUART_FRAME_READ_STATUS:
+                read = true;
+                err = suouart_read_req(SUOUART_READ_STATUS, &value);
+                printf("fwupdate: SUOUART_READ_STATUS [%04lx]\r\n", value);
+                break;
+        case SUOUART_FRAME_READ_MEMINFO:
+                read = true;
+                err = suouart_read_req(SUOUART_READ_MEMINFO, &value);
+                printf("fwupdate: SUOUART_READ_MEMINFO [%04lx]\r\n", value);
+                break;
+        case SUOUART_FRAME_RESUME:
+                read = true;
+                err = suouart_resume_req(size, buf, &value);
+                printf("fwupdate: SUOUART_RESUME [%04lx]\r\n", value);
+                break;
+        case SUOUART_FRAME_DELTA:
+                printf("fwupdate: SUOUART_DELTA\r\n");
+                err = suouart_delta_req(size, buf);
+                break;
+        case SUOUART_FRAME_COMPRESS:
+                printf("fwupdate: SUOUART_COMPRESS\r\n");
+                err = suouart_compress_req(size, buf);
+                break;
+        default:
+                err = SUOUART_ERROR_REQUEST_NOT_SUPPORTED;
+                printf("fwupdate: what? [%02x]\r\n", type);
+                break;
+        }
+
+        if (err == SUOUART_ERROR_OK) {
+                if (read) {
+                        uart_printfln("OK %d", value);
+                } else if (type != SUOUART_FRAME_PATCH_DATA) {
+                        uart_printfln("OK");
+                }
+        } else {
+                uart_printfln("ERROR %s", suouart_err_str(err));
+        }
+
+        return err;
+}
+
+static void uart_read_ahead_cb(void *user_data, uint16_t transferred)
+{
+        rx_ahead_len += transferred;
+
+        if (in_interrupt()) {
+                OS_EVENT_SIGNAL_FROM_ISR(rx_ahead_event);
+        } else {
+                OS_EVENT_SIGNAL(rx_ahead_event);
+        }
+}
+
+/**
+ * Brief:  Start receiving data in the background, following any not read yet
+ */
+static void uart_read_ahead_start(void)
+{
+        uint16_t len = rx_ahead_len - rx_ahead_pos;
+
+        memmove(rx_ahead, &rx_ahead[rx_ahead_pos], len);
+        rx_ahead_pos = 0;
+        rx_ahead_len = len;
+
+        ad_uart_read_async(uart_handle, (char *) &rx_ahead[len], sizeof(rx_ahead) - len,
+                                                                        uart_read_ahead_cb, NULL);
+}
+
+/**
+ * Brief:  Stop receiving data in the background, data received so far are read first by uart_read()
+ */
+static void uart_read_ahead_stop(void)
+{
+        /* Nothing to complete if buffer got full, callback was called already */
+        ad_uart_complete_async_read(uart_handle);
+        OS_EVENT_WAIT(rx_ahead_event, OS_EVENT_FOREVER);
+}
+
+/**
+ * Brief:  Read from UART, starting with data received ahead
+ * Param:  buffer and number of bytes to read
+ * Param:  timeout
+ * Return: number of bytes read
+ */
+static int uart_read(uint8_t *buf, uint16_t len, OS_TICK_TIME timeout)
+{
+        uint16_t n = MIN(len, rx_ahead_len - rx_ahead_pos);
+        int ret;
+
+        memcpy(buf, &rx_ahead[rx_ahead_pos], n);
+        rx_ahead_pos += n;
+
+        if (n < len) {
+                ret = ad_uart_read(uart_handle, (char *) &buf[n], len - n, timeout);
+                if (ret > 0) {
+                        n += ret;
+                }
+        }
+
+        return n;
+}
+
+/**
+ * Brief:  Read binary frame into CLI buffer
+ * Param:  pointer to payload length
+ * Return: 1 if frame is valid, 0 if its CRC is wrong or it could not be read whole,
+ *         -1 if no frame started within SUOUART_FRAME_IDLE_TIMEOUT_MS
+ */
+static int32_t uart_read_frame(uint16_t *len)
+{
+        const OS_TICK_TIME timeout = OS_MS_2_TICKS(SUOUART_FRAME_TIMEOUT_MS);
+        uint8_t *frame = cli_buffer;
+        uint32_t crc;
+        uint8_t c;
+
+        /* Skip anything up to the start of frame, e.g. line ending of the CLI command */
+        do {
+                if (uart_read(&c, 1, OS_MS_2_TICKS(SUOUART_FRAME_IDLE_TIMEOUT_MS)) != 1 ||
+                                                                                run_task == 0) {
+                        return -1;
+                }
+        } while (c != SUOUART_FRAME_SYNC);
+
+        if (uart_read(frame, SUOUART_FRAME_HDR_SIZE, timeout) != SUOUART_FRAME_HDR_SIZE) {
+                return 0;
+        }
+
+        *len = frame[2] | (frame[3] << 8);
+        if (*len > SUOUART_BUFFER_SIZE) {
+                return 0;
+        }
+
+        /* Payload and CRC are read in one go, straight into the buffer they are processed from */
+        if (uart_read(&frame[SUOUART_FRAME_HDR_SIZE], *len + SUOUART_FRAME_CRC_SIZE,
+                                                timeout) != *len + SUOUART_FRAME_CRC_SIZE) {
+                return 0;
+        }
+
+        crc = suouart_crc32(frame, SUOUART_FRAME_HDR_SIZE + *len);
+        frame += SUOUART_FRAME_HDR_SIZE + *len;
+
+        return crc == (frame[0] | (frame[1] << 8) | (frame[2] << 16) | ((uint32_t) frame[3] << 24));
+}
+
+static void suouart_fwupdate_bin_execution(void)
+{
+        uint8_t *frame = cli_buffer;
+        uint8_t seq = 0;
+        bool seq_reported = false;
+        suouart_error_t err;
+        uint16_t len;
+        int32_t valid;
+
+        rx_ahead_pos = 0;
+        rx_ahead_len = 0;
+
+        /* keep going until get an exit frame, or host is gone */
+        while (run_task == 1) {
+                valid = uart_read_frame(&len);
+                if (valid < 0) {
+                        break;
+                }
+
+                uart_read_ahead_start();
+
+                if (!valid) {
+                        uart_printfln("ERROR FRAME_CRC %d", seq);
+                } else if (frame[1] != seq) {
+                        if ((uint8_t) (frame[1] - seq) >= 0x80) {
+                                /* Sent again as acknowledge was not received */
+                                uart_printfln("ACK %d", (uint8_t) (seq - 1));
+                        } else if (!seq_reported) {
+                                uart_printfln("ERROR FRAME_SEQ %d", seq);
+                                seq_reported = true;
+                        }
+                } else if (frame[0] == SUOUART_FRAME_EXIT) {
+                        uart_printfln("OK");
+                        uart_read_ahead_stop();
+                        break;
+                } else {
+                        seq++;
+                        seq_reported = false;
+
+                        err = suouart_fwupdate_request(frame[0], 0, len, &frame[SUOUART_FRAME_HDR_SIZE]);
+                        if ((err == SUOUART_ERROR_OK) && (frame[0] == SUOUART_FRAME_PATCH_DATA)) {
+                                uart_printfln("ACK %d", frame[1]);
+                        }
+                }
+
+                uart_read_ahead_stop();
+        }
+        printf(("fwupdate: done"));
+}
+
 static void suouart_fwupdate_execution(int32_t pkt_length, char *argv[10], uint8_t *buf, uint32_t buf_size)
 {
         uint16_t offs;
@@ -170,9 +463,7 @@ static void suouart_fwupdate_execution(int32_t pkt_length, char *argv[10], uint8
         uint32_t slen;
         uint8_t *src;
         uint8_t *dst;
-        suouart_error_t err;
-        uint32_t value;
-        bool read;
+        suouart_frame_type_t type;
 
         /* keep going until get an empty line */
         while (pkt_length > 0)
@@ -238,8 +529,6 @@ static void suouart_fwupdate_execution(int32_t pkt_length, char *argv[10], uint8
 
                         src = (uint8_t*)argv[3];
                         dst = buf;
-                        err = SUOUART_ERROR_REQUEST_NOT_SUPPORTED;
-                        read = false;
 
                         /* convert hex string back to data */
                         for (n = 0; n < size; n++) {
@@ -249,42 +538,15 @@ static void suouart_fwupdate_execution(int32_t pkt_length, char *argv[10], uint8
                                 hex = ((hi << 4) | lo);
                                 dst[n] = hex;
                         }
-                        if (0 == strcmp(argv[0], "SUOUART_WRITE_STATUS")) {
-                                printf("fwupdate: SUOUART_WRITE_STATUS [%s]\r\n", argv[3]);
-                                err = suouart_write_req(SUOUART_WRITE_STATUS, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUART_MEM_DEV")) {
-                                printf("fwupdate: SUOUART_MEM_DEV [%s]\n", argv[3]);
-                                err = suouart_write_req(SUOUART_WRITE_MEMDEV, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUART_GPIO_MAP")) {
-                                printf("fwupdate: SUOUART_GPIO_MAP [%s]\r\n", argv[3]);
-                                err = suouart_write_req(SUOUART_WRITE_GPIO_MAP, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUART_PATCH_LEN")) {
-                                printf("fwupdate: SUOUART_PATCH_LEN [%s]\r\n", argv[3]);
-                                err = suouart_write_req(SUOUART_WRITE_PATCH_LEN, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUART_PATCH_DATA")) {
-                                err = suouart_write_req(SUOUART_WRITE_PATCH_DATA, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUART_READ_STATUS")) {
-                                read = true;
-                                err = suouart_read_req(SUOUART_READ_STATUS, &value);
-                                printf("fwupdate: SUOUART_READ_STATUS [%04lx]\r\n", value);
-                        } else if (0 == strcmp(argv[0], "SUOUART_READ_MEMINFO")) {
-                                read = true;
-                                err = suouart_read_req(SUOUART_READ_MEMINFO, &value);
-                                printf("fwupdate: SUOUART_READ_MEMINFO [%04lx]\r\n", value);
-                        } else {
-                                err = SUOUART_ERROR_REQUEST_NOT_SUPPORTED;
-                                printf("fwupdate: what? [%s]\r\n", argv[0]);
-                        }
-                        if (err == SUOUART_ERROR_OK) {
-                                if (read) {
-                                        uart_printfln("OK %d", value);
-                                } else {
-                                        if (0 != strcmp(argv[0], "SUOUART_PATCH_DATA"))
-                                                uart_printfln("OK");
+                        type = 0;
+                        for (n = 0; n < ARRAY_LENGTH(suouart_fwupdate_cmds); n++) {
+                                if (0 == strcmp(argv[0], suouart_fwupdate_cmds[n].name)) {
+                                        type = suouart_fwupdate_cmds[n].type;
+                                        break;
                                 }
-                        } else {
-                                uart_printfln("ERROR %s", suouart_err_str(err));
                         }
+
+                        suouart_fwupdate_request(type, offs, size, buf);
                 }
         }
         printf(("fwupdate: done"));
@@ -302,6 +564,8 @@ static void suouart_task(void *params)
 
        run_task = 1;
 
+       OS_EVENT_CREATE(rx_ahead_event);
+
        uart_handle = ad_uart_open(&uart_conf);  /* Open the UART with the desired configuration    */
        ASSERT_ERROR(uart_handle != NULL);  /* Check if the UART1 opened OK */
 
@@ -359,6 +623,11 @@ static void suouart_task(void *params)
                                 uart_printfln("OK");
                                 suouart_fwupdate_execution(length, argv, qspibuf, qspibufsz);
                         }
+                        else if ((0 == strcmp(argv[0], "fwupdatebin")) && (argc == 1)) {
+                                /* Frames are received in the CLI buffer, no 'alloc' needed */
+                                uart_printfln("OK");
+                                suouart_fwupdate_bin_execution();
+                        }
                         else if ((0 == strcmp(argv[0], "readsdtparam")) && (argc == 1)) {
 
                                 nvms_t *nvms_h;
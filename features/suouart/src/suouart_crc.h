@@ -0,0 +1,84 @@
+/**
+ ****************************************************************************************
+ *
+ * @file suouart_crc.h
+ *
+ * @brief SUOUART CRC32 (IEEE 802.3)
+ *
+ * Copyright (C) 2016-2022 Renesas Electronics Corporation and/or its affiliates
+ * The MIT License (MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+ ****************************************************************************************
+ */
+
+#ifndef SUOUART_CRC_H_
+#define SUOUART_CRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Initial value of CRC32, to be passed to first suouart_crc32_update() call
+ */
+#define SUOUART_CRC32_INIT           (0xFFFFFFFF)
+
+/**
+ * \brief Update CRC32
+ *
+ * Can be called any number of times, data being split at any point, with the same result as a
+ * single call.
+ *
+ * \param [in] crc  current value of CRC, SUOUART_CRC32_INIT for first data
+ * \param [in] data pointer to data to compute CRC over
+ * \param [in] len  number of bytes pointed by data
+ *
+ * \return new value of CRC
+ *
+ */
+uint32_t suouart_crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * \brief Get final value of CRC32
+ *
+ * \param [in] crc value of CRC returned by last suouart_crc32_update() call
+ *
+ * \return CRC32 of data
+ *
+ */
+static inline uint32_t suouart_crc32_final(uint32_t crc)
+{
+        return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * \brief Compute CRC32 of data
+ *
+ * \param [in] data pointer to data to compute CRC over
+ * \param [in] len  number of bytes pointed by data
+ *
+ * \return CRC32 of data
+ *
+ */
+static inline uint32_t suouart_crc32(const uint8_t *data, size_t len)
+{
+        return suouart_crc32_final(suouart_crc32_update(SUOUART_CRC32_INIT, data, len));
+}
+
+#endif /* SUOUART_CRC_H_ */
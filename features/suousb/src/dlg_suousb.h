@@ -71,22 +71,51 @@ suousb_error_t suousb_write_req(suousb_write_request_t req, uint16_t offset, uin
 suousb_error_t suousb_read_req(suousb_write_request_t req, uint32_t *value);
 
 /**
- * Initialization of SUOUSB Service instance
+ * Resume interrupted image transfer
+ *
+ * To be requested after image is started with SUOUSB_WRITE_MEMDEV, before any image data. If a
+ * checkpoint of the image with the given header was saved, image data are expected from it.
+ *
+ * \param [in]  length length of value, at least size of image header
+ * \param [in]  value  start of image, with its header
+ * \param [out] offset offset in image to send data from, 0 if whole image is to be sent
  *
  * \return error
  */
-int suousb_init(suousb_notify_cb_t cb);
+suousb_error_t suousb_resume_req(uint16_t length, const uint8_t *value, uint32_t *offset);
 
 /**
- * Update CRC
+ * Receive image as delta against active image
  *
- * param [in] crc current value of CRC
- * param [in] data pointer to data to compute CRC over
- * param [in] len number of bytes pointed by data
+ * To be requested after image is started with SUOUSB_WRITE_MEMDEV, before any image data. Image
+ * data are then operations rebuilding the image from the active one (see dlg_suousb.c).
  *
- * \return new value of CRC
+ * \param [in]  length length of value, at least size of image header
+ * \param [in]  value  start of image the delta was made against, with its header
  *
+ * \return error, SUOUSB_ERROR_APPLICATION_ERROR if active image is not the given one
  */
-uint32_t suousb_update_crc(uint32_t crc, const uint8_t *data, size_t len);
+suousb_error_t suousb_delta_req(uint16_t length, const uint8_t *value);
+
+/**
+ * Receive compressed image data
+ *
+ * To be requested after image is started with SUOUSB_WRITE_MEMDEV, and after any resume or delta
+ * request. Image data (or delta operations) are then received compressed (see dlg_suousb.c), and
+ * checked once decompressed.
+ *
+ * \param [in]  length length of value, 1
+ * \param [in]  value  codec, only 0x01 (LZ77 with 4 KB window) is supported
+ *
+ * \return error, SUOUSB_ERROR_APPLICATION_ERROR if codec is not supported
+ */
+suousb_error_t suousb_compress_req(uint16_t length, const uint8_t *value);
+
+/**
+ * Initialization of SUOUSB Service instance
+ *
+ * \return error
+ */
+int suousb_init(suousb_notify_cb_t cb);
 #endif
 #endif /* DLG_SUOUSB_H_ */
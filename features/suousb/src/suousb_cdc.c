@@ -53,6 +53,7 @@
 //#include "platform_devices.h"
 
 #include "dlg_suousb.h"
+#include "suousb_crc.h"
 
 //#include "commons.h"
 
@@ -78,6 +79,61 @@ it can be less for other commands, but we expect to have to receive and work on
 RX buffer's worth when pulling in data for SUOUSB */
 #define CLI_BUFF_SIZE           USB_CDC_RX_BUFF_SIZE
 
+/*
+ * Binary frames of the firmware update ('fwupdatebin' command), received in the CLI buffer:
+ *
+ *      sync (1) | type (1) | sequence number (1) | payload length (2, LE) | payload | CRC32 (4, LE)
+ *
+ * The CRC covers type to payload. Payload is binary, up to SUOUSB_BUFFER_SIZE bytes. Responses
+ * are the same lines as for the CLI, a bad frame is answered with "ERROR FRAME_CRC <seq>", or
+ * "ERROR FRAME_SEQ <seq>" if not the expected one, and must be sent again.
+ *
+ * The host may send several PATCH_DATA frames without waiting for a response, USB flow control
+ * holds them back while one is processed. Each one written is acknowledged with "ACK <seq>", which
+ * also acknowledges all frames before it. Frames following a lost one are discarded, reporting
+ * "ERROR FRAME_SEQ <seq>" once, so the host sends them again from the lost one. A frame received
+ * again after it was written is acknowledged again.
+ *
+ * Without any frame for SUOUSB_FRAME_IDLE_TIMEOUT_MS, e.g. host gone while sending an image, the
+ * CLI is back, so that the transfer can be resumed later (see suousb_resume_req()).
+ */
+#define SUOUSB_FRAME_SYNC               0xA5
+#define SUOUSB_FRAME_HDR_SIZE           4       /* following sync */
+#define SUOUSB_FRAME_CRC_SIZE           4
+#define SUOUSB_FRAME_TIMEOUT_MS         1000
+#define SUOUSB_FRAME_IDLE_TIMEOUT_MS    10000
+
+typedef enum {
+        SUOUSB_FRAME_WRITE_STATUS       = 0x01,
+        SUOUSB_FRAME_MEM_DEV            = 0x02,
+        SUOUSB_FRAME_GPIO_MAP           = 0x03,
+        SUOUSB_FRAME_PATCH_LEN          = 0x04,
+        SUOUSB_FRAME_PATCH_DATA         = 0x05,
+        SUOUSB_FRAME_READ_STATUS        = 0x06,
+        SUOUSB_FRAME_READ_MEMINFO       = 0x07,
+        SUOUSB_FRAME_RESUME             = 0x08,
+        SUOUSB_FRAME_DELTA              = 0x09,
+        SUOUSB_FRAME_COMPRESS           = 0x0A,
+        SUOUSB_FRAME_EXIT               = 0x7F,
+} suousb_frame_type_t;
+
+/* Firmware update requests, as CLI commands */
+static const struct {
+        const char *name;
+        suousb_frame_type_t type;
+} suousb_fwupdate_cmds[] = {
+        { "SUOUSB_WRITE_STATUS",        SUOUSB_FRAME_WRITE_STATUS },
+        { "SUOUSB_MEM_DEV",             SUOUSB_FRAME_MEM_DEV },
+        { "SUOUSB_GPIO_MAP",            SUOUSB_FRAME_GPIO_MAP },
+        { "SUOUSB_PATCH_LEN",           SUOUSB_FRAME_PATCH_LEN },
+        { "SUOUSB_PATCH_DATA",          SUOUSB_FRAME_PATCH_DATA },
+        { "SUOUSB_READ_STATUS",         SUOUSB_FRAME_READ_STATUS },
+        { "SUOUSB_READ_MEMINFO",        SUOUSB_FRAME_READ_MEMINFO },
+        { "SUOUSB_RESUME",              SUOUSB_FRAME_RESUME },
+        { "SUOUSB_DELTA",               SUOUSB_FRAME_DELTA },
+        { "SUOUSB_COMPRESS",            SUOUSB_FRAME_COMPRESS },
+};
+
 /*********************************************************************
  *
  *       Defines, configurable
@@ -354,6 +410,165 @@ static uint32_t usb_cdc_suousb_alloc_execution(char *argv, uint8_t **buf)
         return 0;
 }
 
+/**
+ * Brief:  Execute firmware update request and send response
+ * Param:  request type, unknown types are not supported
+ * Param:  offset, size and data of request
+ * Return: error of request
+ */
+static suousb_error_t usb_cdc_suousb_fwupdate_request(suousb_frame_type_t type, uint16_t offs, uint16_t size, uint8_t *buf)
+{
+        suousb_error_t err;
+        uint32_t value;
+        bool read = false;
+
+        switch (type) {
+        case SUOUSB_FRAME_WRITE_STATUS:
+                printf("fwupdate: SUOUSB_WRITE_STATUS\r\n");
+                err = suousb_write_req(SUOUSB_WRITE_STATUS, offs, size, buf);
+                break;
+        case SUOUSB_FRAME_MEM_DEV:
+                printf("fwupdate: SUOUSB_MEM_DEV\r\n");
+                err = suousb_write_req(SUOUSB_WRITE_MEMDEV, offs, size, buf);
+                break;
+        case SUOUSB_FRAME_GPIO_MAP:
+                printf("fwupdate: SUOUSB_GPIO_MAP\r\n");
+                err = suousb_write_req(SUOUSB_WRITE_GPIO_MAP, offs, size, buf);
+                break;
+        case SUOUSB_FRAME_PATCH_LEN:
+                printf("fwupdate: SUOUSB_PATCH_LEN\r\n");
+                err = suousb_write_req(SUOUSB_WRITE_PATCH_LEN, offs, size, buf);
+                break;
+        case SUOUSB_FRAME_PATCH_DATA:
+                err = suousb_write_req(SUOUSB_WRITE_PATCH_DATA, offs, size, buf);
+                break;
+        case SUOUSB_FRAME_READ_STATUS:
+                read = true;
+                err = suousb_read_req(SUOUSB_READ_STATUS, &value);
+                printf("fwupdate: SUOUSB_READ_STATUS [%04lx]\r\n", value);
+                break;
+        case SUOUSB_FRAME_READ_MEMINFO:
+                read = true;
+                err = suousb_read_req(SUOUSB_READ_MEMINFO, &value);
+                printf("fwupdate: SUOUSB_READ_MEMINFO [%04lx]\r\n", value);
+                break;
+        case SUOUSB_FRAME_RESUME:
+                read = true;
+                err = suousb_resume_req(size, buf, &value);
+                printf("fwupdate: SUOUSB_RESUME [%04lx]\r\n", value);
+                break;
+        case SUOUSB_FRAME_DELTA:
+                printf("fwupdate: SUOUSB_DELTA\r\n");
+                err = suousb_delta_req(size, buf);
+                break;
+        case SUOUSB_FRAME_COMPRESS:
+                printf("fwupdate: SUOUSB_COMPRESS\r\n");
+                err = suousb_compress_req(size, buf);
+                break;
+        default:
+                err = SUOUSB_ERROR_REQUEST_NOT_SUPPORTED;
+                printf("fwupdate: what? [%02x]\r\n", type);
+                break;
+        }
+
+        if (err == SUOUSB_ERROR_OK) {
+                if (read) {
+                        dialog_cdc_printfln("OK %d", value);
+                } else if (type != SUOUSB_FRAME_PATCH_DATA) {
+                        /* PATCH_DATA is confirmed by SUOUSB_CMP_OK notification, once written */
+                        dialog_cdc_printfln("OK");
+                }
+        } else {
+                dialog_cdc_printfln("ERROR %s", suousb_err_str(err));
+        }
+
+        return err;
+}
+
+/**
+ * Brief:  Read binary frame into CLI buffer
+ * Param:  pointer to payload length
+ * Return: 1 if frame is valid, 0 if its CRC is wrong or it could not be read whole,
+ *         -1 if no frame started within SUOUSB_FRAME_IDLE_TIMEOUT_MS
+ */
+static int32_t cdc_read_frame(uint16_t *len)
+{
+        uint8_t *frame = cli_buffer;
+        uint32_t crc;
+        uint8_t c;
+
+        /* Skip anything up to the start of frame, e.g. line ending of the CLI command */
+        do {
+                if (USBD_CDC_Receive(usb_cdc_hInst, &c, 1, SUOUSB_FRAME_IDLE_TIMEOUT_MS) != 1 ||
+                                                                                run_usb_task == 0) {
+                        return -1;
+                }
+        } while (c != SUOUSB_FRAME_SYNC);
+
+        if (USBD_CDC_Receive(usb_cdc_hInst, frame, SUOUSB_FRAME_HDR_SIZE,
+                                        SUOUSB_FRAME_TIMEOUT_MS) != SUOUSB_FRAME_HDR_SIZE) {
+                return 0;
+        }
+
+        *len = frame[2] | (frame[3] << 8);
+        if (*len > SUOUSB_BUFFER_SIZE) {
+                return 0;
+        }
+
+        /* Payload and CRC are read in one go, straight into the buffer they are processed from */
+        if (USBD_CDC_Receive(usb_cdc_hInst, &frame[SUOUSB_FRAME_HDR_SIZE], *len + SUOUSB_FRAME_CRC_SIZE,
+                                SUOUSB_FRAME_TIMEOUT_MS) != *len + SUOUSB_FRAME_CRC_SIZE) {
+                return 0;
+        }
+
+        crc = suousb_crc32(frame, SUOUSB_FRAME_HDR_SIZE + *len);
+        frame += SUOUSB_FRAME_HDR_SIZE + *len;
+
+        return crc == (frame[0] | (frame[1] << 8) | (frame[2] << 16) | ((uint32_t) frame[3] << 24));
+}
+
+static void usb_cdc_suousb_fwupdate_bin_execution(void)
+{
+        uint8_t *frame = cli_buffer;
+        uint8_t seq = 0;
+        bool seq_reported = false;
+        suousb_error_t err;
+        uint16_t len;
+        int32_t valid;
+
+        /* keep going until get an exit frame, or host is gone */
+        while (run_usb_task == 1) {
+                valid = cdc_read_frame(&len);
+                if (valid < 0) {
+                        break;
+                }
+
+                if (!valid) {
+                        dialog_cdc_printfln("ERROR FRAME_CRC %d", seq);
+                } else if (frame[1] != seq) {
+                        if ((uint8_t) (frame[1] - seq) >= 0x80) {
+                                /* Sent again as acknowledge was not received */
+                                dialog_cdc_printfln("ACK %d", (uint8_t) (seq - 1));
+                        } else if (!seq_reported) {
+                                dialog_cdc_printfln("ERROR FRAME_SEQ %d", seq);
+                                seq_reported = true;
+                        }
+                } else if (frame[0] == SUOUSB_FRAME_EXIT) {
+                        dialog_cdc_printfln("OK");
+                        break;
+                } else {
+                        seq++;
+                        seq_reported = false;
+
+                        err = usb_cdc_suousb_fwupdate_request(frame[0], 0, len, &frame[SUOUSB_FRAME_HDR_SIZE]);
+                        if ((err == SUOUSB_ERROR_OK) && (frame[0] == SUOUSB_FRAME_PATCH_DATA)) {
+                                dialog_cdc_printfln("ACK %d", frame[1]);
+                        }
+                }
+        }
+        printf(("fwupdate: done"));
+}
+
 static void usb_cdc_suousb_fwupdate_execution(int32_t pkt_length, char *argv[10], uint8_t *buf, uint32_t buf_size)
 {
         uint16_t offs;
@@ -361,9 +576,7 @@ static void usb_cdc_suousb_fwupdate_execution(int32_t pkt_length, char *argv[10]
         uint32_t slen;
         uint8_t *src;
         uint8_t *dst;
-        suousb_error_t err;
-        uint32_t value;
-        bool read;
+        suousb_frame_type_t type;
 
         /* keep going until get an empty line */
         while (pkt_length > 0)
@@ -428,8 +641,6 @@ static void usb_cdc_suousb_fwupdate_execution(int32_t pkt_length, char *argv[10]
 
                         src = (uint8_t*)argv[3];
                         dst = buf;
-                        err = SUOUSB_ERROR_REQUEST_NOT_SUPPORTED;
-                        read = false;
 
                         /* convert hex string back to data */
                         for (n = 0; n < size; n++) {
@@ -439,56 +650,15 @@ static void usb_cdc_suousb_fwupdate_execution(int32_t pkt_length, char *argv[10]
                                 hex = ((hi << 4) | lo);
                                 dst[n] = hex;
                         }
-                        if (0 == strcmp(argv[0], "SUOUSB_WRITE_STATUS")) {
-                                printf("fwupdate: SUOUSB_WRITE_STATUS [%s]\r\n", argv[3]);
-                                err = suousb_write_req(SUOUSB_WRITE_STATUS, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUSB_MEM_DEV")) {
-                                printf("fwupdate: SUOUSB_MEM_DEV [%s]\n", argv[3]);
-                                err = suousb_write_req(SUOUSB_WRITE_MEMDEV, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUSB_GPIO_MAP")) {
-                                printf("fwupdate: SUOUSB_GPIO_MAP [%s]\r\n", argv[3]);
-                                err = suousb_write_req(SUOUSB_WRITE_GPIO_MAP, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUSB_PATCH_LEN")) {
-                                printf("fwupdate: SUOUSB_PATCH_LEN [%s]\r\n", argv[3]);
-                                err = suousb_write_req(SUOUSB_WRITE_PATCH_LEN, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUSB_PATCH_DATA")) {
-                                err = suousb_write_req(SUOUSB_WRITE_PATCH_DATA, offs, size, buf);
-                        } else if (0 == strcmp(argv[0], "SUOUSB_READ_STATUS")) {
-                                read = true;
-                                err = suousb_read_req(SUOUSB_READ_STATUS, &value);
-                                printf("fwupdate: SUOUSB_READ_STATUS [%04lx]\r\n", value);
-                        } else if (0 == strcmp(argv[0], "SUOUSB_READ_MEMINFO")) {
-                                read = true;
-                                err = suousb_read_req(SUOUSB_READ_MEMINFO, &value);
-                                printf("fwupdate: SUOUSB_READ_MEMINFO [%04lx]\r\n", value);
-                        } else {
-                                err = SUOUSB_ERROR_REQUEST_NOT_SUPPORTED;
-                                printf("fwupdate: what? [%s]\r\n", argv[0]);
-                        }
-                        if (err == SUOUSB_ERROR_OK) {
-                                if (read) {
-                                        dialog_cdc_printfln("OK %d", value);
-                                } else {
-
-                                        /* but will need to deal with sequence
-                                        disorder with SUOTA_CMP_OK notification
-                                        on host side
-                                        But should wait on host of OK because
-                                        flash erase may take time and we need
-                                        next TX deferred so USB timing isn't
-                                        messed up
-                                        - only, I don't get the notification
-                                        and writing next block causes error!
-                                        Because chunk_len is a uint8_t and the
-                                        note about using len=n*20 where
-                                        64<len<buffer in receiver is incomplete,
-                                        so 240 is maximum chunk size. */
-                                        if (0 != strcmp(argv[0], "SUOUSB_PATCH_DATA"))
-                                                dialog_cdc_printfln("OK");
+                        type = 0;
+                        for (n = 0; n < ARRAY_LENGTH(suousb_fwupdate_cmds); n++) {
+                                if (0 == strcmp(argv[0], suousb_fwupdate_cmds[n].name)) {
+                                        type = suousb_fwupdate_cmds[n].type;
+                                        break;
                                 }
-                        } else {
-                                dialog_cdc_printfln("ERROR %s", suousb_err_str(err));
                         }
+
+                        usb_cdc_suousb_fwupdate_request(type, offs, size, buf);
                 }
         }
         printf(("fwupdate: done"));
@@ -574,6 +744,11 @@ void usb_cdc_task(void *params)
                                 dialog_cdc_printfln("OK");
                                 usb_cdc_suousb_fwupdate_execution(length, argv, qspibuf, qspibufsz);
                         }
+                        else if ((0 == strcmp(argv[0], "fwupdatebin")) && (argc == 1)) {
+                                /* Frames are received in the CLI buffer, no 'alloc' needed */
+                                dialog_cdc_printfln("OK");
+                                usb_cdc_suousb_fwupdate_bin_execution();
+                        }
                         else if ((0 == strcmp(argv[0], "readsdtparam")) && (argc == 1)) {
 
                                 nvms_t *nvms_h;
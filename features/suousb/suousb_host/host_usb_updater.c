@@ -37,7 +37,7 @@
 #include <sys/stat.h>
 #include <time.h>
 
-#define HOST_USB_UPDATER_VERSION 2
+#define HOST_USB_UPDATER_VERSION 4
 //*************
 //** Windows **
 //*************
@@ -61,6 +61,13 @@
 // Run example:
 //      sudo ./host_usb.exe /dev/ttyACM0 ../../../../../projects/dk_apps/demos/pxp_reporter/Release_QSPI_SUOUSB/pxp_reporter.1.0.0.1.img -verbose
 //
+// The image is sent in binary frames ('fwupdatebin'), or as hex CLI lines ('fwupdate') if the target
+// does not support them or -cli is given. In binary frames, up to 4 blocks of image data are sent
+// ahead of the acknowledge of the target, which can be changed with -window <n> (1 to wait for each).
+// With -delta <base_image.img>, only a delta against the image the target runs is sent, if that is
+// the given base image. Data sent are LZ compressed unless -nocompress is given, or the target
+// does not support it.
+//
 
 //These are just to make the view in my editor accurate :-)
 //#define _WIN32
@@ -81,6 +88,56 @@
 //replicate output to a logfile 'host_usb_updater.log'
 //#define HOST_USB_UPDATER_LOG
 bool isVerbose = false;
+bool isBinary = false;
+
+//Binary frames, see src/suousb_cdc.c:
+//      sync (1) | type (1) | sequence number (1) | payload length (2, LE) | payload | CRC32 (4, LE)
+#define SUOUSB_FRAME_SYNC               0xA5
+#define SUOUSB_FRAME_HDR_SIZE           5
+#define SUOUSB_FRAME_CRC_SIZE           4
+#define SUOUSB_FRAME_RETRIES            5
+#define SUOUSB_WINDOW_DEFAULT           4
+#define SUOUSB_WINDOW_MAX               64      //sequence numbers of frames in flight must not wrap
+#define SUOUSB_WINDOW_TIMEOUT           20      //iterations of read timeout before frames in flight are sent again
+
+#define SUOUSB_FRAME_WRITE_STATUS       0x01
+#define SUOUSB_FRAME_MEM_DEV            0x02
+#define SUOUSB_FRAME_GPIO_MAP           0x03
+#define SUOUSB_FRAME_PATCH_LEN          0x04
+#define SUOUSB_FRAME_PATCH_DATA         0x05
+#define SUOUSB_FRAME_READ_STATUS        0x06
+#define SUOUSB_FRAME_READ_MEMINFO       0x07
+#define SUOUSB_FRAME_RESUME             0x08
+#define SUOUSB_FRAME_DELTA              0x09
+#define SUOUSB_FRAME_COMPRESS           0x0A
+#define SUOUSB_FRAME_EXIT               0x7F
+#define SUOUSB_RESUME_HDR_SIZE          64      //image header identifying the image to resume
+
+//Delta images, see src/dlg_suousb.c: ADD <len> <bytes> | COPY <len | 0x80000000> <offset>
+#define SUOUSB_DELTA_COPY               0x80000000
+#define SUOUSB_DELTA_KEY_SIZE           8       //bytes hashed to find matches in base image
+#define SUOUSB_DELTA_MIN_MATCH          16      //shorter matches are sent as they are
+#define SUOUSB_DELTA_COPY_MAX           0x8000  //bytes per COPY, bounds the work of the target per frame
+#define SUOUSB_DELTA_HASH_BITS          16
+#define SUOUSB_DELTA_CHAIN_MAX          64      //matches tried per image position
+
+//Compressed data, see src/dlg_suousb.c:
+//      0LLLLLLL <L + 1 bytes> | 1LLLDDDD DDDDDDDD (L < 7) | 1111DDDD DDDDDDDD LLLLLLLL
+#define SUOUSB_LZ_CODEC                 0x01
+#define SUOUSB_LZ_WINDOW                4096    //history of the target, matches reach no further
+#define SUOUSB_LZ_MIN_MATCH             3
+#define SUOUSB_LZ_MAX_MATCH             (SUOUSB_LZ_MIN_MATCH + 7 + 255)
+#define SUOUSB_LZ_LITERALS_MAX          128
+#define SUOUSB_LZ_HASH_BITS             15
+#define SUOUSB_LZ_CHAIN_MAX             128     //matches tried per position
+
+uint32_t window = SUOUSB_WINDOW_DEFAULT;
+uint32_t sent = 0;      //image bytes sent, less than image size when resumed or sent as delta
+unsigned char *basebuf = NULL;  //base image of delta, NULL if not given
+unsigned char *deltabuf = NULL; //delta of image against base image
+uint32_t deltasize = 0;
+bool compress = true;
+unsigned char *lzbuf = NULL;    //data sent compressed, after the resumed ones
 
 #ifdef _WIN32
 
@@ -820,6 +877,174 @@ bool issue_command_get_ok(char *command, char *buff, DWORD *len)
         return error;
 }
 
+// Updates CRC32 (IEEE 802.3), as suousb_crc32_update() on the target
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+        int k;
+
+        while (len--) {
+                crc ^= *data++;
+                for (k = 0; k < 8; k++) {
+                        crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+                }
+        }
+        return crc;
+}
+
+static uint8_t frame_seq;
+
+// Writes binary frame
+// Params:
+//      type:           request type, SUOUSB_FRAME_xxx
+//      seq:            sequence number
+//      data:           pointer to payload
+//      len:            payload length
+// Return:
+//      true if error
+bool write_frame(uint8_t type, uint8_t seq, const uint8_t *data, uint16_t len)
+{
+        static uint8_t frame[SUOUSB_FRAME_HDR_SIZE + 0x10000 + SUOUSB_FRAME_CRC_SIZE];
+        uint32_t size = SUOUSB_FRAME_HDR_SIZE + len;
+        uint32_t crc;
+
+        frame[0] = SUOUSB_FRAME_SYNC;
+        frame[1] = type;
+        frame[2] = seq;
+        frame[3] = len & 0xFF;
+        frame[4] = (len >> 8) & 0xFF;
+        memcpy(&frame[SUOUSB_FRAME_HDR_SIZE], data, len);
+
+        crc = crc32_update(0xFFFFFFFF, &frame[1], size - 1) ^ 0xFFFFFFFF;
+        frame[size++] = crc & 0xFF;
+        frame[size++] = (crc >> 8) & 0xFF;
+        frame[size++] = (crc >> 16) & 0xFF;
+        frame[size++] = (crc >> 24) & 0xFF;
+
+        return (size == write_buff((char *) frame, size)) ? false : true;
+}
+
+// Issues binary frame and confirms expected response, sending frame again if target could not
+// receive it
+// Params:
+//      type:           request type, SUOUSB_FRAME_xxx
+//      data:           pointer to payload
+//      datalen:        payload length
+//      response:       pointer to string expected in response from target
+//      buff:           pointer to buffer to hold response in (60 bytes please)
+//      len:            pointer to DWORD to put response length into
+// Return:
+//      true if error or response incorrect
+bool issue_frame_get_response(uint8_t type, const uint8_t *data, uint16_t datalen, char *response,
+        char *buff, DWORD *len)
+{
+        int attempts;
+        bool error = true;
+
+        for (attempts = 0; attempts < SUOUSB_FRAME_RETRIES; attempts++) {
+                if (write_frame(type, frame_seq, data, datalen)) {
+                        printf_err("issue_frame_get_response: write error\n");
+                        break;
+                }
+
+                error = wait_response(300, buff, len);
+                if (error) {
+                        printf_verbose("issue_frame_get_response: TIMEOUT\n");
+                        break;
+                }
+
+                if (0 == strncmp(buff, "ERROR FRAME", 11)) {
+                        printf_verbose("issue_frame_get_response: RETRY, got [%s]\n", buff);
+                        error = true;
+                        continue;
+                }
+
+                frame_seq++;
+                if (0 != strncmp(buff, response, strlen(response))) {
+                        printf_err("issue_frame_get_response: NO, got [%s]\n", buff);
+                        error = true;
+                }
+                break;
+        }
+
+        return error;
+}
+
+// Sends image data in PATCH_DATA frames, keeping up to 'window' frames in flight. Target acknowledges
+// frames cumulatively, and reports the frame expected when one is lost, which is sent again with
+// the ones following it
+// Params:
+//      data:           pointer to image data
+//      size:           number of bytes
+//      blocksz:        bytes per frame, as set with PATCH_LEN (last frame may be shorter)
+//      buff:           pointer to buffer to hold response in (60 bytes please)
+//      len:            pointer to DWORD to put response length into
+// Return:
+//      true if error
+bool send_data_frames(const uint8_t *data, uint32_t size, uint32_t blocksz, char *buff, DWORD *len)
+{
+        uint32_t frames = (size + blocksz - 1) / blocksz;
+        uint32_t base = 0;              //first frame not acknowledged
+        uint32_t next = 0;              //next frame to send
+        uint32_t resent = frames;       //frame sent again on last error report
+        uint32_t stale = 0;             //frames sent before it, which may still report it
+        uint8_t seq0 = frame_seq;
+        int attempts = 0;
+
+        while (base < frames) {
+                while ((next < frames) && ((next - base) < window)) {
+                        uint32_t n = ((size - (next * blocksz)) > blocksz) ? blocksz : (size - (next * blocksz));
+
+                        if (write_frame(SUOUSB_FRAME_PATCH_DATA, seq0 + next, &data[next * blocksz], n)) {
+                                printf_err("send_data_frames: write error\n");
+                                return true;
+                        }
+                        next++;
+                }
+
+                if (attempts == SUOUSB_FRAME_RETRIES) {
+                        printf_err("send_data_frames: no progress @ frame %d\n", base);
+                        return true;
+                }
+
+                if (wait_response(SUOUSB_WINDOW_TIMEOUT, buff, len)) {
+                        printf_verbose("send_data_frames: TIMEOUT, resend from %d\n", base);
+                        resent = base;
+                        stale = 0;
+                        next = base;
+                        attempts++;
+                } else if (0 == strncmp(buff, "ACK ", 4)) {
+                        uint32_t acked = (uint8_t)(atoi(&buff[4]) - (uint8_t)(seq0 + base)) + 1;
+
+                        //Acknowledges of frames received again are older, ignore them
+                        if (acked <= (next - base)) {
+                                base += acked;
+                                attempts = 0;
+                        }
+                } else if (0 == strncmp(buff, "ERROR FRAME", 11)) {
+                        uint32_t idx = base + (uint8_t)(atoi(strrchr(buff, ' ') + 1) - (uint8_t)(seq0 + base));
+
+                        //Frames in flight behind a lost one may report it too, these are not sent again
+                        if ((idx == resent) && stale) {
+                                stale--;
+                        } else if (idx < next) {
+                                printf_verbose("send_data_frames: RETRY from %d, got [%s]\n", idx, buff);
+                                stale = next - idx - 1;
+                                resent = idx;
+                                next = idx;
+                                attempts++;
+                        }
+                } else if (0 == strncmp(buff, "INFO ", 5)) {
+                        printf_verbose("DATA=[%s]\n", buff);
+                } else {
+                        printf_err("send_data_frames: NO, got [%s]\n", buff);
+                        return true;
+                }
+        }
+
+        frame_seq = seq0 + frames;
+        return false;
+}
+
 // Confirms expected response - abort SUOUSB process if mismatch
 // Params:
 //      response:       pointer to string expected in response from target
@@ -830,18 +1055,26 @@ bool issue_command_get_ok(char *command, char *buff, DWORD *len)
 bool wait_for_specific_response_or_abort(char *response, int retrycount, char *buff, DWORD *len)
 {
         unsigned char *suousb_mem_dev_abort = "SUOUSB_MEM_DEV 0 4 000000FF\n"; //{ 0xFF, 0x00, 0x00, 0x00 };
+        const uint8_t suousb_mem_dev_abort_bin[] = { 0x00, 0x00, 0x00, 0xFF };
 
         bool error = wait_response(retrycount, buff, len);
         if (!error) {
                 if (0 == strncmp(buff, response, strlen(response))) {
                 } else {
                         printf_err("wait_for_specific_response_or_abort: FAIL=[%s]\n", buff);
-                        write_buff(suousb_mem_dev_abort, strlen(suousb_mem_dev_abort));
                         error = true;
                 }
         } else {
                 printf_verbose("wait_for_specific_response_or_abort: TIMEOUT\n");
-                write_buff(suousb_mem_dev_abort, strlen(suousb_mem_dev_abort));
+        }
+
+        if (error) {
+                if (isBinary) {
+                        write_frame(SUOUSB_FRAME_MEM_DEV, frame_seq, suousb_mem_dev_abort_bin,
+                                sizeof(suousb_mem_dev_abort_bin));
+                } else {
+                        write_buff(suousb_mem_dev_abort, strlen(suousb_mem_dev_abort));
+                }
         }
         return error;
 }
@@ -1130,6 +1363,443 @@ bool do_firmware_update(unsigned char *imagebuf, uint32_t size, uint32_t suousbb
         return error;
 }
 
+static uint32_t delta_hash(const uint8_t *data)
+{
+        uint32_t a = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+        uint32_t b = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t) data[7] << 24);
+
+        return ((a * 2654435761u) ^ (b * 2246822519u)) >> (32 - SUOUSB_DELTA_HASH_BITS);
+}
+
+static uint32_t delta_put_op(uint8_t *delta, uint32_t word)
+{
+        delta[0] = word & 0xFF;
+        delta[1] = (word >> 8) & 0xFF;
+        delta[2] = (word >> 16) & 0xFF;
+        delta[3] = (word >> 24) & 0xFF;
+
+        return 4;
+}
+
+// Makes delta of image against base image, as ADD and COPY operations. Matches are found through
+// hash chains of the base image, trying first where the previous match would continue, as code
+// following a change is mostly just moved.
+// Params:
+//      base:           pointer to base image
+//      basesize:       length of base image
+//      imagebuf:       pointer to image
+//      size:           length of image
+//      delta:          pointer to buffer for delta, at least size + 4 bytes
+// Return:
+//      length of delta, 0 if error
+uint32_t make_delta(const uint8_t *base, uint32_t basesize, const uint8_t *imagebuf, uint32_t size,
+        uint8_t *delta)
+{
+        int32_t *head = malloc(sizeof(int32_t) << SUOUSB_DELTA_HASH_BITS);
+        int32_t *chain = malloc(sizeof(int32_t) * (basesize + 1));
+        uint32_t deltalen = 0;
+        uint32_t literal = 0;   //start of image bytes not sent yet
+        uint32_t next = 0;      //base offset following previous match
+        uint32_t pos = 0;
+        uint32_t i;
+
+        if (!head || !chain) {
+                free(head);
+                free(chain);
+                return 0;
+        }
+
+        memset(head, 0xFF, sizeof(int32_t) << SUOUSB_DELTA_HASH_BITS);
+        for (i = 0; i + SUOUSB_DELTA_KEY_SIZE <= basesize; i++) {
+                uint32_t h = delta_hash(&base[i]);
+
+                chain[i] = head[h];
+                head[h] = i;
+        }
+
+        while (pos + SUOUSB_DELTA_MIN_MATCH <= size) {
+                uint32_t best = 0;
+                uint32_t bestlen = 0;
+                int32_t c = head[delta_hash(&imagebuf[pos])];
+                int32_t cand = (next < basesize) ? (int32_t) next : -1;
+                int tries = 0;
+
+                if (cand < 0) {
+                        cand = c;
+                        c = (c >= 0) ? chain[c] : -1;
+                }
+
+                while ((cand >= 0) && (tries++ < SUOUSB_DELTA_CHAIN_MAX)) {
+                        uint32_t n = 0;
+
+                        while ((cand + n < basesize) && (pos + n < size) &&
+                                (base[cand + n] == imagebuf[pos + n])) {
+                                n++;
+                        }
+                        if (n > bestlen) {
+                                best = cand;
+                                bestlen = n;
+                        }
+
+                        cand = c;
+                        c = (c >= 0) ? chain[c] : -1;
+                }
+
+                if (bestlen < SUOUSB_DELTA_MIN_MATCH) {
+                        pos++;
+                        continue;
+                }
+
+                if (literal < pos) {
+                        deltalen += delta_put_op(&delta[deltalen], pos - literal);
+                        memcpy(&delta[deltalen], &imagebuf[literal], pos - literal);
+                        deltalen += pos - literal;
+                }
+
+                next = best + bestlen;
+                while (bestlen) {
+                        uint32_t n = (bestlen > SUOUSB_DELTA_COPY_MAX) ? SUOUSB_DELTA_COPY_MAX : bestlen;
+
+                        deltalen += delta_put_op(&delta[deltalen], n | SUOUSB_DELTA_COPY);
+                        deltalen += delta_put_op(&delta[deltalen], best);
+                        best += n;
+                        pos += n;
+                        bestlen -= n;
+                }
+                literal = pos;
+        }
+
+        if (literal < size) {
+                deltalen += delta_put_op(&delta[deltalen], size - literal);
+                memcpy(&delta[deltalen], &imagebuf[literal], size - literal);
+                deltalen += size - literal;
+        }
+
+        free(head);
+        free(chain);
+
+        return deltalen;
+}
+
+static uint32_t lz_hash(const uint8_t *data)
+{
+        uint32_t v = data[0] | (data[1] << 8) | ((uint32_t) data[2] << 16);
+
+        return (v * 2654435761u) >> (32 - SUOUSB_LZ_HASH_BITS);
+}
+
+static uint32_t lz_put_literals(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+        uint32_t len = 0;
+
+        while (n) {
+                uint32_t run = (n > SUOUSB_LZ_LITERALS_MAX) ? SUOUSB_LZ_LITERALS_MAX : n;
+
+                dst[len++] = run - 1;
+                memcpy(&dst[len], src, run);
+                len += run;
+                src += run;
+                n -= run;
+        }
+
+        return len;
+}
+
+// Compresses data for the target to decompress within its window, longest match found through
+// hash chains of the positions still in the window.
+// Params:
+//      data:           pointer to data
+//      size:           length of data
+//      lz:             pointer to buffer for compressed data, at least size + size / 128 + 1 bytes
+// Return:
+//      length of compressed data, 0 if error
+uint32_t make_lz(const uint8_t *data, uint32_t size, uint8_t *lz)
+{
+        int32_t *head = malloc(sizeof(int32_t) << SUOUSB_LZ_HASH_BITS);
+        int32_t *chain = malloc(sizeof(int32_t) * (size + 1));
+        uint32_t lzlen = 0;
+        uint32_t literal = 0;   //start of bytes not sent yet
+        uint32_t pos = 0;
+
+        if (!head || !chain) {
+                free(head);
+                free(chain);
+                return 0;
+        }
+
+        memset(head, 0xFF, sizeof(int32_t) << SUOUSB_LZ_HASH_BITS);
+
+        while (pos < size) {
+                uint32_t best = 0;
+                uint32_t bestlen = 0;
+                uint32_t h;
+                int32_t cand;
+                int tries = 0;
+
+                if (pos + SUOUSB_LZ_MIN_MATCH > size) {
+                        break;
+                }
+
+                h = lz_hash(&data[pos]);
+                cand = head[h];
+                while ((cand >= 0) && (pos - cand <= SUOUSB_LZ_WINDOW) && (tries++ < SUOUSB_LZ_CHAIN_MAX)) {
+                        uint32_t n = 0;
+
+                        while ((n < SUOUSB_LZ_MAX_MATCH) && (pos + n < size) && (data[cand + n] == data[pos + n])) {
+                                n++;
+                        }
+                        if (n > bestlen) {
+                                best = cand;
+                                bestlen = n;
+                        }
+                        cand = chain[cand];
+                }
+                chain[pos] = head[h];
+                head[h] = pos;
+
+                if (bestlen < SUOUSB_LZ_MIN_MATCH) {
+                        pos++;
+                        continue;
+                }
+
+                lzlen += lz_put_literals(&lz[lzlen], &data[literal], pos - literal);
+
+                if (bestlen < SUOUSB_LZ_MIN_MATCH + 7) {
+                        lz[lzlen++] = 0x80 | ((bestlen - SUOUSB_LZ_MIN_MATCH) << 4) | ((pos - best - 1) >> 8);
+                        lz[lzlen++] = (pos - best - 1) & 0xFF;
+                } else {
+                        lz[lzlen++] = 0xF0 | ((pos - best - 1) >> 8);
+                        lz[lzlen++] = (pos - best - 1) & 0xFF;
+                        lz[lzlen++] = bestlen - SUOUSB_LZ_MIN_MATCH - 7;
+                }
+
+                //Also index the positions inside the match
+                while (--bestlen) {
+                        pos++;
+                        if (pos + SUOUSB_LZ_MIN_MATCH <= size) {
+                                h = lz_hash(&data[pos]);
+                                chain[pos] = head[h];
+                                head[h] = pos;
+                        }
+                }
+                pos++;
+                literal = pos;
+        }
+
+        lzlen += lz_put_literals(&lz[lzlen], &data[literal], size - literal);
+
+        free(head);
+        free(chain);
+
+        return lzlen;
+}
+
+// Milliseconds from an arbitrary point in time, for throughput report
+uint32_t time_ms(void)
+{
+#ifdef _WIN32
+        return GetTickCount();
+#else
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
+
+// Same sequence as do_firmware_update(), but requests are sent in binary frames, so the image is
+// not converted to hex and a chunk can take the whole SUOUSB buffer of the target
+bool do_firmware_update_bin(unsigned char *imagebuf, uint32_t size, uint32_t suousbbuffsz)
+{
+        printf_verbose("do_firmware_update_bin with size=%d and suousbbuffsz=%d\n", size, suousbbuffsz);
+        uint32_t xfered = 0;
+        uint32_t chunksz = suousbbuffsz;
+        bool error = false;
+        char buff[60];
+        DWORD len;
+
+        //SUOUSB_MEM_DEV values as for do_firmware_update(), LSB first
+        const uint8_t suousb_mem_dev_start[] = { 0x00, 0x00, 0x00, 0x13 };
+        const uint8_t suousb_mem_dev_reset[] = { 0x00, 0x00, 0x00, 0xFD };
+        const uint8_t suousb_mem_dev_end[] = { 0x00, 0x00, 0x00, 0xFE };
+        const uint8_t suousb_mem_dev_abort[] = { 0x00, 0x00, 0x00, 0xFF };
+        const uint8_t suousb_write_status_ena_ntfy[] = { 0x01, 0x00 };
+        uint8_t suousb_patch_len[2];
+        const uint8_t suousb_read_meminfo[] = { 0x00 };
+
+        if (size < 64) {   //ensure big enough to have a header! (user not insane)
+                return true;
+        }
+
+        if ((chunksz < 64) || (chunksz > 0xFFFF)) {    //ensure header can fit in single buffer (target not insane)
+                return true;
+        }
+
+        isBinary = true;
+        frame_seq = 0;
+
+        //START UPDATE PROCESS
+        printf_verbose("do_firmware_update_bin: start work\n");
+
+        error = issue_frame_get_response(SUOUSB_FRAME_WRITE_STATUS, suousb_write_status_ena_ntfy,
+                sizeof(suousb_write_status_ena_ntfy), "OK", buff, &len);
+        if (error) {
+                printf_err("Failure to get ok command \n");
+                return error;
+        }
+        //SUOUSB_MEM_DEV, wait for SUOUSB_SERV_STATUS=SUOUSB_IMG_STARTED then OK
+        error = issue_frame_get_response(SUOUSB_FRAME_MEM_DEV, suousb_mem_dev_start,
+                sizeof(suousb_mem_dev_start), "INFO SUOUSB_IMG_STARTED", buff, &len);
+        if (!error) {
+                error = wait_for_specific_response_or_abort("OK", 300, buff, &len);
+        }
+        if (error) {
+                printf_err("Failure at INFO SUOUSB_IMG_STARTED\n");
+                return error;
+        }
+
+        //SUOUSB_RESUME - target holding part of this image from an interrupted transfer tells
+        //where to continue from. Older targets answer ERROR, then the whole image is sent.
+        error = issue_frame_get_response(SUOUSB_FRAME_RESUME, imagebuf, SUOUSB_RESUME_HDR_SIZE,
+                "OK", buff, &len);
+        if (!error) {
+                xfered = strtoul(&buff[3], NULL, 10); //i.e. 'O', 'K', ' ', offset
+                if (xfered > size) {
+                        xfered = 0;
+                }
+        } else if (0 == strncmp(buff, "ERROR ", 6)) {
+                error = false;
+        } else {
+                printf_err("do_firmware_update_bin: SUOUSB_RESUME error\n");
+                return error;
+        }
+        if (xfered) {
+                printf_err("Resuming transfer at %d of %d bytes\n", xfered, size);
+        }
+
+        //SUOUSB_DELTA - target running the base image rebuilds the image from the delta against
+        //it. Otherwise, or for older targets, it answers ERROR and the whole image is sent.
+        if (deltabuf && !xfered) {
+                error = issue_frame_get_response(SUOUSB_FRAME_DELTA, basebuf, SUOUSB_RESUME_HDR_SIZE,
+                        "OK", buff, &len);
+                if (!error) {
+                        printf_err("Sending delta of %d bytes for %d bytes of image\n", deltasize, size);
+                        imagebuf = deltabuf;
+                        size = deltasize;
+                } else if (0 == strncmp(buff, "ERROR ", 6)) {
+                        printf_err("Target does not run the base image, sending whole image\n");
+                        error = false;
+                } else {
+                        printf_err("do_firmware_update_bin: SUOUSB_DELTA error\n");
+                        return error;
+                }
+        }
+
+        //SUOUSB_COMPRESS - data from here on are sent compressed, the target decompresses them
+        //before processing. Older targets answer ERROR, then they are sent as they are.
+        if (compress && (xfered < size)) {
+                const uint8_t codec = SUOUSB_LZ_CODEC;
+                uint32_t lzsize = 0;
+
+                free(lzbuf);
+                lzbuf = malloc(size + (size - xfered) / SUOUSB_LZ_LITERALS_MAX + 1);
+                if (lzbuf) {
+                        lzsize = make_lz(&imagebuf[xfered], size - xfered, &lzbuf[xfered]);
+                }
+
+                if (lzsize && (lzsize < size - xfered)) {
+                        error = issue_frame_get_response(SUOUSB_FRAME_COMPRESS, &codec, sizeof(codec),
+                                "OK", buff, &len);
+                        if (!error) {
+                                printf_err("Sending %d bytes compressed to %d bytes\n", size - xfered, lzsize);
+                                //Compressed data start after the resumed bytes, which are not sent
+                                imagebuf = lzbuf;
+                                size = xfered + lzsize;
+                        } else if (0 == strncmp(buff, "ERROR ", 6)) {
+                                printf_err("Target does not support compression, sending data as they are\n");
+                                error = false;
+                        } else {
+                                printf_err("do_firmware_update_bin: SUOUSB_COMPRESS error\n");
+                                return error;
+                        }
+                }
+        }
+        sent = size - xfered;
+
+        printf_verbose("do_firmware_update_bin: sending %d bytes in %d blocks, window %d\n", size, chunksz, window);
+        //Full blocks, then last shorter block
+        while (!error && (xfered < size)) {
+                uint32_t n = ((size - xfered) >= chunksz) ? ((size - xfered) / chunksz) * chunksz : (size - xfered);
+                uint32_t blocksz = (n < chunksz) ? n : chunksz;
+
+                //SUOUSB_PATCH_LEN
+                suousb_patch_len[0] = blocksz & 0xFF;
+                suousb_patch_len[1] = (blocksz >> 8) & 0xFF;
+                error = issue_frame_get_response(SUOUSB_FRAME_PATCH_LEN, suousb_patch_len,
+                        sizeof(suousb_patch_len), "OK", buff, &len);
+                if (error) {
+                        printf_err("do_firmware_update_bin: set up block size %d - ERROR\n", blocksz);
+                        break;
+                }
+
+                //SUOUSB_PATCH_DATA * X
+                printf_verbose("do_firmware_update_bin: send %d bytes @ %d\n", n, xfered);
+                error = send_data_frames(&imagebuf[xfered], n, blocksz, buff, &len);
+                xfered += n;
+        }
+
+        printf_verbose("do_firmware_update_bin: end block processing - %s - remainder:%d\n",
+                        (error ? "ERROR" : "OK"), (size - xfered));
+
+        if (error) {
+                printf_err("Error in do_firmware_update_bin\n");
+                write_frame(SUOUSB_FRAME_MEM_DEV, frame_seq, suousb_mem_dev_abort, sizeof(suousb_mem_dev_abort));
+                return error;
+        }
+        //SUOUSB_MEM_INFO - check size matches, if not abort update
+        error = issue_frame_get_response(SUOUSB_FRAME_READ_MEMINFO, suousb_read_meminfo,
+                sizeof(suousb_read_meminfo), "OK", buff, &len);
+        if (!error) {
+                int length = atoi(&buff[3]); //i.e. 'O', 'K', ' ', value to test
+
+                if (length != size) {
+                        printf_err("ERROR from SUOUSB_READ_MEMINFO\n");
+                        printf_err("LEN?=[%d]\n", length);
+                        printf_err("RAW?=[%s]\n", buff);
+
+                        write_frame(SUOUSB_FRAME_MEM_DEV, frame_seq, suousb_mem_dev_abort, sizeof(suousb_mem_dev_abort));
+                        return true;
+                }
+                printf_verbose("do_firmware_update_bin: SUOUSB_READ_MEMINFO size ok %d %d [%s]\n",
+                                size, length, buff);
+        } else {
+                printf_err("do_firmware_update_bin: SUOUSB_READ_MEMINFO error\n");
+                return error;
+        }
+
+        //SUOUSB_MEM_DEV - End of transfer, receiver verifies image checksum and writes image header
+        printf_verbose("do_firmware_update_bin: send suousb_mem_dev_end\n");
+        error = issue_frame_get_response(SUOUSB_FRAME_MEM_DEV, suousb_mem_dev_end,
+                sizeof(suousb_mem_dev_end), "INFO SUOUSB_CMP_OK", buff, &len);
+        if (error) {
+                printf_err("do_firmware_update_bin: SUOUSB_CMP_OK error\n");
+                return error;
+        }
+        //Consume OK of the end command
+        wait_response(300, buff, &len);
+
+        //SUOUSB_MEM_DEV - System Reboot Command
+        printf_verbose("do_firmware_update_bin: send suousb_mem_dev_reset\n");
+        error = write_frame(SUOUSB_FRAME_MEM_DEV, frame_seq, suousb_mem_dev_reset, sizeof(suousb_mem_dev_reset));
+        if (error) {
+                printf_err("do_firmware_update_bin: suousb_mem_dev_reset error\n");
+        }
+
+        printf_verbose("do_firmware_update_bin: STOP\n");
+
+        return error;
+}
+
 int main(int argc, char **argv)
 {
         int exitCode = 1;
@@ -1140,18 +1810,36 @@ int main(int argc, char **argv)
         size_t actual;
         char clibuff[60];
         bool error;
+        bool forceCli = false;
+        char *basename = NULL;
+        uint32_t start;
+        int i;
 
         printf_err("HOST_USB_UPDATER_VERSION = %d \n", HOST_USB_UPDATER_VERSION);
 
         if (argc < 3) {
-                printf_err("usage: %s <comport> <image_file.img> [-verbose]\n", argv[0]);
+                printf_err("usage: %s <comport> <image_file.img> [-verbose] [-cli] [-window <n>] [-delta <base_image.img>] [-nocompress]\n", argv[0]);
                 return exitCode;
         }
 #ifdef HOST_USB_UPDATER_LOG
         verbose_output = fopen("host_usb_updater.log","wb");
 #endif
-        if (argc > 3) {
-                isVerbose = (strcmp(argv[3], "-verbose") == 0);
+        for (i = 3; i < argc; i++) {
+                if (strcmp(argv[i], "-verbose") == 0) {
+                        isVerbose = true;
+                } else if (strcmp(argv[i], "-cli") == 0) {
+                        forceCli = true;
+                } else if ((strcmp(argv[i], "-window") == 0) && (i + 1 < argc)) {
+                        window = atoi(argv[++i]);
+                        if ((window < 1) || (window > SUOUSB_WINDOW_MAX)) {
+                                printf_err("ERROR: window must be 1 to %d\n", SUOUSB_WINDOW_MAX);
+                                return exitCode;
+                        }
+                } else if ((strcmp(argv[i], "-delta") == 0) && (i + 1 < argc)) {
+                        basename = argv[++i];
+                } else if (strcmp(argv[i], "-nocompress") == 0) {
+                        compress = false;
+                }
         }
 
         hComm = open_serial_port(argv[1]);
@@ -1202,11 +1890,64 @@ int main(int argc, char **argv)
                 goto RESULT;
         }
 
+        if (basename) {
+                struct stat basest;
+
+                printf_verbose("=== Try loading base image for delta ===\n");
+
+                if ((stat(basename, &basest) == -1) || (basest.st_size < SUOUSB_RESUME_HDR_SIZE)) {
+                        printf_err("ERROR: base image\n");
+                        goto RESULT;
+                }
+
+                basebuf = malloc(basest.st_size);
+                deltabuf = malloc(st.st_size + 4);
+                if (!basebuf || !deltabuf) {
+                        printf_err("ERROR: malloc / base image size\n");
+                        goto RESULT;
+                }
+
+                fp = fopen(basename, "rb");
+                if (fp == 0) {
+                        printf_err("ERROR: fopen\n");
+                        goto RESULT;
+                }
+
+                actual = fread(basebuf, 1, basest.st_size, fp);
+                fclose(fp);
+                if (basest.st_size != actual) {
+                        printf_err("ERROR: fread (req:%ld actual:%ld)\n", basest.st_size, actual);
+                        goto RESULT;
+                }
+
+                deltasize = make_delta(basebuf, basest.st_size, buf, st.st_size, deltabuf);
+                printf_err("Delta against base image: %d bytes, %d%% of image\n", deltasize,
+                        (int) (((uint64_t) deltasize * 100) / st.st_size));
+
+                //Delta not worth it, e.g. base image unrelated
+                if ((deltasize == 0) || (deltasize >= st.st_size)) {
+                        free(deltabuf);
+                        deltabuf = NULL;
+                }
+        }
+
         printf_verbose("=== Try to perform USB firmware update ===\n");
+        sent = st.st_size;
 
         //get size of SUOUSB buffer
         if (issue_command("getsuousbbuffsz", clibuff, 60)) {
                 uint32_t suousbbuffsz = atoi(clibuff);
+
+                start = time_ms();
+
+                //Binary frames are received straight into the SUOUSB buffer of the target, no alloc
+                //needed. Older targets answer ERROR, then fall back to hex CLI lines.
+                if (!forceCli && issue_command("fwupdatebin", NULL, 0)) {
+                        exitCode = do_firmware_update_bin(buf, st.st_size, suousbbuffsz) ? 1 : 0;
+                        goto DONE;
+                }
+                printf_verbose("=== Binary frames not used, fall back to CLI ===\n");
+
                 //Allocate same as SUOUSB buffer as working buffer for data transfer
                 //We send hex, but it will be translated into binary into this working buffer
                 //The target will make sure the CLI buffer is big enough for holding enough
@@ -1227,7 +1968,20 @@ int main(int argc, char **argv)
                 printf_err("ERROR: getsuousbbuffsz\n");
         }
 
+DONE:
+        if (exitCode == 0) {
+                uint32_t elapsed = time_ms() - start;
+
+                //Only the bytes sent count, not the ones resumed from, rebuilt from the base image
+                //or decompressed
+                printf_err("Transferred %ld bytes in %d.%03d s, %d KB/s\n", (long) sent,
+                        elapsed / 1000, elapsed % 1000,
+                        elapsed ? (uint32_t) (((uint64_t) sent * 1000) / (1024 * (uint64_t) elapsed)) : 0);
+        }
         free(buf);
+        free(basebuf);
+        free(deltabuf);
+        free(lzbuf);
 
 #ifdef _WIN32
         for (int i=5; i>=0; i--){